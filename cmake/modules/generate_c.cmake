@@ -29,6 +29,7 @@ file(APPEND ${OUTPUT_HEADER_FILE} "extern \"C\" {\n")
 file(APPEND ${OUTPUT_HEADER_FILE} "#endif\n")
 file(APPEND ${OUTPUT_HEADER_FILE} "typedef void* OPI_Host;\n")
 file(APPEND ${OUTPUT_HEADER_FILE} "typedef void (*OPI_ErrorCallback)(OPI_Host host, int errorcode, void* privatedata);\n")
+file(APPEND ${OUTPUT_HEADER_FILE} "typedef void (*OPI_PropagationCallback)(void* handle, int errorcode, void* privatedata);\n")
 
 macro(BEGIN_STRUCTURE TYPENAME)
 file(APPEND ${OUTPUT_HEADER_FILE} "typedef struct OPI_${TYPENAME}_t\n")
@@ -77,9 +78,9 @@ macro(PARSE_TYPE TYPE)
   elseif(${${TYPE}} STREQUAL "const char*")
   elseif(${${TYPE}} STREQUAL "std::string")
     set(TYPE_IS_STRING 1)
-  elseif(${${TYPE}} STREQUAL "PropagationMode")
-    set(TYPE_IS_ENUM 1)
-    set(${TYPE} "OPI_PropagationMode")
+  elseif(${${TYPE}} STREQUAL "PropagationMode" OR ${${TYPE}} STREQUAL "ErrorCode")
+    set(TYPE_IS_ENUM ${${TYPE}})
+    set(${TYPE} "OPI_${${TYPE}}")
   else()
     if(${${TYPE}} MATCHES "(.*)&")
       #string(REGEX MATCH "(.*)&" RESULT ${${TYPE}})
@@ -116,7 +117,7 @@ macro(PARSE_FUNCTION_ARGS ARGS)
           if(REFCAST)
             set(NAME "*(static_cast<OPI::${REFCAST}*>(${NAME}))")
           elseif(TYPE_IS_ENUM)
-              set(NAME "static_cast<OPI::PropagationMode>(${NAME})")
+              set(NAME "static_cast<OPI::${TYPE_IS_ENUM}>(${NAME})")
           elseif(${TYPE} STREQUAL "OPI_IndexList")
               set(NAME "static_cast<OPI::IndexList*>(${NAME})")
           endif()
@@ -7,7 +7,8 @@ file(APPEND ${OUTPUT_FILE} " ***************************************************
 file(APPEND ${OUTPUT_FILE} "#ifndef OPI_TYPES_H\n")
 file(APPEND ${OUTPUT_FILE} "#define OPI_TYPES_H\n")
 file(APPEND ${OUTPUT_FILE} "extern \"C\" {typedef void* OPI_Host;\n")
-file(APPEND ${OUTPUT_FILE} "typedef void (*OPI_ErrorCallback)(OPI_Host host, int errorcode, void* privatedata);}\n")
+file(APPEND ${OUTPUT_FILE} "typedef void (*OPI_ErrorCallback)(OPI_Host host, int errorcode, void* privatedata);\n")
+file(APPEND ${OUTPUT_FILE} "typedef void (*OPI_PropagationCallback)(void* handle, int errorcode, void* privatedata);}\n")
 file(APPEND ${OUTPUT_FILE} "namespace OPI\n")
 file(APPEND ${OUTPUT_FILE} "{\n")
 file(APPEND ${OUTPUT_FILE} "/// @addtogroup CPP_API_GROUP\n")
@@ -77,6 +77,8 @@ macro(PARSE_TYPE TYPE)
     set(${TYPE} "TYPE(C_PTR)")
   elseif(${${TYPE}} STREQUAL "ErrorCallback")
     set(${TYPE} "TYPE(C_FUNPTR)")
+  elseif(${${TYPE}} STREQUAL "PropagationCallback")
+    set(${TYPE} "TYPE(C_FUNPTR)${VALUE_DEF}")
   elseif(${${TYPE}} STREQUAL "int")
     set(${TYPE} "INTEGER(C_INT)${VALUE_DEF}")
   elseif(${${TYPE}} STREQUAL "int*")
@@ -90,7 +92,7 @@ macro(PARSE_TYPE TYPE)
   elseif(${${TYPE}} STREQUAL "double*")
     set(${TYPE} "REAL(C_DOUBLE)")
   elseif(${${TYPE}} STREQUAL "ErrorCode")
-    set(${TYPE} "INTEGER(C_INT)")
+    set(${TYPE} "INTEGER(C_INT)${VALUE_DEF}")
   elseif(${${TYPE}} STREQUAL "std::string")
     set(OPI_STRING_VAL 1)
     set(${TYPE} "TYPE(C_PTR)${VALUE_DEF}")
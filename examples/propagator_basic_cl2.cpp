@@ -53,20 +53,14 @@ class BasicCL: public OPI::Propagator
 			// cl_int for OpenCL error reporting
 			cl_int err;
 
-            // Create the kernel program. OPI's OpenCL support module returns the context
-            // and device pointers as C types - to write a propagator using the OpenCL C++
-            // API, these need to be wrapped into their respective C++ objects.
-            // retainOwnership needs to be set to true to let OPI manage the context.
-            cl::Context context = cl::Context(*clSupport->getOpenCLContext(), true);
-            cl::Program program = cl::Program(context, kernelCode, false, &err);
-            if (err != CL_SUCCESS) std::cout << "Error creating program: " << err << std::endl;
-
-            // Build the kernel for the default device. Again, the C type from OPI's OpenCL
-            // module needs to be wrapped into the cl::Device class. Again, make sure
-            // retainOwnership is true to let OPI manage the device.
-            cl::Device device = cl::Device(*clSupport->getOpenCLDevice(), true);
-            err = program.build({device});
-            if (err != CL_SUCCESS) std::cout << "Error building: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << std::endl;
+            // Build the kernel program. OPI's OpenCL support module compiles it for the current
+            // device and caches the binary on disk, so later runs of the host skip the compilation.
+            // The program is returned as a C type - to write a propagator using the OpenCL C++
+            // API, it needs to be wrapped into its C++ object. retainObject is false since the
+            // plugin owns the returned program.
+            cl_program builtProgram = clSupport->buildOpenCLProgram(kernelCode.c_str());
+            if (!builtProgram) std::cout << "Error building program" << std::endl;
+            cl::Program program = cl::Program(builtProgram, false);
 
 			// create the kernel object
             cl::Kernel kernel = cl::Kernel(program, "cl_propagate", &err);
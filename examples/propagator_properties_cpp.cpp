@@ -92,6 +92,9 @@ class PropertiesCPP: public OPI::Propagator
         // It is important to remember that the host can set new property values at any
         // time. If you are using properties that affect the propagation you need to
         // make sure to check for updated values at every propagation step.
+        // Properties without a member variable, e.g. ones created from a config file, can be
+        // read with getPropertyDouble(index) and friends. Resolve the index once with
+        // getPropertyIndex() instead of looking the name up at every step.
         virtual OPI::ErrorCode runPropagation(OPI::Population& population, double julian_day, double dt )
 		{
 			std::cout << "Test int: " << testproperty_int << std::endl;
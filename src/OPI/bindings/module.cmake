@@ -11,6 +11,7 @@ BIND_CLASS( Module
 
   FUNCTION getPropertyCount RETURN int
   FUNCTION getPropertyName ARGS int index RETURN std::string
+  FUNCTION getPropertyIndex ARGS std::string name RETURN int
   FUNCTION getPropertyType OVERLOAD_ALIAS getPropertyTypeByString ARGS std::string name RETURN PropertyType
   FUNCTION getPropertyType OVERLOAD_ALIAS getPropertyTypeByIndex ARGS int index RETURN PropertyType
 
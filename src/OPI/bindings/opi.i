@@ -83,3 +83,80 @@ def getCovariance(index):
         void setObjectProperties(int index, ObjectProperties props) { if (index < $self->getSize()) $self->getObjectProperties()[index] = props; }
         void setCovariance(int index, Covariance c) { if (index < $self->getSize()) $self->getCovariance()[index] = c; }
 };
+
+// Bulk access: getBuffer(type) wraps the host data of a field in a writable buffer without
+// copying, and getArray(type) views it as a NumPy structured array, e.g.
+//   orbits = population.getArray(OPI.DATA_ORBIT)
+//   orbits['semi_major_axis'] += 10.0
+//   population.update(OPI.DATA_ORBIT)
+// Call update() after writing so the changes are transferred to the devices. The views are
+// only valid until the Population is resized or destroyed.
+
+%{
+static PyObject* opi_buffer_from_memory(void* data, Py_ssize_t size)
+{
+#if PY_VERSION_HEX >= 0x03030000
+	return PyMemoryView_FromMemory((char*)data, size, PyBUF_WRITE);
+#else
+	return PyBuffer_FromReadWriteMemory(data, size);
+#endif
+}
+%}
+
+%extend OPI::Population {
+	PyObject* getBuffer(int type)
+	{
+		size_t size = (size_t)$self->getSize();
+		void* data = 0;
+		switch (type)
+		{
+			case OPI::DATA_ORBIT: data = $self->getOrbit(); size *= sizeof(OPI::Orbit); break;
+			case OPI::DATA_PROPERTIES: data = $self->getObjectProperties(); size *= sizeof(OPI::ObjectProperties); break;
+			case OPI::DATA_POSITION: data = $self->getPosition(); size *= sizeof(OPI::Vector3); break;
+			case OPI::DATA_VELOCITY: data = $self->getVelocity(); size *= sizeof(OPI::Vector3); break;
+			case OPI::DATA_ACCELERATION: data = $self->getAcceleration(); size *= sizeof(OPI::Vector3); break;
+			case OPI::DATA_EPOCH: data = $self->getEpoch(); size *= sizeof(OPI::Epoch); break;
+			case OPI::DATA_COVARIANCE: data = $self->getCovariance(); size *= sizeof(OPI::Covariance); break;
+			case OPI::DATA_BYTES: data = $self->getBytes(); size *= $self->getByteArraySize(); break;
+			default: break;
+		}
+		if (!data || size == 0) Py_RETURN_NONE;
+		return opi_buffer_from_memory(data, (Py_ssize_t)size);
+	}
+
+	%pythoncode %{
+def getArray(self, type):
+    import numpy
+    buffer = self.getBuffer(type)
+    if buffer is None:
+        return None
+    if type == DATA_BYTES:
+        return numpy.frombuffer(buffer, dtype=numpy.uint8).reshape(self.getSize(), self.getByteArraySize())
+    return numpy.frombuffer(buffer, dtype=getDtype(type))
+%}
+};
+
+%pythoncode %{
+def getDtype(type):
+    """Returns the NumPy dtype matching the memory layout of a Population data type."""
+    import numpy
+    vector = ['x', 'y', 'z']
+    covariance = ['k%d_k%d' % (i, j) for i in range(1, 7) for j in range(1, i + 1)]
+    for d in (1, 2):
+        covariance += ['d%d_k%d' % (d, j) for j in range(1, 7)] + ['d%d_d%d' % (d, j) for j in range(1, d + 1)]
+    fields = {
+        DATA_ORBIT: ['semi_major_axis', 'eccentricity', 'inclination', 'raan', 'arg_of_perigee', 'mean_anomaly'],
+        DATA_PROPERTIES: ['mass', 'diameter', 'area_to_mass', 'drag_coefficient', 'reflectivity'],
+        DATA_POSITION: vector,
+        DATA_VELOCITY: vector,
+        DATA_ACCELERATION: vector,
+        DATA_EPOCH: ['beginning_of_life', 'end_of_life', 'current_epoch'],
+        DATA_COVARIANCE: covariance
+    }
+    if type not in fields:
+        return None
+    layout = [(name, 'f8') for name in fields[type]]
+    if type == DATA_PROPERTIES:
+        layout.append(('id', 'i4'))
+    return numpy.dtype(layout, align=True)
+%}
@@ -1,5 +1,16 @@
 DECLARE_CLASS( IndexList )
 
+BIND_CLASS( PropagationHandle
+  DESTRUCTOR NAME "destroyPropagationHandle"
+  FUNCTION wait RETURN ErrorCode
+  FUNCTION isFinished RETURN int
+  FUNCTION getResult RETURN ErrorCode
+  FUNCTION setCallback ARGS PropagationCallback callback void* privatedata
+  FUNCTION complete ARGS ErrorCode result
+)
+
 BIND_CLASS( Propagator
   FUNCTION propagate OVERLOAD_ALIAS propagateAll ARGS Population& population double julian_day double dt PropagationMode mode IndexList* indices RETURN ErrorCode
+  FUNCTION propagateFast ARGS Population& population double julian_day double dt PropagationMode mode IndexList* indices RETURN ErrorCode
+  FUNCTION propagateAsync ARGS Population& population double julian_day double dt PropagationMode mode IndexList* indices RETURN PropagationHandle
 )
@@ -230,6 +230,66 @@ BEGIN_ENUM(DataType)
   ENUM_VALUE(DATA_PARTIALS 8)
 END_ENUM(DataType)
 
+COMMENT("This type contains bit flags for selecting a combination of data values")
+BEGIN_ENUM_AS_INT(FieldMask)
+  ENUM_VALUE(FIELD_NONE 0)
+  ENUM_VALUE(FIELD_ORBIT 1)
+  ENUM_VALUE(FIELD_PROPERTIES 2)
+  ENUM_VALUE(FIELD_POSITION 4)
+  ENUM_VALUE(FIELD_VELOCITY 8)
+  ENUM_VALUE(FIELD_ACCELERATION 16)
+  ENUM_VALUE(FIELD_EPOCH 32)
+  ENUM_VALUE(FIELD_COVARIANCE 64)
+  ENUM_VALUE(FIELD_BYTES 128)
+  ENUM_VALUE(FIELD_PARTIALS 256)
+  COMMENT("Object names (host only)")
+  ENUM_VALUE(FIELD_NAMES 512)
+  ENUM_VALUE(FIELD_ALL 1023)
+END_ENUM(FieldMask)
+
+COMMENT("This type contains bit flags for the findings of Population::validate")
+BEGIN_ENUM_AS_INT(ValidationFlags)
+  ENUM_VALUE(VALIDATION_NONE 0)
+  COMMENT("Object properties contain NaN")
+  ENUM_VALUE(VALIDATION_PROPERTIES_NAN 1)
+  ENUM_VALUE(VALIDATION_DRAG_COEFFICIENT 2)
+  ENUM_VALUE(VALIDATION_MASS 4)
+  ENUM_VALUE(VALIDATION_DIAMETER 8)
+  ENUM_VALUE(VALIDATION_AREA_TO_MASS 16)
+  ENUM_VALUE(VALIDATION_REFLECTIVITY 32)
+  COMMENT("Orbit contains NaN")
+  ENUM_VALUE(VALIDATION_ORBIT_NAN 64)
+  COMMENT("Semi major axis below Earth radius without end of life")
+  ENUM_VALUE(VALIDATION_DECAYED 128)
+  ENUM_VALUE(VALIDATION_ECCENTRICITY 256)
+  COMMENT("Angles outside of -2PI to 2PI")
+  ENUM_VALUE(VALIDATION_ANGLES 512)
+  COMMENT("End of life precedes beginning of life")
+  ENUM_VALUE(VALIDATION_LIFETIME 1024)
+  COMMENT("Position inside Earth without end of life")
+  ENUM_VALUE(VALIDATION_INSIDE_EARTH 2048)
+  ENUM_VALUE(VALIDATION_VELOCITY 4096)
+  COMMENT("Position set but no velocity")
+  ENUM_VALUE(VALIDATION_NO_VELOCITY 8192)
+  COMMENT("Neither state vector nor orbit set")
+  ENUM_VALUE(VALIDATION_NO_STATE 16384)
+  COMMENT("Population only: some objects have a current epoch while others do not")
+  ENUM_VALUE(VALIDATION_MIXED_EPOCHS 32768)
+END_ENUM(ValidationFlags)
+
+COMMENT("This type contains bit flags for the events found by an EventDetector")
+BEGIN_ENUM_AS_INT(EventFlags)
+  ENUM_VALUE(EVENT_NONE 0)
+  COMMENT("Perigee altitude below the threshold")
+  ENUM_VALUE(EVENT_PERIGEE 1)
+  COMMENT("Altitude of the position below the threshold")
+  ENUM_VALUE(EVENT_ALTITUDE 2)
+  COMMENT("End of life reached at the current epoch")
+  ENUM_VALUE(EVENT_END_OF_LIFE 4)
+  COMMENT("Flagged by an EventPredicate")
+  ENUM_VALUE(EVENT_CUSTOM 8)
+END_ENUM(EventFlags)
+
 COMMENT("This type contains all available device types")
 BEGIN_ENUM_AS_INT(Device)
   ENUM_VALUE(DEVICE_NOT_SET -1)
@@ -296,6 +356,28 @@ BEGIN_ENUM(CovarianceType)
   ENUM_VALUE(CV_EQUINOCTIALS_NO_DYNAMICS 5)
 END_ENUM(CovarianceType)
 
+COMMENT("This type selects the storage variant of the covariances returned by Population::getCompactCovariance")
+BEGIN_ENUM(CovarianceStorage)
+  COMMENT("All 36 elements of the packed lower triangle as doubles, the layout of the Covariance type.")
+  ENUM_VALUE(COVARIANCE_FULL 0)
+  COMMENT("The 21 elements of the 6x6 block of the kinematic parameters as doubles (k1_k1 to k6_k6).")
+  ENUM_VALUE(COVARIANCE_STATE_ONLY 1)
+  COMMENT("All 36 elements as floats.")
+  ENUM_VALUE(COVARIANCE_FLOAT 2)
+  COMMENT("The 21 elements of the kinematic block as floats.")
+  ENUM_VALUE(COVARIANCE_STATE_ONLY_FLOAT 3)
+END_ENUM(CovarianceStorage)
+
+COMMENT("This type selects the operation of Population::reduce")
+BEGIN_ENUM(ReductionOperation)
+  COMMENT("The smallest valid value.")
+  ENUM_VALUE(REDUCTION_MIN 0)
+  COMMENT("The largest valid value.")
+  ENUM_VALUE(REDUCTION_MAX 1)
+  COMMENT("The sum of all valid values.")
+  ENUM_VALUE(REDUCTION_SUM 2)
+END_ENUM(ReductionOperation)
+
 COMMENT("This type contains all error values")
 BEGIN_ENUM(ErrorCode)
   ENUM_VALUE(SUCCESS 0)
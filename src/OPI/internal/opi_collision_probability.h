@@ -0,0 +1,151 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_COLLISION_PROBABILITY_H
+#define OPI_COLLISION_PROBABILITY_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include "../opi_datatypes.h"
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Probability of collision of CollisionDetection::computeCollisionProbabilities, shared by
+	// the host implementation and the CUDA kernel.
+
+	//! Number of Simpson intervals across the hard-body circle
+	const int COLLISION_PROBABILITY_INTERVALS = 64;
+	//! Doubles per pair in the results: miss distance, time of closest approach, probability
+	const int COLLISION_PROBABILITY_RESULTS = 3;
+
+	//! Returns a unit vector perpendicular to the unit vector u
+	OPI_CUDA_PREFIX inline Vector3 encounterPerpendicular(const Vector3& u)
+	{
+		Vector3 axis(0.0, 0.0, 0.0);
+		const double ax = fabs(u.x), ay = fabs(u.y), az = fabs(u.z);
+		if (ax <= ay && ax <= az) axis.x = 1.0;
+		else if (ay <= az) axis.y = 1.0;
+		else axis.z = 1.0;
+		const Vector3 p = cross(u, axis);
+		return p / length(p);
+	}
+
+	//! Returns the mass of a 1D Gaussian with mean m and deviation s within [-h, h]
+	OPI_CUDA_PREFIX inline double encounterIntervalMass(double m, double h, double s)
+	{
+		if (s <= 0.0) return (fabs(m) < h) ? 1.0 : 0.0;
+		return 0.5 * (erf((h - m) / (M_SQRT2 * s)) + erf((h + m) / (M_SQRT2 * s)));
+	}
+
+	//! Returns the element (i, j) of the position block of a packed covariance
+	OPI_CUDA_PREFIX inline double positionCovariance(const Covariance& c, int i, int j)
+	{
+		const double* v = &c.k1_k1;
+		return (i >= j) ? v[i * (i + 1) / 2 + j] : v[j * (j + 1) / 2 + i];
+	}
+
+	//! Returns the probability of collision of two objects moving on straight lines
+	/** The relative motion is assumed to be linear during the encounter. The combined position
+	 * covariance, null for no uncertainty, is projected into the plane perpendicular to the
+	 * relative velocity and the resulting 2D Gaussian is integrated over the circle of the
+	 * combined hard-body radius. missDistance and time receive the distance and time of closest
+	 * approach, relative to the given states.
+	 */
+	OPI_CUDA_PREFIX inline double collisionProbability(const Vector3& p1, const Vector3& v1, const Vector3& p2, const Vector3& v2,
+													  const Covariance* c1, const Covariance* c2, double radius,
+													  double& missDistance, double& time)
+	{
+		const Vector3 r = p2 - p1;
+		const Vector3 v = v2 - v1;
+		const double vv = v * v;
+		time = (vv > 0.0) ? -(r * v) / vv : 0.0;
+		const Vector3 m = r + v * time;
+		missDistance = length(m);
+		if (radius <= 0.0) return 0.0;
+
+		// encounter plane: x points to the miss vector, the relative velocity is its normal
+		Vector3 ex, ez;
+		if (missDistance > 0.0)
+		{
+			ex = m / missDistance;
+			ez = (vv > 0.0) ? v / sqrt(vv) : encounterPerpendicular(ex);
+		}
+		else
+		{
+			ez = (vv > 0.0) ? v / sqrt(vv) : Vector3(0.0, 0.0, 1.0);
+			ex = encounterPerpendicular(ez);
+		}
+		const Vector3 ey = cross(ez, ex);
+
+		// combined covariance projected into the plane
+		const double e[2][3] = { { ex.x, ex.y, ex.z }, { ey.x, ey.y, ey.z } };
+		double s[2][2] = { { 0.0, 0.0 }, { 0.0, 0.0 } };
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+			{
+				const double c = (c1 ? positionCovariance(*c1, i, j) : 0.0) + (c2 ? positionCovariance(*c2, i, j) : 0.0);
+				s[0][0] += e[0][i] * c * e[0][j];
+				s[0][1] += e[0][i] * c * e[1][j];
+				s[1][1] += e[1][i] * c * e[1][j];
+			}
+
+		// principal axes of the projected covariance
+		const double mean = 0.5 * (s[0][0] + s[1][1]);
+		const double spread = sqrt(0.25 * (s[0][0] - s[1][1]) * (s[0][0] - s[1][1]) + s[0][1] * s[0][1]);
+		const double theta = 0.5 * atan2(2.0 * s[0][1], s[0][0] - s[1][1]);
+		const double sx = sqrt(fmax(mean + spread, 0.0));
+		const double sy = sqrt(fmax(mean - spread, 0.0));
+		const double mx = missDistance * cos(theta);
+		const double my = -missDistance * sin(theta);
+		if (sx <= 0.0) return (missDistance < radius) ? 1.0 : 0.0;
+
+		// integrate over x = -radius cos(phi), which removes the square root at the edges of the
+		// circle; the range is limited to where the Gaussian along x is not negligible
+		const double lower = fmax(-radius, mx - 8.0 * sx);
+		const double upper = fmin(radius, mx + 8.0 * sx);
+		if (lower >= upper) return 0.0;
+		const double phi0 = acos(-lower / radius);
+		const double phi1 = acos(-upper / radius);
+		const double step = (phi1 - phi0) / COLLISION_PROBABILITY_INTERVALS;
+		double sum = 0.0;
+		for (int k = 0; k <= COLLISION_PROBABILITY_INTERVALS; k++)
+		{
+			const double phi = phi0 + k * step;
+			const double x = -radius * cos(phi);
+			const double h = radius * sin(phi);
+			const double u = (x - mx) / sx;
+			const double f = exp(-0.5 * u * u) * encounterIntervalMass(my, h, sy) * h;
+			const double weight = (k == 0 || k == COLLISION_PROBABILITY_INTERVALS) ? 1.0 : ((k % 2) ? 4.0 : 2.0);
+			sum += weight * f;
+		}
+		const double probability = sum * step / 3.0 / (sqrt(2.0 * M_PI) * sx);
+		return fmin(fmax(probability, 0.0), 1.0);
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
@@ -0,0 +1,99 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_device_budget.h"
+#include "../opi_host.h"
+#include <algorithm>
+namespace OPI
+{
+	// orders eviction candidates from the least to the most recently used
+	static bool usedEarlier(const std::pair<unsigned long long, DeviceMirror*>& a, const std::pair<unsigned long long, DeviceMirror*>& b)
+	{
+		return a.first < b.first;
+	}
+
+	DeviceMemoryBudget::DeviceMemoryBudget():
+		limit(0),
+		clock(0)
+	{
+	}
+
+	void DeviceMemoryBudget::setLimit(size_t bytes)
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		limit = bytes;
+		// a lower limit takes effect right away
+		if(limit > 0) reserve(0, 0);
+	}
+
+	size_t DeviceMemoryBudget::getLimit() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		return limit;
+	}
+
+	void DeviceMemoryBudget::add(DeviceMirror* mirror)
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		mirrors.insert(mirror);
+	}
+
+	void DeviceMemoryBudget::remove(DeviceMirror* mirror)
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		mirrors.erase(mirror);
+	}
+
+	void DeviceMemoryBudget::reserve(DeviceMirror* mirror, size_t bytes)
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		if(limit == 0) return;
+		size_t used = getUsedBytes();
+		if(used + bytes <= limit) return;
+
+		std::vector<std::pair<unsigned long long, DeviceMirror*> > candidates;
+		for(std::set<DeviceMirror*>::const_iterator itr = mirrors.begin(); itr != mirrors.end(); ++itr) {
+			DeviceMirror* candidate = *itr;
+			if(candidate->deviceBytes == 0 || candidate == mirror || (mirror && mirror->owner && candidate->owner == mirror->owner)) continue;
+			candidates.push_back(std::make_pair(candidate->lastUse.load(), candidate));
+		}
+		std::sort(candidates.begin(), candidates.end(), usedEarlier);
+		for(size_t i = 0; i < candidates.size() && used + bytes > limit; i++) {
+			// writing back a mirror may create and destroy others
+			if(mirrors.find(candidates[i].second) == mirrors.end()) continue;
+			const size_t released = candidates[i].second->evictDevices();
+			used -= std::min(used, released);
+		}
+	}
+
+	std::vector<DeviceMemoryUsage> DeviceMemoryBudget::getUsage() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		std::vector<DeviceMemoryUsage> usage;
+		for(std::set<DeviceMirror*>::const_iterator itr = mirrors.begin(); itr != mirrors.end(); ++itr)
+			if((*itr)->deviceBytes > 0) (*itr)->appendUsage(usage);
+		return usage;
+	}
+
+	size_t DeviceMemoryBudget::getUsedBytes() const
+	{
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		size_t used = 0;
+		for(std::set<DeviceMirror*>::const_iterator itr = mirrors.begin(); itr != mirrors.end(); ++itr)
+			used += (*itr)->deviceBytes;
+		return used;
+	}
+}
@@ -0,0 +1,124 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_DEVICE_BUDGET_H
+#define OPI_DEVICE_BUDGET_H
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <vector>
+namespace OPI
+{
+	struct DeviceMemoryUsage;
+
+	//! A recursive mutex that can tell whether any thread holds it
+	/** The budget must not release a data object that the evicting thread itself is using
+	 * further up its call stack, which a plain recursive try_lock would allow.
+	 */
+	class MirrorMutex
+	{
+		public:
+			MirrorMutex(): depth(0) { }
+			void lock() { mutex.lock(); depth++; }
+			bool try_lock() { if(!mutex.try_lock()) return false; depth++; return true; }
+			void unlock() { depth--; mutex.unlock(); }
+			//! Locks the mutex only if no thread holds it, including the calling one
+			bool try_lock_unused()
+			{
+				if(!mutex.try_lock()) return false;
+				if(depth > 0) { mutex.unlock(); return false; }
+				depth++;
+				return true;
+			}
+		private:
+			std::recursive_mutex mutex;
+			// number of nested locks, only accessed while holding the mutex
+			int depth;
+	};
+
+	/**
+	 * @brief A data object holding device memory that the Host may release
+	 * @ingroup CPP_API_INTERNAL_GROUP
+	 *
+	 * Implemented by SynchronizedData, which keeps deviceBytes up to date and sets lastUse
+	 * on every device access.
+	 */
+	class DeviceMirror
+	{
+		public:
+			DeviceMirror(const void* owningObject): owner(owningObject), deviceBytes(0), lastUse(0), lastDevice(0) { }
+			virtual ~DeviceMirror() { }
+			//! Releases all device memory, copying data that is newer on a device to the host first
+			/** Returns the number of bytes released, zero if the mirror is in use by another thread
+			 * or cannot be released, e.g. because it is split into slices.
+			 */
+			virtual size_t evictDevices() = 0;
+			//! Adds one entry per device holding memory to usage
+			/** Must not block on the mirror, since the budget lock is held while this is called
+			 * and allocating threads take the locks in the opposite order.
+			 */
+			virtual void appendUsage(std::vector<DeviceMemoryUsage>& usage) = 0;
+
+			//! The object the data belongs to, mirrors of the same object are not evicted for each other
+			const void* owner;
+			//! Bytes of device memory currently held
+			std::atomic<size_t> deviceBytes;
+			//! Value of the budget's clock at the last device access
+			std::atomic<unsigned long long> lastUse;
+			//! The device accessed last, reported for mirrors that are in use
+			std::atomic<int> lastDevice;
+	};
+
+	/**
+	 * @brief Keeps the device memory of all data objects of a Host below a limit
+	 * @ingroup CPP_API_INTERNAL_GROUP
+	 *
+	 * Before a data object allocates device memory, the budget releases the device memory of
+	 * the least recently used objects of other owners until the allocation fits; if that is not
+	 * possible, the allocation exceeds the limit. The budget is thread-safe, mirrors that are
+	 * locked by another thread are skipped.
+	 */
+	class DeviceMemoryBudget
+	{
+		public:
+			DeviceMemoryBudget();
+			//! Sets the maximum number of bytes of device memory, zero for no limit
+			void setLimit(size_t bytes);
+			//! Returns the maximum number of bytes of device memory, zero for no limit
+			size_t getLimit() const;
+			//! Registers a data object
+			void add(DeviceMirror* mirror);
+			//! Unregisters a data object before it is destroyed
+			void remove(DeviceMirror* mirror);
+			//! Returns the next value of the access clock
+			unsigned long long tick() { return ++clock; }
+			//! Makes room for an allocation of the given size by mirror, evicting other mirrors
+			void reserve(DeviceMirror* mirror, size_t bytes);
+			//! Returns the device memory held by every data object, per device
+			std::vector<DeviceMemoryUsage> getUsage() const;
+			//! Returns the number of bytes of device memory held by all data objects
+			size_t getUsedBytes() const;
+		private:
+			DeviceMemoryBudget(const DeviceMemoryBudget& other);
+			// recursive, since writing back an evicted mirror may allocate
+			mutable std::recursive_mutex mutex;
+			std::set<DeviceMirror*> mirrors;
+			size_t limit;
+			std::atomic<unsigned long long> clock;
+	};
+}
+#endif
@@ -0,0 +1,61 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_EVENTS_H
+#define OPI_EVENTS_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include "opi_validation.h"
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Built-in checks of EventDetector, shared by the host implementation and the CUDA kernel.
+
+	//! Returns the EventFlags of an object; fields without data are passed as null
+	/** Altitudes are measured above VALIDATION_EARTH_RADIUS in km. The end of life is compared
+	 * to the current epoch of the object, or to julianDay if it has none.
+	 */
+	OPI_CUDA_PREFIX inline int detectObjectEvents(const Orbit* orbit, const Vector3* position, const Epoch* epoch,
+												  int criteria, double perigeeAltitude, double altitude, double julianDay)
+	{
+		int flags = EVENT_NONE;
+		if ((criteria & EVENT_PERIGEE) && orbit && !isZero(*orbit)
+			&& orbit->semi_major_axis * (1.0 - orbit->eccentricity) - VALIDATION_EARTH_RADIUS < perigeeAltitude)
+			flags |= EVENT_PERIGEE;
+		if ((criteria & EVENT_ALTITUDE) && position && !isZero(*position)
+			&& length(*position) - VALIDATION_EARTH_RADIUS < altitude)
+			flags |= EVENT_ALTITUDE;
+		if ((criteria & EVENT_END_OF_LIFE) && epoch && epoch->end_of_life > 0.0)
+		{
+			const double now = (epoch->current_epoch > 0.0) ? epoch->current_epoch : julianDay;
+			if (epoch->end_of_life <= now) flags |= EVENT_END_OF_LIFE;
+		}
+		return flags;
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
@@ -0,0 +1,116 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_HOST_ALLOCATOR_H
+#define OPI_HOST_ALLOCATOR_H
+#include "opi_gpusupport.h"
+#include "opi_memory_map.h"
+#include "opi_memory_pool.h"
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <type_traits>
+namespace OPI
+{
+	//! Allocator for host side buffers, optionally using page-locked memory
+	/** If a GpuSupport object is given, memory is allocated through GpuSupport::allocatePinned
+	 * so it can be transferred to the device via DMA, or through GpuSupport::allocateManaged if
+	 * managed memory is requested. Otherwise, memory comes from the given HostMemoryPool, or the
+	 * default heap if there is none.
+	 * An allocator can also hand out a MemoryMap once for the first allocation that fits into it;
+	 * elements in mapped memory are not initialized so they keep the contents of the file.
+	 */
+	template< class T >
+	class HostAllocator
+	{
+		public:
+			typedef T value_type;
+			typedef std::true_type propagate_on_container_move_assignment;
+			typedef std::true_type propagate_on_container_swap;
+
+			HostAllocator(GpuSupport* pinnedSupport = 0, HostMemoryPool* memoryPool = 0, bool managedMemory = false): gpu(pinnedSupport), pool(memoryPool), managed(managedMemory) { }
+			HostAllocator(GpuSupport* pinnedSupport, HostMemoryPool* memoryPool, const std::shared_ptr<MemoryMap>& mappedMemory): gpu(pinnedSupport), pool(memoryPool), managed(false), mapped(mappedMemory) { }
+			template< class U >
+			HostAllocator(const HostAllocator<U>& other): gpu(other.gpu), pool(other.pool), managed(other.managed), mapped(other.mapped) { }
+
+			T* allocate(std::size_t n)
+			{
+				if(n == 0) return 0;
+				if(mapped && mapped->isValid() && !mapped->isAcquired() && (n * sizeof(T) <= mapped->getSize())) {
+					mapped->acquire();
+					return static_cast<T*>(mapped->getData());
+				}
+				if(gpu) {
+					void* mem = 0;
+					if(managed) gpu->allocateManaged(&mem, n * sizeof(T));
+					else gpu->allocatePinned(&mem, n * sizeof(T));
+					if(!mem) throw std::bad_alloc();
+					return static_cast<T*>(mem);
+				}
+				if(pool) return static_cast<T*>(pool->allocate(n * sizeof(T)));
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			}
+
+			void deallocate(T* mem, std::size_t n)
+			{
+				if(!mem) return;
+				if(isMapped(mem)) mapped->release();
+				else if(gpu && managed) gpu->freeManaged(mem);
+				else if(gpu) gpu->freePinned(mem);
+				else if(pool) pool->deallocate(mem, n * sizeof(T));
+				else ::operator delete(mem);
+			}
+
+			//! Value-initializes new elements, except for those in mapped memory
+			template< class U >
+			void construct(U* p) { if(!isMapped(p)) ::new((void*)p) U(); }
+			template< class U, class... Args >
+			void construct(U* p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+
+			//! Returns true if this allocator hands out page-locked memory
+			bool isPinned() const { return gpu != 0 && !managed; }
+			//! Returns true if this allocator hands out managed memory
+			bool isManaged() const { return gpu != 0 && managed; }
+
+			//! Returns true if the given pointer lies within the mapped memory
+			bool isMapped(const void* p) const
+			{
+				if(!mapped || !mapped->isValid()) return false;
+				const char* begin = static_cast<const char*>(mapped->getData());
+				return (static_cast<const char*>(p) >= begin) && (static_cast<const char*>(p) < begin + mapped->getSize());
+			}
+
+			template< class U >
+			struct rebind { typedef HostAllocator<U> other; };
+
+			//! The GpuSupport used for pinned or managed allocations, zero for pageable memory
+			GpuSupport* gpu;
+			//! The pool pageable memory is taken from, zero for the default heap
+			HostMemoryPool* pool;
+			//! If memory is allocated as managed instead of page-locked memory
+			bool managed;
+			//! Mapped file memory that is used for the first fitting allocation
+			std::shared_ptr<MemoryMap> mapped;
+	};
+
+	template< class T, class U >
+	bool operator==(const HostAllocator<T>& a, const HostAllocator<U>& b) { return (a.gpu == b.gpu) && (a.pool == b.pool) && (a.managed == b.managed) && (a.mapped == b.mapped); }
+	template< class T, class U >
+	bool operator!=(const HostAllocator<T>& a, const HostAllocator<U>& b) { return !(a == b); }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_INTERPOLATION_H
+#define OPI_INTERPOLATION_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include "../opi_datatypes.h"
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Cubic Hermite interpolation of EphemerisCache, shared by the host implementation and the CUDA kernel.
+
+	//! Interpolates the state at fraction s of a segment of h seconds between two samples
+	/** p0, v0 and p1, v1 are the positions and velocities at the begin and end of the segment.
+	 * The result matches both samples exactly and is continuous in position and velocity
+	 * across segments.
+	 */
+	OPI_CUDA_PREFIX inline void hermiteInterpolate(const Vector3& p0, const Vector3& v0, const Vector3& p1, const Vector3& v1,
+												   double h, double s, Vector3& position, Vector3& velocity)
+	{
+		const double s2 = s * s;
+		const double s3 = s2 * s;
+		// basis functions and their derivatives with respect to s
+		const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+		const double h10 = s3 - 2.0 * s2 + s;
+		const double h01 = -2.0 * s3 + 3.0 * s2;
+		const double h11 = s3 - s2;
+		const double d00 = 6.0 * s2 - 6.0 * s;
+		const double d10 = 3.0 * s2 - 4.0 * s + 1.0;
+		const double d01 = -d00;
+		const double d11 = 3.0 * s2 - 2.0 * s;
+		position.x = h00 * p0.x + h10 * h * v0.x + h01 * p1.x + h11 * h * v1.x;
+		position.y = h00 * p0.y + h10 * h * v0.y + h01 * p1.y + h11 * h * v1.y;
+		position.z = h00 * p0.z + h10 * h * v0.z + h01 * p1.z + h11 * h * v1.z;
+		const double rate = (h > 0.0) ? 1.0 / h : 0.0;
+		velocity.x = (d00 * p0.x + d01 * p1.x) * rate + d10 * v0.x + d11 * v1.x;
+		velocity.y = (d00 * p0.y + d01 * p1.y) * rate + d10 * v0.y + d11 * v1.y;
+		velocity.z = (d00 * p0.z + d01 * p1.z) * rate + d10 * v0.z + d11 * v1.z;
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
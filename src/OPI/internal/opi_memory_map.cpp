@@ -0,0 +1,125 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_memory_map.h"
+#include <iostream>
+#ifdef _WIN32
+#include <fstream>
+#include <cstdlib>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+namespace OPI
+{
+	MemoryMap::MemoryMap(const char* filename, size_t offset, size_t length):
+		mapping(0),
+		mappingSize(0),
+		data(0),
+		size(0),
+		acquired(false)
+	{
+		if(length == 0) return;
+#ifdef _WIN32
+		std::ifstream in(filename, std::ifstream::binary);
+		if(in.is_open())
+		{
+			mapping = malloc(length);
+			mappingSize = length;
+			in.seekg(offset);
+			in.read(static_cast<char*>(mapping), length);
+			if(in.good()) data = mapping;
+			else
+			{
+				::free(mapping);
+				mapping = 0;
+			}
+		}
+#else
+		int fd = open(filename, O_RDONLY);
+		if(fd >= 0)
+		{
+			struct stat info;
+			// accessing pages beyond the end of the file would fail, so check the range first
+			if((fstat(fd, &info) == 0) && ((size_t)info.st_size >= offset + length))
+			{
+				// mappings have to start at a page boundary
+				size_t pageSize = sysconf(_SC_PAGESIZE);
+				size_t pageOffset = offset % pageSize;
+				void* pages = mmap(0, length + pageOffset, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset - pageOffset);
+				if(pages != MAP_FAILED)
+				{
+					mapping = pages;
+					mappingSize = length + pageOffset;
+					data = static_cast<char*>(pages) + pageOffset;
+				}
+			}
+			close(fd);
+		}
+#endif
+		if(data) size = length;
+		else std::cout << "Unable to map " << length << " bytes of " << filename << std::endl;
+	}
+
+	MemoryMap::~MemoryMap()
+	{
+		release();
+	}
+
+	bool MemoryMap::isValid() const
+	{
+		return (data != 0);
+	}
+
+	void* MemoryMap::getData() const
+	{
+		return data;
+	}
+
+	size_t MemoryMap::getSize() const
+	{
+		return size;
+	}
+
+	void MemoryMap::acquire()
+	{
+		acquired = true;
+	}
+
+	bool MemoryMap::isAcquired() const
+	{
+		return acquired;
+	}
+
+	void MemoryMap::release()
+	{
+		if(mapping)
+		{
+#ifdef _WIN32
+			::free(mapping);
+#else
+			munmap(mapping, mappingSize);
+#endif
+		}
+		mapping = 0;
+		mappingSize = 0;
+		data = 0;
+		size = 0;
+		acquired = false;
+	}
+}
@@ -0,0 +1,64 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_MEMORY_MAP_H
+#define OPI_MEMORY_MAP_H
+#include <cstddef>
+namespace OPI
+{
+	/**
+	 * @brief A platform-independent wrapper for private (copy-on-write) file mappings
+	 * @ingroup CPP_API_INTERNAL_GROUP
+	 *
+	 * On platforms without mmap the file range is read into heap memory instead.
+	 */
+	class MemoryMap
+	{
+		public:
+			/**
+			 * @brief Maps a range of a file into memory
+			 * @param filename Filename
+			 * @param offset Start of the range
+			 * @param length Number of bytes to map
+			 */
+			MemoryMap(const char* filename, size_t offset, size_t length);
+			~MemoryMap();
+			/**
+			 * @brief Check if the file range was mapped successfully
+			 * @return Success
+			 */
+			bool isValid() const;
+			//! Returns the start of the mapped memory
+			void* getData() const;
+			//! Returns the size of the mapped memory in bytes
+			size_t getSize() const;
+			//! Marks the memory as used by a container
+			void acquire();
+			//! Returns true if the memory is currently used by a container
+			bool isAcquired() const;
+			//! Unmaps the memory once the container no longer needs it
+			void release();
+		private:
+			MemoryMap(const MemoryMap& other);
+			//! Start of the mapped pages, which may begin before the requested range
+			void* mapping;
+			size_t mappingSize;
+			void* data;
+			size_t size;
+			bool acquired;
+	};
+}
+#endif
@@ -0,0 +1,93 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_memory_pool.h"
+#include <new>
+namespace OPI
+{
+	HostMemoryPool::HostMemoryPool():
+		cachedBytes(0),
+		limit(DEFAULT_MEMORY_CACHE_LIMIT)
+	{
+	}
+
+	HostMemoryPool::~HostMemoryPool()
+	{
+		release();
+	}
+
+	void* HostMemoryPool::allocate(size_t bytes)
+	{
+		if(bytes < MINIMUM_BLOCK_SIZE)
+			return ::operator new(bytes);
+		const size_t blockSize = memoryBlockSize(bytes);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			// a slightly larger block is fine, but not one much larger than needed
+			std::multimap<size_t, void*>::iterator itr = blocks.lower_bound(blockSize);
+			if(itr != blocks.end() && itr->first <= blockSize + blockSize / 4) {
+				void* mem = itr->second;
+				cachedBytes -= itr->first;
+				blocks.erase(itr);
+				return mem;
+			}
+		}
+		return ::operator new(blockSize);
+	}
+
+	void HostMemoryPool::deallocate(void* mem, size_t bytes)
+	{
+		if(!mem) return;
+		if(bytes >= MINIMUM_BLOCK_SIZE) {
+			const size_t blockSize = memoryBlockSize(bytes);
+			std::lock_guard<std::mutex> lock(mutex);
+			if(cachedBytes + blockSize <= limit) {
+				blocks.insert(std::make_pair(blockSize, mem));
+				cachedBytes += blockSize;
+				return;
+			}
+		}
+		::operator delete(mem);
+	}
+
+	void HostMemoryPool::setLimit(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		limit = bytes;
+		// drop the largest blocks until the cache fits
+		while(cachedBytes > limit) {
+			std::multimap<size_t, void*>::iterator largest = --blocks.end();
+			cachedBytes -= largest->first;
+			::operator delete(largest->second);
+			blocks.erase(largest);
+		}
+	}
+
+	size_t HostMemoryPool::getCachedBytes() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return cachedBytes;
+	}
+
+	void HostMemoryPool::release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(std::multimap<size_t, void*>::iterator itr = blocks.begin(); itr != blocks.end(); ++itr)
+			::operator delete(itr->second);
+		blocks.clear();
+		cachedBytes = 0;
+	}
+}
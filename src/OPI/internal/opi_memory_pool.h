@@ -0,0 +1,74 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_MEMORY_POOL_H
+#define OPI_MEMORY_POOL_H
+#include <cstddef>
+#include <map>
+#include <mutex>
+namespace OPI
+{
+	//! Default number of bytes kept in the memory caches of a Host
+	static const size_t DEFAULT_MEMORY_CACHE_LIMIT = (size_t)512 << 20;
+
+	//! Returns the size class of an allocation, as used by the memory caches
+	/** Sizes are rounded up to a power of two below one megabyte and to whole megabytes above,
+	 * so buffers of similar size share a class while large allocations waste little memory.
+	 */
+	inline size_t memoryBlockSize(size_t bytes)
+	{
+		const size_t megabyte = (size_t)1 << 20;
+		if(bytes >= megabyte)
+			return (bytes + megabyte - 1) & ~(megabyte - 1);
+		size_t blockSize = 256;
+		while(blockSize < bytes) blockSize <<= 1;
+		return blockSize;
+	}
+
+	/**
+	 * @brief A cache of freed host memory blocks, bucketed by size
+	 * @ingroup CPP_API_INTERNAL_GROUP
+	 *
+	 * Large host buffers of short-lived Populations are handed back to the pool instead of the
+	 * system and reused by later allocations of a similar size, which saves the page faults of
+	 * fresh memory. Small allocations are left to the default heap. The pool is thread-safe.
+	 */
+	class HostMemoryPool
+	{
+		public:
+			HostMemoryPool();
+			~HostMemoryPool();
+			//! Returns a block of at least the given size
+			void* allocate(size_t bytes);
+			//! Returns a block obtained from allocate() with the same size to the pool
+			void deallocate(void* mem, size_t bytes);
+			//! Sets the maximum number of bytes kept in the pool, zero disables caching
+			void setLimit(size_t bytes);
+			//! Returns the number of bytes currently kept in the pool
+			size_t getCachedBytes() const;
+			//! Frees all cached blocks
+			void release();
+		private:
+			HostMemoryPool(const HostMemoryPool& other);
+			//! Allocations below this size are not cached
+			static const size_t MINIMUM_BLOCK_SIZE = (size_t)64 << 10;
+			mutable std::mutex mutex;
+			std::multimap<size_t, void*> blocks;
+			size_t cachedBytes;
+			size_t limit;
+	};
+}
+#endif
@@ -0,0 +1,174 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_NAME_ARENA_H
+#define OPI_NAME_ARENA_H
+#include <cstddef>
+#include <string>
+#include <vector>
+namespace OPI
+{
+	//! Stores the object names of a Population in one contiguous buffer
+	/** Every name is a null-terminated string within the buffer, referenced by its offset
+	 * and length; empty names take no space. Changing a name appends the new string and
+	 * leaves the old one unused until more than half of the buffer is unused, then the
+	 * buffer is compacted. Removing and reordering objects only moves the references.
+	 * Pointers returned by get() are invalidated by every change of a name.
+	 */
+	class NameArena
+	{
+		public:
+			NameArena(): unused(0) { }
+
+			//! Returns the number of objects
+			int size() const { return (int)entries.size(); }
+
+			//! Sets the number of objects, new objects have empty names
+			void resize(int count)
+			{
+				for (int i = count; i < (int)entries.size(); i++) release(i);
+				entries.resize(count, Entry());
+				compactIfSparse();
+			}
+
+			//! Returns true if at least one object has a name
+			bool hasNames() const { return chars.size() > unused; }
+
+			//! Returns the name of an object
+			const char* get(int index) const { return entries[index].length > 0 ? &chars[entries[index].offset] : ""; }
+
+			//! Returns the length of the name of an object
+			int length(int index) const { return entries[index].length; }
+
+			//! Sets the name of an object to length characters of name
+			void set(int index, const char* name, int length)
+			{
+				// names taken from this buffer would move while it grows
+				if (length > 0 && !chars.empty() && name >= &chars[0] && name < &chars[0] + chars.size())
+				{
+					const std::string copy(name, length);
+					set(index, copy.data(), length);
+					return;
+				}
+				release(index);
+				if (length > 0)
+				{
+					entries[index].offset = chars.size();
+					entries[index].length = length;
+					chars.insert(chars.end(), name, name + length);
+					chars.push_back('\0');
+				}
+				compactIfSparse();
+			}
+
+			//! Removes an object
+			void remove(int index)
+			{
+				release(index);
+				entries.erase(entries.begin() + index);
+				compactIfSparse();
+			}
+
+			//! Removes the objects whose mask entry is set, keeping the order of the others
+			void removeMarked(const std::vector<char>& mask)
+			{
+				int kept = 0;
+				for (int i = 0; i < (int)entries.size(); i++)
+				{
+					if (i < (int)mask.size() && mask[i]) release(i);
+					else entries[kept++] = entries[i];
+				}
+				entries.resize(kept);
+				compactIfSparse();
+			}
+
+			//! Rearranges the objects, object i becomes the former object indices[i]
+			void permute(const int* indices)
+			{
+				std::vector<Entry> permuted(entries.size());
+				for (size_t i = 0; i < entries.size(); i++) permuted[i] = entries[indices[i]];
+				entries.swap(permuted);
+			}
+
+			//! Sets the names of count objects starting at offset to those of source starting at first
+			void copy(const NameArena& source, int first, int count, int offset)
+			{
+				for (int i = 0; i < count; i++) set(offset + i, source.get(first + i), source.length(first + i));
+			}
+
+			//! Sets the name of object i to the name of source object indices[i]
+			void gather(const NameArena& source, const int* indices, int count)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					if (indices[i] >= 0 && indices[i] < source.size())
+						set(i, source.get(indices[i]), source.length(indices[i]));
+				}
+			}
+
+			//! Stores all names one after another in object order, dropping unused space
+			void compact()
+			{
+				std::vector<char> packed;
+				packed.reserve(chars.size() - unused);
+				for (size_t i = 0; i < entries.size(); i++)
+				{
+					if (entries[i].length == 0) continue;
+					const size_t offset = packed.size();
+					packed.insert(packed.end(), chars.begin() + entries[i].offset, chars.begin() + entries[i].offset + entries[i].length + 1);
+					entries[i].offset = offset;
+				}
+				chars.swap(packed);
+				unused = 0;
+			}
+
+			//! Compacts the buffer and releases unused memory
+			void shrinkToFit()
+			{
+				compact();
+				std::vector<char>(chars).swap(chars);
+				std::vector<Entry>(entries).swap(entries);
+			}
+
+		private:
+			struct Entry
+			{
+				Entry(): offset(0), length(0) { }
+				size_t offset;
+				int length;
+			};
+
+			// marks the string of an object as unused and empties its name
+			void release(int index)
+			{
+				if (entries[index].length > 0) unused += entries[index].length + 1;
+				entries[index] = Entry();
+			}
+
+			// compacts the buffer once most of it is unused
+			void compactIfSparse()
+			{
+				if (unused > 4096 && unused * 2 > chars.size()) compact();
+			}
+
+			std::vector<char> chars;
+			std::vector<Entry> entries;
+			// bytes of chars that belong to no object
+			size_t unused;
+	};
+}
+
+#endif
@@ -0,0 +1,93 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_PARALLEL_H
+#define OPI_PARALLEL_H
+#include <algorithm>
+#include <thread>
+#include <vector>
+namespace OPI
+{
+	//! Calls body(begin, end) for consecutive ranges covering [0, size) on all hardware threads
+	/** Each range contains at least grainSize elements, so small inputs are processed on the
+	 * calling thread only. The body must be safe to call concurrently for disjoint ranges.
+	 */
+	template< class Function >
+	void parallelFor(int size, Function body, int grainSize = 4096)
+	{
+		if(size <= 0) return;
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		int numRanges = std::min(numThreads, (size + grainSize - 1) / grainSize);
+		if(numRanges <= 1) {
+			body(0, size);
+			return;
+		}
+		int rangeSize = (size + numRanges - 1) / numRanges;
+		std::vector<std::thread> workers;
+		workers.reserve(numRanges - 1);
+		for(int begin = rangeSize; begin < size; begin += rangeSize)
+			workers.push_back(std::thread(body, begin, std::min(begin + rangeSize, size)));
+		// the calling thread processes the first range itself
+		body(0, rangeSize);
+		for(size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	//! Sorts [begin, end) with std::sort on separate ranges and merges them on all hardware threads
+	/** As with parallelFor, each range contains at least grainSize elements. */
+	template< class Iterator >
+	void parallelSort(Iterator begin, Iterator end, int grainSize = 65536)
+	{
+		const int size = (int)(end - begin);
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		int numRanges = std::min(numThreads, (size + grainSize - 1) / grainSize);
+		if(numRanges <= 1) {
+			std::sort(begin, end);
+			return;
+		}
+		int rangeSize = (size + numRanges - 1) / numRanges;
+		std::vector<int> bounds;
+		for(int b = 0; b < size; b += rangeSize)
+			bounds.push_back(b);
+		bounds.push_back(size);
+		std::vector<std::thread> workers;
+		for(size_t r = 0; r + 1 < bounds.size(); r++) {
+			Iterator first = begin + bounds[r], last = begin + bounds[r+1];
+			workers.push_back(std::thread([first, last]() { std::sort(first, last); }));
+		}
+		for(size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		// merge neighbouring ranges until a single one is left
+		while(bounds.size() > 2) {
+			const size_t ranges = bounds.size() - 1;
+			workers.clear();
+			for(size_t r = 0; r + 2 < bounds.size(); r += 2) {
+				Iterator first = begin + bounds[r], middle = begin + bounds[r+1], last = begin + bounds[r+2];
+				workers.push_back(std::thread([first, middle, last]() { std::inplace_merge(first, middle, last); }));
+			}
+			for(size_t i = 0; i < workers.size(); i++)
+				workers[i].join();
+			std::vector<int> merged;
+			for(size_t r = 0; r <= ranges; r += 2)
+				merged.push_back(bounds[r]);
+			if(ranges % 2 == 1)
+				merged.push_back(bounds[ranges]);
+			bounds.swap(merged);
+		}
+	}
+}
+
+#endif
@@ -24,6 +24,8 @@ namespace OPI
 	Plugin::Plugin(DynLib *libhandle)
 	{
 		handle = libhandle;
+		proc_enable = 0;
+		proc_disable = 0;
 		// load information function from library
 		pluginInfoFunction func = (pluginInfoFunction)handle->loadFunction("OPI_Plugin_info");
 		info.name = "Unset plugin name";
@@ -42,6 +44,9 @@ namespace OPI
 			proc_enable = (pluginEnableFunction)handle->loadFunction("OPI_Plugin_enable", true);
 			proc_disable = (pluginDisableFunction)handle->loadFunction("OPI_Plugin_disable", true);
 		}
+		name = std::string(info.name, info.name_len);
+		author = std::string(info.author, info.author_len);
+		description = std::string(info.desc, info.desc_len);
 	}
 
 	Plugin::~Plugin()
@@ -75,17 +80,17 @@ namespace OPI
 
     const char* Plugin::getName() const
 	{
-        return std::string(info.name, info.name_len).c_str();
+        return name.c_str();
 	}
 
     const char* Plugin::getAuthor() const
 	{
-        return std::string(info.author, info.author_len).c_str();
+        return author.c_str();
 	}
 
     const char* Plugin::getDescription() const
 	{
-        return std::string(info.desc, info.desc_len).c_str();
+        return description.c_str();
 	}
 	/// @endcond
 }
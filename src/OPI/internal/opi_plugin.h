@@ -54,6 +54,10 @@ namespace OPI
 		private:
 			DynLib* handle;
 			PluginInfo info;
+			// copies of the strings of info, which are not null-terminated
+			std::string name;
+			std::string author;
+			std::string description;
 
 			// function pointers
 			pluginEnableFunction proc_enable;
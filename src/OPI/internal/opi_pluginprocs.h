@@ -46,6 +46,10 @@ namespace OPI
 	typedef Propagator* (*pluginPropagatorFunction)(OPI_Host host);
 	// c interface propagation function
     typedef ErrorCode (*pluginPropagateFunction)(OPI_Propagator propagator, OPI_Population data, double julian_day, double dt, PropagationMode mode, IndexList* indices);
+	// optional c interface function, queues a propagation and completes the handle with OPI_PropagationHandle_complete
+	typedef ErrorCode (*pluginPropagateAsyncFunction)(OPI_Propagator propagator, OPI_Population data, double julian_day, double dt, PropagationMode mode, IndexList* indices, void* handle);
+	// optional c interface function, returns non-zero if propagate may be called concurrently
+	typedef int (*pluginReentrantFunction)(OPI_Propagator propagator);
 
 	// cpp distance query interface function
 	typedef DistanceQuery* (*pluginDistanceQueryFunction)(OPI_Host host);
@@ -33,6 +33,8 @@ namespace OPI
 			proc_init(this);
 		}
 		proc_propagate = (pluginPropagateFunction)(handle->loadFunction("OPI_Plugin_propagate", true));
+		proc_reentrant = (pluginReentrantFunction)(handle->loadFunction("OPI_Plugin_reentrant", true));
+		proc_propagate_async = (pluginPropagateAsyncFunction)(handle->loadFunction("OPI_Plugin_propagateAsync", true));
 		setName(plugin->getName());
 		setAuthor(plugin->getAuthor());
 		setDescription(plugin->getDescription());
@@ -40,7 +42,7 @@ namespace OPI
 
 	PropagatorPlugin::~PropagatorPlugin()
 	{
-
+		finishAsync();
 	}
 
 	ErrorCode PropagatorPlugin::enable()
@@ -60,11 +62,25 @@ namespace OPI
 		return NOT_IMPLEMENTED;
 	}
 
+	ErrorCode PropagatorPlugin::runPropagationAsync(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices, PropagationHandle& handle)
+	{
+		if(proc_propagate_async)
+			return proc_propagate_async(this, (void*)(&population), julian_day, dt, mode, indices, &handle);
+		return NOT_IMPLEMENTED;
+	}
+
 	int PropagatorPlugin::requiresCUDA()
 	{
 		return 0;
 	}
 
+	bool PropagatorPlugin::reentrant()
+	{
+		if(proc_reentrant)
+			return proc_reentrant(this) != 0;
+		return false;
+	}
+
     //FIXME Implement missing interface functions
 
 	/**
@@ -37,11 +37,15 @@ namespace OPI
 			virtual ErrorCode disable();
             virtual ErrorCode runPropagation(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices);
 			virtual int requiresCUDA();
+			virtual bool reentrant();
+			virtual ErrorCode runPropagationAsync(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices, PropagationHandle& handle);
 		private:
 			Plugin* plugin;
 			// propagate proc
 			pluginPropagateFunction proc_propagate;
 			pluginInitFunction proc_init;
+			pluginReentrantFunction proc_reentrant;
+			pluginPropagateAsyncFunction proc_propagate_async;
 
 	};
 
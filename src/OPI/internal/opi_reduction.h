@@ -0,0 +1,63 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_REDUCTION_H
+#define OPI_REDUCTION_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include "../opi_datatypes.h"
+#include <math.h>
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Operations of Population::reduce, shared by the host implementation and the CUDA kernel.
+
+	//! Returns the value that does not change the result of the given ReductionOperation
+	OPI_CUDA_PREFIX inline double reductionIdentity(int operation)
+	{
+		if (operation == REDUCTION_MIN) return HUGE_VAL;
+		if (operation == REDUCTION_MAX) return -HUGE_VAL;
+		return 0.0;
+	}
+
+	//! Combines two partial results of the given ReductionOperation
+	OPI_CUDA_PREFIX inline double reductionCombine(int operation, double a, double b)
+	{
+		if (operation == REDUCTION_MIN) return (b < a) ? b : a;
+		if (operation == REDUCTION_MAX) return (b > a) ? b : a;
+		return a + b;
+	}
+
+	//! Returns true if a value is taken into account, i.e. it is not NaN and inside the bounds
+	OPI_CUDA_PREFIX inline bool reductionValid(double value, double lowerBound, double upperBound)
+	{
+		// comparisons with NaN are false
+		return (value >= lowerBound && value <= upperBound);
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
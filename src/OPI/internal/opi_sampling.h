@@ -0,0 +1,165 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_SAMPLING_H
+#define OPI_SAMPLING_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include "../opi_datatypes.h"
+#include <cmath>
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Monte Carlo clones of Population::sampleClones, shared by the host implementation and the CUDA kernels.
+
+	//! Number of doubles of a factored covariance, the packed lower triangle of 8x8 elements
+	static const int SAMPLING_FACTOR_SIZE = 36;
+
+	//! Returns the number of sampled parameters of a CovarianceType, zero if it cannot be sampled
+	OPI_CUDA_PREFIX inline int samplingDimension(int covarianceType)
+	{
+		switch(covarianceType)
+		{
+			case CV_STATE_VECTORS:
+			case CV_KEPLERIAN: return 8;
+			case CV_STATE_VECTORS_NO_DYNAMICS:
+			case CV_KEPLERIAN_NO_DYNAMICS: return 6;
+			default: return 0;
+		}
+	}
+
+	//! Mixes a 64 bit counter into a uniformly distributed 64 bit value (splitmix64 finalizer)
+	OPI_CUDA_PREFIX inline unsigned long long samplingHash(unsigned long long x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	//! Factors a covariance into its Cholesky factor, stored as a packed lower triangle
+	/** Row i starts at element i * (i + 1) / 2, like in covarianceToArray(). Columns with a
+	 * pivot that is not positive are set to zero, so semi-definite covariances, e.g. with
+	 * unused parameters, leave those parameters unchanged.
+	 */
+	OPI_CUDA_PREFIX inline void factorCovariance(const Covariance& covariance, int dimension, double* factor)
+	{
+		covarianceToArray(covariance, factor);
+		for (int j = 0; j < dimension; j++)
+		{
+			const int rowJ = j * (j + 1) / 2;
+			double pivot = factor[rowJ + j];
+			for (int k = 0; k < j; k++) pivot -= factor[rowJ + k] * factor[rowJ + k];
+			const double diagonal = (pivot > 0.0) ? sqrt(pivot) : 0.0;
+			factor[rowJ + j] = diagonal;
+			for (int i = j + 1; i < dimension; i++)
+			{
+				const int rowI = i * (i + 1) / 2;
+				double value = factor[rowI + j];
+				for (int k = 0; k < j; k++) value -= factor[rowI + k] * factor[rowJ + k];
+				factor[rowI + j] = (diagonal > 0.0) ? value / diagonal : 0.0;
+			}
+		}
+	}
+
+	//! Draws the correlated offsets of a clone from a factored covariance
+	/** The standard normal numbers are derived from the seed and the clone number only, so a
+	 * clone is the same no matter on which device or thread it is generated.
+	 */
+	OPI_CUDA_PREFIX inline void sampleOffsets(const double* factor, int dimension, unsigned long long seed, unsigned long long clone, double* offset)
+	{
+		double z[8];
+		const unsigned long long stream = samplingHash(seed ^ samplingHash(clone));
+		for (int k = 0; k < dimension; k += 2)
+		{
+			// Box-Muller transform of two uniform numbers in (0, 1)
+			const double u1 = ((samplingHash(stream + k) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+			const double u2 = ((samplingHash(stream + k + 1) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+			const double r = sqrt(-2.0 * log(u1));
+			z[k] = r * cos(2.0 * M_PI * u2);
+			z[k + 1] = r * sin(2.0 * M_PI * u2);
+		}
+		for (int i = 0; i < dimension; i++)
+		{
+			const int row = i * (i + 1) / 2;
+			double value = 0.0;
+			for (int j = 0; j <= i; j++) value += factor[row + j] * z[j];
+			offset[i] = value;
+		}
+	}
+
+	//! Generates a clone of an object from its factored covariance
+	/** The parent fields and clone fields that are null are skipped. State vectors are
+	 * converted to orbits and vice versa if the kinematic parameters are only one of them,
+	 * the dynamic parameters are offsets of the drag and reflectivity coefficients.
+	 */
+	OPI_CUDA_PREFIX inline void sampleClone(const double* factor, int covarianceType, unsigned long long seed, unsigned long long clone,
+											const Orbit* orbit, const Vector3* position, const Vector3* velocity,
+											const ObjectProperties* properties, const Epoch* epoch,
+											Orbit* cloneOrbit, Vector3* clonePosition, Vector3* cloneVelocity,
+											ObjectProperties* cloneProperties, Epoch* cloneEpoch)
+	{
+		const int dimension = samplingDimension(covarianceType);
+		double offset[8];
+		sampleOffsets(factor, dimension, seed, clone, offset);
+		if (covarianceType == CV_STATE_VECTORS || covarianceType == CV_STATE_VECTORS_NO_DYNAMICS)
+		{
+			Vector3 p = position ? *position : Vector3(0.0, 0.0, 0.0);
+			Vector3 v = velocity ? *velocity : Vector3(0.0, 0.0, 0.0);
+			p.x += offset[0]; p.y += offset[1]; p.z += offset[2];
+			v.x += offset[3]; v.y += offset[4]; v.z += offset[5];
+			if (clonePosition) *clonePosition = p;
+			if (cloneVelocity) *cloneVelocity = v;
+			if (cloneOrbit && !stateVectorToOrbit(p, v, *cloneOrbit) && orbit) *cloneOrbit = *orbit;
+		}
+		else
+		{
+			Orbit o = orbit ? *orbit : Orbit(0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+			o.semi_major_axis += offset[0];
+			o.eccentricity = fmax(0.0, o.eccentricity + offset[1]);
+			o.inclination += offset[2];
+			o.raan += offset[3];
+			o.arg_of_perigee += offset[4];
+			o.mean_anomaly += offset[5];
+			if (cloneOrbit) *cloneOrbit = o;
+			if (clonePosition && cloneVelocity) orbitToStateVector(o, *clonePosition, *cloneVelocity);
+		}
+		if (cloneProperties && properties)
+		{
+			ObjectProperties p = *properties;
+			if (dimension > 6)
+			{
+				p.drag_coefficient += offset[6];
+				p.reflectivity += offset[7];
+			}
+			*cloneProperties = p;
+		}
+		if (cloneEpoch && epoch) *cloneEpoch = *epoch;
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
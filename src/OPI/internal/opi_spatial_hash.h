@@ -0,0 +1,81 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_SPATIAL_HASH_H
+#define OPI_SPATIAL_HASH_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include <cmath>
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Helpers of the uniform grid DistanceQuery, shared by the host implementation and the
+	// CUDA kernels. Cells are cubes of cellSize; a cell is mapped onto one of tableSize
+	// buckets (a power of two), so cells far apart may share a bucket.
+
+	//! Returns the grid coordinate of a position component
+	OPI_CUDA_PREFIX inline long long spatialHashCoordinate(double x, double cellSize)
+	{
+		return (long long)floor(x / cellSize);
+	}
+
+	//! Returns the bucket of the cell with the given grid coordinates
+	OPI_CUDA_PREFIX inline unsigned int spatialHashBucket(long long x, long long y, long long z, unsigned int tableSize)
+	{
+		const unsigned long long h = ((unsigned long long)x * 73856093ULL) ^ ((unsigned long long)y * 19349663ULL) ^ ((unsigned long long)z * 83492791ULL);
+		return (unsigned int)(h & (tableSize - 1));
+	}
+
+	//! Returns true if two positions lie within a cube of edge length cubeSize around each other
+	OPI_CUDA_PREFIX inline bool spatialHashInCube(double ax, double ay, double az, double bx, double by, double bz, double cubeSize)
+	{
+		return fabs(ax - bx) <= cubeSize && fabs(ay - by) <= cubeSize && fabs(az - bz) <= cubeSize;
+	}
+
+	// Population::getSpatialOrder() sorts objects along a Morton (Z-order) curve through a grid
+	// of 2^21 cells per axis spanning the bounding box of the positions.
+
+	//! Spreads the lower 21 bits of v so that two zero bits follow each of them
+	OPI_CUDA_PREFIX inline unsigned long long spatialMortonSpread(unsigned long long v)
+	{
+		v &= 0x1fffffULL;
+		v = (v | (v << 32)) & 0x1f00000000ffffULL;
+		v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+		v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+		v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+		v = (v | (v << 2)) & 0x1249249249249249ULL;
+		return v;
+	}
+
+	//! Returns the 63-bit Morton code of a cell given by three 21-bit grid coordinates
+	OPI_CUDA_PREFIX inline unsigned long long spatialMortonKey(unsigned int x, unsigned int y, unsigned int z)
+	{
+		return spatialMortonSpread(x) | (spatialMortonSpread(y) << 1) | (spatialMortonSpread(z) << 2);
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
@@ -18,39 +18,91 @@
 #define OPI_SYNCHRONIZED_DATA_H
 #include "../opi_host.h"
 #include "opi_gpusupport.h"
+#include "opi_host_allocator.h"
+#include "opi_parallel.h"
+#include "opi_device_budget.h"
+#include "../opi_indexlist.h"
 #include <vector>
 #include <map>
 #include <algorithm>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <string>
 namespace OPI
 {
 	//! Template based inter-device synchronization helper class
+	/** All member functions may be called from several threads; the synchronization state is
+	 * protected by a lock. The memory returned by getData() is not, so threads working on the
+	 * same data concurrently have to coordinate their accesses themselves.
+	 *
+	 * If the host uses managed memory (see Host::getManagedMemory()), the data is allocated once
+	 * and all devices refer to the host memory. Synchronizing then waits for the device that
+	 * modified the data and migrates its pages with prefetches instead of copying it.
+	 *
+	 * Device allocations count against the device memory limit of the host (see
+	 * Host::setDeviceMemoryLimit()), which may release the device memory of data objects that
+	 * have not been accessed on a device for the longest time.
+	 */
 	template< class DataType >
-	class SynchronizedData
+	class SynchronizedData: public DeviceMirror
 	{
 		public:
             //! Initialize with a reference to the host object
-            SynchronizedData(Host& owning_host);
+            //! The name identifies the data in the transfer statistics of the host, the owner
+            //! the object it belongs to in the device memory usage
+            SynchronizedData(Host& owning_host, const char* dataName = "Data", const void* owner = 0);
 			~SynchronizedData();
 
+			//! Releases all device memory, copying data that is newer on a device to the host first
+			virtual size_t evictDevices();
+			//! Adds one entry per device holding memory to usage
+			virtual void appendUsage(std::vector<DeviceMemoryUsage>& usage);
+
 			//! Reserves space to hold a specific amount of objects
+			/** If the new size is smaller than the number of objects, the objects at the end are
+			 * dropped. Existing allocations are kept, and a GPU holding the latest data reuses
+			 * its allocation when the data grows again as long as it is large enough.
+			 */
 			void reserve(int num_Objects);
+			//! Releases all memory not required to hold the current number of objects
+			void shrinkToFit();
 			//! Resize all memory objects
             void resize(int num_Objects);
 
 			//! Remove the object at index index;
             void remove(int index, int arraySize = 1);
+			//! Removes all objects for which the mask is set, keeping the order of the remaining ones
+			/** The mask contains one entry per group of arraySize consecutive elements. */
+			void removeMarked(const std::vector<char>& mask, int arraySize = 1);
 			//! Retrieve the device-specific data pointer for the requested device
 			DataType* getData(Device device, bool no_sync);
 			//! Notify about updates in data structure of requested device
 			void update(Device device);
+			//! Notify about updates of the count objects starting at first on the requested device
+			/** Copies that were up to date before only transfer the modified ranges on their next
+			 * synchronization. Many scattered ranges, ranges covering most of the data, slices and
+			 * pending column updates fall back to a full update.
+			 */
+			void update(Device device, int first, int count);
+			//! Starts an asynchronous upload to the requested device
+			/** The transfer runs on a stream owned by this object so uploads of different data
+			 * objects can overlap. It is completed by the next getData() call for that device.
+			 */
+			void prefetch(Device device);
 
 			//! Returns the allocated number of objects
 			int getReservedSize();
 			//! Returns the number of used objects
 			int getSize();
+			//! Returns the device holding the latest data
+			Device getLatestDevice() const { std::lock_guard<MirrorMutex> lock(mutex); return latestDevice; }
+			//! Returns a counter that changes whenever the data may have been modified
+			/** Caches derived from the data compare it to detect that they are outdated. */
+			unsigned long long getRevision() const { std::lock_guard<MirrorMutex> lock(mutex); return revision; }
 
-			//! Sorts the internal data
+			//! Sorts the internal data on the host, using all hardware threads
 			void sort();
 
 			//! Adds an object to the back of the host memory
@@ -61,31 +113,164 @@ namespace OPI
 			//! Checks if some data has been stored
 			bool hasData();
 
-			//! Removes duplicate data entries
+			//! Removes duplicate data entries on the host, using all hardware threads for sorting
 			void removeDuplicates();
+
+			//! Moves the host memory to page-locked (or back to pageable) memory
+			/** Has no effect if the GPU support does not provide pinned memory. */
+			void setPinnedHostMemory(bool pinned);
+			//! Returns true if the host memory is page-locked
+			bool isPinnedHostMemory() const;
+
+			//! Uses the given file mapping as host memory for num_Objects objects
+			/** The mapping is private, so modifications are not written back to the file.
+			 * Device memory is released and the host holds the latest data afterwards.
+			 */
+			void adoptHostMemory(const std::shared_ptr<MemoryMap>& mapping, int num_Objects);
+
+			//! Retrieve the data in structure-of-arrays layout for the requested device
+			/** The columns hold one array per 8-byte component of DataType. They are created on
+			 * first use and kept as a cache that is transposed again only after updates.
+			 */
+			double* getColumns(Device device, bool no_sync);
+			//! Notify about updates of the columns on the requested device
+			void updateColumns(Device device);
+
+			//! Restricts the memory of a device to the count objects starting at offset
+			/** The device pointer then refers to the object at offset. Slices on different devices
+			 * must not overlap; updates of a slice only invalidate that part of the host memory, so
+			 * several devices can modify their slices before the host gathers them. Set count
+			 * to -1 to hold all objects on the device again.
+			 */
+			void setSlice(Device device, int offset, int count);
+
+			//! Resizes this object to the indexed groups of arraySize elements of source and copies them
+			/** If the latest source data is on a GPU, the elements are gathered there and only the
+			 * indices are transferred. Otherwise they are gathered on the host. Indices outside of
+			 * the source are skipped.
+			 */
+			void gatherFrom(SynchronizedData<DataType>& source, IndexList& list, int arraySize = 1);
+			//! Copies the groups of arraySize elements of source to the indexed positions of this object
+			/** The counterpart of gatherFrom(); the list needs one index per group of the source.
+			 * If the latest data of this object is on a GPU, the elements are scattered there, so
+			 * only the source and the indices are transferred. Indices out of range are skipped.
+			 */
+			void scatterFrom(SynchronizedData<DataType>& source, IndexList& list, int arraySize = 1);
+			//! Copies count groups of arraySize elements of source starting at first to the groups starting at offset
+			/** If the latest source data is on a GPU and this object holds its latest data on a GPU
+			 * or none at all, the range is copied between the devices without staging it on the
+			 * host. Otherwise it is copied on the host. Only the copied range is marked as modified.
+			 */
+			void copyFrom(SynchronizedData<DataType>& source, int first, int count, int offset, int arraySize = 1);
+			//! Sets count elements starting at first to zero where the latest data is
+			void zeroRange(int first, int count);
+			//! Reorders the groups of arraySize elements so that group i becomes the former group list[i]
+			/** The list has to be a permutation of all groups. The elements are gathered on the
+			 * device holding the latest data, or on the host.
+			 */
+			void permute(IndexList& list, int arraySize = 1);
+			//! Keeps only the groups of arraySize elements in list, in list order, on the device holding the latest data
+			/** Returns false without changes if the latest data is not on a GPU or cannot be
+			 * gathered there, e.g. because it is sliced; the caller then compacts on the host.
+			 */
+			bool compactOnDevice(IndexList& list, int arraySize = 1);
 		private:
 			//! Makes sure the data pointer on the specific device is allocated
 			void ensure_allocation(Device device);
+			//! Enlarges the allocation of the device holding the latest data, keeping the data there
+			/** An allocation that is already large enough is reused. Returns false if the data
+			 * cannot stay on the device, e.g. because it is sliced.
+			 */
+			bool grow_on_device(int num_Objects);
 			//! Makes sure the data pointer on the specific device has up-to-date data
 			void ensure_synchronization(Device device);
+			//! Waits for the devices that modified managed memory and migrates it to the specific device
+			void ensure_managed_synchronization(Device device);
 			//! Copies data from host to the specific device
 			void sync_host_to_device(Device device);
+			//! Copies data from the latest device directly to the specific device, returns false if not possible
+			bool sync_device_to_device(Device device);
+			//! Waits for a pending asynchronous transfer to the specific device
+			void finish_transfer(Device device);
+			//! Waits for all pending asynchronous transfers
+			void finish_transfers();
+			//! Adds a copy that started at start to the transfer statistics of the host
+			void record_transfer(Device source, Device destination, size_t bytes, std::chrono::steady_clock::time_point start);
+
+			//! Returns true if the device holds a slice only
+			bool is_sliced(Device device);
+			//! Returns the number of objects within the slice of a device
+			int slice_count(Device device);
+			//! Copies all slices that are newer than the host memory to the host
+			void gather_slices();
+			//! Makes sure the slice on the specific device has up-to-date data
+			void ensure_slice_synchronization(Device device);
 
 			//! Clears all device data but keeps host data
 			void clearDevices();
+			//! Returns an allocator for host memory of the requested kind
+			HostAllocator<DataType> hostAllocator(bool pinned);
+			//! Transposes the latest data into the columns, or the columns back into the data
+			void transpose(bool toColumns);
+			//! Writes modified columns back to the data before it is accessed
+			void sync_rows();
+			//! Prepares a partial update on the specific device, returns false if ranges cannot be tracked
+			bool begin_range_update(Device device);
+			//! Adds a modified range to all copies that are outdated in parts only
+			void add_dirty_range(int first, int count);
+			//! Makes room for a device allocation within the device memory limit of the host
+			void reserve_device_memory(size_t bytes);
+			//! Sets the number of bytes allocated on a device
+			void set_device_bytes(Device device, size_t bytes);
 
+			//! Ranges of objects in which a copy differs from the latest data
+			struct DirtyRanges
+			{
+					DirtyRanges(): partial(false) { }
+					//! If only the ranges are outdated; otherwise the whole copy is, if it needs an update
+					bool partial;
+					//! Sorted, non-overlapping pairs of first object and count
+					std::vector<std::pair<int, int> > ranges;
+					void clear() { partial = false; ranges.clear(); }
+					//! Merges a range into the list, falls back to a full update of numObjects objects if it gets too long
+					void add(int first, int count, int numObjects);
+					//! Drops the parts of the ranges at or beyond numObjects
+					void clip(int numObjects);
+					//! Returns the number of objects within the ranges
+					size_t objects() const;
+			};
+
+			typedef std::vector<DataType, HostAllocator<DataType> > HostVector;
 			//! the host memory
-			std::vector<DataType> hostData;
+			HostVector hostData;
 			//! if the host needs an update
 			bool hostNeedsUpdate;
+			//! The outdated ranges of the host memory, if hostNeedsUpdate is set
+			DirtyRanges hostDirty;
 			//! Device specific data container
 			struct DeviceData
 			{
-					DeviceData(): ptr(0),needsUpdate(false)	{ }
+					DeviceData(): ptr(0),bytes(0),needsUpdate(false),prefetched(false),stream(0),transfer(0),sliceOffset(0),sliceSize(-1),sliceNewer(false)	{ }
 					//! The pointer to the on-device memory data location
 					DataType* ptr;
+					//! The size of the allocation, zero for managed memory
+					size_t bytes;
 					//! If this device needs an update
 					bool needsUpdate;
+					//! If an upload to this device has been started by prefetch()
+					bool prefetched;
+					//! Stream used for asynchronous transfers to this device
+					void* stream;
+					//! Event marking the end of the pending transfer
+					void* transfer;
+					//! First object held by this device
+					int sliceOffset;
+					//! Number of objects held by this device, -1 if it holds all objects
+					int sliceSize;
+					//! If the slice has been modified on the device after the host
+					bool sliceNewer;
+					//! The outdated ranges, if needsUpdate is set
+					DirtyRanges dirty;
 			};
 			//! Reference to the host object
 			Host& host;
@@ -96,11 +281,27 @@ namespace OPI
 			//! The number of objects this data object can currently hold
 			int numObjects;
             int reservedSize;
+			//! Structure-of-arrays copy of the data, allocated on first use
+			std::unique_ptr<SynchronizedData<double> > columnData;
+			//! If the columns hold the same data as the rows
+			bool columnsValid;
+			//! If the columns have been modified after the rows
+			bool columnsNewer;
+			//! If at least one device holds a slice that is newer than the host memory
+			bool slicesNewer;
+			//! Incremented on every modification, see getRevision()
+			unsigned long long revision;
+			//! Guards the synchronization state
+			mutable MirrorMutex mutex;
+			//! Name of the data in the transfer statistics
+			std::string name;
+			//! If the host memory is managed memory that the devices access directly
+			bool managed;
 	};
 
 	template<class DataType>
-    SynchronizedData<DataType>::SynchronizedData(Host& owning_host):
-		host(owning_host)
+    SynchronizedData<DataType>::SynchronizedData(Host& owning_host, const char* dataName, const void* owner):
+		DeviceMirror(owner), host(owning_host), name(dataName)
 	{
 		// set latest device to -1
 		latestDevice = DEVICE_NOT_SET;
@@ -108,25 +309,39 @@ namespace OPI
 		hostNeedsUpdate = false;
 		numObjects = 0;
         reservedSize = 0;
+		columnsValid = false;
+		columnsNewer = false;
+		slicesNewer = false;
+		revision = 0;
+		managed = host.getManagedMemory();
+		// use the host's default kind of host memory, pageable memory comes from the host's pool
+		setPinnedHostMemory(host.getPinnedHostMemory());
+		host.getDeviceMemoryBudget().add(this);
 	}
 
 	template<class DataType>
 	SynchronizedData<DataType>::~SynchronizedData()
 	{
-		// retrieve cuda support object
-		GpuSupport* cuda = host.getGPUSupport();
+		// the budget must not evict this object while it is destroyed
+		host.getDeviceMemoryBudget().remove(this);
+		// retrieve cuda support object, data that never left the host does not need it
+		GpuSupport* cuda = deviceData.empty() ? 0 : host.getGPUSupport();
 		// check if the object is valid
 		if(cuda) {
 			// store currently selected device
 			int oldDevice = cuda->getCurrentDevice();
+			finish_transfers();
 			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr) {
-				// check if the pointer is allocated (not 0)
-				if(itr->second.ptr) {
-					// select device
-					cuda->selectDevice(itr->first - DEVICE_CUDA);
+				// select device
+				cuda->selectDevice(itr->first - DEVICE_CUDA);
+				// check if the pointer is allocated (not 0), managed memory is freed with the host memory
+				if(itr->second.ptr && !managed) {
 					// and free pointer
 					cuda->free(itr->second.ptr);
 				}
+				if(itr->second.stream) {
+					cuda->destroyStream(itr->second.stream);
+				}
 			}
 			// select the old device again
 			cuda->selectDevice(oldDevice);
@@ -136,6 +351,7 @@ namespace OPI
 	template<class DataType>
 	void SynchronizedData<DataType>::add(const DataType &object)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		ensure_synchronization(DEVICE_HOST);
 		reserve(numObjects + 1);
 		hostData.resize(numObjects + 1);
@@ -147,21 +363,23 @@ namespace OPI
 	template<class DataType>
 	void SynchronizedData<DataType>::set(const DataType &object, int index)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		if((index >= 0)&&(index < numObjects))
 		{
 			ensure_synchronization(DEVICE_HOST);
 			hostData[index] = object;
-			update(DEVICE_HOST);
+			update(DEVICE_HOST, index, 1);
 		}
 	}
 
 	template<class DataType>
 	void SynchronizedData<DataType>::sort()
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		if(hasData())
 		{
 			ensure_synchronization(DEVICE_HOST);
-			std::sort(hostData.begin(), hostData.end());
+			parallelSort(hostData.begin(), hostData.end());
 
 			update(DEVICE_HOST);
 		}
@@ -170,6 +388,7 @@ namespace OPI
 	template<class DataType>
 	bool SynchronizedData<DataType>::hasData()
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		// check if there is any data stored
 		bool hasDataStored = false;
 		if(hostData.size() > 0)
@@ -187,6 +406,7 @@ namespace OPI
 	template<class DataType>
 	int SynchronizedData<DataType>::getReservedSize()
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		return reservedSize;
 	}
 
@@ -194,32 +414,97 @@ namespace OPI
 	template<class DataType>
 	int SynchronizedData<DataType>::getSize()
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		return numObjects;
 	}
 
 	template<class DataType>
 	void SynchronizedData<DataType>::removeDuplicates()
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		ensure_synchronization(DEVICE_HOST);
-		std::sort( hostData.begin(), hostData.end());
+		parallelSort(hostData.begin(), hostData.end());
 		hostData.erase( std::unique( hostData.begin(), hostData.end()), hostData.end() );
 		numObjects = hostData.size();
 		update(DEVICE_HOST);
 	}
 
+	template<class DataType>
+	HostAllocator<DataType> SynchronizedData<DataType>::hostAllocator(bool pinned)
+	{
+		// managed memory is used regardless of the pinned setting
+		if(managed)
+			return HostAllocator<DataType>(host.getGPUSupport(), 0, true);
+		// don't load the GPU support just to find out pinned memory is not requested
+		GpuSupport* cuda = pinned ? host.getGPUSupport() : 0;
+		if(cuda && cuda->supportsPinnedMemory())
+			return HostAllocator<DataType>(cuda);
+		return HostAllocator<DataType>(0, &host.getHostMemoryPool());
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::setPinnedHostMemory(bool pinned)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		HostAllocator<DataType> allocator = hostAllocator(pinned);
+		if(allocator != hostData.get_allocator())
+		{
+			// uploads from the old buffer have to finish before it is released
+			finish_transfers();
+			HostVector buffer(allocator);
+			buffer.reserve(hostData.capacity());
+			buffer.assign(hostData.begin(), hostData.end());
+			hostData.swap(buffer);
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::adoptHostMemory(const std::shared_ptr<MemoryMap>& mapping, int num_Objects)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		clearDevices();
+		if(managed) {
+			// the devices cannot access the mapping, so its contents are copied to managed memory
+			HostVector buffer(hostData.get_allocator());
+			const DataType* mappedData = static_cast<const DataType*>(mapping->getData());
+			buffer.reserve(num_Objects);
+			buffer.assign(mappedData, mappedData + num_Objects);
+			hostData.swap(buffer);
+		}
+		else {
+			HostVector buffer(HostAllocator<DataType>(hostData.get_allocator().gpu, hostData.get_allocator().pool, mapping));
+			// the first allocation is served from the mapping and its elements are left untouched
+			buffer.reserve(num_Objects);
+			buffer.resize(num_Objects);
+			hostData.swap(buffer);
+		}
+		numObjects = num_Objects;
+		reservedSize = num_Objects;
+		update(DEVICE_HOST);
+	}
+
+	template<class DataType>
+	bool SynchronizedData<DataType>::isPinnedHostMemory() const
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		return hostData.get_allocator().isPinned();
+	}
+
 	template<class DataType>
 	void SynchronizedData<DataType>::clearDevices()
 	{
 		// retrieve cuda support object
-		GpuSupport* cuda = host.getGPUSupport();
+		GpuSupport* cuda = deviceData.empty() ? 0 : host.getGPUSupport();
 		// check if the object is valid
 		if(cuda) {
 			// store current device
 			int oldDevice = cuda->getCurrentDevice();
+			// transfers into the memory about to be freed have to finish first
+			finish_transfers();
 			// invalidate all device pointers
 			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr) {
-				// check if pointer is allocated
-				if(itr->second.ptr) {
+				// check if pointer is allocated, managed device pointers refer to the host memory
+				if(itr->second.ptr && !managed) {
 					// select device
 					cuda->selectDevice(itr->first - DEVICE_CUDA);
 					// free memory
@@ -228,6 +513,8 @@ namespace OPI
 				// reset to default values
 				itr->second.ptr = 0;
 				itr->second.needsUpdate = false;
+				itr->second.prefetched = false;
+				set_device_bytes(itr->first, 0);
 			}
 			// select the previously selected cuda device
 			cuda->selectDevice(oldDevice);
@@ -238,8 +525,9 @@ namespace OPI
 	template<class DataType>
     void SynchronizedData<DataType>::remove(int index, int arraySize)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		// check if data is available and the index range is valid
-		if((hasData()) && (index >= 0) && (index < numObjects))
+		if((hasData()) && (index >= 0) && (index + arraySize <= numObjects))
 		{
 			// synchronize data to host
 			ensure_synchronization(DEVICE_HOST);
@@ -247,16 +535,57 @@ namespace OPI
             hostData.erase(hostData.begin() + index, hostData.begin() + index + arraySize);
 			// update where the latest information is located
 			update(DEVICE_HOST);
-			numObjects -= 1;
+			numObjects -= arraySize;
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::removeMarked(const std::vector<char>& mask, int arraySize)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		int groups = std::min((int)mask.size(), numObjects / arraySize);
+		int kept = 0;
+		if(hasData())
+		{
+			// synchronize data to host once
+			ensure_synchronization(DEVICE_HOST);
+			// move all remaining groups to the front in a single pass
+			for(int i = 0; i < groups; i++)
+			{
+				if(!mask[i])
+				{
+					if(kept != i)
+						std::copy(hostData.begin() + i * arraySize, hostData.begin() + (i + 1) * arraySize, hostData.begin() + kept * arraySize);
+					kept++;
+				}
+			}
+			// keep any trailing elements not covered by the mask
+			int tail = numObjects - groups * arraySize;
+			if(tail > 0)
+				std::copy(hostData.begin() + groups * arraySize, hostData.begin() + numObjects, hostData.begin() + kept * arraySize);
+			numObjects = kept * arraySize + tail;
+			hostData.resize(numObjects);
+			// update where the latest information is located
+			update(DEVICE_HOST);
+		}
+		else {
+			for(int i = 0; i < groups; i++)
+				if(!mask[i]) kept++;
+			numObjects = kept * arraySize + (numObjects - groups * arraySize);
 		}
 	}
 
 	template<class DataType>
 	void SynchronizedData<DataType>::reserve(int num_Objects)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		sync_rows();
+		columnsValid = false;
+		revision++;
 		if(num_Objects > reservedSize)
 		{
-			if((hasData()))
+			// data that lives on a GPU is moved to a larger allocation there
+			if(hasData() && !grow_on_device(num_Objects))
 			{
 				// first synchronize data to host
 				ensure_synchronization(DEVICE_HOST);
@@ -275,17 +604,58 @@ namespace OPI
 		}
         else if (num_Objects < reservedSize)
 		{
-            for (int i=reservedSize-1; i>=num_Objects; i--)
-            {
-                // FIXME: Untested - is this enough?
-                remove(i);
-            }
+			// drop the objects that no longer fit in one go; device memory is only ever
+			// accessed up to numObjects so the allocations can stay as they are
+			if(num_Objects < 0) num_Objects = 0;
+			if(numObjects > num_Objects)
+			{
+				finish_transfers();
+				numObjects = num_Objects;
+				if(hostData.size() > (size_t)numObjects)
+					hostData.resize(numObjects);
+				// partial updates must not copy the dropped objects
+				hostDirty.clip(numObjects);
+				for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+					itr->second.dirty.clip(numObjects);
+			}
+			reservedSize = num_Objects;
 		}
 	}
 
+	template<class DataType>
+	void SynchronizedData<DataType>::shrinkToFit()
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		sync_rows();
+		columnsValid = false;
+		revision++;
+		if(hasData())
+		{
+			// device allocations are sized to the reserved size and have to be
+			// recreated, so move the latest data to the host first
+			ensure_synchronization(DEVICE_HOST);
+			clearDevices();
+			hostData.resize(numObjects);
+			if(hostData.capacity() > hostData.size())
+			{
+				HostVector buffer(hostData.begin(), hostData.end(), hostData.get_allocator());
+				hostData.swap(buffer);
+			}
+			if(latestDevice != DEVICE_NOT_SET)
+				latestDevice = DEVICE_HOST;
+			hostNeedsUpdate = false;
+		}
+		reservedSize = numObjects;
+	}
+
 	template<class DataType>
 	void SynchronizedData<DataType>::resize(int num_Objects)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		sync_rows();
+		columnsValid = false;
+		revision++;
+		finish_transfers();
 		if(num_Objects > reservedSize)
 		{
 			reserve(num_Objects);
@@ -294,19 +664,50 @@ namespace OPI
 		{
 			hostData.resize(num_Objects);
 		}
+		// the new objects are not covered by any dirty range
+		if(num_Objects > numObjects)
+		{
+			hostDirty.clear();
+			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			{
+				itr->second.dirty.clear();
+				if(itr->second.ptr && itr->first != latestDevice)
+					itr->second.needsUpdate = true;
+			}
+		}
+		else
+		{
+			hostDirty.clip(num_Objects);
+			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+				itr->second.dirty.clip(num_Objects);
+		}
 		numObjects = num_Objects;
     }
 
 	template<class DataType>
 	DataType* SynchronizedData<DataType>::getData(Device device, bool no_sync)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
 		// no synchronization?
 		if(no_sync) {
+			// the caller may write to the memory right away
+			finish_transfers();
+			// pending changes of the columns are overwritten as well
+			columnsNewer = false;
+			columnsValid = false;
+			revision++;
+			// managed memory may still be in use by the device that modified it last
+			if(managed)
+				ensure_managed_synchronization(device);
 			// set update flag to false to suppress warnings
-			if(device == DEVICE_HOST)
+			if(device == DEVICE_HOST) {
 				hostNeedsUpdate = false;
-			else
+				hostDirty.clear();
+			}
+			else {
 				deviceData[device].needsUpdate = false;
+				deviceData[device].dirty.clear();
+			}
 			// make sure the memory is allocated
 			ensure_allocation(device);
 		}
@@ -314,8 +715,10 @@ namespace OPI
 			ensure_synchronization(device);
 		if(device == DEVICE_HOST)
 			return hostData.data();
-		else
-			return deviceData[device].ptr;
+		// device memory accessed last is released last
+		lastUse = host.getDeviceMemoryBudget().tick();
+		lastDevice = device;
+		return deviceData[device].ptr;
 	}
 
 	template<class DataType>
@@ -337,16 +740,33 @@ namespace OPI
 			if(cuda) {
 				// check if the requested device is not out of range
 				if((device - DEVICE_CUDA) < cuda->getDeviceCount()) {
+					if(managed) {
+						// the device refers to the host memory, which may have been reallocated
+						ensure_allocation(DEVICE_HOST);
+						DataType* memory = hostData.data() + (is_sliced(device) ? std::min(deviceData[device].sliceOffset, numObjects) : 0);
+						if(deviceData[device].ptr != memory) {
+							deviceData[device].ptr = memory;
+							// map the memory for the device so accesses do not migrate it back and forth
+							cuda->adviseManaged(memory, sizeof(DataType) * (is_sliced(device) ? slice_count(device) : numObjects), device - DEVICE_CUDA);
+							deviceData[device].needsUpdate = true;
+							deviceData[device].dirty.clear();
+						}
+					}
 					// check if pointer already allocated
-					if(!deviceData[device].ptr)
+					else if(!deviceData[device].ptr)
 					{
 						// if not change device
 						int oldDevice = cuda->getCurrentDevice();
 						cuda->selectDevice(device - DEVICE_CUDA);
 						// allocate
-                        cuda->allocate((void**)&(deviceData[device].ptr), sizeof(DataType) * reservedSize);
+                        const int allocated = is_sliced(device) ? std::max(1, deviceData[device].sliceSize) : reservedSize;
+                        reserve_device_memory(sizeof(DataType) * allocated);
+                        cuda->allocate((void**)&(deviceData[device].ptr), sizeof(DataType) * allocated);
+                        host.recordAllocation(name, device, sizeof(DataType) * allocated);
+                        set_device_bytes(device, deviceData[device].ptr ? sizeof(DataType) * allocated : 0);
 						// set needUpdate flag to true
 						deviceData[device].needsUpdate = true;
+						deviceData[device].dirty.clear();
 						// select the old device
 						cuda->selectDevice(oldDevice);
 					}
@@ -364,8 +784,25 @@ namespace OPI
 	template<class DataType>
 	void SynchronizedData<DataType>::ensure_synchronization(Device device)
 	{
+		// modified columns have to be written back first
+		sync_rows();
+		// the host and all devices share managed memory
+		if(managed) {
+			ensure_managed_synchronization(device);
+			return;
+		}
+		// host memory may be modified afterwards, so pending uploads have to finish
+		if(device == DEVICE_HOST)
+			finish_transfers();
 		// first make sure the memory is allocated
 		ensure_allocation(device);
+		// devices holding a slice synchronize only that part
+		if(is_sliced(device)) {
+			ensure_slice_synchronization(device);
+			return;
+		}
+		// everything else requires the slices modified on other devices
+		if(slicesNewer) gather_slices();
 		// only update if there is an update available
 		if(latestDevice != -1) {
 			// device is host device
@@ -382,11 +819,21 @@ namespace OPI
 							int oldDevice = cuda->getCurrentDevice();
 							// select new device
 							cuda->selectDevice(latestDevice - DEVICE_CUDA);
-							// copy data from device to host
+							// copy data from device to host, or just the modified ranges
 							hostData.resize(numObjects);
-                            cuda->copy(hostData.data(), deviceData[latestDevice].ptr, sizeof(DataType), numObjects, false);
+							std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+							if(hostDirty.partial) {
+								for(size_t r = 0; r < hostDirty.ranges.size(); r++)
+									cuda->copyRange(hostData.data() + hostDirty.ranges[r].first, deviceData[latestDevice].ptr, (size_t)hostDirty.ranges[r].first * sizeof(DataType), sizeof(DataType), hostDirty.ranges[r].second, false);
+								record_transfer(latestDevice, DEVICE_HOST, sizeof(DataType) * hostDirty.objects(), start);
+							}
+							else {
+								cuda->copy(hostData.data(), deviceData[latestDevice].ptr, sizeof(DataType), numObjects, false);
+								record_transfer(latestDevice, DEVICE_HOST, sizeof(DataType) * numObjects, start);
+							}
 							// set update flag to false, since we just updated the values
 							hostNeedsUpdate = false;
+							hostDirty.clear();
 							// select the old device
 							cuda->selectDevice(oldDevice);
 						}
@@ -400,15 +847,30 @@ namespace OPI
 			else if ((device >= DEVICE_CUDA)&&(device <= DEVICE_CUDA_LAST)) {
 				// check if pointer already allocated
 				if(latestDevice == DEVICE_HOST) {
-					sync_host_to_device(device);
+					// an upload may already have been started by prefetch()
+					if(deviceData[device].prefetched) {
+						finish_transfer(device);
+						deviceData[device].prefetched = false;
+					}
+					// copies that are up to date are not uploaded again
+					else if(deviceData[device].needsUpdate)
+						sync_host_to_device(device);
+					deviceData[device].needsUpdate = false;
+					deviceData[device].dirty.clear();
 				}
 				else if((latestDevice >= DEVICE_CUDA)&&(latestDevice <= DEVICE_CUDA_LAST)) {
-					// synchronize to host first
-					ensure_synchronization(DEVICE_HOST);
-					// now synchronize from our host to the requested device
-					sync_host_to_device(device);
+					// the requested device already holds the latest data
+					if(latestDevice == device || !deviceData[device].needsUpdate) return;
+					// try a direct copy between the devices first, the host mirror stays stale
+					if(!sync_device_to_device(device)) {
+						// synchronize to host first
+						ensure_synchronization(DEVICE_HOST);
+						// now synchronize from our host to the requested device
+						sync_host_to_device(device);
+					}
 					// update the dirty flag
 					deviceData[device].needsUpdate = false;
+					deviceData[device].dirty.clear();
 				}
 				else // unknown device
 					host.sendError(INVALID_DEVICE);
@@ -418,6 +880,55 @@ namespace OPI
 		}
 	}
 
+	template<class DataType>
+	void SynchronizedData<DataType>::ensure_managed_synchronization(Device device)
+	{
+		// host memory may be modified afterwards, so pending prefetches have to finish
+		if(device == DEVICE_HOST)
+			finish_transfers();
+		ensure_allocation(device);
+		if(latestDevice == DEVICE_NOT_SET) return;
+		const bool outdated = slicesNewer || ((device == DEVICE_HOST) ? hostNeedsUpdate : deviceData[device].needsUpdate);
+		GpuSupport* cuda = host.getGPUSupport();
+		if(outdated && cuda) {
+			int oldDevice = cuda->getCurrentDevice();
+			// wait for the devices that modified the data, a prefetch to the host does both
+			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr) {
+				const bool modified = (itr->first == latestDevice && !slicesNewer) || itr->second.sliceNewer;
+				if(!modified || !itr->second.ptr || itr->first == device) continue;
+				cuda->selectDevice(itr->first - DEVICE_CUDA);
+				if(device == DEVICE_HOST)
+					cuda->prefetchManaged(itr->second.ptr, sizeof(DataType) * (is_sliced(itr->first) ? slice_count(itr->first) : numObjects), -1, 0);
+				else
+					cuda->synchronizeStream(0);
+			}
+			if(device != DEVICE_HOST) {
+				DeviceData& target = deviceData[device];
+				// an upload may already have been started by prefetch()
+				if(target.prefetched)
+					finish_transfer(device);
+				else {
+					cuda->selectDevice(device - DEVICE_CUDA);
+					cuda->prefetchManaged(target.ptr, sizeof(DataType) * (is_sliced(device) ? slice_count(device) : numObjects), device - DEVICE_CUDA, target.stream);
+				}
+			}
+			cuda->selectDevice(oldDevice);
+		}
+		if(device == DEVICE_HOST) {
+			// the memory is shared, so the modified slices are part of the host memory now
+			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+				itr->second.sliceNewer = false;
+			slicesNewer = false;
+			hostNeedsUpdate = false;
+			hostDirty.clear();
+		}
+		else {
+			deviceData[device].needsUpdate = false;
+			deviceData[device].prefetched = false;
+			deviceData[device].dirty.clear();
+		}
+	}
+
 	template<class DataType>
 	void SynchronizedData<DataType>::sync_host_to_device(Device device)
 	{
@@ -430,7 +941,19 @@ namespace OPI
 			// select the right device
 			cuda->selectDevice(device - DEVICE_CUDA);
 			// copy data from host to device
-            cuda->copy(deviceData[device].ptr, hostData.data(), sizeof(DataType), numObjects, true);
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const DirtyRanges& dirty = deviceData[device].dirty;
+			if(dirty.partial) {
+				// only the modified ranges are outdated
+				for(size_t r = 0; r < dirty.ranges.size(); r++)
+					cuda->copyRange(deviceData[device].ptr, hostData.data() + dirty.ranges[r].first, (size_t)dirty.ranges[r].first * sizeof(DataType), sizeof(DataType), dirty.ranges[r].second, true);
+				record_transfer(DEVICE_HOST, device, sizeof(DataType) * dirty.objects(), start);
+			}
+			else {
+				const int count = is_sliced(device) ? slice_count(device) : numObjects;
+				cuda->copy(deviceData[device].ptr, hostData.data() + (is_sliced(device) ? deviceData[device].sliceOffset : 0), sizeof(DataType), count, true);
+				record_transfer(DEVICE_HOST, device, sizeof(DataType) * count, start);
+			}
 			// select the old device again
 			cuda->selectDevice(oldDevice);
 		}
@@ -438,19 +961,814 @@ namespace OPI
 			host.sendError(CUDA_REQUIRED);
 	}
 
+	template<class DataType>
+	bool SynchronizedData<DataType>::sync_device_to_device(Device device)
+	{
+		// retrieve cuda support
+		GpuSupport* cuda = host.getGPUSupport();
+		// check if support is valid and the source data exists
+		if(cuda && deviceData[latestDevice].ptr) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			const DirtyRanges& dirty = deviceData[device].dirty;
+			if(dirty.partial) {
+				for(size_t r = 0; r < dirty.ranges.size(); r++)
+					if(!cuda->copyPeerRange(deviceData[device].ptr, (size_t)dirty.ranges[r].first * sizeof(DataType), device - DEVICE_CUDA, deviceData[latestDevice].ptr, (size_t)dirty.ranges[r].first * sizeof(DataType), latestDevice - DEVICE_CUDA, sizeof(DataType), dirty.ranges[r].second))
+						return false;
+				record_transfer(latestDevice, device, sizeof(DataType) * dirty.objects(), start);
+				return true;
+			}
+			if(!cuda->copyPeer(deviceData[device].ptr, device - DEVICE_CUDA, deviceData[latestDevice].ptr, latestDevice - DEVICE_CUDA, sizeof(DataType), numObjects))
+				return false;
+			record_transfer(latestDevice, device, sizeof(DataType) * numObjects, start);
+			return true;
+		}
+		return false;
+	}
+
 	template<class DataType>
 	void SynchronizedData<DataType>::update(Device device)
 	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		if(is_sliced(device)) {
+			// the rest of the data has to be on the host so the slice can be merged later
+			if(!slicesNewer && (latestDevice != DEVICE_HOST) && (latestDevice != DEVICE_NOT_SET))
+				ensure_synchronization(DEVICE_HOST);
+			finish_transfers();
+			columnsValid = false;
+			revision++;
+			columnsNewer = false;
+			slicesNewer = true;
+			deviceData[device].sliceNewer = true;
+			deviceData[device].needsUpdate = false;
+			// the host holds everything but the modified slices
+			latestDevice = DEVICE_HOST;
+			hostNeedsUpdate = true;
+			hostDirty.clear();
+			for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			{
+				// slices on other devices do not overlap and stay valid
+				if(itr->second.ptr && itr->second.sliceSize < 0) {
+					itr->second.needsUpdate = true;
+					itr->second.dirty.clear();
+				}
+				itr->second.prefetched = false;
+			}
+			return;
+		}
+		// pending uploads are outdated now
+		finish_transfers();
+		// as are the columns
+		columnsValid = false;
+		columnsNewer = false;
+		revision++;
+		// and the modified slices
+		slicesNewer = false;
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			itr->second.sliceNewer = false;
 		latestDevice = device;
 		// the host needs an update if the device is not the host itself
 		hostNeedsUpdate = (device != DEVICE_HOST);
+		hostDirty.clear();
 		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
 		{
 			// if the device has some memory allocated
 			if(itr->second.ptr)
 				// it may need an update
 				itr->second.needsUpdate = (itr->first != device);
+			itr->second.prefetched = false;
+			itr->second.dirty.clear();
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::update(Device device, int first, int count)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		if(first < 0) {
+			count += first;
+			first = 0;
 		}
+		count = std::min(count, numObjects - first);
+		if(count <= 0) return;
+		if(!begin_range_update(device)) {
+			update(device);
+			return;
+		}
+		add_dirty_range(first, count);
+	}
+
+	template<class DataType>
+	bool SynchronizedData<DataType>::begin_range_update(Device device)
+	{
+		// slices and modified columns are only tracked as a whole
+		if(latestDevice == DEVICE_NOT_SET || slicesNewer || columnsNewer) return false;
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			if(itr->second.sliceSize >= 0) return false;
+		finish_transfers();
+		columnsValid = false;
+		revision++;
+		// copies that were up to date are outdated by the new ranges only
+		if(device == DEVICE_HOST) {
+			hostNeedsUpdate = false;
+			hostDirty.clear();
+		}
+		else {
+			if(!hostNeedsUpdate || latestDevice == DEVICE_HOST) {
+				hostDirty.clear();
+				hostDirty.partial = true;
+			}
+			hostNeedsUpdate = true;
+		}
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+		{
+			DeviceData& target = itr->second;
+			target.prefetched = false;
+			if(itr->first == device) {
+				target.needsUpdate = false;
+				target.dirty.clear();
+			}
+			else if(target.ptr) {
+				if(!target.needsUpdate || itr->first == latestDevice) {
+					target.dirty.clear();
+					target.dirty.partial = true;
+				}
+				target.needsUpdate = true;
+			}
+		}
+		latestDevice = device;
+		return true;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::add_dirty_range(int first, int count)
+	{
+		if(hostNeedsUpdate && hostDirty.partial)
+			hostDirty.add(first, count, numObjects);
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			if(itr->second.needsUpdate && itr->second.dirty.partial)
+				itr->second.dirty.add(first, count, numObjects);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::DirtyRanges::add(int first, int count, int numObjects)
+	{
+		if(!partial) return;
+		// merge with all ranges that overlap or touch the new one
+		typename std::vector<std::pair<int, int> >::iterator itr = ranges.begin();
+		while(itr != ranges.end() && itr->first + itr->second < first) ++itr;
+		int last = first + count;
+		typename std::vector<std::pair<int, int> >::iterator end = itr;
+		while(end != ranges.end() && end->first <= last) {
+			first = std::min(first, end->first);
+			last = std::max(last, end->first + end->second);
+			++end;
+		}
+		itr = ranges.erase(itr, end);
+		ranges.insert(itr, std::make_pair(first, last - first));
+		// many small copies or most of the data are transferred faster at once
+		if(ranges.size() > 64 || objects() * 2 > (size_t)numObjects)
+			clear();
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::DirtyRanges::clip(int numObjects)
+	{
+		while(!ranges.empty() && ranges.back().first >= numObjects)
+			ranges.pop_back();
+		if(!ranges.empty())
+			ranges.back().second = std::min(ranges.back().second, numObjects - ranges.back().first);
+	}
+
+	template<class DataType>
+	size_t SynchronizedData<DataType>::DirtyRanges::objects() const
+	{
+		size_t count = 0;
+		for(size_t r = 0; r < ranges.size(); r++)
+			count += ranges[r].second;
+		return count;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::prefetch(Device device)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		sync_rows();
+		if ((device >= DEVICE_CUDA)&&(device <= DEVICE_CUDA_LAST)) {
+			// direct device to device copies are done right away
+			if(latestDevice != DEVICE_HOST || slicesNewer) {
+				ensure_synchronization(device);
+				return;
+			}
+			ensure_allocation(device);
+			GpuSupport* cuda = host.getGPUSupport();
+			DeviceData& target = deviceData[device];
+			// the data is only uploaded if it is outdated
+			const bool sliced = is_sliced(device);
+			if(cuda && target.ptr && !target.prefetched && target.needsUpdate) {
+				// store currently selected device
+				int oldDevice = cuda->getCurrentDevice();
+				cuda->selectDevice(device - DEVICE_CUDA);
+				if(!target.stream) target.stream = cuda->createStream();
+				// queue the upload and mark its end
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				if(managed)
+					cuda->prefetchManaged(target.ptr, sizeof(DataType) * (sliced ? slice_count(device) : numObjects), device - DEVICE_CUDA, target.stream);
+				else if(target.dirty.partial) {
+					for(size_t r = 0; r < target.dirty.ranges.size(); r++)
+						cuda->copyRangeAsync(target.ptr, hostData.data() + target.dirty.ranges[r].first, (size_t)target.dirty.ranges[r].first * sizeof(DataType), sizeof(DataType), target.dirty.ranges[r].second, true, target.stream);
+					record_transfer(DEVICE_HOST, device, sizeof(DataType) * target.dirty.objects(), start);
+				}
+				else {
+					const int count = sliced ? slice_count(device) : numObjects;
+					cuda->copyAsync(target.ptr, hostData.data() + (sliced ? target.sliceOffset : 0), sizeof(DataType), count, true, target.stream);
+					record_transfer(DEVICE_HOST, device, sizeof(DataType) * count, start);
+				}
+				target.transfer = cuda->recordEvent(target.stream);
+				target.prefetched = true;
+				// select the old device again
+				cuda->selectDevice(oldDevice);
+			}
+		}
+		else ensure_synchronization(device);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::finish_transfer(Device device)
+	{
+		typename std::map<Device, DeviceData>::iterator itr = deviceData.find(device);
+		if(itr != deviceData.end() && itr->second.transfer) {
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda) {
+				cuda->synchronizeEvent(itr->second.transfer);
+				cuda->destroyEvent(itr->second.transfer);
+			}
+			itr->second.transfer = 0;
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::finish_transfers()
+	{
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			finish_transfer(itr->first);
+	}
+
+	template<class DataType>
+	double* SynchronizedData<DataType>::getColumns(Device device, bool no_sync)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		const int components = sizeof(DataType) / sizeof(double);
+		if(!columnData) columnData.reset(new SynchronizedData<double>(host, (name + "Columns").c_str(), owner));
+		if(columnData->getSize() != numObjects * components) {
+			columnData->resize(numObjects * components);
+			columnsValid = false;
+		}
+		// the caller overwrites the columns and calls updateColumns() afterwards
+		if(no_sync)
+			return columnData->getData(device, true);
+		if(!columnsValid && !columnsNewer) {
+			transpose(true);
+			columnsValid = true;
+		}
+		return columnData->getData(device, false);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::updateColumns(Device device)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		if(columnData) {
+			columnData->update(device);
+			columnsValid = true;
+			columnsNewer = true;
+			revision++;
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::sync_rows()
+	{
+		if(columnsNewer) {
+			// reset first, transposing accesses the rows through ensure_synchronization()
+			columnsNewer = false;
+			transpose(false);
+			columnsValid = true;
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::setSlice(Device device, int offset, int count)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		if((device < DEVICE_CUDA) || (device > DEVICE_CUDA_LAST)) {
+			host.sendError(INVALID_DEVICE);
+			return;
+		}
+		if(count < 0) offset = 0;
+		DeviceData& target = deviceData[device];
+		if(target.sliceOffset == offset && target.sliceSize == count) return;
+		// the slice layout changes, so all data is collected on the host first
+		if(hasData()) ensure_synchronization(DEVICE_HOST);
+		finish_transfers();
+		GpuSupport* cuda = host.getGPUSupport();
+		if(cuda && target.ptr && !managed) {
+			int oldDevice = cuda->getCurrentDevice();
+			cuda->selectDevice(device - DEVICE_CUDA);
+			cuda->free(target.ptr);
+			cuda->selectDevice(oldDevice);
+		}
+		target.ptr = 0;
+		set_device_bytes(device, 0);
+		target.needsUpdate = false;
+		target.prefetched = false;
+		target.sliceOffset = offset;
+		target.sliceSize = count;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::gatherFrom(SynchronizedData<DataType>& source, IndexList& list, int arraySize)
+	{
+		std::unique_lock<MirrorMutex> lock(mutex, std::defer_lock);
+		std::unique_lock<MirrorMutex> sourceLock(source.mutex, std::defer_lock);
+		std::lock(lock, sourceLock);
+		const int count = list.getSize();
+		const int sourceCount = source.numObjects / arraySize;
+		const size_t elementSize = sizeof(DataType) * arraySize;
+		resize(count * arraySize);
+		// fields that were never set are not allocated anywhere
+		if(count == 0 || !source.hasData()) return;
+		// gather on the device holding the latest data so only the selected objects are touched
+		const Device device = source.latestDevice;
+		if((device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST) && !source.slicesNewer && !source.is_sliced(device)) {
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda) {
+				const DataType* sourceData = source.getData(device, false);
+				const int* indices = list.getData(device);
+				DataType* destination = getData(device, true);
+				int oldDevice = cuda->getCurrentDevice();
+				cuda->selectDevice(device - DEVICE_CUDA);
+				bool gathered = cuda->gatherElements(destination, sourceData, indices, count, sourceCount, elementSize);
+				cuda->selectDevice(oldDevice);
+				if(gathered) {
+					update(device);
+					return;
+				}
+			}
+		}
+		const DataType* sourceData = source.getData(DEVICE_HOST, false);
+		const int* indices = list.getData(DEVICE_HOST);
+		DataType* destination = getData(DEVICE_HOST, true);
+		for(int i = 0; i < count; i++) {
+			if(indices[i] >= 0 && indices[i] < sourceCount)
+				std::copy(sourceData + (size_t)indices[i] * arraySize, sourceData + (size_t)(indices[i] + 1) * arraySize, destination + (size_t)i * arraySize);
+		}
+		update(DEVICE_HOST);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::scatterFrom(SynchronizedData<DataType>& source, IndexList& list, int arraySize)
+	{
+		std::unique_lock<MirrorMutex> lock(mutex, std::defer_lock);
+		std::unique_lock<MirrorMutex> sourceLock(source.mutex, std::defer_lock);
+		std::lock(lock, sourceLock);
+		const int count = std::min(list.getSize(), source.numObjects / arraySize);
+		const int destinationCount = numObjects / arraySize;
+		const size_t elementSize = sizeof(DataType) * arraySize;
+		if(count <= 0 || !source.hasData()) return;
+		// scatter where the latest data is, so the rest of the objects stays in place
+		const Device device = latestDevice;
+		if((device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST) && !slicesNewer && !is_sliced(device)) {
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda) {
+				DataType* destination = getData(device, false);
+				const DataType* sourceData = source.getData(device, false);
+				const int* indices = list.getData(device);
+				int oldDevice = cuda->getCurrentDevice();
+				cuda->selectDevice(device - DEVICE_CUDA);
+				bool scattered = cuda->scatterElements(destination, destinationCount, sourceData, indices, count, elementSize);
+				cuda->selectDevice(oldDevice);
+				if(scattered) {
+					update(device);
+					return;
+				}
+			}
+		}
+		DataType* destination = getData(DEVICE_HOST, false);
+		const DataType* sourceData = source.getData(DEVICE_HOST, false);
+		const int* indices = list.getData(DEVICE_HOST);
+		for(int i = 0; i < count; i++) {
+			if(indices[i] >= 0 && indices[i] < destinationCount)
+				std::copy(sourceData + (size_t)i * arraySize, sourceData + (size_t)(i + 1) * arraySize, destination + (size_t)indices[i] * arraySize);
+		}
+		// devices holding a copy only need the scattered objects
+		if(begin_range_update(DEVICE_HOST)) {
+			for(int i = 0; i < count; i++)
+				if(indices[i] >= 0 && indices[i] < destinationCount)
+					add_dirty_range(indices[i] * arraySize, arraySize);
+		}
+		else update(DEVICE_HOST);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::copyFrom(SynchronizedData<DataType>& source, int first, int count, int offset, int arraySize)
+	{
+		std::unique_lock<MirrorMutex> lock(mutex, std::defer_lock);
+		std::unique_lock<MirrorMutex> sourceLock(source.mutex, std::defer_lock);
+		std::lock(lock, sourceLock);
+		if(count <= 0) return;
+		const int begin = first * arraySize;
+		const int destination = offset * arraySize;
+		const int elements = count * arraySize;
+		// fields that were never set are copied by clearing the range
+		if(!source.hasData()) {
+			if(hasData()) zeroRange(destination, elements);
+			return;
+		}
+		const Device sourceDevice = source.latestDevice;
+		if((sourceDevice >= DEVICE_CUDA) && (sourceDevice <= DEVICE_CUDA_LAST) && !source.slicesNewer && !source.is_sliced(sourceDevice)) {
+			// the range is written where the latest data of this object is
+			Device device = DEVICE_NOT_SET;
+			if((latestDevice >= DEVICE_CUDA) && (latestDevice <= DEVICE_CUDA_LAST)) device = latestDevice;
+			else if(!hasData()) device = sourceDevice;
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda && (device != DEVICE_NOT_SET) && !slicesNewer && !is_sliced(device)) {
+				DataType* sourceData = source.getData(sourceDevice, false);
+				DataType* destinationData = getData(device, false);
+				if(cuda->copyPeerRange(destinationData, (size_t)destination * sizeof(DataType), device - DEVICE_CUDA, sourceData, (size_t)begin * sizeof(DataType), sourceDevice - DEVICE_CUDA, sizeof(DataType), elements)) {
+					update(device, destination, elements);
+					return;
+				}
+			}
+		}
+		const DataType* sourceData = source.getData(DEVICE_HOST, false);
+		DataType* destinationData = getData(DEVICE_HOST, false);
+		// the ranges may overlap if both are the same object
+		std::memmove(destinationData + destination, sourceData + begin, (size_t)elements * sizeof(DataType));
+		update(DEVICE_HOST, destination, elements);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::zeroRange(int first, int count)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		if(count <= 0) return;
+		const Device device = latestDevice;
+		if((device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST) && !slicesNewer && !is_sliced(device)) {
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda) {
+				DataType* data = getData(device, false);
+				int oldDevice = cuda->getCurrentDevice();
+				cuda->selectDevice(device - DEVICE_CUDA);
+				bool cleared = cuda->zeroMemoryRange(data, (size_t)first * sizeof(DataType), (size_t)count * sizeof(DataType));
+				cuda->selectDevice(oldDevice);
+				if(cleared) {
+					update(device, first, count);
+					return;
+				}
+			}
+		}
+		// the constructors of the generated types leave their members uninitialized
+		DataType zero;
+		std::memset(static_cast<void*>(&zero), 0, sizeof(DataType));
+		std::fill_n(getData(DEVICE_HOST, false) + first, count, zero);
+		update(DEVICE_HOST, first, count);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::permute(IndexList& list, int arraySize)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		const int count = numObjects / arraySize;
+		const size_t elementSize = sizeof(DataType) * arraySize;
+		if(count == 0 || !hasData()) return;
+		sync_rows();
+		const Device device = latestDevice;
+		// managed memory cannot be replaced by a device allocation
+		if((device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST) && !slicesNewer && !is_sliced(device) && !managed) {
+			GpuSupport* cuda = host.getGPUSupport();
+			if(cuda) {
+				const int* indices = list.getData(device);
+				DataType* source = getData(device, false);
+				finish_transfers();
+				int oldDevice = cuda->getCurrentDevice();
+				cuda->selectDevice(device - DEVICE_CUDA);
+				// gather into a new allocation that replaces the old one
+				DataType* permuted = 0;
+				reserve_device_memory(sizeof(DataType) * reservedSize);
+				cuda->allocate((void**)&permuted, sizeof(DataType) * reservedSize);
+				bool gathered = permuted && cuda->gatherElements(permuted, source, indices, count, count, elementSize);
+				if(gathered) cuda->free(source);
+				else if(permuted) cuda->free(permuted);
+				cuda->selectDevice(oldDevice);
+				if(gathered) {
+					host.recordAllocation(name, device, sizeof(DataType) * reservedSize);
+					deviceData[device].ptr = permuted;
+					set_device_bytes(device, sizeof(DataType) * reservedSize);
+					update(device);
+					return;
+				}
+			}
+		}
+		ensure_synchronization(DEVICE_HOST);
+		const int* indices = list.getData(DEVICE_HOST);
+		const std::vector<DataType> source(hostData.begin(), hostData.begin() + numObjects);
+		DataType* destination = hostData.data();
+		parallelFor(count, [&](int begin, int end) {
+			for(int i = begin; i < end; i++)
+				std::copy(source.begin() + (size_t)indices[i] * arraySize, source.begin() + (size_t)(indices[i] + 1) * arraySize, destination + (size_t)i * arraySize);
+		});
+		update(DEVICE_HOST);
+	}
+
+	template<class DataType>
+	bool SynchronizedData<DataType>::compactOnDevice(IndexList& list, int arraySize)
+	{
+		std::lock_guard<MirrorMutex> lock(mutex);
+		const int count = list.getSize();
+		const size_t elementSize = sizeof(DataType) * arraySize;
+		if(!hasData() || count * arraySize > numObjects) return false;
+		sync_rows();
+		const Device device = latestDevice;
+		// managed memory cannot be replaced by a device allocation
+		if((device < DEVICE_CUDA) || (device > DEVICE_CUDA_LAST) || slicesNewer || is_sliced(device) || managed) return false;
+		GpuSupport* cuda = host.getGPUSupport();
+		if(!cuda) return false;
+		const int* indices = list.getData(device);
+		DataType* source = getData(device, false);
+		finish_transfers();
+		int oldDevice = cuda->getCurrentDevice();
+		cuda->selectDevice(device - DEVICE_CUDA);
+		// gather into a new allocation that replaces the old one
+		DataType* compacted = 0;
+		reserve_device_memory(sizeof(DataType) * reservedSize);
+		cuda->allocate((void**)&compacted, sizeof(DataType) * reservedSize);
+		bool gathered = compacted && cuda->gatherElements(compacted, source, indices, count, numObjects / arraySize, elementSize);
+		if(gathered) cuda->free(source);
+		else if(compacted) cuda->free(compacted);
+		cuda->selectDevice(oldDevice);
+		if(!gathered) return false;
+		host.recordAllocation(name, device, sizeof(DataType) * reservedSize);
+		deviceData[device].ptr = compacted;
+		set_device_bytes(device, sizeof(DataType) * reservedSize);
+		// the host and other devices are outdated and only need the remaining objects
+		numObjects = count * arraySize;
+		if(hostData.capacity() > 0) hostData.resize(numObjects);
+		update(device);
+		return true;
+	}
+
+	template<class DataType>
+	bool SynchronizedData<DataType>::grow_on_device(int num_Objects)
+	{
+		const Device device = latestDevice;
+		// managed memory only grows on the host
+		if((device < DEVICE_CUDA) || (device > DEVICE_CUDA_LAST) || slicesNewer || managed) return false;
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			if(itr->second.sliceSize >= 0) return false;
+		GpuSupport* cuda = host.getGPUSupport();
+		DataType* oldPtr = deviceData[device].ptr;
+		if(!cuda || !oldPtr) return false;
+		finish_transfers();
+		int oldDevice = cuda->getCurrentDevice();
+		cuda->selectDevice(device - DEVICE_CUDA);
+		DataType* newPtr = 0;
+		const size_t kept = deviceData[device].bytes;
+		if(kept >= sizeof(DataType) * num_Objects)
+		{
+			// the allocation is still large enough from before a shrinking reserve()
+			const bool zeroed = cuda->zeroMemoryRange(oldPtr, sizeof(DataType) * numObjects, sizeof(DataType) * (num_Objects - numObjects));
+			cuda->selectDevice(oldDevice);
+			if(!zeroed) return false;
+			deviceData[device].ptr = 0;
+			clearDevices();
+			deviceData[device].ptr = oldPtr;
+			set_device_bytes(device, kept);
+			deviceData[device].needsUpdate = false;
+			deviceData[device].dirty.clear();
+			hostNeedsUpdate = true;
+			hostDirty.clear();
+			return true;
+		}
+		reserve_device_memory(sizeof(DataType) * num_Objects);
+		cuda->allocate((void**)&newPtr, sizeof(DataType) * num_Objects);
+		// the new objects are zero, as they are on the host
+		bool moved = newPtr
+			&& cuda->copyPeer(newPtr, device - DEVICE_CUDA, oldPtr, device - DEVICE_CUDA, sizeof(DataType), numObjects)
+			&& cuda->zeroMemoryRange(newPtr, sizeof(DataType) * numObjects, sizeof(DataType) * (num_Objects - numObjects));
+		cuda->selectDevice(oldDevice);
+		if(!moved) {
+			if(newPtr) {
+				cuda->selectDevice(device - DEVICE_CUDA);
+				cuda->free(newPtr);
+				cuda->selectDevice(oldDevice);
+			}
+			return false;
+		}
+		host.recordAllocation(name, device, sizeof(DataType) * num_Objects);
+		// all other copies are too small now and are recreated on their next use
+		deviceData[device].ptr = 0;
+		clearDevices();
+		cuda->selectDevice(device - DEVICE_CUDA);
+		cuda->free(oldPtr);
+		cuda->selectDevice(oldDevice);
+		deviceData[device].ptr = newPtr;
+		set_device_bytes(device, sizeof(DataType) * num_Objects);
+		deviceData[device].needsUpdate = false;
+		deviceData[device].dirty.clear();
+		hostNeedsUpdate = true;
+		hostDirty.clear();
+		return true;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::record_transfer(Device source, Device destination, size_t bytes, std::chrono::steady_clock::time_point start)
+	{
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		host.recordTransfer(name, source, destination, bytes, milliseconds);
+		if(host.isTracing()) {
+			// the transfer has already finished, so its begin is reconstructed from the duration
+			const double now = host.getTraceTime();
+			const int count = (int)(bytes / sizeof(DataType));
+			host.trace(TRACE_BEGIN, "transfer", name.c_str(), count, destination, now - milliseconds * 1000.0);
+			host.trace(TRACE_END, "transfer", name.c_str(), count, destination, now);
+		}
+	}
+
+	template<class DataType>
+	bool SynchronizedData<DataType>::is_sliced(Device device)
+	{
+		typename std::map<Device, DeviceData>::iterator itr = deviceData.find(device);
+		return (itr != deviceData.end()) && (itr->second.sliceSize >= 0);
+	}
+
+	template<class DataType>
+	int SynchronizedData<DataType>::slice_count(Device device)
+	{
+		// slices are clipped to the current number of objects
+		const DeviceData& data = deviceData[device];
+		return std::max(0, std::min(data.sliceSize, numObjects - data.sliceOffset));
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::gather_slices()
+	{
+		GpuSupport* cuda = host.getGPUSupport();
+		if(!cuda) {
+			host.sendError(CUDA_REQUIRED);
+			return;
+		}
+		int oldDevice = cuda->getCurrentDevice();
+		hostData.resize(numObjects);
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr) {
+			if(itr->second.sliceNewer && itr->second.ptr) {
+				cuda->selectDevice(itr->first - DEVICE_CUDA);
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				cuda->copy(hostData.data() + itr->second.sliceOffset, itr->second.ptr, sizeof(DataType), slice_count(itr->first), false);
+				record_transfer(itr->first, DEVICE_HOST, sizeof(DataType) * slice_count(itr->first), start);
+			}
+			itr->second.sliceNewer = false;
+		}
+		cuda->selectDevice(oldDevice);
+		slicesNewer = false;
+		hostNeedsUpdate = false;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::ensure_slice_synchronization(Device device)
+	{
+		DeviceData& target = deviceData[device];
+		if(latestDevice == DEVICE_NOT_SET) return;
+		// the slice on the device is the latest version
+		if(slicesNewer && target.sliceNewer) return;
+		if(!slicesNewer && latestDevice != DEVICE_HOST) {
+			// the latest data is on a device holding all objects
+			ensure_synchronization(DEVICE_HOST);
+			target.needsUpdate = true;
+		}
+		// the host memory of this slice is valid now
+		if(target.prefetched) {
+			finish_transfer(device);
+			target.prefetched = false;
+			target.needsUpdate = false;
+		}
+		else if(target.needsUpdate) {
+			sync_host_to_device(device);
+			target.needsUpdate = false;
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::transpose(bool toColumns)
+	{
+		const int components = sizeof(DataType) / sizeof(double);
+		const int size = numObjects;
+		// transpose on the device holding the latest data if possible
+		Device device = toColumns ? latestDevice : columnData->getLatestDevice();
+		GpuSupport* cuda = host.getGPUSupport();
+		if(cuda && (device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST)) {
+			bool transposed = false;
+			int oldDevice = cuda->getCurrentDevice();
+			if(toColumns) {
+				ensure_synchronization(device);
+				double* columns = columnData->getData(device, true);
+				cuda->selectDevice(device - DEVICE_CUDA);
+				transposed = cuda->transpose(columns, reinterpret_cast<double*>(deviceData[device].ptr), size, components);
+				if(transposed) columnData->update(device);
+			}
+			else {
+				double* columns = columnData->getData(device, false);
+				ensure_allocation(device);
+				cuda->selectDevice(device - DEVICE_CUDA);
+				transposed = cuda->transpose(reinterpret_cast<double*>(deviceData[device].ptr), columns, components, size);
+				if(transposed) update(device);
+			}
+			cuda->selectDevice(oldDevice);
+			if(transposed) return;
+		}
+		if(toColumns) {
+			ensure_synchronization(DEVICE_HOST);
+			const double* rows = reinterpret_cast<const double*>(hostData.data());
+			double* columns = columnData->getData(DEVICE_HOST, true);
+			parallelFor(size, [=](int begin, int end) {
+				for(int c = 0; c < components; c++)
+					for(int i = begin; i < end; i++)
+						columns[(size_t)c * size + i] = rows[(size_t)i * components + c];
+			});
+			columnData->update(DEVICE_HOST);
+		}
+		else {
+			const double* columns = columnData->getData(DEVICE_HOST, false);
+			ensure_allocation(DEVICE_HOST);
+			double* rows = reinterpret_cast<double*>(hostData.data());
+			parallelFor(size, [=](int begin, int end) {
+				for(int i = begin; i < end; i++)
+					for(int c = 0; c < components; c++)
+						rows[(size_t)i * components + c] = columns[(size_t)c * size + i];
+			});
+			update(DEVICE_HOST);
+		}
+	}
+
+	template<class DataType>
+	size_t SynchronizedData<DataType>::evictDevices()
+	{
+		// data in use by any thread, including the evicting one, is left alone
+		if(!mutex.try_lock_unused()) return 0;
+		std::lock_guard<MirrorMutex> lock(mutex, std::adopt_lock);
+		if(managed || deviceBytes == 0) return 0;
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr)
+			if(itr->second.ptr && itr->second.sliceSize >= 0) return 0;
+		// data that is newer on a device is written back first
+		if((latestDevice >= DEVICE_CUDA) && (latestDevice <= DEVICE_CUDA_LAST)) {
+			ensure_synchronization(DEVICE_HOST);
+			latestDevice = DEVICE_HOST;
+		}
+		const size_t released = deviceBytes;
+		clearDevices();
+		return released;
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::appendUsage(std::vector<DeviceMemoryUsage>& usage)
+	{
+		// data in use by another thread may be allocating, which takes the budget lock that the
+		// caller holds; it is reported as one entry from the atomic counters instead
+		if(!mutex.try_lock()) {
+			DeviceMemoryUsage entry;
+			entry.owner = owner;
+			entry.data = name;
+			entry.device = (Device)lastDevice.load();
+			entry.bytes = deviceBytes;
+			entry.newerThanHost = false;
+			usage.push_back(entry);
+			return;
+		}
+		std::lock_guard<MirrorMutex> lock(mutex, std::adopt_lock);
+		for(typename std::map<Device, DeviceData>::iterator itr = deviceData.begin(); itr != deviceData.end(); ++itr) {
+			if(itr->second.bytes == 0) continue;
+			DeviceMemoryUsage entry;
+			entry.owner = owner;
+			entry.data = name;
+			entry.device = itr->first;
+			entry.bytes = itr->second.bytes;
+			entry.newerThanHost = (itr->first == latestDevice && hostNeedsUpdate) || itr->second.sliceNewer;
+			usage.push_back(entry);
+		}
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::reserve_device_memory(size_t bytes)
+	{
+		host.getDeviceMemoryBudget().reserve(this, bytes);
+	}
+
+	template<class DataType>
+	void SynchronizedData<DataType>::set_device_bytes(Device device, size_t bytes)
+	{
+		DeviceData& target = deviceData[device];
+		deviceBytes += bytes;
+		deviceBytes -= target.bytes;
+		target.bytes = bytes;
 	}
 }
 
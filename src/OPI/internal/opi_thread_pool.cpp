@@ -0,0 +1,172 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_thread_pool.h"
+#include <algorithm>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	ThreadPool::ThreadPool(int numThreads):
+		queuedTasks(0),
+		stopping(false)
+	{
+		if(numThreads <= 0)
+			numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		// the calling thread uses the last queue
+		for(int i = 0; i < numThreads; i++)
+			queues.push_back(std::unique_ptr<Queue>(new Queue()));
+		for(int i = 0; i < numThreads - 1; i++)
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		joinTaskThreads(true);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wakeWorkers.notify_all();
+		for(size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	int ThreadPool::getThreadCount() const
+	{
+		return (int)queues.size();
+	}
+
+	void ThreadPool::run(int count, const std::function<void(int)>& body)
+	{
+		if(count <= 0) return;
+		if(workers.empty() || count == 1) {
+			for(int i = 0; i < count; i++) body(i);
+			return;
+		}
+		Batch batch;
+		batch.body = &body;
+		batch.remaining = count;
+		// deal out the tasks round robin, consecutive indices end up on different threads
+		for(int i = 0; i < count; i++) {
+			Queue& queue = *queues[i % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			Task task = { &batch, i };
+			queue.tasks.push_back(task);
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			queuedTasks += count;
+		}
+		wakeWorkers.notify_all();
+		// threads waiting for another batch may help with this one
+		batchDone.notify_all();
+
+		const int self = (int)queues.size() - 1;
+		while(batch.remaining > 0) {
+			if(!runTask(self)) {
+				// the remaining tasks are running on other threads
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				batchDone.wait(lock, [&]{ return batch.remaining == 0 || queuedTasks > 0; });
+			}
+		}
+	}
+
+	void ThreadPool::submit(const std::function<void()>& task)
+	{
+		if(workers.empty()) {
+			joinTaskThreads(false);
+			std::shared_ptr<std::atomic<bool> > finished(new std::atomic<bool>(false));
+			std::lock_guard<std::mutex> lock(taskThreadMutex);
+			taskThreads.push_back(std::make_pair(std::thread([task, finished]() {
+				task();
+				*finished = true;
+			}), finished));
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			submitted.push_back(task);
+		}
+		wakeWorkers.notify_one();
+	}
+
+	void ThreadPool::joinTaskThreads(bool all)
+	{
+		std::lock_guard<std::mutex> lock(taskThreadMutex);
+		for(size_t i = 0; i < taskThreads.size();) {
+			if(all || *taskThreads[i].second) {
+				taskThreads[i].first.join();
+				taskThreads.erase(taskThreads.begin() + i);
+			}
+			else i++;
+		}
+	}
+
+	bool ThreadPool::runTask(int worker)
+	{
+		Task task = { 0, 0 };
+		const int numQueues = (int)queues.size();
+		for(int i = 0; i < numQueues && !task.batch; i++) {
+			Queue& queue = *queues[(worker + i) % numQueues];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if(queue.tasks.empty()) continue;
+			// own queue from the back, others from the front
+			if(i == 0) {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			else {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+		}
+		if(!task.batch) return false;
+		queuedTasks--;
+		(*task.batch->body)(task.index);
+		if(--task.batch->remaining == 0) {
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			batchDone.notify_all();
+		}
+		return true;
+	}
+
+	void ThreadPool::workerLoop(int worker)
+	{
+		while(true) {
+			if(runTask(worker)) continue;
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wakeWorkers.wait(lock, [&]{ return stopping || queuedTasks > 0 || !submitted.empty(); });
+			// tasks of run() calls come first, their callers are waiting
+			if(queuedTasks > 0) continue;
+			if(!submitted.empty()) {
+				std::function<void()> task = submitted.front();
+				submitted.pop_front();
+				lock.unlock();
+				task();
+				continue;
+			}
+			// submitted tasks are finished before the workers stop
+			if(stopping) return;
+		}
+	}
+
+	/**
+	 * \endcond
+	 */
+}
@@ -0,0 +1,103 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_THREAD_POOL_H
+#define OPI_THREAD_POOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	//! Work-stealing thread pool owned by the Host
+	/** Every worker has its own task queue. Workers take tasks from the back of their own
+	 * queue and steal from the front of the others when it runs empty, so uneven task
+	 * durations are balanced without a central lock. The thread calling run() executes
+	 * tasks as well, which makes nested calls from within a task safe.
+	 */
+	class ThreadPool
+	{
+		public:
+			//! Creates a pool using the given total number of threads (0: one per hardware thread)
+			ThreadPool(int numThreads = 0);
+			~ThreadPool();
+
+			//! Returns the number of threads working on a run() call, including the caller
+			int getThreadCount() const;
+
+			//! Calls body(i) for every i in [0, count) and returns when all calls have finished
+			/** The calls may run concurrently and in any order. */
+			void run(int count, const std::function<void(int)>& body);
+
+			//! Queues a task and returns without waiting for it
+			/** Submitted tasks are only run by the worker threads, never by a thread waiting in
+			 * run(), so a long task cannot delay an unrelated run() call. A pool without workers
+			 * starts a separate thread for every task. Tasks that have not run yet are finished
+			 * before the pool is destroyed.
+			 */
+			void submit(const std::function<void()>& task);
+
+		private:
+			struct Batch
+			{
+				const std::function<void(int)>* body;
+				std::atomic<int> remaining;
+			};
+			struct Task
+			{
+				Batch* batch;
+				int index;
+			};
+			struct Queue
+			{
+				std::mutex mutex;
+				std::deque<Task> tasks;
+			};
+
+			// executes one task from the given worker's queue or any other queue
+			bool runTask(int worker);
+			void workerLoop(int worker);
+			// joins the threads of submitted tasks that have finished, or all of them
+			void joinTaskThreads(bool all);
+
+			std::vector<std::unique_ptr<Queue> > queues;
+			std::vector<std::thread> workers;
+			// submitted tasks, guarded by sleepMutex
+			std::deque<std::function<void()> > submitted;
+			// threads running submitted tasks if there are no workers, with their finished flags
+			std::vector<std::pair<std::thread, std::shared_ptr<std::atomic<bool> > > > taskThreads;
+			std::mutex taskThreadMutex;
+			std::mutex sleepMutex;
+			std::condition_variable wakeWorkers;
+			std::condition_variable batchDone;
+			std::atomic<int> queuedTasks;
+			bool stopping;
+	};
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
@@ -0,0 +1,56 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_TRACE_H
+#define OPI_TRACE_H
+#include "../opi_host.h"
+#include "../opi_module.h"
+namespace OPI
+{
+	//! Reports the begin and end of an operation to the trace callback and trace file of a Host
+	/** Tracing costs a single flag check if the Host is not tracing.
+	 */
+	class TraceScope
+	{
+		public:
+			TraceScope(const Host& traceHost, const char* traceOperation, const char* traceModule, int traceSize, Device traceDevice):
+				host(traceHost), operation(traceOperation), module(traceModule), size(traceSize), device(traceDevice)
+			{
+				if(host.isTracing()) host.trace(TRACE_BEGIN, operation, module, size, device);
+			}
+			~TraceScope()
+			{
+				if(host.isTracing()) host.trace(TRACE_END, operation, module, size, device);
+			}
+
+		private:
+			TraceScope(const TraceScope&);
+			TraceScope& operator=(const TraceScope&);
+
+			const Host& host;
+			const char* operation;
+			const char* module;
+			int size;
+			Device device;
+	};
+
+	//! Returns the device a module is expected to run on, for tracing
+	inline Device traceDevice(Module& module)
+	{
+		return (module.requiresCUDA() > 0 || module.requiresOpenCL() > 0) ? DEVICE_CUDA : DEVICE_HOST;
+	}
+}
+#endif
@@ -0,0 +1,105 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_VALIDATION_H
+#define OPI_VALIDATION_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include "../opi_datatypes.h"
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Checks of Population::validate, shared by the host implementation and the CUDA kernel.
+
+	//! Julian date of 1950-01-01; current epochs before that count as not set
+	const double VALIDATION_MINIMUM_EPOCH = 2433282.5;
+	//! Earth radius used by the validation, in km
+	const double VALIDATION_EARTH_RADIUS = 6378.0;
+
+	//! Epoch state of an object reported by validateObject()
+	enum ValidationEpoch
+	{
+		VALIDATION_EPOCH_NO_ORBIT = 0,
+		VALIDATION_EPOCH_SET = 1,
+		VALIDATION_EPOCH_NOT_SET = 2
+	};
+
+	//! Returns the ValidationFlags of an object; fields without data are passed as null
+	/** epochState is set to one of the ValidationEpoch values. */
+	OPI_CUDA_PREFIX inline int validateObject(const ObjectProperties* properties, const Orbit* orbit, const Epoch* epoch,
+											  const Vector3* position, const Vector3* velocity, int& epochState)
+	{
+		int flags = VALIDATION_NONE;
+		const Epoch e = epoch ? *epoch : Epoch(0.0, 0.0, 0.0);
+		if (properties && !isZero(*properties))
+		{
+			const ObjectProperties& p = *properties;
+			if (hasNaN(p)) flags |= VALIDATION_PROPERTIES_NAN;
+			if (p.drag_coefficient < 1e-32) flags |= VALIDATION_DRAG_COEFFICIENT;
+			if (p.mass < 1e-12) flags |= VALIDATION_MASS;
+			if (p.diameter < 1e-12) flags |= VALIDATION_DIAMETER;
+			if (p.area_to_mass <= 0.0) flags |= VALIDATION_AREA_TO_MASS;
+			if (p.reflectivity < 0.0 || p.reflectivity > 2.0) flags |= VALIDATION_REFLECTIVITY;
+		}
+
+		const bool hasOrbit = orbit && !isZero(*orbit);
+		epochState = VALIDATION_EPOCH_NO_ORBIT;
+		if (hasOrbit)
+		{
+			const Orbit& o = *orbit;
+			const double limit = 2*M_PI;
+			if (hasNaN(o)) flags |= VALIDATION_ORBIT_NAN;
+			if (o.semi_major_axis < VALIDATION_EARTH_RADIUS && e.end_of_life <= 0.0) flags |= VALIDATION_DECAYED;
+			if (o.eccentricity <= 0.0 || o.eccentricity >= 1.0) flags |= VALIDATION_ECCENTRICITY;
+			if (o.inclination < -limit || o.inclination > limit
+				|| o.raan < -limit || o.raan > limit
+				|| o.arg_of_perigee < -limit || o.arg_of_perigee > limit
+				|| o.mean_anomaly < -limit || o.mean_anomaly > limit)
+				flags |= VALIDATION_ANGLES;
+			if (e.end_of_life > 0.0 && e.beginning_of_life > 0.0 && e.end_of_life < e.beginning_of_life) flags |= VALIDATION_LIFETIME;
+			epochState = (e.current_epoch < VALIDATION_MINIMUM_EPOCH) ? VALIDATION_EPOCH_NOT_SET : VALIDATION_EPOCH_SET;
+		}
+
+		const bool hasPosition = position && !isZero(*position);
+		const bool hasVelocity = velocity && !isZero(*velocity);
+		if (hasPosition)
+		{
+			if (hasVelocity)
+			{
+				if (length(*position) <= VALIDATION_EARTH_RADIUS && e.end_of_life <= 0.0) flags |= VALIDATION_INSIDE_EARTH;
+				if (length(*velocity) <= 0.0) flags |= VALIDATION_VELOCITY;
+			}
+			else flags |= VALIDATION_NO_VELOCITY;
+		}
+		if (!hasOrbit && !hasPosition && !hasVelocity) flags |= VALIDATION_NO_STATE;
+		return flags;
+	}
+
+	/**
+	 * \endcond
+	 */
+}
+
+#endif
@@ -0,0 +1,593 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_checkpoint.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_gpusupport.h"
+#include "internal/miniz.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Magic number and version of checkpoint files
+	static const int CHECKPOINT_FILE_MAGIC = 47632;
+	static const int CHECKPOINT_FILE_VERSION = 1;
+	// Fields that can be stored in a checkpoint
+	static const int CHECKPOINT_FIELDS = FIELD_ORBIT | FIELD_PROPERTIES | FIELD_POSITION | FIELD_VELOCITY
+		| FIELD_ACCELERATION | FIELD_EPOCH | FIELD_COVARIANCE | FIELD_BYTES | FIELD_NAMES;
+	// Block identifiers that are not data types
+	static const int CHECKPOINT_END = -1;
+	static const int CHECKPOINT_NAMES = -2;
+	// Objects per block compared with the previous snapshot
+	static const int CHECKPOINT_BLOCK_OBJECTS = 4096;
+	// Snapshots waiting for the writer before snapshot() blocks
+	static const size_t CHECKPOINT_QUEUED_SNAPSHOTS = 2;
+
+	static size_t checkpointElementSize(const Population& population, int type)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return sizeof(Orbit);
+			case DATA_PROPERTIES: return sizeof(ObjectProperties);
+			case DATA_POSITION:
+			case DATA_VELOCITY:
+			case DATA_ACCELERATION: return sizeof(Vector3);
+			case DATA_EPOCH: return sizeof(Epoch);
+			case DATA_COVARIANCE: return sizeof(Covariance);
+			case DATA_BYTES: return population.getByteArraySize();
+			default: return 0;
+		}
+	}
+
+	static char* checkpointField(const Population& population, int type, Device device)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return reinterpret_cast<char*>(population.getOrbit(device));
+			case DATA_PROPERTIES: return reinterpret_cast<char*>(population.getObjectProperties(device));
+			case DATA_POSITION: return reinterpret_cast<char*>(population.getPosition(device));
+			case DATA_VELOCITY: return reinterpret_cast<char*>(population.getVelocity(device));
+			case DATA_ACCELERATION: return reinterpret_cast<char*>(population.getAcceleration(device));
+			case DATA_EPOCH: return reinterpret_cast<char*>(population.getEpoch(device));
+			case DATA_COVARIANCE: return reinterpret_cast<char*>(population.getCovariance(device));
+			case DATA_BYTES: return population.getBytes(device);
+			default: return 0;
+		}
+	}
+
+	static std::string checkpointFilename(const std::string& filename, int snapshot)
+	{
+		std::stringstream name;
+		name << filename << "." << snapshot;
+		return name.str();
+	}
+
+	static void writeCheckpointInt(std::ostream& out, int value)
+	{
+		out.write(reinterpret_cast<char*>(&value), sizeof(int));
+	}
+
+	static int readCheckpointInt(std::istream& in)
+	{
+		int value = 0;
+		in.read(reinterpret_cast<char*>(&value), sizeof(int));
+		return value;
+	}
+
+	static void writeCheckpointString(std::ostream& out, const std::string& value)
+	{
+		writeCheckpointInt(out, (int)value.length());
+		out.write(value.data(), value.length());
+	}
+
+	static bool readCheckpointString(std::istream& in, std::string& value)
+	{
+		const int length = readCheckpointInt(in);
+		if(!in.good() || length < 0) return false;
+		value.resize(length);
+		if(length > 0) in.read(&value[0], length);
+		return in.good();
+	}
+
+	// Hashes a block of data to detect changes between snapshots
+	static unsigned long long checkpointHash(const char* data, size_t length)
+	{
+		unsigned long long hash = 0x9E3779B97F4A7C15ULL ^ length;
+		size_t i = 0;
+		for(; i + sizeof(unsigned long long) <= length; i += sizeof(unsigned long long)) {
+			unsigned long long word;
+			memcpy(&word, data + i, sizeof(unsigned long long));
+			hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+			hash ^= hash >> 31;
+		}
+		for(; i < length; i++)
+			hash = (hash ^ (unsigned char)data[i]) * 0x94D049BB133111EBULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	// A field copied for the writer, in pinned memory if it was downloaded from a GPU
+	struct CheckpointField
+	{
+		int type;
+		size_t elementSize;
+		int objects;
+		char* staging;
+		std::vector<char> host;
+		// completes the download into staging
+		void* event;
+
+		const char* data() const { return staging ? staging : host.data(); }
+	};
+
+	struct CheckpointSnapshot
+	{
+		int number;
+		bool full;
+		double julianDay;
+		int objects;
+		int byteArraySize;
+		std::string propagatorName;
+		std::string description;
+		std::vector<CheckpointField> fields;
+	};
+
+	// Block hashes of a field as of the last written snapshot
+	struct CheckpointHistory
+	{
+		size_t elementSize;
+		int objects;
+		std::vector<unsigned long long> hashes;
+	};
+
+	// Header of a checkpoint file
+	struct CheckpointHeader
+	{
+		int number;
+		int parent;
+		double julianDay;
+		int objects;
+		int byteArraySize;
+		std::string propagatorName;
+		std::string description;
+	};
+
+	static bool readCheckpointHeader(std::istream& in, CheckpointHeader& header)
+	{
+		if(readCheckpointInt(in) != CHECKPOINT_FILE_MAGIC) return false;
+		if(readCheckpointInt(in) != CHECKPOINT_FILE_VERSION) return false;
+		header.number = readCheckpointInt(in);
+		header.parent = readCheckpointInt(in);
+		in.read(reinterpret_cast<char*>(&header.julianDay), sizeof(double));
+		header.objects = readCheckpointInt(in);
+		header.byteArraySize = readCheckpointInt(in);
+		if(!in.good() || header.objects < 0 || header.byteArraySize < 0 || header.parent >= header.number) return false;
+		return readCheckpointString(in, header.propagatorName) && readCheckpointString(in, header.description);
+	}
+
+	class CheckpointWriterImpl
+	{
+		public:
+			CheckpointWriterImpl(Host& owningHost):
+				host(owningHost), isOpen(false), fields(0), fullInterval(0), nextSnapshot(0), snapshotCount(0),
+				lastPopulation(0), lastObjects(-1), lastByteArraySize(-1), stopping(false), failed(false)
+			{
+			}
+
+			// writes the queued snapshots until close() stops the thread
+			void writerLoop()
+			{
+				std::vector<unsigned char> buffer;
+				while(true) {
+					CheckpointSnapshot* snapshot;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+						if(queue.empty()) return;
+						snapshot = &queue.front();
+					}
+					bool ok = writeSnapshot(*snapshot, buffer);
+					releaseStaging(*snapshot);
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						queue.pop_front();
+						if(!ok) failed = true;
+					}
+					changed.notify_all();
+				}
+			}
+
+			// writes the blocks of a snapshot that differ from the previous one
+			bool writeSnapshot(CheckpointSnapshot& snapshot, std::vector<unsigned char>& buffer)
+			{
+				std::ofstream out(checkpointFilename(filename, snapshot.number).c_str(), std::ofstream::binary);
+				if(!out.is_open()) {
+					std::cout << "Unable to open file " << checkpointFilename(filename, snapshot.number) << "!" << std::endl;
+					return false;
+				}
+				writeCheckpointInt(out, CHECKPOINT_FILE_MAGIC);
+				writeCheckpointInt(out, CHECKPOINT_FILE_VERSION);
+				writeCheckpointInt(out, snapshot.number);
+				writeCheckpointInt(out, snapshot.full ? -1 : snapshot.number - 1);
+				out.write(reinterpret_cast<char*>(&snapshot.julianDay), sizeof(double));
+				writeCheckpointInt(out, snapshot.objects);
+				writeCheckpointInt(out, snapshot.byteArraySize);
+				writeCheckpointString(out, snapshot.propagatorName);
+				writeCheckpointString(out, snapshot.description);
+
+				if(snapshot.full) history.clear();
+				GpuSupport* gpu = host.getGPUSupport();
+				for(size_t f = 0; f < snapshot.fields.size() && out.good(); f++) {
+					CheckpointField& field = snapshot.fields[f];
+					if(field.event) {
+						gpu->synchronizeEvent(field.event);
+						gpu->destroyEvent(field.event);
+						field.event = 0;
+					}
+					const int blocks = (field.objects + CHECKPOINT_BLOCK_OBJECTS - 1) / CHECKPOINT_BLOCK_OBJECTS;
+					CheckpointHistory& previous = history[field.type];
+					const bool compare = (previous.elementSize == field.elementSize && previous.objects == field.objects
+						&& (int)previous.hashes.size() == blocks);
+					std::vector<unsigned long long> hashes(blocks);
+					std::vector<char> modified(blocks);
+					for(int b = 0; b < blocks; b++) {
+						const int first = b * CHECKPOINT_BLOCK_OBJECTS;
+						const int count = std::min(CHECKPOINT_BLOCK_OBJECTS, field.objects - first);
+						hashes[b] = checkpointHash(field.data() + field.elementSize * first, field.elementSize * count);
+						modified[b] = !compare || hashes[b] != previous.hashes[b];
+					}
+					previous.elementSize = field.elementSize;
+					previous.objects = field.objects;
+					previous.hashes.swap(hashes);
+
+					// consecutive modified blocks are stored as one range
+					std::vector<std::pair<int, int> > ranges;
+					for(int b = 0; b < blocks; b++) {
+						if(!modified[b]) continue;
+						const int first = b * CHECKPOINT_BLOCK_OBJECTS;
+						const int count = std::min(CHECKPOINT_BLOCK_OBJECTS, field.objects - first);
+						if(!ranges.empty() && ranges.back().first + ranges.back().second == first)
+							ranges.back().second += count;
+						else
+							ranges.push_back(std::make_pair(first, count));
+					}
+					if(ranges.empty()) continue;
+					writeCheckpointInt(out, field.type);
+					writeCheckpointInt(out, (int)field.elementSize);
+					writeCheckpointInt(out, (int)ranges.size());
+					for(size_t r = 0; r < ranges.size(); r++) {
+						unsigned long long length = field.elementSize * ranges[r].second;
+						mz_ulong compressedSize = compressBound((mz_ulong)length);
+						buffer.resize(compressedSize > 0 ? compressedSize : 1);
+						if(compress(buffer.data(), &compressedSize, reinterpret_cast<const unsigned char*>(field.data() + field.elementSize * ranges[r].first), (mz_ulong)length) != Z_OK)
+							return false;
+						unsigned long long compressedLength = compressedSize;
+						writeCheckpointInt(out, ranges[r].first);
+						writeCheckpointInt(out, ranges[r].second);
+						out.write(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+						out.write(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+						out.write(reinterpret_cast<const char*>(buffer.data()), compressedLength);
+					}
+				}
+				writeCheckpointInt(out, CHECKPOINT_END);
+				out.close();
+				return !out.fail();
+			}
+
+			// returns the pinned staging memory of a snapshot
+			void releaseStaging(CheckpointSnapshot& snapshot)
+			{
+				GpuSupport* gpu = host.getGPUSupport();
+				for(size_t f = 0; f < snapshot.fields.size(); f++) {
+					CheckpointField& field = snapshot.fields[f];
+					if(field.event) gpu->destroyEvent(field.event);
+					if(field.staging) gpu->freePinned(field.staging);
+					field.event = 0;
+					field.staging = 0;
+				}
+			}
+
+			Host& host;
+			bool isOpen;
+			std::string filename;
+			int fields;
+			int fullInterval;
+			int nextSnapshot;
+			int snapshotCount;
+			// the Population of the previous snapshot, changing it requires a full snapshot
+			const Population* lastPopulation;
+			int lastObjects;
+			int lastByteArraySize;
+			std::map<int, unsigned long long> lastRevisions;
+
+			// only accessed by the writer thread
+			std::map<int, CheckpointHistory> history;
+
+			// snapshots handed to the writer thread
+			std::thread writer;
+			std::mutex mutex;
+			std::condition_variable changed;
+			std::deque<CheckpointSnapshot> queue;
+			bool stopping;
+			bool failed;
+	};
+
+	//! \endcond
+
+	CheckpointWriter::CheckpointWriter(Host& host):
+		impl(host)
+	{
+	}
+
+	CheckpointWriter::~CheckpointWriter()
+	{
+		close();
+	}
+
+	ErrorCode CheckpointWriter::open(const char* filename, int fields, int full_interval)
+	{
+		if(impl->isOpen || (fields & CHECKPOINT_FIELDS) == 0 || (fields & ~CHECKPOINT_FIELDS & ~FIELD_PARTIALS & FIELD_ALL) || full_interval < 0)
+			return INVALID_ARGUMENT;
+		impl->filename = filename;
+		impl->fields = fields & CHECKPOINT_FIELDS;
+		impl->fullInterval = full_interval;
+		// numbering continues after existing snapshots, so a restarted run adds a new chain
+		impl->nextSnapshot = getLatestSnapshot(filename) + 1;
+		impl->snapshotCount = 0;
+		impl->lastPopulation = 0;
+		impl->lastObjects = -1;
+		impl->lastByteArraySize = -1;
+		impl->lastRevisions.clear();
+		impl->history.clear();
+		impl->stopping = false;
+		impl->failed = false;
+		impl->isOpen = true;
+		CheckpointWriterImpl* writer = *impl;
+		impl->writer = std::thread([writer]() { writer->writerLoop(); });
+		return SUCCESS;
+	}
+
+	ErrorCode CheckpointWriter::snapshot(const Population& population, double julian_day)
+	{
+		if(!impl->isOpen)
+			return INVALID_ARGUMENT;
+		const int size = population.getSize();
+		CheckpointSnapshot snapshot;
+		snapshot.number = impl->nextSnapshot;
+		snapshot.full = (impl->snapshotCount == 0) || (impl->fullInterval > 0 && impl->snapshotCount % impl->fullInterval == 0)
+			|| &population != impl->lastPopulation || size != impl->lastObjects || population.getByteArraySize() != impl->lastByteArraySize;
+		snapshot.julianDay = julian_day;
+		snapshot.objects = size;
+		snapshot.byteArraySize = population.getByteArraySize();
+		snapshot.propagatorName = population.getLastPropagatorName();
+		snapshot.description = population.getDescription();
+
+		GpuSupport* gpu = impl->host.getGPUSupport();
+		for(int type = DATA_ORBIT; type <= DATA_BYTES; type++) {
+			if(!(impl->fields & (1 << type)) || !population.hasData(type)) continue;
+			// unchanged fields are left out of deltas without reading them
+			const unsigned long long revision = population.getRevision(type);
+			std::map<int, unsigned long long>::iterator last = impl->lastRevisions.find(type);
+			if(!snapshot.full && last != impl->lastRevisions.end() && last->second == revision) continue;
+			impl->lastRevisions[type] = revision;
+
+			snapshot.fields.push_back(CheckpointField());
+			CheckpointField& field = snapshot.fields.back();
+			field.type = type;
+			field.elementSize = checkpointElementSize(population, type);
+			field.objects = size;
+			field.staging = 0;
+			field.event = 0;
+			const size_t bytes = field.elementSize * size;
+			if(bytes == 0) continue;
+
+			// data on a GPU is downloaded into pinned memory behind the work queued on the device
+			const Device latest = population.getLatestDevice(type);
+			if(gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST && population.getPartitionCount() == 0 && gpu->supportsPinnedMemory()) {
+				gpu->allocatePinned(reinterpret_cast<void**>(&field.staging), bytes);
+				if(field.staging) {
+					int oldDevice = gpu->getCurrentDevice();
+					gpu->selectDevice(latest - DEVICE_CUDA);
+					gpu->copyAsync(field.staging, checkpointField(population, type, latest), field.elementSize, size, false, 0);
+					field.event = gpu->recordEvent(0);
+					gpu->selectDevice(oldDevice);
+				}
+			}
+			if(!field.staging) {
+				field.host.resize(bytes);
+				memcpy(field.host.data(), checkpointField(population, type, DEVICE_HOST), bytes);
+			}
+		}
+		if(impl->fields & FIELD_NAMES) {
+			// the names are stored as one block, written if any name has changed
+			snapshot.fields.push_back(CheckpointField());
+			CheckpointField& field = snapshot.fields.back();
+			field.type = CHECKPOINT_NAMES;
+			field.objects = 1;
+			field.staging = 0;
+			field.event = 0;
+			for(int i = 0; i < size; i++) {
+				const char* name = population.getObjectName(i);
+				const int length = (int)strlen(name);
+				field.host.insert(field.host.end(), reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(&length) + sizeof(int));
+				field.host.insert(field.host.end(), name, name + length);
+			}
+			field.elementSize = field.host.size();
+		}
+		impl->lastPopulation = &population;
+		impl->lastObjects = size;
+		impl->lastByteArraySize = snapshot.byteArraySize;
+		impl->nextSnapshot++;
+		impl->snapshotCount++;
+
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		impl->changed.wait(lock, [this]() { return impl->queue.size() < CHECKPOINT_QUEUED_SNAPSHOTS; });
+		impl->queue.push_back(CheckpointSnapshot());
+		CheckpointSnapshot& queued = impl->queue.back();
+		queued.number = snapshot.number;
+		queued.full = snapshot.full;
+		queued.julianDay = snapshot.julianDay;
+		queued.objects = snapshot.objects;
+		queued.byteArraySize = snapshot.byteArraySize;
+		queued.propagatorName.swap(snapshot.propagatorName);
+		queued.description.swap(snapshot.description);
+		queued.fields.swap(snapshot.fields);
+		lock.unlock();
+		impl->changed.notify_all();
+		return SUCCESS;
+	}
+
+	ErrorCode CheckpointWriter::wait()
+	{
+		if(!impl->isOpen)
+			return SUCCESS;
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		impl->changed.wait(lock, [this]() { return impl->queue.empty(); });
+		return impl->failed ? UNKNOWN_ERROR : SUCCESS;
+	}
+
+	ErrorCode CheckpointWriter::close()
+	{
+		if(!impl->isOpen)
+			return SUCCESS;
+		{
+			std::lock_guard<std::mutex> lock(impl->mutex);
+			impl->stopping = true;
+		}
+		impl->changed.notify_all();
+		impl->writer.join();
+		impl->isOpen = false;
+		if(impl->failed) {
+			std::cout << "Failed to write checkpoint data!" << std::endl;
+			return UNKNOWN_ERROR;
+		}
+		return SUCCESS;
+	}
+
+	int CheckpointWriter::getSnapshotCount() const
+	{
+		return impl->snapshotCount;
+	}
+
+	int CheckpointWriter::getLatestSnapshot(const char* filename)
+	{
+		int latest = -1;
+		while(true) {
+			std::ifstream in(checkpointFilename(filename, latest + 1).c_str(), std::ifstream::binary);
+			if(!in.is_open()) return latest;
+			latest++;
+		}
+	}
+
+	ErrorCode CheckpointWriter::restore(const char* filename, int snapshot, Population& population, double* julian_day)
+	{
+		if(snapshot < 0) snapshot = getLatestSnapshot(filename);
+		if(snapshot < 0) {
+			std::cout << "No checkpoint found for " << filename << "!" << std::endl;
+			return DIRECTORY_NOT_FOUND;
+		}
+		// follow the parents back to the last full snapshot
+		std::vector<int> chain;
+		for(int number = snapshot; number >= 0; ) {
+			std::ifstream in(checkpointFilename(filename, number).c_str(), std::ifstream::binary);
+			if(!in.is_open()) {
+				std::cout << "Unable to open file " << checkpointFilename(filename, number) << "!" << std::endl;
+				return DIRECTORY_NOT_FOUND;
+			}
+			CheckpointHeader header;
+			if(!readCheckpointHeader(in, header) || header.number != number)
+				return INVALID_DATA;
+			chain.push_back(number);
+			number = header.parent;
+		}
+
+		std::vector<unsigned char> compressed;
+		std::vector<char> data;
+		for(int c = (int)chain.size() - 1; c >= 0; c--) {
+			std::ifstream in(checkpointFilename(filename, chain[c]).c_str(), std::ifstream::binary);
+			CheckpointHeader header;
+			if(!in.is_open() || !readCheckpointHeader(in, header))
+				return INVALID_DATA;
+			if(c == (int)chain.size() - 1) {
+				population.resize(header.objects);
+				population.resizeByteArray(header.byteArraySize);
+			}
+			else if(header.objects != population.getSize() || header.byteArraySize != population.getByteArraySize())
+				return INVALID_DATA;
+			population.setLastPropagatorName(header.propagatorName.c_str());
+			population.setDescription(header.description.c_str());
+			if(julian_day) *julian_day = header.julianDay;
+
+			while(true) {
+				const int type = readCheckpointInt(in);
+				if(!in.good()) return INVALID_DATA;
+				if(type == CHECKPOINT_END) break;
+				const int elementSize = readCheckpointInt(in);
+				const int numRanges = readCheckpointInt(in);
+				const bool names = (type == CHECKPOINT_NAMES);
+				if(!in.good() || numRanges < 0 || (!names && (size_t)elementSize != checkpointElementSize(population, type)))
+					return INVALID_DATA;
+				char* target = names ? 0 : checkpointField(population, type, DEVICE_HOST);
+				for(int r = 0; r < numRanges; r++) {
+					const int first = readCheckpointInt(in);
+					const int count = readCheckpointInt(in);
+					unsigned long long length = 0, compressedLength = 0;
+					in.read(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+					in.read(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+					const int objects = names ? 1 : population.getSize();
+					if(!in.good() || first < 0 || count < 0 || first + count > objects || length != (unsigned long long)elementSize * count)
+						return INVALID_DATA;
+					compressed.resize(compressedLength > 0 ? compressedLength : 1);
+					data.resize(length > 0 ? length : 1);
+					in.read(reinterpret_cast<char*>(compressed.data()), compressedLength);
+					mz_ulong uncompressedSize = (mz_ulong)length;
+					if(!in.good() || uncompress(reinterpret_cast<unsigned char*>(data.data()), &uncompressedSize, compressed.data(), (mz_ulong)compressedLength) != Z_OK || uncompressedSize != length)
+						return INVALID_DATA;
+					if(!names) {
+						if(length > 0) memcpy(target + (size_t)elementSize * first, data.data(), length);
+						continue;
+					}
+					size_t position = 0;
+					for(int i = 0; i < population.getSize(); i++) {
+						int nameLength = 0;
+						if(position + sizeof(int) > length) return INVALID_DATA;
+						memcpy(&nameLength, &data[position], sizeof(int));
+						position += sizeof(int);
+						if(nameLength < 0 || position + nameLength > length) return INVALID_DATA;
+						population.setObjectName(i, std::string(&data[position], nameLength).c_str());
+						position += nameLength;
+					}
+				}
+				if(!names) population.update(type, DEVICE_HOST);
+			}
+		}
+		return SUCCESS;
+	}
+}
@@ -0,0 +1,94 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_CHECKPOINT_H
+#define OPI_CHECKPOINT_H
+#include "opi_common.h"
+#include "opi_datatypes.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+#ifdef __cplusplus
+namespace OPI
+{
+	class Host;
+	class Population;
+
+	class CheckpointWriterImpl;
+	//! \brief Writes restart snapshots of a Population as a base file followed by delta files
+	/** Snapshot k is written to the file "<filename>.<k>". The first snapshot, and every
+	 * full_interval-th one, contains all selected fields; the others only contain the blocks
+	 * of objects that changed since the previous snapshot, so fields that are never modified
+	 * are not written again. Fields whose revision is unchanged (see Population::getRevision())
+	 * are skipped without being read at all.
+	 *
+	 * snapshot() copies the fields into staging buffers: fields on a GPU are downloaded
+	 * asynchronously into pinned memory, queued behind the work on the default stream of the
+	 * device. A background thread then waits for the downloads, compares the blocks with the
+	 * previous snapshot and compresses and writes the changed ones while propagation continues.
+	 * A writer must only be used from one thread at a time.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class CheckpointWriter
+	{
+		public:
+			OPI_API_EXPORT CheckpointWriter(Host& host);
+			//! Writes all queued snapshots and closes the writer
+			OPI_API_EXPORT ~CheckpointWriter();
+
+			//! Selects the file names and fields of the following snapshots
+			/**
+			 * @param filename The name of the snapshot files, followed by the snapshot number.
+			 * @param fields A combination of FieldMask values; partials are not part of a Population.
+			 * @param full_interval Every full_interval-th snapshot contains all data, so a restore
+			 * reads at most this many files. Zero only writes the first snapshot in full.
+			 * @return INVALID_ARGUMENT if no fields or unsupported fields are selected or the
+			 * writer is already open, SUCCESS otherwise.
+			 */
+			OPI_API_EXPORT ErrorCode open(const char* filename, int fields = FIELD_ALL & ~FIELD_PARTIALS, int full_interval = 0);
+			//! Takes a snapshot of population at julian_day and queues it for writing
+			/** The population may be modified as soon as this function returns. Changing a
+			 * Population's size or snapshotting another one produces a full snapshot.
+			 * @return INVALID_ARGUMENT if the writer is not open, SUCCESS otherwise.
+			 */
+			OPI_API_EXPORT ErrorCode snapshot(const Population& population, double julian_day);
+			//! Waits until all queued snapshots are written
+			/** @return UNKNOWN_ERROR if writing any snapshot failed, SUCCESS otherwise. */
+			OPI_API_EXPORT ErrorCode wait();
+			//! Writes all queued snapshots and closes the writer
+			/** @return UNKNOWN_ERROR if writing any snapshot failed, SUCCESS otherwise. */
+			OPI_API_EXPORT ErrorCode close();
+			//! Returns the number of snapshots taken since open()
+			OPI_API_EXPORT int getSnapshotCount() const;
+
+			//! Returns the number of the last snapshot found for filename, or -1 if there is none
+			OPI_API_EXPORT static int getLatestSnapshot(const char* filename);
+			//! Restores a snapshot into population
+			/** Reads the preceding full snapshot and applies all deltas up to the requested one.
+			 * The population is resized to the number of stored objects.
+			 * @param snapshot The number of the snapshot, -1 for the latest one.
+			 * @param julian_day If not null, receives the date of the snapshot.
+			 * @return DIRECTORY_NOT_FOUND if a file of the chain is missing, INVALID_DATA if
+			 * one is damaged, SUCCESS otherwise.
+			 */
+			OPI_API_EXPORT static ErrorCode restore(const char* filename, int snapshot, Population& population, double* julian_day = 0);
+
+		private:
+			Pimpl<CheckpointWriterImpl> impl;
+	};
+}
+#endif
+
+#endif
@@ -16,6 +16,15 @@
  */
 #include "opi_collisiondetection.h"
 #include "opi_host.h"
+#include "opi_indexpairlist.h"
+#include "opi_query.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_parallel.h"
+#include "internal/opi_synchronized_data.h"
+#include "internal/opi_collision_probability.h"
+#include "internal/opi_trace.h"
+#include <algorithm>
+#include <cmath>
 
 namespace OPI
 {
@@ -29,6 +38,156 @@ namespace OPI
 		public:
 	};
 
+	// Motion of an object along p + v t + a t^2 / 2
+	struct ObjectMotion
+	{
+		Vector3 p;
+		Vector3 v;
+		Vector3 a;
+
+		Vector3 at(double t) const
+		{
+			Vector3 x;
+			x.x = p.x + (v.x + 0.5 * a.x * t) * t;
+			x.y = p.y + (v.y + 0.5 * a.y * t) * t;
+			x.z = p.z + (v.z + 0.5 * a.z * t) * t;
+			return x;
+		}
+	};
+
+	// Returns the range of one coordinate on [0, window], including a turning point inside
+	static void motionRange(double p, double v, double a, double window, double& low, double& high)
+	{
+		const double end = p + (v + 0.5 * a * window) * window;
+		low = std::min(p, end);
+		high = std::max(p, end);
+		if (a != 0.0) {
+			const double turn = -v / a;
+			if (turn > 0.0 && turn < window) {
+				const double extremum = p + (v + 0.5 * a * turn) * turn;
+				low = std::min(low, extremum);
+				high = std::max(high, extremum);
+			}
+		}
+	}
+
+	static double squaredLength(const Vector3& x)
+	{
+		return x.x * x.x + x.y * x.y + x.z * x.z;
+	}
+
+	// Finds the time of minimum distance of the relative motion within [0, window]
+	static double closestApproach(const ObjectMotion& relative, double window)
+	{
+		const Vector3& dp = relative.p;
+		const Vector3& dv = relative.v;
+		const Vector3& da = relative.a;
+		// linear estimate, exact without acceleration
+		const double speed2 = squaredLength(dv);
+		double t = (speed2 > 0.0) ? -(dp.x * dv.x + dp.y * dv.y + dp.z * dv.z) / speed2 : 0.0;
+		t = std::max(0.0, std::min(window, t));
+		if (squaredLength(da) > 0.0) {
+			// Newton iterations on the derivative of the squared distance
+			for (int i = 0; i < 8; i++) {
+				const Vector3 r = relative.at(t);
+				Vector3 rate;
+				rate.x = dv.x + da.x * t;
+				rate.y = dv.y + da.y * t;
+				rate.z = dv.z + da.z * t;
+				const double g = r.x * rate.x + r.y * rate.y + r.z * rate.z;
+				const double dg = squaredLength(rate) + r.x * da.x + r.y * da.y + r.z * da.z;
+				if (dg <= 0.0) break;
+				t = std::max(0.0, std::min(window, t - g / dg));
+			}
+		}
+		// the minimum may also be at one of the window bounds
+		double best = t;
+		double distance2 = squaredLength(relative.at(t));
+		const double bounds[2] = { 0.0, window };
+		for (int i = 0; i < 2; i++) {
+			const double d2 = squaredLength(relative.at(bounds[i]));
+			if (d2 < distance2) {
+				distance2 = d2;
+				best = bounds[i];
+			}
+		}
+		return best;
+	}
+
+	// computes the probabilities on a GPU and transfers only the pairs above threshold,
+	// returns false if this is not supported there
+	static bool probabilitiesOnDevice(Population& population, IndexPairList& pairs, std::vector<CollisionProbability>& probabilities_out,
+									  double threshold, IndexPairList* pairs_out, Device device)
+	{
+		Host& host = population.getHostPointer();
+		GpuSupport* gpu = host.getGPUSupport();
+		const int size = population.getSize();
+		const int count = pairs.getPairsUsed();
+		const Vector3* position = population.getPosition(device);
+		const Vector3* velocity = population.getVelocity(device);
+		const Covariance* covariance = population.hasData(DATA_COVARIANCE) ? population.getCovariance(device) : 0;
+		const ObjectProperties* properties = population.hasData(DATA_PROPERTIES) ? population.getObjectProperties(device) : 0;
+		const IndexPair* candidates = pairs.getData(device);
+
+		SynchronizedData<double> results(host, "ProbabilityResults");
+		SynchronizedData<int> flags(host, "ProbabilityFlags");
+		SynchronizedData<int> selected(host, "ProbabilityIndices");
+		results.resize(count * COLLISION_PROBABILITY_RESULTS);
+		flags.resize(count);
+		selected.resize(count);
+		double* result = results.getData(device, true);
+		int* flag = flags.getData(device, true);
+		int* select = selected.getData(device, true);
+		const int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(device - DEVICE_CUDA);
+		const bool computed = gpu->computeCollisionProbabilities(position, velocity, covariance, properties, size, candidates, count, threshold, result, flag);
+		const int kept = computed ? gpu->selectFlagged(flag, count, select) : -1;
+		gpu->selectDevice(oldDevice);
+		if (kept < 0) return false;
+		if (kept == 0)
+		{
+			if (pairs_out) pairs_out->update(device, 0);
+			return true;
+		}
+
+		SynchronizedData<double> filtered(host, "ProbabilityResults");
+		filtered.resize(kept * COLLISION_PROBABILITY_RESULTS);
+		double* filteredResult = filtered.getData(device, true);
+		IndexPair* keptPairs = 0;
+		if (pairs_out)
+		{
+			pairs_out->reserve(kept);
+			pairs_out->update(device, kept);
+			keptPairs = pairs_out->getData(device, true);
+		}
+		gpu->selectDevice(device - DEVICE_CUDA);
+		bool gathered = gpu->gatherElements(filteredResult, result, select, kept, count, COLLISION_PROBABILITY_RESULTS * sizeof(double));
+		if (gathered && keptPairs)
+			gathered = gpu->gatherElements(keptPairs, candidates, select, kept, count, sizeof(IndexPair));
+		gpu->selectDevice(oldDevice);
+		if (!gathered) return false;
+		filtered.update(device);
+		if (pairs_out) pairs_out->update(device, kept);
+
+		// the pairs are needed on the host anyway to fill in the objects
+		const double* values = filtered.getData(DEVICE_HOST, false);
+		const IndexPair* keptHost = keptPairs ? pairs_out->getData(DEVICE_HOST) : 0;
+		const int* indices = keptHost ? 0 : selected.getData(DEVICE_HOST, false);
+		const IndexPair* allHost = keptHost ? 0 : pairs.getData(DEVICE_HOST);
+		probabilities_out.resize(kept);
+		for (int k = 0; k < kept; k++)
+		{
+			CollisionProbability& p = probabilities_out[k];
+			const IndexPair& pair = keptHost ? keptHost[k] : allHost[indices[k]];
+			p.object1 = pair.object1;
+			p.object2 = pair.object2;
+			p.miss_distance = values[k * COLLISION_PROBABILITY_RESULTS];
+			p.time = values[k * COLLISION_PROBABILITY_RESULTS + 1];
+			p.probability = values[k * COLLISION_PROBABILITY_RESULTS + 2];
+		}
+		return true;
+	}
+
 	//! \endcond
 
 	CollisionDetection::CollisionDetection()
@@ -42,6 +201,7 @@ namespace OPI
 	ErrorCode CollisionDetection::detectPairs(Population &population, DistanceQuery *query, IndexPairList &pairs_out, float time_passed)
 	{
 		ErrorCode status = SUCCESS;
+		TraceScope trace(population.getHostPointer(), "detectPairs", getName(), population.getSize(), traceDevice(*this));
 		// ensure this propagator is enabled
 		status = enable();
 		// an error occured?
@@ -51,4 +211,173 @@ namespace OPI
 		return status;
 	}
 
+	ErrorCode CollisionDetection::detectConjunctions(Population& population, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window)
+	{
+		conjunctions_out.clear();
+		ErrorCode status = SUCCESS;
+		TraceScope trace(population.getHostPointer(), "detectConjunctions", getName(), population.getSize(), traceDevice(*this));
+		status = enable();
+		if(status == SUCCESS)
+			status = runDetectConjunctions(population, query, conjunctions_out, threshold, time_window);
+		getHost()->sendError(status);
+		return status;
+	}
+
+	ErrorCode CollisionDetection::runDetectConjunctions(Population& population, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window)
+	{
+		if(!query || threshold < 0.0f || time_window < 0.0f)
+			return INVALID_ARGUMENT;
+		const int size = population.getSize();
+		if(size == 0)
+			return SUCCESS;
+		const Vector3* position = population.getPosition(DEVICE_HOST);
+		const Vector3* velocity = population.getVelocity(DEVICE_HOST);
+		const Vector3* acceleration = population.hasData(DATA_ACCELERATION) ? population.getAcceleration(DEVICE_HOST) : 0;
+		const double window = time_window;
+
+		// bound the motion of every object by a box, the query runs on the box centers
+		Population boxes(population.getHostPointer(), size);
+		Vector3* center = boxes.getPosition(DEVICE_HOST, true);
+		std::vector<Vector3> extent(size);
+		std::vector<ObjectMotion> motion(size);
+		std::vector<double> largestExtent(size);
+		parallelFor(size, [&](int begin, int end) {
+			for(int i = begin; i < end; i++) {
+				ObjectMotion& m = motion[i];
+				m.p = position[i];
+				m.v = velocity[i];
+				if(acceleration)
+					m.a = acceleration[i];
+				else
+					m.a.x = m.a.y = m.a.z = 0.0;
+				double low, high;
+				motionRange(m.p.x, m.v.x, m.a.x, window, low, high);
+				center[i].x = 0.5 * (low + high);
+				extent[i].x = 0.5 * (high - low);
+				motionRange(m.p.y, m.v.y, m.a.y, window, low, high);
+				center[i].y = 0.5 * (low + high);
+				extent[i].y = 0.5 * (high - low);
+				motionRange(m.p.z, m.v.z, m.a.z, window, low, high);
+				center[i].z = 0.5 * (low + high);
+				extent[i].z = 0.5 * (high - low);
+				largestExtent[i] = std::max(extent[i].x, std::max(extent[i].y, extent[i].z));
+			}
+		}, 1024);
+		boxes.update(DATA_POSITION, DEVICE_HOST);
+		const double maxExtent = *std::max_element(largestExtent.begin(), largestExtent.end());
+
+		// boxes overlapping within threshold have centers closer than this on every axis
+		IndexPairList pairs(population.getHostPointer());
+		ErrorCode status = query->rebuild(boxes);
+		if(status == SUCCESS)
+			status = query->queryCubicPairs(boxes, pairs, (float)(threshold + 2.0 * maxExtent));
+		if(status != SUCCESS)
+			return status;
+		pairs.removeDuplicates();
+
+		const int numPairs = pairs.getPairsUsed();
+		const IndexPair* candidates = pairs.getData(DEVICE_HOST);
+		std::vector<Conjunction> conjunctions(numPairs);
+		parallelFor(numPairs, [&](int begin, int end) {
+			for(int k = begin; k < end; k++) {
+				Conjunction& c = conjunctions[k];
+				c.object1 = candidates[k].object1;
+				c.object2 = candidates[k].object2;
+				c.time = 0.0;
+				c.distance = -1.0;
+				const int i = c.object1;
+				const int j = c.object2;
+				if(i < 0 || j < 0 || i >= size || j >= size || i == j)
+					continue;
+				// exact box test with the extents of both objects
+				if(std::fabs(center[i].x - center[j].x) > extent[i].x + extent[j].x + threshold
+				|| std::fabs(center[i].y - center[j].y) > extent[i].y + extent[j].y + threshold
+				|| std::fabs(center[i].z - center[j].z) > extent[i].z + extent[j].z + threshold)
+					continue;
+				ObjectMotion relative;
+				relative.p = motion[j].p - motion[i].p;
+				relative.v = motion[j].v - motion[i].v;
+				relative.a = motion[j].a - motion[i].a;
+				c.time = closestApproach(relative, window);
+				c.distance = std::sqrt(squaredLength(relative.at(c.time)));
+			}
+		}, 1024);
+		for(int k = 0; k < numPairs; k++) {
+			if(conjunctions[k].distance >= 0.0 && conjunctions[k].distance <= threshold)
+				conjunctions_out.push_back(conjunctions[k]);
+		}
+		return SUCCESS;
+	}
+
+	ErrorCode CollisionDetection::computeCollisionProbabilities(Population& population, IndexPairList& pairs, std::vector<CollisionProbability>& probabilities_out, double threshold, IndexPairList* pairs_out)
+	{
+		probabilities_out.clear();
+		ErrorCode status = SUCCESS;
+		TraceScope trace(population.getHostPointer(), "computeCollisionProbabilities", getName(), pairs.getPairsUsed(), traceDevice(*this));
+		status = enable();
+		if(status == SUCCESS)
+			status = runComputeCollisionProbabilities(population, pairs, probabilities_out, threshold, pairs_out);
+		getHost()->sendError(status);
+		return status;
+	}
+
+	ErrorCode CollisionDetection::runComputeCollisionProbabilities(Population& population, IndexPairList& pairs, std::vector<CollisionProbability>& probabilities_out, double threshold, IndexPairList* pairs_out)
+	{
+		if(threshold < 0.0 || &pairs == pairs_out || !population.hasData(DATA_POSITION) || !population.hasData(DATA_VELOCITY))
+			return INVALID_ARGUMENT;
+		const int count = pairs.getPairsUsed();
+		if(count == 0) {
+			if(pairs_out)
+				pairs_out->update(DEVICE_HOST, 0);
+			return SUCCESS;
+		}
+
+		const Device device = population.getLatestDevice(DATA_POSITION);
+		if(getHost()->getGPUSupport() && device >= DEVICE_CUDA && device <= DEVICE_CUDA_LAST
+		&& probabilitiesOnDevice(population, pairs, probabilities_out, threshold, pairs_out, device))
+			return SUCCESS;
+
+		const int size = population.getSize();
+		const Vector3* position = population.getPosition(DEVICE_HOST);
+		const Vector3* velocity = population.getVelocity(DEVICE_HOST);
+		const Covariance* covariance = population.hasData(DATA_COVARIANCE) ? population.getCovariance(DEVICE_HOST) : 0;
+		const ObjectProperties* properties = population.hasData(DATA_PROPERTIES) ? population.getObjectProperties(DEVICE_HOST) : 0;
+		const IndexPair* candidates = pairs.getData(DEVICE_HOST);
+		std::vector<CollisionProbability> probabilities(count);
+		parallelFor(count, [&](int begin, int end) {
+			for(int k = begin; k < end; k++) {
+				CollisionProbability& p = probabilities[k];
+				p.object1 = candidates[k].object1;
+				p.object2 = candidates[k].object2;
+				p.probability = -1.0;
+				p.miss_distance = 0.0;
+				p.time = 0.0;
+				const int i = p.object1;
+				const int j = p.object2;
+				if(i < 0 || j < 0 || i >= size || j >= size)
+					continue;
+				// diameters are given in m, positions in km
+				const double radius = properties ? 0.0005 * (properties[i].diameter + properties[j].diameter) : 0.0;
+				p.probability = collisionProbability(position[i], velocity[i], position[j], velocity[j],
+													 covariance ? covariance + i : 0, covariance ? covariance + j : 0,
+													 radius, p.miss_distance, p.time);
+			}
+		}, 1024);
+		for(int k = 0; k < count; k++) {
+			if(probabilities[k].probability >= 0.0 && probabilities[k].probability >= threshold)
+				probabilities_out.push_back(probabilities[k]);
+		}
+		if(pairs_out) {
+			const int kept = (int)probabilities_out.size();
+			pairs_out->reserve(kept);
+			pairs_out->update(DEVICE_HOST, kept);
+			IndexPair* keptPairs = pairs_out->getData(DEVICE_HOST, true);
+			for(int k = 0; k < kept; k++) {
+				keptPairs[k].object1 = probabilities_out[k].object1;
+				keptPairs[k].object2 = probabilities_out[k].object2;
+			}
+			pairs_out->update(DEVICE_HOST, kept);
+		}
+		return SUCCESS;
+	}
 }
@@ -20,6 +20,7 @@
 #include "opi_error.h"
 #include "opi_module.h"
 #include <string>
+#include <vector>
 namespace OPI
 {
 	class Population;
@@ -30,6 +31,36 @@ namespace OPI
 	//! Contains the propagation implementation data
 	class CollisionDetectionImpl;
 
+	//! \brief Two objects coming close within a time window, see CollisionDetection::detectConjunctions()
+	//! \ingroup CPP_API_GROUP
+	struct Conjunction
+	{
+		//! The object with the smaller index
+		int object1;
+		//! The object with the larger index
+		int object2;
+		//! Time of closest approach in seconds after the current state
+		double time;
+		//! Distance of the objects at the time of closest approach
+		double distance;
+	};
+
+	//! \brief Probability of collision of two objects, see CollisionDetection::computeCollisionProbabilities()
+	//! \ingroup CPP_API_GROUP
+	struct CollisionProbability
+	{
+		//! The first object of the pair
+		int object1;
+		//! The second object of the pair
+		int object2;
+		//! Probability of collision during the encounter
+		double probability;
+		//! Distance of the objects at the time of closest approach
+		double miss_distance;
+		//! Time of closest approach in seconds after the current state
+		double time;
+	};
+
 
 	//! \brief This class implements a way to detect collision pairs in an object population
 	//! \ingroup CPP_API_GROUP
@@ -42,6 +73,37 @@ namespace OPI
 
 			//! Detect colliding pairs and store them in pairs_out, use the specified query object
 			ErrorCode detectPairs(Population& population, DistanceQuery* query, IndexPairList& pairs_out, float time_passed);
+
+			//! Detect pairs coming closer than threshold within time_window seconds after the current state
+			/** Every object is assumed to move along p + v t + a t^2 / 2, using the positions and
+			 * velocities of the Population and its accelerations if available. The motion over the
+			 * window is bounded by a box per object, the query is rebuilt on the box centers to
+			 * find overlapping boxes, and the time of closest approach is computed for each of
+			 * these candidates. Fast crossings are therefore found with steps much larger than
+			 * the time needed to cross the threshold. threshold uses the length unit of the
+			 * positions, velocities are given per second. The conjunctions are sorted by object.
+			 */
+			ErrorCode detectConjunctions(Population& population, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window);
+
+			//! Compute the probability of collision of every pair in pairs
+			/** The relative motion is assumed to be linear during the encounter. The position
+			 * blocks of the covariances of both objects are added, projected into the plane
+			 * perpendicular to the relative velocity, and the resulting 2D Gaussian is integrated
+			 * over the circle of the combined hard-body radius, half the sum of the diameters.
+			 * Positions are given in km, diameters in m, and the covariance is taken to be that
+			 * of the state vector; objects without covariance have no position uncertainty.
+			 * Pairs with a probability below threshold are dropped, in the order of pairs. If
+			 * pairs_out is given, it receives the remaining pairs. The computation runs on the GPU
+			 * if the latest positions are there, and only the remaining pairs are transferred.
+			 */
+			ErrorCode computeCollisionProbabilities(Population& population, IndexPairList& pairs, std::vector<CollisionProbability>& probabilities_out, double threshold = 0.0, IndexPairList* pairs_out = nullptr);
+
+		protected:
+			//! Override this function to change the conjunction screening, the default runs on the host
+			virtual ErrorCode runDetectConjunctions(Population& population, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window);
+			//! Override this function to change the probability computation, the default runs on the GPU if available
+			virtual ErrorCode runComputeCollisionProbabilities(Population& population, IndexPairList& pairs, std::vector<CollisionProbability>& probabilities_out, double threshold, IndexPairList* pairs_out);
+
 		private:
 			//! Implementation of pair detection
 			virtual ErrorCode runDetectPairs(Population& population, DistanceQuery* query, IndexPairList& pairs_out, float time_passed) = 0;
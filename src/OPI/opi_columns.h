@@ -0,0 +1,75 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_COLUMNS_H
+#define OPI_COLUMNS_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#include <cstddef>
+
+//! Returns the component index of a member of a Population data type, for use with OPI::Columns
+#define OPI_COMPONENT(Type, member) ((int)(offsetof(Type, member) / sizeof(double)))
+
+namespace OPI
+{
+	//! \brief Structure-of-arrays view of a Population data field
+	/** Every data type is split into 8-byte components (e.g. the six elements of an Orbit)
+	 * and each component is stored in a separate, contiguous array of size values. Kernels
+	 * touching only a few components therefore get coalesced loads, and host loops over a
+	 * single component can be vectorized. Use OPI_COMPONENT to get the index of a member,
+	 * e.g. columns.component(OPI_COMPONENT(Orbit, eccentricity)).
+	 * The view does not own its memory; it is valid until the Population is modified.
+	 * \ingroup CPP_API_GROUP
+	 */
+	template< class T >
+	struct Columns
+	{
+		OPI_CUDA_PREFIX Columns(): data(0), size(0) { }
+		OPI_CUDA_PREFIX Columns(double* columnData, int numObjects): data(columnData), size(numObjects) { }
+
+		//! Returns the number of components of the data type
+		OPI_CUDA_PREFIX static int components() { return (int)(sizeof(T) / sizeof(double)); }
+		//! Returns the array holding the given component of all objects
+		OPI_CUDA_PREFIX double* component(int c) const { return data + (size_t)c * size; }
+		//! Returns the given component of an object
+		OPI_CUDA_PREFIX double& operator()(int index, int c) const { return data[(size_t)c * size + index]; }
+
+		//! Gathers all components of an object
+		OPI_CUDA_PREFIX T get(int index) const
+		{
+			T value;
+			double* out = reinterpret_cast<double*>(&value);
+			for (int c = 0; c < components(); c++) out[c] = (*this)(index, c);
+			return value;
+		}
+		//! Scatters all components of an object
+		OPI_CUDA_PREFIX void set(int index, const T& value) const
+		{
+			const double* in = reinterpret_cast<const double*>(&value);
+			for (int c = 0; c < components(); c++) (*this)(index, c) = in[c];
+		}
+
+		//! Start of the column storage, zero if no data is available
+		double* data;
+		//! Number of objects, i.e. the length of each component array
+		int size;
+	};
+}
+
+#endif
@@ -18,12 +18,23 @@
 #define OPI_CPP_API_H
 #include "opi_error.h"
 #include "opi_population.h"
+#include "opi_population_batch.h"
 #include "opi_indexpairlist.h"
 #include "opi_indexlist.h"
 #include "opi_host.h"
 #include "opi_propagator.h"
+#include "opi_propagation_handle.h"
 #include "opi_perturbation_module.h"
+#include "opi_propagator_integrator.h"
+#include "opi_custom_propagator.h"
+#include "opi_split_propagator.h"
 #include "opi_query.h"
+#include "opi_grid_query.h"
 #include "opi_collisiondetection.h"
+#include "opi_pipeline.h"
+#include "opi_trajectory.h"
+#include "opi_checkpoint.h"
+#include "opi_event_detector.h"
+#include "opi_ephemeris.h"
 #include "opi_gpusupport.h"
 #endif
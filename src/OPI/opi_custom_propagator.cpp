@@ -15,6 +15,16 @@
  * License along with this library.
  */
 #include "opi_custom_propagator.h"
+#include "opi_perturbation_module.h"
+#include "opi_propagator_integrator.h"
+#include "opi_perturbations.h"
+#include "opi_indexlist.h"
+#include "opi_host.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_parallel.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
 
 namespace OPI
 {
@@ -22,36 +32,392 @@ namespace OPI
 	{
 		std::vector<PerturbationModule*> modules;
 		PropagatorIntegrator* integrator;
+		// shared accumulator, kept between propagation steps
+		std::unique_ptr<Perturbations> accumulator;
+
+		// step capture: the recorded graph, the stream it was recorded on and the device
+		// copy of the step parameters its kernels read
+		bool captureEnabled;
+		bool captureFailed;
+		GpuSupport* gpu;
+		void* graph;
+		void* captureStream;
+		StepParameters* deviceParameters;
+		int captureDevice;
+		// what the graph was recorded for, its kernels refer to the device memory of these
+		const Population* graphPopulation;
+		int graphSize;
+		int graphByteArraySize;
+		const IndexList* graphIndices;
+		int graphIndexCount;
+		PropagationMode graphMode;
+		const Perturbations* graphAccumulator;
+		// device memory the graph refers to, it is recorded again if any of it moved
+		std::vector<void*> graphPointers;
+		// Population fields the recorded step marks as updated on the device
+		std::vector<int> graphUpdates;
 	};
 
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// modules that need a GPU write into the shared accumulator on their device
+	static bool runsOnDevice(PerturbationModule* module)
+	{
+		return module->requiresCUDA() > 0 || module->requiresOpenCL() > 0;
+	}
+
+	// modules that run on CUDA and can be recorded into a graph
+	static bool capturable(Module* module)
+	{
+		return module->requiresCUDA() > 0 && module->supportsStepCapture() > 0;
+	}
+
+	// moves a field to the current device, copies cannot be recorded into a graph
+	static void* uploadField(Population& population, int type)
+	{
+		switch (type)
+		{
+			case DATA_ORBIT: return population.getOrbit(DEVICE_CUDA);
+			case DATA_PROPERTIES: return population.getObjectProperties(DEVICE_CUDA);
+			case DATA_POSITION: return population.getPosition(DEVICE_CUDA);
+			case DATA_VELOCITY: return population.getVelocity(DEVICE_CUDA);
+			case DATA_ACCELERATION: return population.getAcceleration(DEVICE_CUDA);
+			case DATA_EPOCH: return population.getEpoch(DEVICE_CUDA);
+			case DATA_COVARIANCE: return population.getCovariance(DEVICE_CUDA);
+			case DATA_BYTES: return population.getBytes(DEVICE_CUDA);
+			default: return 0;
+		}
+	}
+
+	// moves the given fields to the host, skipping fields the population never allocated
+	static void downloadFields(Population& population, int fields)
+	{
+		if ((fields & FIELD_ORBIT) && population.hasData(DATA_ORBIT)) population.getOrbit();
+		if ((fields & FIELD_PROPERTIES) && population.hasData(DATA_PROPERTIES)) population.getObjectProperties();
+		if ((fields & FIELD_POSITION) && population.hasData(DATA_POSITION)) population.getPosition();
+		if ((fields & FIELD_VELOCITY) && population.hasData(DATA_VELOCITY)) population.getVelocity();
+		if ((fields & FIELD_ACCELERATION) && population.hasData(DATA_ACCELERATION)) population.getAcceleration();
+		if ((fields & FIELD_EPOCH) && population.hasData(DATA_EPOCH)) population.getEpoch();
+		if ((fields & FIELD_COVARIANCE) && population.hasData(DATA_COVARIANCE)) population.getCovariance();
+		if ((fields & FIELD_BYTES) && population.hasData(DATA_BYTES)) population.getBytes();
+	}
+
+	// device memory of the cleared accumulator, which a recorded graph writes to
+	static void accumulatorPointers(Perturbations& delta, std::vector<void*>& pointers)
+	{
+		const int fields = delta.getFields();
+		if (fields & FIELD_ORBIT) pointers.push_back(delta.getDeltaOrbit(DEVICE_CUDA));
+		if (fields & FIELD_POSITION) pointers.push_back(delta.getDeltaPosition(DEVICE_CUDA));
+		if (fields & FIELD_VELOCITY) pointers.push_back(delta.getDeltaVelocity(DEVICE_CUDA));
+		if (fields & FIELD_ACCELERATION) pointers.push_back(delta.getDeltaAcceleration(DEVICE_CUDA));
+		if (fields & FIELD_PARTIALS) pointers.push_back(delta.getPartialsMatrix(DEVICE_CUDA));
+		if (fields & FIELD_BYTES) pointers.push_back(delta.getBytes(DEVICE_CUDA));
+	}
+
+	static void releaseGraph(CustomPropagatorImpl& impl)
+	{
+		if (impl.graph) impl.gpu->destroyGraph(impl.graph);
+		impl.graph = 0;
+		impl.graphPopulation = 0;
+		impl.graphAccumulator = 0;
+		impl.graphPointers.clear();
+		impl.graphUpdates.clear();
+	}
+
+	static void releaseCapture(CustomPropagatorImpl& impl)
+	{
+		releaseGraph(impl);
+		if (impl.captureStream) impl.gpu->destroyStream(impl.captureStream);
+		if (impl.deviceParameters) impl.gpu->free(impl.deviceParameters);
+		impl.captureStream = 0;
+		impl.deviceParameters = 0;
+	}
+
+	// replays the recorded step, or records it; returns false if the modules have to be called as usual
+	static bool runCapturedStep(CustomPropagatorImpl& impl, const char* name, Population& population, Perturbations& delta,
+								double julian_day, double dt, PropagationMode mode, IndexList* indices, ErrorCode& status)
+	{
+		GpuSupport* gpu = population.getHostPointer().getGPUSupport();
+		if (!gpu || population.getPartitionCount() > 0) return false;
+		for (size_t i = 0; i < impl.modules.size(); i++)
+			if (!capturable(impl.modules[i])) return false;
+		if (!capturable(impl.integrator)) return false;
+
+		const int device = gpu->getCurrentDevice();
+		if (impl.gpu && (impl.gpu != gpu || impl.captureDevice != device)) releaseCapture(impl);
+		impl.gpu = gpu;
+		impl.captureDevice = device;
+		if (!impl.deviceParameters)
+			gpu->allocate(reinterpret_cast<void**>(&impl.deviceParameters), sizeof(StepParameters));
+		if (!impl.captureStream)
+			impl.captureStream = gpu->createStream();
+		if (!impl.deviceParameters || !impl.captureStream)
+		{
+			impl.captureFailed = true;
+			return false;
+		}
+
+		// everything the step reads is moved to the device before it is recorded or replayed;
+		// the device memory may have moved since, e.g. if it was released for other data
+		std::vector<void*> pointers;
+		for (int type = DATA_ORBIT; type <= DATA_BYTES; type++)
+			if (population.hasData(type)) pointers.push_back(uploadField(population, type));
+		if (indices) pointers.push_back(indices->getData(DEVICE_CUDA));
+		StepParameters parameters;
+		parameters.julian_day = julian_day;
+		parameters.dt = dt;
+		gpu->copy(impl.deviceParameters, &parameters, sizeof(StepParameters), 1, true);
+
+		if (impl.graph) accumulatorPointers(delta, pointers);
+		const bool recorded = impl.graph && impl.graphPointers == pointers && impl.graphPopulation == &population && impl.graphSize == population.getSize()
+			&& impl.graphByteArraySize == population.getByteArraySize() && impl.graphIndices == indices
+			&& impl.graphIndexCount == (indices ? indices->getSize() : 0) && impl.graphMode == mode && impl.graphAccumulator == &delta;
+		if (recorded)
+		{
+			// the graph runs on the default stream, behind the uploads and the cleared accumulator
+			if (!gpu->launchGraph(impl.graph, 0))
+			{
+				releaseGraph(impl);
+				return false;
+			}
+			for (size_t i = 0; i < impl.graphUpdates.size(); i++)
+				population.update(impl.graphUpdates[i], DEVICE_CUDA);
+			status = SUCCESS;
+			return true;
+		}
+
+		releaseGraph(impl);
+		unsigned long long revisions[DATA_BYTES + 1];
+		for (int type = DATA_ORBIT; type <= DATA_BYTES; type++)
+			revisions[type] = population.getRevision(type);
+		// the accumulator must be allocated on the device before recording
+		delta.zero(DEVICE_CUDA);
+		accumulatorPointers(delta, pointers);
+		if (!gpu->beginCapture(impl.captureStream))
+		{
+			impl.captureFailed = true;
+			return false;
+		}
+		delta.setStepContext(impl.captureStream, impl.deviceParameters);
+		status = SUCCESS;
+		for (size_t i = 0; i < impl.modules.size() && status == SUCCESS; i++)
+			status = impl.modules[i]->calculate(population, delta, julian_day, dt, mode, indices);
+		if (status == SUCCESS)
+			status = impl.integrator->integrate(population, delta, julian_day, dt, mode, indices);
+		delta.setStepContext(0, 0);
+		void* graph = gpu->endCapture(impl.captureStream);
+
+		// the recorded work has not run yet; if it cannot be launched the step runs as usual
+		if (status != SUCCESS || !graph || !gpu->launchGraph(graph, 0))
+		{
+			if (graph) gpu->destroyGraph(graph);
+			else if (status == SUCCESS)
+			{
+				std::cout << "Custom propagator " << name << " could not record its step, step capture is disabled." << std::endl;
+				impl.captureFailed = true;
+			}
+			delta.zero(DEVICE_CUDA);
+			return false;
+		}
+		impl.graph = graph;
+		impl.graphPopulation = &population;
+		impl.graphSize = population.getSize();
+		impl.graphByteArraySize = population.getByteArraySize();
+		impl.graphIndices = indices;
+		impl.graphIndexCount = indices ? indices->getSize() : 0;
+		impl.graphMode = mode;
+		impl.graphAccumulator = &delta;
+		impl.graphPointers.swap(pointers);
+		for (int type = DATA_ORBIT; type <= DATA_BYTES; type++)
+			if (population.getRevision(type) != revisions[type]) impl.graphUpdates.push_back(type);
+		return true;
+	}
+
+	// enables the integrator and the modules that are not enabled yet, returns the first error
+	static ErrorCode enableComponents(CustomPropagatorImpl& impl)
+	{
+		if (impl.integrator)
+		{
+			const ErrorCode status = impl.integrator->enable();
+			if (status != SUCCESS) return status;
+		}
+		for (size_t i = 0; i < impl.modules.size(); i++)
+		{
+			const ErrorCode status = impl.modules[i]->enable();
+			if (status != SUCCESS) return status;
+		}
+		return SUCCESS;
+	}
+
+	//! \endcond
+
     CustomPropagator::CustomPropagator(const char* name)
 	{
 		setName(name);
 		impl->integrator = 0;
+		impl->captureEnabled = false;
+		impl->captureFailed = false;
+		impl->gpu = 0;
+		impl->graph = 0;
+		impl->captureStream = 0;
+		impl->deviceParameters = 0;
+		impl->captureDevice = -1;
+		impl->graphPopulation = 0;
+		impl->graphAccumulator = 0;
 	}
 
 	CustomPropagator::~CustomPropagator()
 	{
+		finishAsync();
+		if (impl->gpu) releaseCapture(**impl);
+	}
 
+	ErrorCode CustomPropagator::runEnable()
+	{
+		return enableComponents(**impl);
+	}
+
+	ErrorCode CustomPropagator::runDisable()
+	{
+		ErrorCode status = impl->integrator ? impl->integrator->disable() : SUCCESS;
+		for (size_t i = 0; i < impl->modules.size(); i++)
+		{
+			const ErrorCode moduleStatus = impl->modules[i]->disable();
+			if (status == SUCCESS) status = moduleStatus;
+		}
+		return status;
 	}
 
 	void CustomPropagator::addModule(PerturbationModule *module)
 	{
 		impl->modules.push_back(module);
+		resetStepCapture();
 	}
 
 	void CustomPropagator::setIntegrator(PropagatorIntegrator *integrator)
 	{
 		impl->integrator = integrator;
+		resetStepCapture();
+	}
+
+	void CustomPropagator::setStepCapture(bool enabled)
+	{
+		impl->captureEnabled = enabled;
+		resetStepCapture();
+	}
+
+	bool CustomPropagator::getStepCapture() const
+	{
+		return impl->captureEnabled;
+	}
+
+	void CustomPropagator::resetStepCapture()
+	{
+		if (impl->gpu) releaseGraph(**impl);
+		impl->captureFailed = false;
 	}
 
     ErrorCode CustomPropagator::runPropagation(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices)
 	{
-		return SUCCESS;
+		if (impl->integrator == 0)
+		{
+			std::cout << "Custom propagator " << getName() << " has no integrator." << std::endl;
+			return INVALID_PROPERTY;
+		}
+		// modules added after this propagator was enabled are enabled on their first step
+		const ErrorCode enabled = enableComponents(**impl);
+		if (enabled != SUCCESS) return enabled;
+
+		bool deviceModules = false;
+		int fields = FIELD_NONE;
+		for (size_t i = 0; i < impl->modules.size(); i++)
+		{
+			deviceModules = deviceModules || runsOnDevice(impl->modules[i]);
+			fields |= impl->modules[i]->perturbationFields();
+		}
+
+		// all modules add their results to this accumulator, which only holds the fields
+		// they declare; it is cleared where the first modules will write to it
+		if (!impl->accumulator || impl->accumulator->getSize() != population.getSize())
+			impl->accumulator.reset(new Perturbations(population, fields));
+		else
+		{
+			impl->accumulator->requestFields(fields);
+			impl->accumulator->zero(deviceModules ? DEVICE_CUDA : DEVICE_HOST);
+		}
+		Perturbations& delta = *impl->accumulator;
+		if (impl->captureEnabled && !impl->captureFailed)
+		{
+			ErrorCode status = SUCCESS;
+			if (runCapturedStep(**impl, getName(), population, delta, julian_day, dt, mode, indices, status))
+				return status;
+		}
+		std::vector<PerturbationModule*> hostModules;
+
+		// GPU modules run back to back on the device, so the accumulator and the
+		// population stay resident there between the calls
+		for (size_t i = 0; i < impl->modules.size(); i++)
+		{
+			PerturbationModule* module = impl->modules[i];
+			if (!runsOnDevice(module))
+			{
+				hostModules.push_back(module);
+				continue;
+			}
+			ErrorCode status = module->calculate(population, delta, julian_day, dt, mode, indices);
+			if (status != SUCCESS) return status;
+		}
+
+		// host modules run concurrently, each with a private accumulator that is added
+		// to the shared one afterwards
+		if (hostModules.size() > 0)
+		{
+			// download the fields the modules declare now, so they do not trigger the same
+			// synchronization from several threads at once; anything else a module reads is
+			// synchronized on first access
+			int hostFields = FIELD_NONE;
+			for (size_t i = 0; i < hostModules.size(); i++)
+				hostFields |= hostModules[i]->perturbationFields();
+			downloadFields(population, hostFields);
+			if (indices) indices->getData(DEVICE_HOST);
+
+			std::vector<std::unique_ptr<Perturbations> > partial(hostModules.size());
+			std::vector<ErrorCode> results(hostModules.size(), SUCCESS);
+			for (size_t i = 1; i < hostModules.size(); i++)
+				partial[i].reset(new Perturbations(population, hostModules[i]->perturbationFields()));
+			parallelFor((int)hostModules.size(), [&](int begin, int end) {
+				for (int i = begin; i < end; i++)
+				{
+					// the first module writes to the shared accumulator directly
+					Perturbations& target = (i == 0) ? delta : *partial[i];
+					results[i] = hostModules[i]->calculate(population, target, julian_day, dt, mode, indices);
+				}
+			}, 1);
+			for (size_t i = 0; i < hostModules.size(); i++)
+			{
+				if (results[i] != SUCCESS) return results[i];
+				if (partial[i]) delta.accumulate(*partial[i]);
+			}
+		}
+
+		return impl->integrator->integrate(population, delta, julian_day, dt, mode, indices);
 	}
 
 	int CustomPropagator::requiresCUDA()
 	{
-		return 0;
+		int required = impl->integrator ? impl->integrator->requiresCUDA() : 0;
+		for (size_t i = 0; i < impl->modules.size(); i++)
+			required = std::max(required, impl->modules[i]->requiresCUDA());
+		return required;
+	}
+
+	int CustomPropagator::requiresOpenCL()
+	{
+		int required = impl->integrator ? impl->integrator->requiresOpenCL() : 0;
+		for (size_t i = 0; i < impl->modules.size(); i++)
+			required = std::max(required, impl->modules[i]->requiresOpenCL());
+		return required;
 	}
 }
@@ -40,10 +40,33 @@ namespace OPI
 			/// Sets the integrator for this propagator
 			OPI_API_EXPORT void setIntegrator(PropagatorIntegrator* integrator);
 
+			/// Records the device work of a propagation step into a CUDA graph and replays it in later steps
+			/** Requires all modules and the integrator to run on CUDA and to support step capture
+			 * (see Module::supportsStepCapture()). The first step records the graph; following
+			 * steps of the same Population, IndexList and mode upload julian_day and dt and launch
+			 * the graph instead of calling the modules, which removes the per-kernel launch
+			 * overhead. If a step cannot be recorded, the modules are called as usual.
+			 */
+			OPI_API_EXPORT void setStepCapture(bool enabled);
+			/// Returns true if step capture is enabled
+			OPI_API_EXPORT bool getStepCapture() const;
+			/// Discards the recorded step, required when modules change their parameters or device buffers
+			OPI_API_EXPORT void resetStepCapture();
+
 		protected:
-			/// Override the propagation method
+			/// Evaluates all modules into one Perturbations object and passes it to the integrator
+			/** Modules requiring CUDA or OpenCL are evaluated one after another on the device,
+			 * all other modules run concurrently on the host. Modules added after this propagator
+			 * was enabled are enabled before their first step; if the integrator or a module cannot
+			 * be enabled, the propagation returns its error.
+			 */
             virtual ErrorCode runPropagation(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
 			virtual int requiresCUDA();
+			virtual int requiresOpenCL();
+			/// Enables the integrator and all modules, returns the first error
+			virtual ErrorCode runEnable();
+			/// Disables the integrator and all modules, returns the first error
+			virtual ErrorCode runDisable();
 
 		private:
 			Pimpl<CustomPropagatorImpl> impl;
@@ -22,6 +22,7 @@
 #endif
 
 #include "OPI/opi_types.h"
+#include "opi_kepler.h"
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <limits>
@@ -81,18 +82,10 @@ namespace OPI
 	}
 
     //! Calculate eccentric anomaly from given orbit
+    /** Iterates until the default tolerance of solveKepler() is reached. */
     OPI_CUDA_PREFIX inline double eccentricAnomaly(const Orbit& o)
     {
-        double ea = o.mean_anomaly;
-        int maxloop = 5;
-        double fcte, fctes;
-
-        for (int i=0; i<maxloop; i++) {
-            fcte  = ea - o.eccentricity * sin(ea) - o.mean_anomaly;
-            fctes = 1.0 - o.eccentricity * cos(ea);
-            ea -= fcte/fctes;
-        }
-        return ea;
+        return solveKepler(o.mean_anomaly, o.eccentricity);
     }
 
     //! Calculate true anomaly from given orbit
@@ -279,7 +272,7 @@ namespace OPI
             else if (cosAngle < -1.0) cosAngle = -1.0;
             return acos(cosAngle);
         }
-        else return std::numeric_limits<double>::quiet_NaN();
+        else return NAN;
     }
 
     OPI_CUDA_PREFIX inline bool isZero(const Orbit& o)
@@ -571,6 +564,257 @@ namespace OPI
         return c;
     }
 
+
+    // adapted from SGP4 reference implementation by D. Vallado e.a.
+    // https://celestrak.com/publications/AIAA/2006-6753/
+    //! Converts an orbit to position and velocity vectors
+    OPI_CUDA_PREFIX inline void orbitToStateVector(const Orbit& o, Vector3& position, Vector3& velocity)
+    {
+        double ta = trueAnomaly(o);
+        double argp = o.arg_of_perigee;
+        const double arglat = argp + ta;
+        double raan = o.raan;
+        const double small = 1e-15;
+
+        if (o.eccentricity < small)
+        {
+            // circular equatorial
+            if ((o.inclination < small) || (fabs(o.inclination-M_PI) < small))
+            {
+                argp = 0.0;
+                raan = 0.0;
+                ta = o.raan + arglat;
+            }
+            else {
+                // circular inclined
+                argp = 0.0;
+                ta = arglat;
+            }
+        }
+        else {
+            // elliptical equatorial
+            if ((o.inclination < small) || (fabs(o.inclination-M_PI) < small))
+            {
+                argp = o.raan + o.arg_of_perigee;
+                raan = 0.0;
+            }
+        }
+
+        // ----------  form pqw position and velocity vectors ----------
+        const double sin_ta = sin(ta);
+        const double cos_ta = cos(ta);
+        double p = o.semi_major_axis * (1.0 - o.eccentricity * o.eccentricity);
+        const double mu = 398600.4418;
+        const double temp = p / (1.0 + o.eccentricity * cos_ta);
+        Vector3 r;
+        r.x = temp*cos_ta;
+        r.y = temp*sin_ta;
+        r.z = 0.0;
+        if (fabs(p) < 1e-8 ) p = 1e-8;
+
+        const double sqrt_mu_p = sqrt(mu/p);
+        Vector3 v;
+        v.x = -sin_ta * sqrt_mu_p;
+        v.y = (o.eccentricity + cos_ta) * sqrt_mu_p;
+        v.z = 0.0;
+
+        r = rotateZ(r,-argp);
+        r = rotateX(r,-o.inclination);
+        position = rotateZ(r,-raan);
+
+        v = rotateZ(v,-argp);
+        v = rotateX(v,-o.inclination);
+        velocity = rotateZ(v,-raan);
+    }
+
+    // adapted from SGP4 reference implementation by D. Vallado e.a.
+    // https://celestrak.com/publications/AIAA/2006-6753/
+    //! Converts position and velocity vectors to an orbit
+    /** Returns false if the orbit is degenerate, in which case some elements are set to NaN. */
+    OPI_CUDA_PREFIX inline bool stateVectorToOrbit(const Vector3& r, const Vector3& v, Orbit& o)
+    {
+        enum typeorbit_t {
+            CIRCULAR_EQUATORIAL,
+            CIRCULAR_INCLINED,
+            ELLIPTICAL_EQUATORIAL,
+            ELLIPTICAL_INCLINED
+        } typeorbit;
+
+        const double twopi = 2.0 * M_PI;
+        const double halfpi = 0.5 * M_PI;
+        const double small = 1e-15;
+        const double mu = 398600.4418;
+        const double nan = NAN;
+        bool valid = true;
+
+        const double magr = length(r);
+        const double magv = length(v);
+
+        Vector3 hbar = cross(r,v);
+        const double magh = length(hbar);
+
+        if (magh > small)
+        {
+            // ------------------  find h n and e vectors   ----------------
+            Vector3 nbar;
+            nbar.x = -hbar.y;
+            nbar.y = hbar.x;
+            nbar.z = 0.0;
+            const double magn = length(nbar);
+            const double c1 = magv*magv - mu/magr;
+            const double rdotv = r * v;
+            Vector3 ebar = (r*c1 - v*rdotv) / mu;
+            o.eccentricity = length(ebar);
+
+            // ------------  find a e and semi-latus rectum   ----------
+            const double sme = (magv*magv*0.5) - (mu / magr);
+            if (fabs(sme) > small)
+            {
+                o.semi_major_axis = -mu / (2.0 *sme);
+            }
+            else {
+                o.semi_major_axis = INFINITY;
+                valid = false;
+            }
+
+            // -----------------  find inclination   -------------------
+            const double hk = hbar.z / magh;
+            o.inclination = acos(hk);
+
+            // --------  determine type of orbit for later use  --------
+            // ------ elliptical, parabolic, hyperbolic inclined -------
+            typeorbit = ELLIPTICAL_INCLINED;
+            if (o.eccentricity < small)
+            {
+                // ----------------  circular equatorial ---------------
+                if ((o.inclination < small) || (fabs(o.inclination - M_PI) < small))
+                    typeorbit = CIRCULAR_EQUATORIAL;
+                else
+                    // --------------  circular inclined ---------------
+                    typeorbit = CIRCULAR_INCLINED;
+            }
+            else {
+                // - elliptical, parabolic, hyperbolic equatorial --
+                if ((o.inclination < small) || (fabs(o.inclination - M_PI) < small))
+                    typeorbit = ELLIPTICAL_EQUATORIAL;
+            }
+
+            // ----------  find longitude of ascending node ------------
+            if (magn > small)
+            {
+                double temp = nbar.x / magn;
+                if (temp > 1.0) temp = 1.0;
+                else if (temp < -1.0) temp = -1.0;
+                o.raan = acos(temp);
+                if (nbar.y < 0.0) o.raan = twopi - o.raan;
+            }
+            else {
+                o.raan = nan;
+                valid = false;
+            }
+
+            // ---------------- find argument of perigee ---------------
+            if (typeorbit == ELLIPTICAL_INCLINED)
+            {
+                o.arg_of_perigee = angle(nbar,ebar);
+                if (ebar.z < 0.0) o.arg_of_perigee = twopi - o.arg_of_perigee;
+            }
+            else {
+                o.arg_of_perigee = nan;
+                valid = false;
+            }
+
+            // ------------  find true anomaly at epoch    -------------
+            double nu = nan;
+            if (typeorbit == ELLIPTICAL_EQUATORIAL || typeorbit == ELLIPTICAL_INCLINED)
+            {
+                nu = angle(ebar,r);
+                if (rdotv < 0.0) nu = twopi - nu;
+            }
+
+            // ----  find argument of latitude - circular inclined -----
+            if (typeorbit == CIRCULAR_INCLINED)
+            {
+                double arglat = angle(nbar,r);
+                if (r.z < 0.0) arglat = twopi - arglat;
+                o.mean_anomaly = arglat;
+            }
+
+            // -------- find true longitude - circular equatorial ------
+            if ((magr>small) && (typeorbit == CIRCULAR_EQUATORIAL))
+            {
+                double temp = r.x / magr;
+                if (temp > 1.0) temp = 1.0;
+                else if (temp < -1.0) temp = -1.0;
+                double truelon = acos(temp);
+                if (r.y < 0.0) truelon = twopi - truelon;
+                if (o.inclination > halfpi) truelon = twopi - truelon;
+                o.mean_anomaly = truelon;
+            }
+
+            // ------------ find mean anomaly for all orbits -----------
+            if (typeorbit == ELLIPTICAL_EQUATORIAL || typeorbit == ELLIPTICAL_INCLINED)
+            {
+                // get mean anomaly from true anomaly
+                const double ecc = o.eccentricity;
+                double ea = INFINITY;
+                double ma = INFINITY;
+
+                if (fabs(ecc) < small)
+                {
+                    // circular
+                    ea = nu;
+                    ma = nu;
+                }
+                else if (ecc < 1.0 - small)
+                {
+                    // elliptical
+                    const double sine = (sqrt(1.0 - ecc*ecc) * sin(nu)) / (1.0 + ecc*cos(nu));
+                    const double cose = (ecc + cos(nu)) / (1.0 + ecc*cos(nu));
+                    ea = atan2(sine, cose);
+                    ma = ea - ecc*sin(ea);
+                }
+                else if (ecc > 1.0 + small)
+                {
+                    // hyperbolic
+                    if ((ecc > 1.0) && (fabs(nu) + 0.00001 < M_PI - acos(1.0 / ecc)))
+                    {
+                        const double sine = (sqrt(ecc*ecc - 1.0) * sin(nu)) / (1.0 + ecc*cos(nu));
+                        //ea = asinh(sine);
+                        //Unfortunately, some compilers don't implement all standard functions.
+                        //Yes, I'm looking at you, Visual Studio!
+                        ea = log(sine + sqrt(1+sine*sine));
+                        ma = ecc*sinh(ea) - ea;
+                    }
+                }
+                else if (fabs(nu) < 168.0*M_PI / 180.0)
+                {
+                    // parabolic
+                    ea = tan(nu*0.5);
+                    ma = ea + ea*ea*ea/3.0;
+                }
+
+                if (ecc < 1.0)
+                {
+                    ma = fmod(ma, 2.0 * M_PI);
+                    if (ma < 0.0) ma += 2.0*M_PI;
+                }
+
+                o.mean_anomaly = ma;
+            }
+        }
+        else {
+            o.semi_major_axis = nan;
+            o.eccentricity = nan;
+            o.inclination = nan;
+            o.raan = nan;
+            o.arg_of_perigee = nan;
+            o.mean_anomaly = nan;
+            valid = false;
+        }
+        return valid;
+    }
+
 }
 
 #endif
@@ -0,0 +1,168 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_DISPATCH_H
+#define OPI_DISPATCH_H
+
+#ifndef OPI_CUDA_PREFIX
+#ifdef __CUDACC__
+#define OPI_CUDA_PREFIX __host__ __device__
+#else
+#define OPI_CUDA_PREFIX
+#endif
+#endif
+
+#include "opi_common.h"
+#include "opi_error.h"
+#include "opi_datatypes.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_indexlist.h"
+#include <algorithm>
+#ifdef __CUDACC__
+#include <cuda_runtime.h>
+#endif
+
+// Per-object loops for propagator plugins, specialised at compile time for the propagation
+// mode and for indexed access.
+//
+// The plugin writes a functor with an operator()(int object, double julian_day) const that
+// propagates a single object, starting from the given epoch: julian_day in single epoch mode,
+// the object's current_epoch in individual epoch mode. The object is the index into the
+// Population, taken from the IndexList if one is given. dispatchHost() and dispatchCUDA()
+// pick one of four loops or kernels in which mode and index access are template constants,
+// so the loop body contains no branches on either. The functor is copied to every thread,
+// or passed to the kernel by value, so it should only hold pointers to the Population data
+// and the parameters of the step; the plugin marks the written fields as updated afterwards.
+//
+//   struct Step {
+//       OPI::Orbit* orbit; double dt;
+//       OPI_CUDA_PREFIX void operator()(int object, double julian_day) const { ... }
+//   };
+//   Step step = { population.getOrbit(OPI::DEVICE_CUDA), dt };
+//   OPI::ErrorCode status = OPI::dispatchCUDA(population, julian_day, mode, indices, step);
+//   population.update(OPI::DATA_ORBIT, OPI::DEVICE_CUDA);
+
+namespace OPI
+{
+	//! Calls the functor for element i of a dispatched loop
+	template <bool IndividualEpochs, bool Indexed, class Functor>
+	OPI_CUDA_PREFIX inline void dispatchObject(const Functor& functor, int i, const int* indices, const Epoch* epochs, double julian_day)
+	{
+		const int object = Indexed ? indices[i] : i;
+		functor(object, IndividualEpochs ? epochs[object].current_epoch : julian_day);
+	}
+
+	//! Host loop over the elements [begin, end) for one combination of mode and index access
+	template <bool IndividualEpochs, bool Indexed, class Functor>
+	void dispatchHostRange(Functor functor, int begin, int end, const int* indices, const Epoch* epochs, double julian_day)
+	{
+		for (int i = begin; i < end; i++)
+			dispatchObject<IndividualEpochs, Indexed>(functor, i, indices, epochs, julian_day);
+	}
+
+	//! Calls functor(object, julian_day) for all (or the indexed) objects on the host's threads
+	/** Every range of at least grainSize consecutive elements is one task for the thread pool
+	 * of the Population's Host, so at most Host::getThreadCount() threads are used and the
+	 * calling thread takes part. Small Populations are processed on the calling thread only.
+	 * When called from within another parallel operation, e.g. under
+	 * Propagator::propagateParallel, the ranges share the busy pool instead of starting more
+	 * threads. The epochs and indices are taken from host memory.
+	 * @return INVALID_ARGUMENT for an unknown mode, SUCCESS otherwise.
+	 */
+	template <class Functor>
+	ErrorCode dispatchHost(Population& population, double julian_day, PropagationMode mode, IndexList* indices, Functor functor, int grainSize = 4096)
+	{
+		if (mode != MODE_SINGLE_EPOCH && mode != MODE_INDIVIDUAL_EPOCHS) return INVALID_ARGUMENT;
+		const int size = indices ? indices->getSize() : population.getSize();
+		if (size <= 0) return SUCCESS;
+		const int* index = indices ? indices->getData(DEVICE_HOST) : 0;
+		const Epoch* epochs = (mode == MODE_INDIVIDUAL_EPOCHS) ? population.getEpoch(DEVICE_HOST) : 0;
+		typedef void (*Loop)(Functor, int, int, const int*, const Epoch*, double);
+		const Loop loop = (mode == MODE_INDIVIDUAL_EPOCHS)
+			? (index ? &dispatchHostRange<true, true, Functor> : &dispatchHostRange<true, false, Functor>)
+			: (index ? &dispatchHostRange<false, true, Functor> : &dispatchHostRange<false, false, Functor>);
+
+		Host& host = population.getHostPointer();
+		const int numThreads = std::max(1, host.getThreadCount());
+		const int numRanges = std::min(numThreads, (size + grainSize - 1) / std::max(1, grainSize));
+		if (numRanges <= 1)
+		{
+			loop(functor, 0, size, index, epochs, julian_day);
+			return SUCCESS;
+		}
+		const int rangeSize = (size + numRanges - 1) / numRanges;
+		host.runParallel((size + rangeSize - 1) / rangeSize, [&](int range) {
+			const int begin = range * rangeSize;
+			loop(functor, begin, std::min(begin + rangeSize, size), index, epochs, julian_day);
+		});
+		return SUCCESS;
+	}
+
+#ifdef __CUDACC__
+	//! Kernel with one thread per element for one combination of mode and index access
+	template <bool IndividualEpochs, bool Indexed, class Functor>
+	__global__ void dispatchKernel(Functor functor, int size, const int* indices, const Epoch* epochs, double julian_day)
+	{
+		const int i = blockIdx.x * blockDim.x + threadIdx.x;
+		if (i < size)
+			dispatchObject<IndividualEpochs, Indexed>(functor, i, indices, epochs, julian_day);
+	}
+
+	//! Launches a specialised kernel, choosing the block size for full occupancy if it is zero
+	template <bool IndividualEpochs, bool Indexed, class Functor>
+	cudaError_t dispatchLaunch(Functor functor, int size, const int* indices, const Epoch* epochs, double julian_day, int blockSize, cudaStream_t stream)
+	{
+		if (blockSize <= 0)
+		{
+			int minGridSize = 0;
+			if (cudaOccupancyMaxPotentialBlockSize(&minGridSize, &blockSize, dispatchKernel<IndividualEpochs, Indexed, Functor>, 0, 0) != cudaSuccess)
+				blockSize = 256;
+		}
+		const int blocks = (size + blockSize - 1) / blockSize;
+		dispatchKernel<IndividualEpochs, Indexed, Functor><<<blocks, blockSize, 0, stream>>>(functor, size, indices, epochs, julian_day);
+		return cudaGetLastError();
+	}
+
+	//! Launches functor(object, julian_day) for all (or the indexed) objects on the current CUDA device
+	/** The epochs and indices are taken from the device, the kernel is queued on the given
+	 * stream and this function returns without waiting for it.
+	 * @param blockSize The number of threads per block, zero chooses the block size with the
+	 * highest occupancy for the kernel.
+	 * @return INVALID_ARGUMENT for an unknown mode, UNKNOWN_ERROR if the launch failed,
+	 * SUCCESS otherwise.
+	 */
+	template <class Functor>
+	ErrorCode dispatchCUDA(Population& population, double julian_day, PropagationMode mode, IndexList* indices, Functor functor, int blockSize = 0, cudaStream_t stream = 0)
+	{
+		if (mode != MODE_SINGLE_EPOCH && mode != MODE_INDIVIDUAL_EPOCHS) return INVALID_ARGUMENT;
+		const int size = indices ? indices->getSize() : population.getSize();
+		if (size <= 0) return SUCCESS;
+		const int* index = indices ? indices->getData(DEVICE_CUDA) : 0;
+		const Epoch* epochs = (mode == MODE_INDIVIDUAL_EPOCHS) ? population.getEpoch(DEVICE_CUDA) : 0;
+		cudaError_t status;
+		if (mode == MODE_INDIVIDUAL_EPOCHS)
+			status = index ? dispatchLaunch<true, true>(functor, size, index, epochs, julian_day, blockSize, stream)
+						   : dispatchLaunch<true, false>(functor, size, index, epochs, julian_day, blockSize, stream);
+		else
+			status = index ? dispatchLaunch<false, true>(functor, size, index, epochs, julian_day, blockSize, stream)
+						   : dispatchLaunch<false, false>(functor, size, index, epochs, julian_day, blockSize, stream);
+		return (status == cudaSuccess) ? SUCCESS : UNKNOWN_ERROR;
+	}
+#endif
+}
+
+#endif
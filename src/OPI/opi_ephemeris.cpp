@@ -0,0 +1,189 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_ephemeris.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_propagator.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_synchronized_data.h"
+#include "internal/opi_interpolation.h"
+#include "internal/opi_parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+	class EphemerisCacheImpl
+	{
+		public:
+			EphemerisCacheImpl(Host& owningHost):
+				host(owningHost),
+				positions(owningHost, "EphemerisPosition"),
+				velocities(owningHost, "EphemerisVelocity"),
+				numObjects(0)
+			{
+			}
+
+			// appends one sample of count objects to knots, on the device holding the source
+			void append(SynchronizedData<Vector3>& knots, const Population& population, Device latest, int type)
+			{
+				const int first = (int)times.size() * numObjects;
+				const int required = first + numObjects;
+				// grow geometrically, so samples are not moved on every call
+				if(required > knots.getReservedSize())
+					knots.reserve(std::max(required, 2 * knots.getReservedSize()));
+				knots.resize(required);
+				GpuSupport* gpu = host.getGPUSupport();
+				if(gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST) {
+					Vector3* source = (type == DATA_POSITION) ? population.getPosition(latest) : population.getVelocity(latest);
+					Vector3* destination = knots.getData(latest, false);
+					const int device = latest - DEVICE_CUDA;
+					if(gpu->copyPeer(destination + first, device, source, device, sizeof(Vector3), numObjects)) {
+						knots.update(latest, first, numObjects);
+						return;
+					}
+				}
+				const Vector3* hostSource = (type == DATA_POSITION) ? population.getPosition(DEVICE_HOST) : population.getVelocity(DEVICE_HOST);
+				memcpy(knots.getData(DEVICE_HOST, false) + first, hostSource, (size_t)numObjects * sizeof(Vector3));
+				knots.update(DEVICE_HOST, first, numObjects);
+			}
+
+			Host& host;
+			// samples of all objects, stored one sample after the other
+			SynchronizedData<Vector3> positions;
+			SynchronizedData<Vector3> velocities;
+			std::vector<double> times;
+			int numObjects;
+	};
+	//! \endcond
+
+	EphemerisCache::EphemerisCache(Host& host):
+		impl(host)
+	{
+	}
+
+	EphemerisCache::~EphemerisCache()
+	{
+	}
+
+	void EphemerisCache::clear()
+	{
+		impl->positions.resize(0);
+		impl->velocities.resize(0);
+		impl->times.clear();
+		impl->numObjects = 0;
+	}
+
+	ErrorCode EphemerisCache::addSample(const Population& population, double julian_day)
+	{
+		if(impl->times.empty())
+			impl->numObjects = population.getSize();
+		else if(population.getSize() != impl->numObjects || julian_day <= impl->times.back())
+			return INVALID_ARGUMENT;
+		if(impl->numObjects > 0) {
+			impl->append(impl->positions, population, population.getLatestDevice(DATA_POSITION), DATA_POSITION);
+			impl->append(impl->velocities, population, population.getLatestDevice(DATA_VELOCITY), DATA_VELOCITY);
+		}
+		impl->times.push_back(julian_day);
+		return SUCCESS;
+	}
+
+	ErrorCode EphemerisCache::propagate(Propagator& propagator, Population& population, double julian_day, double dt, int steps)
+	{
+		ErrorCode status = SUCCESS;
+		if(impl->times.empty() || impl->times.back() != julian_day)
+			status = addSample(population, julian_day);
+		for(int step = 0; step < steps && status == SUCCESS; step++) {
+			status = propagator.propagate(population, julian_day + step * dt / 86400.0, dt);
+			if(status == SUCCESS)
+				status = addSample(population, julian_day + (step + 1) * dt / 86400.0);
+		}
+		return status;
+	}
+
+	ErrorCode EphemerisCache::evaluate(Population& population, double julian_day)
+	{
+		const std::vector<double>& times = impl->times;
+		if(times.empty() || julian_day < times.front() || julian_day > times.back())
+			return INDEX_RANGE;
+		const int size = impl->numObjects;
+		if(population.getSize() != size)
+			population.resize(size);
+		if(size == 0)
+			return SUCCESS;
+
+		// segment containing julian_day; a single sample is a segment of length zero
+		int segment = (int)(std::upper_bound(times.begin(), times.end(), julian_day) - times.begin()) - 1;
+		segment = std::max(0, std::min(segment, (int)times.size() - 2));
+		const int next = std::min(segment + 1, (int)times.size() - 1);
+		const double h = (times[next] - times[segment]) * 86400.0;
+		const double s = (h > 0.0) ? (julian_day - times[segment]) * 86400.0 / h : 0.0;
+
+		// interpolate on the device holding the samples, and on the host otherwise
+		const Device latest = impl->positions.getLatestDevice();
+		GpuSupport* gpu = impl->host.getGPUSupport();
+		if(gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST) {
+			const Vector3* p = impl->positions.getData(latest, false);
+			const Vector3* v = impl->velocities.getData(latest, false);
+			Vector3* position = population.getPosition(latest, true);
+			Vector3* velocity = population.getVelocity(latest, true);
+			const int oldDevice = gpu->getCurrentDevice();
+			gpu->selectDevice(latest - DEVICE_CUDA);
+			bool interpolated = gpu->interpolateHermite(position, velocity, p + (size_t)segment * size, v + (size_t)segment * size,
+														p + (size_t)next * size, v + (size_t)next * size, size, h, s);
+			gpu->selectDevice(oldDevice);
+			if(interpolated) {
+				population.update(DATA_POSITION, latest);
+				population.update(DATA_VELOCITY, latest);
+				return SUCCESS;
+			}
+		}
+		const Vector3* p = impl->positions.getData(DEVICE_HOST, false);
+		const Vector3* v = impl->velocities.getData(DEVICE_HOST, false);
+		const Vector3* p0 = p + (size_t)segment * size;
+		const Vector3* v0 = v + (size_t)segment * size;
+		const Vector3* p1 = p + (size_t)next * size;
+		const Vector3* v1 = v + (size_t)next * size;
+		Vector3* position = population.getPosition(DEVICE_HOST, true);
+		Vector3* velocity = population.getVelocity(DEVICE_HOST, true);
+		parallelFor(size, [&](int begin, int end) {
+			for(int i = begin; i < end; i++)
+				hermiteInterpolate(p0[i], v0[i], p1[i], v1[i], h, s, position[i], velocity[i]);
+		});
+		population.update(DATA_POSITION, DEVICE_HOST);
+		population.update(DATA_VELOCITY, DEVICE_HOST);
+		return SUCCESS;
+	}
+
+	int EphemerisCache::getSampleCount() const
+	{
+		return (int)impl->times.size();
+	}
+
+	double EphemerisCache::getFirstEpoch() const
+	{
+		return impl->times.empty() ? 0.0 : impl->times.front();
+	}
+
+	double EphemerisCache::getLastEpoch() const
+	{
+		return impl->times.empty() ? 0.0 : impl->times.back();
+	}
+}
@@ -0,0 +1,82 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_EPHEMERIS_H
+#define OPI_EPHEMERIS_H
+#include "opi_common.h"
+#include "opi_datatypes.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+#ifdef __cplusplus
+namespace OPI
+{
+	class Host;
+	class Population;
+	class Propagator;
+
+	class EphemerisCacheImpl;
+	//! \brief Stores propagated states to evaluate positions and velocities at arbitrary times
+	/** The cache holds samples of the positions and velocities of all objects at increasing
+	 * Julian dates, all objects being at the same epoch in each sample. Between two samples,
+	 * the states are interpolated with cubic Hermite segments, which match the sampled
+	 * positions and velocities exactly. Samples are kept on the device holding the data of the
+	 * sampled Population and evaluate() runs on that device if the GPU support provides an
+	 * interpolation kernel, so states at arbitrary times cost a single pass instead of another
+	 * propagation. The accuracy depends on the sample spacing; a few dozen samples per orbit
+	 * keep the errors of near-circular orbits far below the usual propagation errors.
+	 * Positions are expected in km and velocities in km/s.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class EphemerisCache
+	{
+		public:
+			OPI_API_EXPORT EphemerisCache(Host& host);
+			OPI_API_EXPORT ~EphemerisCache();
+
+			//! Removes all samples
+			OPI_API_EXPORT void clear();
+			//! Adds the positions and velocities of population as a sample at julian_day
+			/** Samples must be added in increasing order of time and all have the same number
+			 * of objects.
+			 * @return INVALID_ARGUMENT if the sample does not follow the last one or its size differs.
+			 */
+			OPI_API_EXPORT ErrorCode addSample(const Population& population, double julian_day);
+			//! Propagates population by steps steps of dt seconds and samples every state
+			/** The state before the first step is sampled at julian_day as well, unless the
+			 * last sample already is at that date. Stops at the first error of the propagator.
+			 */
+			OPI_API_EXPORT ErrorCode propagate(Propagator& propagator, Population& population, double julian_day, double dt, int steps);
+			//! Replaces the positions and velocities of population with the states at julian_day
+			/** The population is resized to the number of cached objects if necessary; other
+			 * data, including the epochs, is not changed.
+			 * @return INDEX_RANGE if julian_day is outside of the sampled interval.
+			 */
+			OPI_API_EXPORT ErrorCode evaluate(Population& population, double julian_day);
+
+			//! Returns the number of samples
+			OPI_API_EXPORT int getSampleCount() const;
+			//! Returns the date of the first sample, or 0 if there is none
+			OPI_API_EXPORT double getFirstEpoch() const;
+			//! Returns the date of the last sample, or 0 if there is none
+			OPI_API_EXPORT double getLastEpoch() const;
+
+		private:
+			Pimpl<EphemerisCacheImpl> impl;
+	};
+}
+#endif
+
+#endif
@@ -0,0 +1,281 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_event_detector.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_indexlist.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_synchronized_data.h"
+#include "internal/opi_parallel.h"
+#include "internal/opi_events.h"
+#include <memory>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	class EventDetectorImpl
+	{
+		public:
+			EventDetectorImpl(Host& owningHost):
+				host(owningHost),
+				criteria(EVENT_PERIGEE | EVENT_ALTITUDE | EVENT_END_OF_LIFE),
+				perigeeThreshold(0.0),
+				altitudeThreshold(0.0),
+				predicate(0),
+				compaction(false),
+				flags(owningHost, "EventFlags", this),
+				selected(owningHost, "EventIndices", this),
+				eventFlags(owningHost, "EventFlags", this),
+				events(new IndexList(owningHost))
+			{
+			}
+
+			Host& host;
+			int criteria;
+			double perigeeThreshold;
+			double altitudeThreshold;
+			EventPredicate* predicate;
+			bool compaction;
+			// flags of all objects of the last detection
+			SynchronizedData<int> flags;
+			// indices of the flagged objects, before they are copied into a list of the right size
+			SynchronizedData<int> selected;
+			// flags of the events of the last detection
+			SynchronizedData<int> eventFlags;
+			// replaced on every detection, since the size of an IndexList cannot shrink
+			std::unique_ptr<IndexList> events;
+	};
+
+	// returns the GPU holding the latest data of a checked field, or DEVICE_HOST
+	static Device detectionDevice(const Population& population, int criteria)
+	{
+		const int types[] = { DATA_ORBIT, DATA_POSITION, DATA_EPOCH };
+		const int checks[] = { EVENT_PERIGEE, EVENT_ALTITUDE, EVENT_END_OF_LIFE };
+		for (int i = 0; i < 3; i++)
+		{
+			if (!(criteria & checks[i]) || !population.hasData(types[i])) continue;
+			const Device device = population.getLatestDevice(types[i]);
+			if (device >= DEVICE_CUDA && device <= DEVICE_CUDA_LAST) return device;
+		}
+		return DEVICE_HOST;
+	}
+
+	// runs the built-in checks on a GPU, returns false if they are not supported there
+	static bool flagOnDevice(EventDetectorImpl& impl, Population& population, double julian_day, Device device)
+	{
+		GpuSupport* gpu = impl.host.getGPUSupport();
+		const int criteria = impl.criteria;
+		const Orbit* orbit = ((criteria & EVENT_PERIGEE) && population.hasData(DATA_ORBIT)) ? population.getOrbit(device) : 0;
+		const Vector3* position = ((criteria & EVENT_ALTITUDE) && population.hasData(DATA_POSITION)) ? population.getPosition(device) : 0;
+		const Epoch* epoch = ((criteria & EVENT_END_OF_LIFE) && population.hasData(DATA_EPOCH)) ? population.getEpoch(device) : 0;
+		int* flags = impl.flags.getData(device, true);
+		const int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(device - DEVICE_CUDA);
+		const bool flagged = gpu->detectEvents(orbit, position, epoch, population.getSize(), criteria,
+											   impl.perigeeThreshold, impl.altitudeThreshold, julian_day, flags);
+		gpu->selectDevice(oldDevice);
+		if (flagged) impl.flags.update(device);
+		return flagged;
+	}
+
+	// runs the built-in checks on the host
+	static void flagOnHost(EventDetectorImpl& impl, Population& population, double julian_day)
+	{
+		const int criteria = impl.criteria;
+		const Orbit* orbit = ((criteria & EVENT_PERIGEE) && population.hasData(DATA_ORBIT)) ? population.getOrbit(DEVICE_HOST) : 0;
+		const Vector3* position = ((criteria & EVENT_ALTITUDE) && population.hasData(DATA_POSITION)) ? population.getPosition(DEVICE_HOST) : 0;
+		const Epoch* epoch = ((criteria & EVENT_END_OF_LIFE) && population.hasData(DATA_EPOCH)) ? population.getEpoch(DEVICE_HOST) : 0;
+		int* flags = impl.flags.getData(DEVICE_HOST, true);
+		const double perigee = impl.perigeeThreshold;
+		const double altitude = impl.altitudeThreshold;
+		parallelFor(population.getSize(), [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				flags[i] = detectObjectEvents(orbit ? orbit + i : 0, position ? position + i : 0, epoch ? epoch + i : 0,
+											  criteria, perigee, altitude, julian_day);
+		});
+		impl.flags.update(DEVICE_HOST);
+	}
+
+	// collects the flagged objects on a GPU, returns their number or -1 if this is not supported there
+	static int selectOnDevice(EventDetectorImpl& impl, int size, Device device)
+	{
+		GpuSupport* gpu = impl.host.getGPUSupport();
+		const int* flags = impl.flags.getData(device, false);
+		impl.selected.resize(size);
+		int* selected = impl.selected.getData(device, true);
+		const int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(device - DEVICE_CUDA);
+		int count = gpu->selectFlagged(flags, size, selected);
+		gpu->selectDevice(oldDevice);
+		if (count <= 0) return count;
+
+		impl.events->reserve(count);
+		impl.events->update(device, count);
+		int* events = impl.events->getData(device, true);
+		impl.eventFlags.resize(count);
+		int* eventFlags = impl.eventFlags.getData(device, true);
+		gpu->selectDevice(device - DEVICE_CUDA);
+		const bool copied = gpu->copyPeer(events, device - DEVICE_CUDA, selected, device - DEVICE_CUDA, sizeof(int), count)
+			&& gpu->gatherElements(eventFlags, flags, events, count, size, sizeof(int));
+		gpu->selectDevice(oldDevice);
+		if (!copied)
+		{
+			impl.events.reset(new IndexList(impl.host));
+			impl.eventFlags.resize(0);
+			return -1;
+		}
+		impl.events->update(device, count);
+		impl.eventFlags.update(device);
+		return count;
+	}
+
+	// collects the flagged objects on the host
+	static void selectOnHost(EventDetectorImpl& impl, int size)
+	{
+		const int* flags = impl.flags.getData(DEVICE_HOST, false);
+		int count = 0;
+		for (int i = 0; i < size; i++)
+			if (flags[i] != EVENT_NONE) count++;
+		if (count == 0) return;
+		impl.events->reserve(count);
+		impl.events->update(DEVICE_HOST, count);
+		int* events = impl.events->getData(DEVICE_HOST, true);
+		impl.eventFlags.resize(count);
+		int* eventFlags = impl.eventFlags.getData(DEVICE_HOST, true);
+		for (int i = 0, k = 0; i < size; i++)
+		{
+			if (flags[i] == EVENT_NONE) continue;
+			events[k] = i;
+			eventFlags[k++] = flags[i];
+		}
+		impl.events->update(DEVICE_HOST, count);
+		impl.eventFlags.update(DEVICE_HOST);
+	}
+
+	//! \endcond
+
+	EventDetector::EventDetector(Host& host):
+		impl(host)
+	{
+	}
+
+	EventDetector::~EventDetector()
+	{
+	}
+
+	void EventDetector::setCriteria(int criteria)
+	{
+		impl->criteria = criteria & (EVENT_PERIGEE | EVENT_ALTITUDE | EVENT_END_OF_LIFE);
+	}
+
+	int EventDetector::getCriteria() const
+	{
+		return impl->criteria;
+	}
+
+	void EventDetector::setPerigeeThreshold(double altitude)
+	{
+		impl->perigeeThreshold = altitude;
+	}
+
+	double EventDetector::getPerigeeThreshold() const
+	{
+		return impl->perigeeThreshold;
+	}
+
+	void EventDetector::setAltitudeThreshold(double altitude)
+	{
+		impl->altitudeThreshold = altitude;
+	}
+
+	double EventDetector::getAltitudeThreshold() const
+	{
+		return impl->altitudeThreshold;
+	}
+
+	void EventDetector::setPredicate(EventPredicate* predicate)
+	{
+		impl->predicate = predicate;
+	}
+
+	EventPredicate* EventDetector::getPredicate() const
+	{
+		return impl->predicate;
+	}
+
+	void EventDetector::setCompaction(bool enabled)
+	{
+		impl->compaction = enabled;
+	}
+
+	bool EventDetector::getCompaction() const
+	{
+		return impl->compaction;
+	}
+
+	ErrorCode EventDetector::detect(Population& population, double julian_day)
+	{
+		const int size = population.getSize();
+		impl->events.reset(new IndexList(impl->host));
+		impl->eventFlags.resize(0);
+		if (size == 0) return SUCCESS;
+		impl->flags.resize(size);
+
+		// the checks run where the data is, so only the events have to be transferred
+		Device device = impl->host.getGPUSupport() ? detectionDevice(population, impl->criteria) : DEVICE_HOST;
+		if (device == DEVICE_HOST || !flagOnDevice(**impl, population, julian_day, device))
+		{
+			device = DEVICE_HOST;
+			flagOnHost(**impl, population, julian_day);
+		}
+		if (impl->predicate)
+		{
+			if (!impl->predicate->evaluate(population, julian_day, impl->flags.getData(device, false), device))
+			{
+				device = DEVICE_HOST;
+				impl->predicate->evaluate(population, julian_day, impl->flags.getData(DEVICE_HOST, false), DEVICE_HOST);
+			}
+			impl->flags.update(device);
+		}
+
+		int count = (device == DEVICE_HOST) ? -1 : selectOnDevice(**impl, size, device);
+		if (count < 0)
+		{
+			selectOnHost(**impl, size);
+			count = impl->eventFlags.getSize();
+		}
+		if (impl->compaction && count > 0) population.remove(*impl->events);
+		return SUCCESS;
+	}
+
+	IndexList& EventDetector::getEvents()
+	{
+		return *impl->events;
+	}
+
+	const int* EventDetector::getEventFlags(Device device)
+	{
+		return impl->eventFlags.getData(device, false);
+	}
+
+	int EventDetector::getEventCount() const
+	{
+		return impl->eventFlags.getSize();
+	}
+}
@@ -0,0 +1,109 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_EVENT_DETECTOR_H
+#define OPI_EVENT_DETECTOR_H
+#include "opi_common.h"
+#include "opi_datatypes.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+#ifdef __cplusplus
+namespace OPI
+{
+	class Host;
+	class Population;
+	class IndexList;
+
+	//! \brief Interface for additional event checks of an EventDetector, e.g. supplied by a plugin
+	//! \ingroup CPP_API_GROUP
+	class EventPredicate
+	{
+		public:
+			virtual ~EventPredicate() {}
+			//! Adds the findings of this predicate to the flags of all objects of population
+			/** flags holds one value per object with the results of the built-in checks, in memory
+			 * of device. Objects are flagged by setting EVENT_CUSTOM or other bits, any nonzero
+			 * value is an event. Return false if the predicate cannot run on this device without
+			 * changing flags; it is then called again with host memory.
+			 */
+			virtual bool evaluate(Population& population, double julian_day, int* flags, Device device) = 0;
+	};
+
+	class EventDetectorImpl;
+	//! \brief Finds decayed and re-entering objects of a Population
+	/** The built-in checks flag objects whose perigee altitude or altitude is below a threshold,
+	 * or whose end of life is not after their current epoch. They run on the GPU if the latest
+	 * data of any checked field is there, and only the indices of the events are transferred;
+	 * otherwise they run on the host. An EventPredicate can add more checks.
+	 *
+	 * If compaction is enabled, the events are removed from the Population in a stable way, on
+	 * the GPU for fields that are there (see Population::remove()). A detector can be attached
+	 * to a Propagator to run after every propagation step, see Propagator::setEventDetector().
+	 * \ingroup CPP_API_GROUP
+	 */
+	class EventDetector
+	{
+		public:
+			OPI_API_EXPORT EventDetector(Host& host);
+			OPI_API_EXPORT ~EventDetector();
+
+			//! Selects the built-in checks, a combination of EventFlags
+			/** Defaults to EVENT_PERIGEE | EVENT_ALTITUDE | EVENT_END_OF_LIFE. EVENT_CUSTOM is ignored. */
+			OPI_API_EXPORT void setCriteria(int criteria);
+			//! Returns the selected built-in checks
+			OPI_API_EXPORT int getCriteria() const;
+			//! Sets the perigee altitude in km below which objects are flagged with EVENT_PERIGEE
+			/** The altitude is measured above a spherical Earth. Defaults to zero. */
+			OPI_API_EXPORT void setPerigeeThreshold(double altitude);
+			//! Returns the perigee altitude threshold in km
+			OPI_API_EXPORT double getPerigeeThreshold() const;
+			//! Sets the altitude of the position in km below which objects are flagged with EVENT_ALTITUDE
+			/** The altitude is measured above a spherical Earth. Defaults to zero. */
+			OPI_API_EXPORT void setAltitudeThreshold(double altitude);
+			//! Returns the altitude threshold in km
+			OPI_API_EXPORT double getAltitudeThreshold() const;
+			//! Sets an additional check, or null for none; the predicate is not owned by the detector
+			OPI_API_EXPORT void setPredicate(EventPredicate* predicate);
+			//! Returns the additional check
+			OPI_API_EXPORT EventPredicate* getPredicate() const;
+			//! Enables removing the events from the Population after each detection
+			OPI_API_EXPORT void setCompaction(bool enabled);
+			//! Returns true if the events are removed from the Population
+			OPI_API_EXPORT bool getCompaction() const;
+
+			//! Checks all objects of population for events at julian_day
+			/** julian_day is used for the end of life check of objects without a current epoch.
+			 * Checks that a GPU does not support run on the host instead.
+			 * @return SUCCESS.
+			 */
+			OPI_API_EXPORT ErrorCode detect(Population& population, double julian_day);
+			//! Returns the indices of the objects found by the last detect() call, in ascending order
+			/** The indices refer to the Population before compaction. The list stays valid until
+			 * the next call of detect().
+			 */
+			OPI_API_EXPORT IndexList& getEvents();
+			//! Returns the EventFlags of the events found by the last detect() call, one per event
+			OPI_API_EXPORT const int* getEventFlags(Device device = DEVICE_HOST);
+			//! Returns the number of events found by the last detect() call
+			OPI_API_EXPORT int getEventCount() const;
+
+		private:
+			Pimpl<EventDetectorImpl> impl;
+	};
+}
+#endif
+
+#endif
@@ -27,6 +27,12 @@ struct cudaDeviceProp;
 namespace OPI
 {
 	class GpuSupport;
+	struct Orbit;
+	struct Vector3;
+	struct ObjectProperties;
+	struct Epoch;
+	struct Covariance;
+	struct IndexPair;
 
 	typedef GpuSupport* (*procCreateGpuSupport)();
 	/**
@@ -36,6 +42,10 @@ namespace OPI
 	/**
 	 * @ingroup CPP_API_GROUP
 	 * @brief CUDA/OpenCL Support Interface
+	 *
+	 * All functions may be called from several threads. selectDevice() and getCurrentDevice()
+	 * refer to the calling thread, so every thread can work on its own device and all other
+	 * functions operate on the device selected by the calling thread.
 	 */
 	class GpuSupport
 	{
@@ -45,7 +55,202 @@ namespace OPI
 
 			virtual void allocate(void** a, size_t size) = 0;
 			virtual void free(void* mem) = 0;
+            //! Returns true if the platform can allocate page-locked host memory
+            virtual bool supportsPinnedMemory() { return false; }
+            //! Allocates page-locked host memory that can be transferred via DMA. Sets *a to zero on failure.
+            virtual void allocatePinned(void** a, size_t size) { *a = 0; }
+            //! Frees memory allocated with allocatePinned()
+            virtual void freePinned(void* mem) {}
+            //! Returns true if the platform can allocate memory that is shared by the host and all devices
+            virtual bool supportsManagedMemory() { return false; }
+            //! Allocates managed memory that the host and all devices access through the same pointer. Sets *a to zero on failure.
+            virtual void allocateManaged(void** a, size_t size) { *a = 0; }
+            //! Frees memory allocated with allocateManaged()
+            virtual void freeManaged(void* mem) {}
+            //! Migrates managed memory to a device, or to the host if device is -1
+            /** Prefetches to a device are queued on the given stream. A prefetch to the host waits
+             * until all work on the current device has finished, so the host can access the memory
+             * right away.
+             */
+            virtual void prefetchManaged(void* mem, size_t size, int device, void* stream) {}
+            //! Marks managed memory as accessed by a device, or by the host if device is -1
+            /** The memory is then mapped for that device, so accesses do not migrate its pages. */
+            virtual void adviseManaged(void* mem, size_t size, int device) {}
+            //! Sets how many bytes of freed device and page-locked memory are kept for reuse
+            /** Implementations that cache allocations must only hand out a cached block once all
+             * work queued on it before it was freed has finished. Zero disables caching.
+             */
+            virtual void setMemoryCacheLimit(size_t bytes) {}
+            //! Frees all cached device and page-locked memory
+            virtual void releaseMemoryCache() {}
+            //! Returns the number of bytes that can currently be allocated on the current device, zero if unknown
+            virtual size_t getFreeDeviceMemory() { return 0; }
             virtual void copy(void* dest, void* source, size_t size, unsigned int num_objects, bool host_to_device) = 0;
+            //! Copies data directly between two devices without staging it on the host.
+            /** Returns false if the platform cannot copy between the given devices, in which case
+             * the caller has to fall back to a transfer through host memory.
+             */
+            virtual bool copyPeer(void* dest, int destDevice, void* source, int sourceDevice, size_t size, unsigned int num_objects) { return false; }
+            //! Like copy(), starting offset bytes into the device memory
+            /** Device memory may be a handle rather than an address (e.g. a cl_mem buffer), so
+             * ranges of it must not be addressed by adding to the pointer. The host pointer is
+             * given as is. The default adds offset to the device pointer.
+             */
+            virtual void copyRange(void* dest, void* source, size_t offset, size_t size, unsigned int num_objects, bool host_to_device)
+            {
+                if (host_to_device) copy((char*)dest + offset, source, size, num_objects, true);
+                else copy(dest, (char*)source + offset, size, num_objects, false);
+            }
+            //! Like copyPeer(), starting destOffset and sourceOffset bytes into the device memory
+            virtual bool copyPeerRange(void* dest, size_t destOffset, int destDevice, void* source, size_t sourceOffset, int sourceDevice, size_t size, unsigned int num_objects)
+            {
+                return copyPeer((char*)dest + destOffset, destDevice, (char*)source + sourceOffset, sourceDevice, size, num_objects);
+            }
+
+            //! Creates a stream (CUDA stream or OpenCL command queue) on the current device.
+            /** Returns zero if asynchronous transfers are not supported by the platform. */
+            virtual void* createStream() { return 0; }
+            //! Releases a stream created with createStream()
+            virtual void destroyStream(void* stream) {}
+            //! Waits until all operations queued on the given stream have finished
+            virtual void synchronizeStream(void* stream) {}
+            //! Queues a copy on the given stream and returns immediately.
+            /** The host memory involved must not be modified or freed until the copy has finished.
+             * The default implementation falls back to a synchronous copy.
+             */
+            virtual void copyAsync(void* dest, void* source, size_t size, unsigned int num_objects, bool host_to_device, void* stream) { copy(dest, source, size, num_objects, host_to_device); }
+            //! Like copyAsync(), starting offset bytes into the device memory, see copyRange()
+            virtual void copyRangeAsync(void* dest, void* source, size_t offset, size_t size, unsigned int num_objects, bool host_to_device, void* stream)
+            {
+                if (host_to_device) copyAsync((char*)dest + offset, source, size, num_objects, true, stream);
+                else copyAsync(dest, (char*)source + offset, size, num_objects, false, stream);
+            }
+            //! Records an event after all operations currently queued on the given stream.
+            /** Returns zero if events are not supported, in which case all queued work has already finished. */
+            virtual void* recordEvent(void* stream) { return 0; }
+            //! Waits until the given event has completed
+            virtual void synchronizeEvent(void* event) {}
+            //! Releases an event created with recordEvent()
+            virtual void destroyEvent(void* event) {}
+            //! Starts recording the work queued on the given stream into a graph instead of running it.
+            /** Only work queued by the calling thread is recorded; synchronous copies and other
+             * synchronizing calls on this thread make the recording fail. Returns false if the
+             * platform cannot record graphs.
+             */
+            virtual bool beginCapture(void* stream) { return false; }
+            //! Stops recording and returns an executable graph, or zero if the recording failed
+            /** The recorded work has not been executed, launchGraph() runs it. */
+            virtual void* endCapture(void* stream) { return 0; }
+            //! Queues the work recorded in a graph on the given stream
+            virtual bool launchGraph(void* graph, void* stream) { return false; }
+            //! Releases a graph returned by endCapture()
+            virtual void destroyGraph(void* graph) {}
+
+            //! Converts size orbits to position and velocity vectors in memory of the current device
+            /** Returns false if the platform has no conversion kernel, in which case the caller
+             * has to convert on the host.
+             */
+            virtual bool convertOrbitsToStateVectors(Orbit* orbit, Vector3* position, Vector3* velocity, int size) { return false; }
+            //! Converts size position and velocity vectors to orbits in memory of the current device
+            /** The number of degenerate state vectors is stored in invalidObjects. Returns false if
+             * the platform has no conversion kernel, in which case the caller has to convert on the host.
+             */
+            virtual bool convertStateVectorsToOrbits(Vector3* position, Vector3* velocity, Orbit* orbit, int size, int* invalidObjects) { return false; }
+            //! Transposes a matrix of doubles with the given number of rows, stored row by row, in memory of the current device
+            /** Used to convert between array-of-structs and structure-of-arrays layouts. Returns false
+             * if the platform has no transposition kernel, in which case the caller transposes on the host.
+             */
+            virtual bool transpose(double* destination, const double* source, int rows, int columns) { return false; }
+            //! Adds count doubles from source to destination in memory of the current device
+            /** Returns false if the platform has no kernel for this, in which case the caller
+             * adds the values on the host.
+             */
+            virtual bool addDoubles(double* destination, const double* source, size_t count) { return false; }
+            //! Copies the indexed elements of elementSize bytes in memory of the current device
+            /** Element i of destination receives element indices[i] of source, indices outside of
+             * the sourceCount elements are skipped. Returns false if the platform has no kernel for
+             * this, in which case the caller gathers the elements on the host.
+             */
+            virtual bool gatherElements(void* destination, const void* source, const int* indices, int count, int sourceCount, size_t elementSize) { return false; }
+            //! Copies elements of elementSize bytes to the indexed positions in memory of the current device
+            /** Element i of source is written to element indices[i] of destination, indices outside
+             * of the destinationCount elements are skipped. Returns false if unsupported.
+             */
+            virtual bool scatterElements(void* destination, int destinationCount, const void* source, const int* indices, int count, size_t elementSize) { return false; }
+            //! Runs the checks of Population::validate on size objects in memory of the current device
+            /** Fields without data are passed as null. The ValidationFlags of each object are written
+             * to errors on the device; epochCounts, in host memory, receives the number of objects
+             * with an orbit that have a current epoch set (first) and that have none (second).
+             * Returns false if the platform has no kernel for this, in which case the caller
+             * validates on the host.
+             */
+            virtual bool validateObjects(const ObjectProperties* properties, const Orbit* orbit, const Epoch* epoch, const Vector3* position, const Vector3* velocity, int size, int* errors, int* epochCounts) { return false; }
+            //! Runs the built-in checks of an EventDetector on size objects in memory of the current device
+            /** criteria is a combination of EventFlags selecting the checks, the thresholds are
+             * altitudes in km. Fields without data are passed as null. The EventFlags of each
+             * object are written to flags on the device. Returns false if unsupported.
+             */
+            virtual bool detectEvents(const Orbit* orbit, const Vector3* position, const Epoch* epoch, int size, int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags) { return false; }
+            //! Computes the probability of collision of count pairs of objects in memory of the current device
+            /** For pair k, the miss distance, the time of closest approach and the probability are
+             * written to results[3k] to results[3k+2], and flags[k] is set to 1 if the probability is
+             * at least threshold and to 0 otherwise; pairs referring to objects beyond size are
+             * not flagged. covariance and properties may be null. Returns false if unsupported.
+             */
+            virtual bool computeCollisionProbabilities(const Vector3* position, const Vector3* velocity, const Covariance* covariance, const ObjectProperties* properties, int size, const IndexPair* pairs, int count, double threshold, double* results, int* flags) { return false; }
+            //! Copies the first elements doubles of size covariances on the current device to a compact array
+            /** The elements of each object are stored consecutively, as floats if singlePrecision is
+             * set. Returns false if unsupported.
+             */
+            virtual bool compactCovariance(void* destination, const Covariance* source, int size, int elements, bool singlePrecision) { return false; }
+            //! Interpolates size positions and velocities between two samples in memory of the current device
+            /** Evaluates the cubic Hermite segments of EphemerisCache at fraction s of a segment
+             * of h seconds, see internal/opi_interpolation.h. Returns false if unsupported.
+             */
+            virtual bool interpolateHermite(Vector3* position, Vector3* velocity, const Vector3* p0, const Vector3* v0, const Vector3* p1, const Vector3* v1, int size, double h, double s) { return false; }
+            //! Generates Monte Carlo clones of each of size objects in memory of the current device
+            /** Implements Population::sampleClones, see internal/opi_sampling.h: the covariance of
+             * every object is factored once, and clone c of object i, written to element
+             * i * clones + c of the clone fields, is drawn with the counter-based generator from
+             * seed. Fields without data are passed as null. Returns false if unsupported.
+             */
+            virtual bool sampleClones(const Covariance* covariance, const Orbit* orbit, const Vector3* position, const Vector3* velocity, const ObjectProperties* properties, const Epoch* epoch, int size, int clones, int covarianceType, unsigned long long seed, Orbit* cloneOrbit, Vector3* clonePosition, Vector3* cloneVelocity, ObjectProperties* cloneProperties, Epoch* cloneEpoch) { return false; }
+            //! Reduces one component of size elements of stride doubles each in memory of the current device
+            /** Implements Population::reduce: operation is a ReductionOperation, values that are NaN
+             * or outside [lowerBound, upperBound] are skipped. result and validCount are in host
+             * memory. Returns false if unsupported.
+             */
+            virtual bool reduceComponent(const double* data, int stride, int size, int component, int operation, double lowerBound, double upperBound, double* result, int* validCount) { return false; }
+            //! Sets size bytes of memory on the current device to zero. Returns false if this is unsupported.
+            virtual bool zeroMemory(void* mem, size_t size) { return false; }
+            //! Like zeroMemory(), starting offset bytes into the device memory, see copyRange()
+            virtual bool zeroMemoryRange(void* mem, size_t offset, size_t size) { return zeroMemory((char*)mem + offset, size); }
+            //! Sorts size indices in memory of the current device in ascending order
+            /** If unique is set, duplicates are removed as well. Returns the number of remaining
+             * indices, or -1 if this is unsupported.
+             */
+            virtual int sortIndices(int* indices, int size, bool unique) { return -1; }
+            //! Writes the indices of the nonzero elements of size flags on the current device to indices
+            /** The indices are written in ascending order. Returns their number, or -1 if this is unsupported. */
+            virtual int selectFlagged(const int* flags, int size, int* indices) { return -1; }
+            //! Removes duplicate pairs of size IndexPairs in memory of the current device
+            /** Each pair is ordered so that object1 is the smaller index, then the pairs are sorted
+             * and duplicates removed. Returns the number of remaining pairs, or -1 if this is unsupported.
+             */
+            virtual int removeDuplicatePairs(IndexPair* pairs, int size) { return -1; }
+            //! Builds the uniform grid of GridDistanceQuery for size positions in memory of the current device
+            /** Every position is assigned the bucket of its cell (see internal/opi_spatial_hash.h),
+             * the object indices are sorted by bucket into indices, and cellStart/cellEnd receive
+             * the range of each of the tableSize buckets within indices (-1 for empty buckets).
+             * keys is scratch memory for size bucket numbers. Returns false if this is unsupported.
+             */
+            virtual bool buildSpatialHash(const Vector3* position, int size, double cellSize, unsigned int tableSize, unsigned int* keys, int* indices, int* cellStart, int* cellEnd) { return false; }
+            //! Finds all pairs of objects within a cube of cubeSize in a grid built by buildSpatialHash()
+            /** The pairs are appended through pairCount, the append counter of an IndexPairList in
+             * memory of the current device; at most maxPairs pairs are written. Returns false if
+             * this is unsupported.
+             */
+            virtual bool querySpatialHash(const Vector3* position, const int* indices, const int* cellStart, const int* cellEnd, int size, double cellSize, unsigned int tableSize, double cubeSize, IndexPair* pairs, int maxPairs, int* pairCount) { return false; }
 
 			virtual void shutdown() = 0;
 
@@ -63,6 +268,16 @@ namespace OPI
             virtual cl_command_queue* getOpenCLQueue() = 0;
             virtual cl_device_id* getOpenCLDevice() = 0;
             virtual cl_device_id** getOpenCLDeviceList() = 0;
+            //! Builds an OpenCL program for the current device, reusing a binary cached on disk
+            /** Binaries are cached per source, build options, device and driver version in the
+             * directory given by the OPI_CL_CACHE_DIR environment variable (an empty value
+             * disables the cache), or in opi_cl_cache in the temporary directory otherwise.
+             * The context contains all devices of the platform and every device has its own
+             * in-order default queue; createStream() adds further queues on the current device
+             * to overlap transfers and kernels. The caller releases the returned program.
+             * Returns NULL if the program cannot be built.
+             */
+            virtual cl_program buildOpenCLProgram(const char* source, const char* options = NULL) { return NULL; }
 #endif
 
 		protected:
@@ -0,0 +1,314 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_grid_query.h"
+#include "opi_host.h"
+#include "opi_indexpairlist.h"
+#include "opi_indexlist.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_spatial_hash.h"
+#include "internal/opi_parallel.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+namespace OPI
+{
+	//! \cond INTERNAL_DOCUMENTATION
+	class GridDistanceQueryImpl
+	{
+		public:
+			GridDistanceQueryImpl():
+				cellSize(0.0), lastCubeSize(0.0), gridCellSize(0.0), gridSize(-1), tableSize(0), onDevice(false),
+				deviceKeys(0), deviceIndices(0), deviceCellStart(0), deviceCellEnd(0), deviceCapacity(0), deviceTableCapacity(0)
+			{}
+
+			// frees the device grid
+			void freeDeviceGrid(GpuSupport* gpu)
+			{
+				if(gpu) {
+					if(deviceKeys) gpu->free(deviceKeys);
+					if(deviceIndices) gpu->free(deviceIndices);
+					if(deviceCellStart) gpu->free(deviceCellStart);
+					if(deviceCellEnd) gpu->free(deviceCellEnd);
+				}
+				deviceKeys = 0;
+				deviceIndices = 0;
+				deviceCellStart = 0;
+				deviceCellEnd = 0;
+				deviceCapacity = 0;
+				deviceTableCapacity = 0;
+			}
+
+			// edge length of the cells set by the property "CellSize"
+			double cellSize;
+			// cube size of the last query
+			double lastCubeSize;
+			// cell size and number of objects of the current grid, gridSize is -1 if there is none
+			double gridCellSize;
+			int gridSize;
+			unsigned int tableSize;
+			bool onDevice;
+
+			// host grid: objects sorted by bucket, and the range of each bucket
+			std::vector<int> indices;
+			std::vector<int> cellOffsets;
+			// current bucket of every object, and the bucket it is sorted into by the last build
+			std::vector<unsigned int> keys;
+			std::vector<unsigned int> gridKeys;
+			// objects whose current bucket differs from the one they are sorted into,
+			// and these objects sorted by their current bucket
+			std::vector<char> displaced;
+			std::vector<int> displacedObjects;
+			std::vector<std::pair<unsigned int, int> > displacedByBucket;
+
+			// device grid, allocated on the first CUDA device
+			unsigned int* deviceKeys;
+			int* deviceIndices;
+			int* deviceCellStart;
+			int* deviceCellEnd;
+			int deviceCapacity;
+			unsigned int deviceTableCapacity;
+	};
+
+	// smallest power of two that leaves about half of the buckets empty
+	static unsigned int tableSizeFor(int size)
+	{
+		unsigned int tableSize = 1;
+		while(tableSize < 2u * (unsigned int)size) tableSize <<= 1;
+		return tableSize;
+	}
+
+	// returns the bucket of a position
+	static unsigned int bucketOf(const GridDistanceQueryImpl* grid, const Vector3& p)
+	{
+		return spatialHashBucket(spatialHashCoordinate(p.x, grid->gridCellSize), spatialHashCoordinate(p.y, grid->gridCellSize),
+								 spatialHashCoordinate(p.z, grid->gridCellSize), grid->tableSize);
+	}
+
+	// sorts the objects by bucket with a counting sort
+	static void buildHostGrid(GridDistanceQueryImpl* grid, const Vector3* position, int size)
+	{
+		std::vector<unsigned int>& keys = grid->keys;
+		keys.resize(size);
+		grid->cellOffsets.assign(grid->tableSize + 1, 0);
+		for(int i = 0; i < size; i++) {
+			keys[i] = bucketOf(grid, position[i]);
+			grid->cellOffsets[keys[i] + 1]++;
+		}
+		for(unsigned int b = 0; b < grid->tableSize; b++)
+			grid->cellOffsets[b + 1] += grid->cellOffsets[b];
+		std::vector<int> next(grid->cellOffsets.begin(), grid->cellOffsets.end() - 1);
+		grid->indices.resize(size);
+		for(int i = 0; i < size; i++)
+			grid->indices[next[keys[i]]++] = i;
+		grid->gridKeys = keys;
+		grid->displaced.assign(size, 0);
+		grid->displacedObjects.clear();
+		grid->displacedByBucket.clear();
+	}
+
+	// appends the pair of i and j if j is the larger index and both lie within the cube
+	static void testHostPair(const Vector3* position, int i, int j, double cubeSize, std::vector<IndexPair>& out)
+	{
+		const Vector3& p = position[i];
+		if(j > i && spatialHashInCube(p.x, p.y, p.z, position[j].x, position[j].y, position[j].z, cubeSize)) {
+			IndexPair pair;
+			pair.object1 = i;
+			pair.object2 = j;
+			out.push_back(pair);
+		}
+	}
+
+	// collects the pairs of the objects at the sorted positions [begin, end)
+	static void queryHostGrid(const GridDistanceQueryImpl* grid, const Vector3* position, double cubeSize, int begin, int end, std::vector<IndexPair>& out)
+	{
+		const bool displaced = !grid->displacedByBucket.empty();
+		for(int k = begin; k < end; k++) {
+			const int i = grid->indices[k];
+			const Vector3& p = position[i];
+			const long long cx = spatialHashCoordinate(p.x, grid->gridCellSize);
+			const long long cy = spatialHashCoordinate(p.y, grid->gridCellSize);
+			const long long cz = spatialHashCoordinate(p.z, grid->gridCellSize);
+			// neighbouring cells may share a bucket, which must only be searched once
+			unsigned int visited[27];
+			int numVisited = 0;
+			for(int dx = -1; dx <= 1; dx++)
+			for(int dy = -1; dy <= 1; dy++)
+			for(int dz = -1; dz <= 1; dz++) {
+				const unsigned int bucket = spatialHashBucket(cx + dx, cy + dy, cz + dz, grid->tableSize);
+				if(std::find(visited, visited + numVisited, bucket) != visited + numVisited) continue;
+				visited[numVisited++] = bucket;
+				for(int m = grid->cellOffsets[bucket]; m < grid->cellOffsets[bucket + 1]; m++) {
+					const int j = grid->indices[m];
+					// objects that left the bucket since the build are found through the displaced list
+					if(!displaced || !grid->displaced[j]) testHostPair(position, i, j, cubeSize, out);
+				}
+				if(displaced) {
+					std::vector<std::pair<unsigned int, int> >::const_iterator itr = std::lower_bound(grid->displacedByBucket.begin(),
+						grid->displacedByBucket.end(), std::make_pair(bucket, -1));
+					for(; itr != grid->displacedByBucket.end() && itr->first == bucket; ++itr)
+						testHostPair(position, i, itr->second, cubeSize, out);
+				}
+			}
+		}
+	}
+
+	// builds the grid on the first CUDA device, returns false if the GPU support cannot do this
+	static bool buildDeviceGrid(GridDistanceQueryImpl* grid, GpuSupport* gpu, Population& population)
+	{
+		const int size = population.getSize();
+		const Vector3* position = population.getPosition(DEVICE_CUDA);
+		int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(0);
+		if(size > grid->deviceCapacity || grid->tableSize > grid->deviceTableCapacity) {
+			grid->freeDeviceGrid(gpu);
+			gpu->allocate((void**)&grid->deviceKeys, sizeof(unsigned int) * size);
+			gpu->allocate((void**)&grid->deviceIndices, sizeof(int) * size);
+			gpu->allocate((void**)&grid->deviceCellStart, sizeof(int) * grid->tableSize);
+			gpu->allocate((void**)&grid->deviceCellEnd, sizeof(int) * grid->tableSize);
+			grid->deviceCapacity = size;
+			grid->deviceTableCapacity = grid->tableSize;
+		}
+		bool success = gpu->buildSpatialHash(position, size, grid->gridCellSize, grid->tableSize,
+											  grid->deviceKeys, grid->deviceIndices, grid->deviceCellStart, grid->deviceCellEnd);
+		gpu->selectDevice(oldDevice);
+		return success;
+	}
+	//! \endcond
+
+	GridDistanceQuery::GridDistanceQuery()
+	{
+		setName("UniformGrid");
+		setAuthor("OPI");
+		setDescription("Built-in uniform grid distance query");
+		registerProperty("CellSize", &impl->cellSize);
+	}
+
+	GridDistanceQuery::~GridDistanceQuery()
+	{
+		if(getHost())
+			impl->freeDeviceGrid(getHost()->getGPUSupport());
+	}
+
+	ErrorCode GridDistanceQuery::runRebuild(Population& population)
+	{
+		const double cellSize = (impl->cellSize > 0.0) ? impl->cellSize : impl->lastCubeSize;
+		// without a cell size, the grid is built by the first query
+		if(cellSize <= 0.0) {
+			impl->gridSize = -1;
+			return SUCCESS;
+		}
+		const int size = population.getSize();
+		impl->gridCellSize = cellSize;
+		impl->gridSize = size;
+		impl->tableSize = tableSizeFor(size);
+		GpuSupport* gpu = getHost()->getGPUSupport();
+		impl->onDevice = getHost()->hasCUDASupport() && population.getPartitionCount() == 0
+				&& buildDeviceGrid(*impl, gpu, population);
+		if(!impl->onDevice)
+			buildHostGrid(*impl, population.getPosition(DEVICE_HOST), size);
+		return SUCCESS;
+	}
+
+	ErrorCode GridDistanceQuery::runRefit(Population& population, IndexList* changedIndices)
+	{
+		const int size = population.getSize();
+		// sorting on the device is cheap, so the device grid is rebuilt; so is an outdated grid
+		if(impl->gridSize != size || impl->onDevice)
+			return runRebuild(population);
+		GridDistanceQueryImpl* grid = *impl;
+		const Vector3* position = population.getPosition(DEVICE_HOST);
+		const int* changed = changedIndices ? changedIndices->getData(DEVICE_HOST) : 0;
+		const int count = changedIndices ? changedIndices->getSize() : size;
+		for(int c = 0; c < count; c++) {
+			const int i = changed ? changed[c] : c;
+			if(i < 0 || i >= size) continue;
+			grid->keys[i] = bucketOf(grid, position[i]);
+			const bool moved = (grid->keys[i] != grid->gridKeys[i]);
+			if(moved && !grid->displaced[i]) grid->displacedObjects.push_back(i);
+			grid->displaced[i] = moved;
+		}
+		// objects may have moved back to their bucket, or have been added more than once
+		std::vector<int>& objects = grid->displacedObjects;
+		std::sort(objects.begin(), objects.end());
+		objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+		int kept = 0;
+		for(size_t k = 0; k < objects.size(); k++)
+			if(grid->displaced[objects[k]]) objects[kept++] = objects[k];
+		objects.resize(kept);
+		// the list is searched for every visited bucket, so it has to stay short
+		if(kept > size / 8)
+			return runRebuild(population);
+		grid->displacedByBucket.resize(kept);
+		for(int k = 0; k < kept; k++)
+			grid->displacedByBucket[k] = std::make_pair(grid->keys[objects[k]], objects[k]);
+		std::sort(grid->displacedByBucket.begin(), grid->displacedByBucket.end());
+		return SUCCESS;
+	}
+
+	ErrorCode GridDistanceQuery::runCubicPairQuery(Population& population, IndexPairList& pairs, float cube_size)
+	{
+		if(cube_size <= 0.0f)
+			return INVALID_ARGUMENT;
+		impl->lastCubeSize = cube_size;
+		// neighbouring cells only contain all candidates if they are at least as large as the cube
+		if(impl->gridSize != population.getSize() || impl->gridCellSize < cube_size) {
+			ErrorCode status = runRebuild(population);
+			if(status != SUCCESS) return status;
+		}
+		const int size = population.getSize();
+		if(impl->onDevice) {
+			GpuSupport* gpu = getHost()->getGPUSupport();
+			const Vector3* position = population.getPosition(DEVICE_CUDA);
+			const GridDistanceQueryImpl* grid = *impl;
+			// the list grows and the query is repeated if the pairs do not fit
+			return pairs.fill(DEVICE_CUDA, [&](IndexPair* out, int capacity, int* counter) {
+				int oldDevice = gpu->getCurrentDevice();
+				gpu->selectDevice(0);
+				bool success = gpu->querySpatialHash(position, grid->deviceIndices, grid->deviceCellStart, grid->deviceCellEnd,
+													 size, grid->gridCellSize, grid->tableSize, cube_size, out, capacity, counter);
+				gpu->selectDevice(oldDevice);
+				return success ? SUCCESS : CUDA_REQUIRED;
+			});
+		}
+
+		// the sorted objects are split into ranges whose pairs are concatenated in order
+		const Vector3* position = population.getPosition(DEVICE_HOST);
+		std::map<int, std::vector<IndexPair> > rangePairs;
+		std::mutex rangeMutex;
+		const GridDistanceQueryImpl* grid = *impl;
+		const double cubeSize = cube_size;
+		parallelFor(size, [&](int begin, int end) {
+			std::vector<IndexPair> found;
+			queryHostGrid(grid, position, cubeSize, begin, end, found);
+			std::lock_guard<std::mutex> lock(rangeMutex);
+			rangePairs[begin].swap(found);
+		}, 1024);
+		int numPairs = 0;
+		for(std::map<int, std::vector<IndexPair> >::const_iterator itr = rangePairs.begin(); itr != rangePairs.end(); ++itr)
+			numPairs += (int)itr->second.size();
+		if(numPairs > pairs.getTotalSpace())
+			pairs.reserve(numPairs);
+		// set the size of the list first so the host memory holds numPairs elements
+		pairs.update(DEVICE_HOST, numPairs);
+		IndexPair* out = pairs.getData(DEVICE_HOST, true);
+		for(std::map<int, std::vector<IndexPair> >::const_iterator itr = rangePairs.begin(); itr != rangePairs.end(); ++itr)
+			out = std::copy(itr->second.begin(), itr->second.end(), out);
+		pairs.update(DEVICE_HOST, numPairs);
+		return SUCCESS;
+	}
+}
@@ -0,0 +1,61 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_GRID_QUERY_H
+#define OPI_GRID_QUERY_H
+#include "opi_query.h"
+#ifdef __cplusplus
+namespace OPI
+{
+	class GridDistanceQueryImpl;
+	//! \brief Built-in DistanceQuery based on a uniform grid
+	/** Every object is sorted into a cubic cell of the grid, and each cell is mapped onto a
+	 * bucket of a hash table, so the grid does not need to know the extent of the Population.
+	 * A pair query only compares objects of neighbouring cells. With CUDA support, the grid is
+	 * built by sorting the bucket numbers on the device and the pairs are written directly into
+	 * the device memory of the IndexPairList; otherwise, or for partitioned Populations, the same
+	 * algorithm runs on the host.
+	 *
+	 * The query is registered with every Host under the name "UniformGrid". Its property
+	 * "CellSize" sets the edge length of the cells used by rebuild(); if it is zero (the default),
+	 * the cube size of the last query is used. queryCubicPairs() rebuilds the grid itself if its
+	 * cells are smaller than the requested cube size or the Population size has changed.
+	 *
+	 * refit() updates the host grid in time proportional to the number of changed objects:
+	 * objects that left the bucket they were sorted into are kept in a short list sorted by
+	 * their new bucket, and the grid is only rebuilt once more than an eighth of the objects
+	 * have moved. A grid on the device is always rebuilt.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class GridDistanceQuery:
+		public DistanceQuery
+	{
+		public:
+			OPI_API_EXPORT GridDistanceQuery();
+			OPI_API_EXPORT virtual ~GridDistanceQuery();
+
+		protected:
+			virtual ErrorCode runRebuild(Population& population);
+			virtual ErrorCode runRefit(Population& population, IndexList* changedIndices);
+			virtual ErrorCode runCubicPairQuery(Population& population, IndexPairList& pairs, float cube_size);
+
+		private:
+			Pimpl<GridDistanceQueryImpl> impl;
+	};
+}
+#endif
+
+#endif
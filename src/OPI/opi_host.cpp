@@ -20,11 +20,29 @@
 #include "opi_gpusupport.h"
 #include "internal/opi_propagator_plugin.h"
 #include "internal/opi_query_plugin.h"
+#include "opi_grid_query.h"
 #include "opi_custom_propagator.h"
+#include "opi_split_propagator.h"
 #include "opi_collisiondetection.h"
 #include "internal/dynlib.h"
+#include "internal/opi_thread_pool.h"
+#include "internal/opi_memory_pool.h"
+#include "internal/opi_device_budget.h"
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <random>
+#include <sys/stat.h>
 #ifdef _MSC_VER
 #include "internal/msdirent.h"
 #else
@@ -35,11 +53,50 @@ namespace OPI
 {
 	//! \cond INTERNAL_DOCUMENTATION
 
+	// name of the file caching plugin information in lazy mode
+	static const char* PLUGIN_MANIFEST_NAME = "opi_plugins.manifest";
+
+	// plugin information cached in the manifest, by file name
+	struct PluginManifestEntry
+	{
+		long long modified;
+		long long size;
+		int type;
+		std::string name;
+	};
+
+	// a plugin found by loadPlugins in lazy mode which is loaded on the first request
+	struct PendingPlugin
+	{
+		std::string path;
+		std::string configFile;
+		std::string name;
+		int type;
+		Host::gpuPlatform platform;
+		// already opened if the plugin information had to be read from the library
+		Plugin* plugin;
+	};
+
 	class HostImpl
 	{
 		public:
 			GpuSupport* gpuSupport;
 			DynLib* gpuSupportPluginHandle;
+			// GPU support requested by loadPlugins but not yet loaded
+			std::atomic<bool> gpuSupportPending;
+			std::string gpuSupportFileName;
+			Host::gpuPlatform gpuSupportPlatform;
+			int gpuSupportPlatformNumber;
+			int gpuSupportDeviceNumber;
+			mutable std::mutex gpuSupportMutex;
+			bool lazyPlugins;
+			std::vector<PendingPlugin> pendingPlugins;
+			mutable std::recursive_mutex pluginMutex;
+			// freed pageable host memory of data objects
+			mutable HostMemoryPool hostMemoryPool;
+			size_t memoryCacheLimit;
+			// device memory of data objects, released least recently used first beyond its limit
+			mutable DeviceMemoryBudget deviceMemoryBudget;
 
 			std::vector<Plugin*> pluginlist;
 			std::vector<Propagator*> propagagorlist;
@@ -49,7 +106,28 @@ namespace OPI
 			std::vector<CollisionDetection*> detectionlist;
 			OPI_ErrorCallback errorCallback;
 			void* errorCallbackParameter;
-			mutable ErrorCode lastError;
+			// last error of every thread that reported one
+			mutable std::map<std::thread::id, ErrorCode> lastErrors;
+			mutable std::mutex errorMutex;
+			bool pinnedHostMemory;
+			int threadCount;
+			mutable std::unique_ptr<ThreadPool> threadPool;
+			mutable std::mutex threadPoolMutex;
+			// transfer and allocation statistics, by data and devices
+			mutable std::map<std::pair<std::string, std::pair<int, int> >, TransferStatistics> transfers;
+			mutable std::map<std::pair<std::string, int>, AllocationStatistics> allocations;
+			mutable std::mutex statisticsMutex;
+			// tracing
+			OPI_TraceCallback traceCallback;
+			void* traceCallbackParameter;
+			std::chrono::steady_clock::time_point creationTime;
+			std::atomic<bool> tracing;
+			mutable std::mutex traceMutex;
+			mutable std::ofstream traceFile;
+			mutable bool traceFileEmpty;
+			// open operations and track number of every thread, for the trace file
+			mutable std::map<std::thread::id, std::vector<std::pair<std::string, double> > > traceStacks;
+			mutable std::map<std::thread::id, int> traceThreads;
 	};
 
 	//! \endcond
@@ -62,15 +140,32 @@ namespace OPI
 #endif
 
         impl->errorCallback = 0;
-		impl->lastError = SUCCESS;
 		impl->errorCallbackParameter = 0;
 
 		impl->gpuSupport = 0;
 		impl->gpuSupportPluginHandle = 0;
+		impl->gpuSupportPending = false;
+		impl->gpuSupportPlatform = PLATFORM_NONE;
+		impl->gpuSupportPlatformNumber = 0;
+		impl->gpuSupportDeviceNumber = 0;
+		impl->lazyPlugins = false;
+		impl->memoryCacheLimit = DEFAULT_MEMORY_CACHE_LIMIT;
+		impl->pinnedHostMemory = false;
+		impl->threadCount = 0;
+
+		impl->traceCallback = 0;
+		impl->traceCallbackParameter = 0;
+		impl->creationTime = std::chrono::steady_clock::now();
+		impl->tracing = false;
+		impl->traceFileEmpty = true;
+
+		// the built-in distance query is always available
+		addDistanceQuery(new GridDistanceQuery());
 	}
 
 	Host::~Host()
 	{
+		stopTraceFile();
 		// free every propagator
 		for(size_t i = 0; i < impl->propagagorlist.size(); ++i)
 		{
@@ -99,6 +194,8 @@ namespace OPI
 		// free all plugin handles
 		for(size_t i = 0; i < impl->pluginlist.size(); ++i)
 			delete impl->pluginlist[i];
+		for(size_t i = 0; i < impl->pendingPlugins.size(); ++i)
+			delete impl->pendingPlugins[i].plugin;
 #ifdef WIN32
         freopen("CON", "w", stdout);
 #endif
@@ -115,9 +212,293 @@ namespace OPI
 		impl->errorCallbackParameter = privatedata;
 	}
 
+	void Host::setTraceCallback(OPI_TraceCallback callback, void* privatedata)
+	{
+		std::lock_guard<std::mutex> lock(impl->traceMutex);
+		impl->traceCallback = callback;
+		impl->traceCallbackParameter = privatedata;
+		impl->tracing = (callback != 0) || impl->traceFile.is_open();
+	}
+
+	ErrorCode Host::startTraceFile(const char* filename)
+	{
+		stopTraceFile();
+		std::lock_guard<std::mutex> lock(impl->traceMutex);
+		impl->traceFile.open(filename);
+		if(!impl->traceFile.is_open()) {
+			sendError(INVALID_ARGUMENT);
+			return INVALID_ARGUMENT;
+		}
+		impl->traceFile << "{\"traceEvents\": [" << std::endl;
+		impl->traceFileEmpty = true;
+		impl->traceStacks.clear();
+		impl->tracing = true;
+		return SUCCESS;
+	}
+
+	void Host::stopTraceFile()
+	{
+		std::lock_guard<std::mutex> lock(impl->traceMutex);
+		if(impl->traceFile.is_open()) {
+			impl->traceFile << std::endl << "], \"displayTimeUnit\": \"ms\"}" << std::endl;
+			impl->traceFile.close();
+		}
+		impl->tracing = (impl->traceCallback != 0);
+	}
+
 	ErrorCode Host::getLastError() const
 	{
-		return impl->lastError;
+		std::lock_guard<std::mutex> lock(impl->errorMutex);
+		std::map<std::thread::id, ErrorCode>::const_iterator error = impl->lastErrors.find(std::this_thread::get_id());
+		return (error != impl->lastErrors.end()) ? error->second : SUCCESS;
+	}
+
+	void Host::setPinnedHostMemory(bool pinned)
+	{
+		impl->pinnedHostMemory = pinned;
+	}
+
+	bool Host::getPinnedHostMemory() const
+	{
+		return impl->pinnedHostMemory;
+	}
+
+	bool Host::getManagedMemory() const
+	{
+		if(impl->gpuSupportPlatform != PLATFORM_CUDA_MANAGED)
+			return false;
+		GpuSupport* gpu = getGPUSupport();
+		return gpu && gpu->supportsManagedMemory();
+	}
+
+	void Host::setMemoryCacheLimit(size_t bytes)
+	{
+		impl->memoryCacheLimit = bytes;
+		impl->hostMemoryPool.setLimit(bytes);
+		// a GPU support that is not loaded yet gets the limit when it is
+		if(!impl->gpuSupportPending && impl->gpuSupport)
+			impl->gpuSupport->setMemoryCacheLimit(bytes);
+	}
+
+	size_t Host::getMemoryCacheLimit() const
+	{
+		return impl->memoryCacheLimit;
+	}
+
+	void Host::releaseMemoryCache()
+	{
+		impl->hostMemoryPool.release();
+		if(!impl->gpuSupportPending && impl->gpuSupport)
+			impl->gpuSupport->releaseMemoryCache();
+	}
+
+	void Host::setDeviceMemoryLimit(size_t bytes)
+	{
+		impl->deviceMemoryBudget.setLimit(bytes);
+	}
+
+	size_t Host::getDeviceMemoryLimit() const
+	{
+		return impl->deviceMemoryBudget.getLimit();
+	}
+
+	std::vector<DeviceMemoryUsage> Host::getDeviceMemoryUsage() const
+	{
+		return impl->deviceMemoryBudget.getUsage();
+	}
+
+	void Host::setThreadCount(int numThreads)
+	{
+		std::lock_guard<std::mutex> lock(impl->threadPoolMutex);
+		impl->threadCount = std::max(0, numThreads);
+		// the pool is recreated with the new size on next use
+		impl->threadPool.reset();
+	}
+
+	int Host::getThreadCount() const
+	{
+		return getThreadPool().getThreadCount();
+	}
+
+	void Host::runParallel(int count, const std::function<void(int)>& body) const
+	{
+		getThreadPool().run(count, body);
+	}
+
+	std::vector<TransferStatistics> Host::getTransferStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(impl->statisticsMutex);
+		std::vector<TransferStatistics> result;
+		for(std::map<std::pair<std::string, std::pair<int, int> >, TransferStatistics>::const_iterator itr = impl->transfers.begin(); itr != impl->transfers.end(); ++itr)
+			result.push_back(itr->second);
+		return result;
+	}
+
+	std::vector<AllocationStatistics> Host::getAllocationStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(impl->statisticsMutex);
+		std::vector<AllocationStatistics> result;
+		for(std::map<std::pair<std::string, int>, AllocationStatistics>::const_iterator itr = impl->allocations.begin(); itr != impl->allocations.end(); ++itr)
+			result.push_back(itr->second);
+		return result;
+	}
+
+	void Host::resetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(impl->statisticsMutex);
+		impl->transfers.clear();
+		impl->allocations.clear();
+	}
+
+	// readable device name for the statistics log
+	static std::string deviceName(Device device)
+	{
+		if(device == DEVICE_HOST)
+			return "host";
+		if(device >= DEVICE_CUDA && device <= DEVICE_CUDA_LAST)
+			return "cuda" + std::to_string(device - DEVICE_CUDA);
+		return "device" + std::to_string(device);
+	}
+
+	void Host::logStatistics() const
+	{
+		std::vector<TransferStatistics> transfers = getTransferStatistics();
+		std::vector<AllocationStatistics> allocations = getAllocationStatistics();
+		std::cout << "OPI transfer statistics:" << std::endl;
+		for(size_t i = 0; i < transfers.size(); i++)
+			std::cout << "  " << transfers[i].data << " " << deviceName(transfers[i].source) << " -> " << deviceName(transfers[i].destination)
+					  << ": " << transfers[i].transfers << " copies, " << transfers[i].bytes << " bytes, "
+					  << transfers[i].milliseconds << " ms" << std::endl;
+		std::cout << "OPI allocation statistics:" << std::endl;
+		for(size_t i = 0; i < allocations.size(); i++)
+			std::cout << "  " << allocations[i].data << " " << deviceName(allocations[i].device)
+					  << ": " << allocations[i].allocations << " allocations, " << allocations[i].bytes << " bytes" << std::endl;
+	}
+
+	// quotes and backslashes in names must not end the JSON string
+	static std::string escapeJSON(const std::string& text)
+	{
+		std::string out;
+		for(size_t i = 0; i < text.size(); i++) {
+			if(text[i] == '"' || text[i] == '\\') out += '\\';
+			if((unsigned char)text[i] >= 0x20) out += text[i];
+		}
+		return out;
+	}
+
+	bool Host::isTracing() const
+	{
+		return impl->tracing;
+	}
+
+	double Host::getTraceTime() const
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - impl->creationTime).count();
+	}
+
+	void Host::trace(TracePhase phase, const char* operation, const char* module, int size, Device device, double timestamp) const
+	{
+		if(!impl->tracing) return;
+		if(timestamp < 0.0) timestamp = getTraceTime();
+		std::lock_guard<std::mutex> lock(impl->traceMutex);
+		if(impl->traceCallback)
+			impl->traceCallback(const_cast<Host*>(this), phase, operation, module, size, device, timestamp, impl->traceCallbackParameter);
+		if(!impl->traceFile.is_open()) return;
+		// operations are written as complete events when they end
+		std::vector<std::pair<std::string, double> >& stack = impl->traceStacks[std::this_thread::get_id()];
+		if(phase == TRACE_BEGIN) {
+			stack.push_back(std::make_pair(std::string(module ? module : "") + " " + operation, timestamp));
+			return;
+		}
+		if(stack.empty()) return;
+		std::map<std::thread::id, int>::iterator thread = impl->traceThreads.find(std::this_thread::get_id());
+		if(thread == impl->traceThreads.end())
+			thread = impl->traceThreads.insert(std::make_pair(std::this_thread::get_id(), (int)impl->traceThreads.size() + 1)).first;
+		if(!impl->traceFileEmpty) impl->traceFile << "," << std::endl;
+		impl->traceFileEmpty = false;
+		impl->traceFile << "{\"name\": \"" << escapeJSON(stack.back().first) << "\", \"cat\": \"" << escapeJSON(operation)
+						<< "\", \"ph\": \"X\", \"ts\": " << std::fixed << stack.back().second
+						<< ", \"dur\": " << (timestamp - stack.back().second) << std::defaultfloat
+						<< ", \"pid\": 1, \"tid\": " << thread->second
+						<< ", \"args\": {\"size\": " << size << ", \"device\": \"" << deviceName(device) << "\"}}";
+		stack.pop_back();
+	}
+
+	ThreadPool& Host::getThreadPool() const
+	{
+		std::lock_guard<std::mutex> lock(impl->threadPoolMutex);
+		if(!impl->threadPool)
+			impl->threadPool.reset(new ThreadPool(impl->threadCount));
+		return *impl->threadPool;
+	}
+
+	static void readPluginManifest(const std::string& fileName, std::map<std::string, PluginManifestEntry>& manifest)
+	{
+		std::ifstream in(fileName.c_str());
+		std::string line;
+		while(std::getline(in, line))
+		{
+			// a last line without newline is cut off, e.g. by a writer that did not finish
+			if(in.eof()) break;
+			if(line.empty() || line[0] == '#') continue;
+			// file name, modification time, size, type and plugin name, separated by tabs
+			std::istringstream fields(line);
+			std::string fileEntry, modified, size, type;
+			PluginManifestEntry entry;
+			if(std::getline(fields, fileEntry, '\t') && std::getline(fields, modified, '\t') &&
+			   std::getline(fields, size, '\t') && std::getline(fields, type, '\t'))
+			{
+				// unknown libraries have no name
+				if(!std::getline(fields, entry.name)) entry.name = "";
+				entry.modified = atoll(modified.c_str());
+				entry.size = atoll(size.c_str());
+				entry.type = atoi(type.c_str());
+				manifest[fileEntry] = entry;
+			}
+		}
+	}
+
+	static void writePluginManifest(const std::string& fileName, const std::map<std::string, PluginManifestEntry>& manifest)
+	{
+		// other jobs may read the manifest of a shared directory at any time, so it is written to
+		// a file of its own and renamed over the manifest, which they see complete or not at all
+		std::random_device random;
+		std::ostringstream tempName;
+		tempName << fileName << ".tmp." << std::hex << random() << random()
+				 << std::chrono::steady_clock::now().time_since_epoch().count();
+		const std::string tempFileName = tempName.str();
+		{
+			// the plugin directory may be read-only, the manifest is only a cache
+			std::ofstream out(tempFileName.c_str());
+			if(!out.is_open()) return;
+			out << "# OPI plugin manifest, regenerated by Host::loadPlugins in lazy mode" << std::endl;
+			for(std::map<std::string, PluginManifestEntry>::const_iterator itr = manifest.begin(); itr != manifest.end(); ++itr)
+				out << itr->first << '\t' << itr->second.modified << '\t' << itr->second.size << '\t'
+					<< itr->second.type << '\t' << itr->second.name << std::endl;
+			out.close();
+			if(out.fail()) {
+				std::remove(tempFileName.c_str());
+				return;
+			}
+		}
+		if(std::rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+#ifdef WIN32
+			// rename does not replace existing files on Windows
+			std::remove(fileName.c_str());
+			if(std::rename(tempFileName.c_str(), fileName.c_str()) == 0) return;
+#endif
+			std::remove(tempFileName.c_str());
+		}
+	}
+
+	void Host::setLazyPluginLoading(bool lazy)
+	{
+		impl->lazyPlugins = lazy;
+	}
+
+	bool Host::getLazyPluginLoading() const
+	{
+		return impl->lazyPlugins;
 	}
 
     ErrorCode Host::loadPlugins(const char* plugindir, gpuPlatform platformSupport, int platformNumber, int deviceNumber)
@@ -126,47 +507,25 @@ namespace OPI
 		std::cout << "Loading plugins from " << plugindir << std::endl;
         std::string suffix = DynLib::getSuffix();
 
-		// check if the cuda support plugin is loaded
-		if(impl->gpuSupport == 0 && platformSupport != PLATFORM_NONE)
+		// remember the support library, it is loaded on the first request for a device
+		if(impl->gpuSupport == 0 && !impl->gpuSupportPending && platformSupport != PLATFORM_NONE)
 		{
-			// try to load cuda plugin
 			std::string pluginName = (platformSupport == PLATFORM_OPENCL ? "OPI-cl" : "OPI-cuda");
-			std::string gpuFrameworkName = (platformSupport == PLATFORM_OPENCL ? "OpenCL" : "CUDA");
-            std::string libraryFileName = std::string(plugindir) + "/support/" + pluginName + suffix;
-			std::cout << "Loading support library " << libraryFileName << std::endl;
-
-			impl->gpuSupportPluginHandle = new DynLib(libraryFileName, true);
-			if(impl->gpuSupportPluginHandle)
-			{
-				procCreateGpuSupport proc_create_support = (procCreateGpuSupport)impl->gpuSupportPluginHandle->loadFunction("createGpuSupport");
-				if(proc_create_support)
-				{
-					// plugin successfully loaded
-					impl->gpuSupport = proc_create_support();
-                    impl->gpuSupport->init(platformNumber, deviceNumber);
-				}
-				else {
-					platformSupport = PLATFORM_NONE;
-#ifdef WIN32
-					DWORD errorMessageID = ::GetLastError();
-					LPSTR messageBuffer = nullptr;
-					size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-						NULL, errorMessageID, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, NULL);
-
-					std::string message(messageBuffer, size);
-#else
-					std::string message = "";
-#endif
-					std::cout << "[OPI] Unable to load GPU support library. " << message << std::endl;
-				}
-			}
-			else {
-				platformSupport = PLATFORM_NONE;
-				std::cout << "[OPI] Cannot find GPU support library (" << libraryFileName << ")."<< std::endl
-					<< "Check your path and make sure your " << gpuFrameworkName << " drivers are installed correctly." << std::endl;
-			}
+			impl->gpuSupportFileName = std::string(plugindir) + "/support/" + pluginName + suffix;
+			impl->gpuSupportPlatform = platformSupport;
+			impl->gpuSupportPlatformNumber = platformNumber;
+			impl->gpuSupportDeviceNumber = deviceNumber;
+			impl->gpuSupportPending = true;
 		}
 
+		// in lazy mode, plugins that did not change since the last run are known from the manifest
+		const std::string manifestFileName = std::string(plugindir) + "/" + PLUGIN_MANIFEST_NAME;
+		std::map<std::string, PluginManifestEntry> manifest;
+		std::map<std::string, PluginManifestEntry> currentManifest;
+		bool manifestChanged = false;
+		if(impl->lazyPlugins)
+			readPluginManifest(manifestFileName, manifest);
+
 		// now load all plugins from plugindir
         DIR* dir = opendir(plugindir);
 		// check if plugindir is a directory
@@ -182,24 +541,64 @@ namespace OPI
                    entry_name.substr(entry_name.find_last_of("."), suffix.length()) == suffix
                   )
 				{
-					// try to load the plugin
                     std::string pluginpath = std::string(plugindir) + "/" + entry_name;
-                    DynLib* lib = new DynLib(pluginpath);
-					if(lib->isValid()) {
-						// if it is valid load the plugin
-						Plugin* plugin = new Plugin(lib);
-						impl->pluginlist.push_back(plugin);
-                        std::string configFileName = "";
-                        if (entry_name.find_last_of(".") != std::string::npos)
-                        {
-                            configFileName = std::string(plugindir) + "/" + entry_name.substr(0,entry_name.find_last_of(".")) + ".cfg";
-                        }
-
-                        std::cout << "Found " << getPluginTypeString(plugin->getInfo().type) << " " << plugin->getInfo().name << " (" << pluginpath << ")" << std::endl;
-                        loadPlugin(plugin,platformSupport,configFileName.c_str());
+                    std::string configFileName = std::string(plugindir) + "/" + entry_name.substr(0,entry_name.find_last_of(".")) + ".cfg";
+					if(impl->lazyPlugins)
+					{
+						PendingPlugin pending;
+						pending.path = pluginpath;
+						pending.configFile = configFileName;
+						pending.platform = platformSupport;
+						pending.plugin = 0;
+
+						struct stat fileStatus;
+						PluginManifestEntry entry;
+						entry.modified = (stat(pluginpath.c_str(), &fileStatus) == 0) ? (long long)fileStatus.st_mtime : -1;
+						entry.size = (entry.modified >= 0) ? (long long)fileStatus.st_size : -1;
+						std::map<std::string, PluginManifestEntry>::iterator known = manifest.find(entry_name);
+						if(known != manifest.end() && entry.modified >= 0 &&
+						   known->second.modified == entry.modified && known->second.size == entry.size)
+							entry = known->second;
+						else
+						{
+							// new or changed library, read its information once
+							entry.type = OPI_UNKNOWN_PLUGIN;
+							entry.name = "";
+							DynLib* lib = new DynLib(pluginpath);
+							if(lib->isValid()) {
+								pending.plugin = new Plugin(lib);
+								entry.type = pending.plugin->getInfo().type;
+								entry.name = std::string(pending.plugin->getInfo().name, pending.plugin->getInfo().name_len);
+							}
+							else
+								delete lib;
+							manifestChanged = true;
+						}
+						currentManifest[entry_name] = entry;
+						pending.type = entry.type;
+						pending.name = entry.name;
+						if(pending.type != OPI_UNKNOWN_PLUGIN) {
+							std::cout << "Found " << getPluginTypeString(pending.type) << " " << pending.name << " (" << pluginpath << "), loading on demand" << std::endl;
+							std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+							impl->pendingPlugins.push_back(pending);
+						}
+						else
+							delete pending.plugin;
 					}
 					else
-						delete lib;
+					{
+						// try to load the plugin
+						DynLib* lib = new DynLib(pluginpath);
+						if(lib->isValid()) {
+							// if it is valid load the plugin
+							Plugin* plugin = new Plugin(lib);
+							impl->pluginlist.push_back(plugin);
+							std::cout << "Found " << getPluginTypeString(plugin->getInfo().type) << " " << plugin->getInfo().name << " (" << pluginpath << ")" << std::endl;
+							loadPlugin(plugin,platformSupport,configFileName.c_str());
+						}
+						else
+							delete lib;
+					}
 				}
 			}
 			// close the directory handle
@@ -210,11 +609,41 @@ namespace OPI
 			status = DIRECTORY_NOT_FOUND;
 		}
 
+		if(impl->lazyPlugins && status == SUCCESS && (manifestChanged || currentManifest.size() != manifest.size()))
+			writePluginManifest(manifestFileName, currentManifest);
+
 		// forward the error message
 		sendError(status);
 		return status;
 	}
 
+	void Host::loadPendingPlugins(int pluginType, const char* name) const
+	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		Host* host = const_cast<Host*>(this);
+		for(size_t i = 0; i < impl->pendingPlugins.size(); )
+		{
+			PendingPlugin pending = impl->pendingPlugins[i];
+			if(pending.type != pluginType || (name && pending.name != name)) {
+				++i;
+				continue;
+			}
+			impl->pendingPlugins.erase(impl->pendingPlugins.begin() + i);
+			Plugin* plugin = pending.plugin;
+			if(!plugin) {
+				DynLib* lib = new DynLib(pending.path);
+				if(!lib->isValid()) {
+					delete lib;
+					continue;
+				}
+				plugin = new Plugin(lib);
+			}
+			impl->pluginlist.push_back(plugin);
+			std::cout << "Loading " << host->getPluginTypeString(pluginType) << " " << pending.name << " (" << pending.path << ")" << std::endl;
+			host->loadPlugin(plugin, pending.platform, pending.configFile.c_str());
+		}
+	}
+
     std::string Host::getPluginTypeString(int pluginType)
     {
         switch (pluginType)
@@ -262,7 +691,7 @@ namespace OPI
             support = true;
         }
         else if (plugin->requiresCUDA() > 0) {
-            if (platform != PLATFORM_CUDA) {
+            if ((platform != PLATFORM_CUDA && platform != PLATFORM_CUDA_MANAGED) || !getGPUSupport()) {
                 std::cout << plugin->getName()
                 << ": Skipped - no CUDA support available." << std::endl;
                 support = false;
@@ -287,7 +716,7 @@ namespace OPI
             }
         }
         else if (plugin->requiresOpenCL() > 0) {
-            if (platform == PLATFORM_OPENCL) {
+            if (platform == PLATFORM_OPENCL && getGPUSupport()) {
                 support = true;
             }
             else {
@@ -365,16 +794,24 @@ namespace OPI
 
     Propagator* Host::getPropagator(const char* name) const
 	{        
-		for(size_t i = 0; i < impl->propagagorlist.size(); ++i)
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		for(int attempt = 0; attempt < 2; ++attempt)
 		{
-            if(strcmp(impl->propagagorlist[i]->getName(),name) == 0)
-				return impl->propagagorlist[i];
+			for(size_t i = 0; i < impl->propagagorlist.size(); ++i)
+			{
+				if(strcmp(impl->propagagorlist[i]->getName(),name) == 0)
+					return impl->propagagorlist[i];
+			}
+			// not loaded yet?
+			if(attempt == 0) loadPendingPlugins(OPI_PROPAGATOR_PLUGIN, name);
 		}
 		return 0;
 	}
 
 	Propagator* Host::getPropagator(int index) const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_PROPAGATOR_PLUGIN, 0);
 		if((index < 0)||(index >= static_cast<int>(impl->propagagorlist.size())))
 		{
 			sendError(INDEX_RANGE);
@@ -385,78 +822,96 @@ namespace OPI
 
 	int Host::getPropagatorCount() const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_PROPAGATOR_PLUGIN, 0);
 		return static_cast<int>(impl->propagagorlist.size());
 	}
 
 	int Host::getCudaDeviceCount() const
 	{
-		if(!impl->gpuSupport)
+		GpuSupport* gpu = getGPUSupport();
+		if(!gpu)
 			return 0;
-		return impl->gpuSupport->getDeviceCount();
+		return gpu->getDeviceCount();
 	}
 	
 	int Host::selectCudaDevice(int deviceNumber) const
 	{
-		if(!impl->gpuSupport) {
+		GpuSupport* gpu = getGPUSupport();
+		if(!gpu) {
 			return -1;
 		}
 		else {
-			impl->gpuSupport->selectDevice(deviceNumber);
+			gpu->selectDevice(deviceNumber);
 			return 0;
 		}
 	}
 
 	std::string Host::getCurrentCudaDeviceName() const
 	{
-		if(!impl->gpuSupport) {
+		GpuSupport* gpu = getGPUSupport();
+		if(!gpu) {
 			return std::string("No CUDA device available.");
 		}
-		return impl->gpuSupport->getCurrentDeviceName();
+		return gpu->getCurrentDeviceName();
 	}
 
 	int Host::getCurrentCudaDeviceCapability() const
 	{
-		if(!impl->gpuSupport) {
+		GpuSupport* gpu = getGPUSupport();
+		if(!gpu) {
 			return 0;
 		}
-		return impl->gpuSupport->getCurrentDeviceCapability();
+		return gpu->getCurrentDeviceCapability();
 	}
 
 	void Host::addPropagator(Propagator *propagator)
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
 		propagator->setHost(this);
 		impl->propagagorlist.push_back(propagator);
 	}
 
 	void Host::addDistanceQuery(DistanceQuery *query)
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
 		query->setHost(this);
 		impl->querylist.push_back(query);
 	}
 
 	int Host::getDistanceQueryCount() const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_DISTANCE_QUERY_PLUGIN, 0);
 		return impl->querylist.size();
 	}
 
 	void Host::addCollisionDetection(CollisionDetection *module)
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
 		module->setHost(this);
 		impl->detectionlist.push_back(module);
 	}
 
     CollisionDetection* Host::getCollisionDetection(const char* name) const
 	{
-		for(size_t i = 0; i < impl->detectionlist.size(); ++i)
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		for(int attempt = 0; attempt < 2; ++attempt)
 		{
-            if(strcmp(impl->detectionlist[i]->getName(), name) == 0)
-				return impl->detectionlist[i];
+			for(size_t i = 0; i < impl->detectionlist.size(); ++i)
+			{
+				if(strcmp(impl->detectionlist[i]->getName(), name) == 0)
+					return impl->detectionlist[i];
+			}
+			if(attempt == 0) loadPendingPlugins(OPI_COLLISION_DETECTION_PLUGIN, name);
 		}
 		return 0;
 	}
 
 	CollisionDetection* Host::getCollisionDetection(int index) const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_COLLISION_DETECTION_PLUGIN, 0);
 		if((index < 0)||(index >= static_cast<int>(impl->detectionlist.size())))
 		{
 			sendError(INDEX_RANGE);
@@ -467,28 +922,37 @@ namespace OPI
 
 	int Host::getCollisionDetectionCount() const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_COLLISION_DETECTION_PLUGIN, 0);
 		return impl->detectionlist.size();
 	}
 
 	bool Host::hasCUDASupport() const
 	{
-		if(impl->gpuSupport)
+		if(getGPUSupport())
 			return getCudaDeviceCount() > 0;
 		return false;
 	}
 
     DistanceQuery* Host::getDistanceQuery(const char* name) const
 	{
-		for(size_t i = 0; i < impl->querylist.size(); ++i)
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		for(int attempt = 0; attempt < 2; ++attempt)
 		{
-            if(strcmp(impl->querylist[i]->getName(),name) == 0)
-				return impl->querylist[i];
+			for(size_t i = 0; i < impl->querylist.size(); ++i)
+			{
+				if(strcmp(impl->querylist[i]->getName(),name) == 0)
+					return impl->querylist[i];
+			}
+			if(attempt == 0) loadPendingPlugins(OPI_DISTANCE_QUERY_PLUGIN, name);
 		}
 		return 0;
 	}
 
 	DistanceQuery* Host::getDistanceQuery(int index) const
 	{
+		std::lock_guard<std::recursive_mutex> lock(impl->pluginMutex);
+		loadPendingPlugins(OPI_DISTANCE_QUERY_PLUGIN, 0);
 		if((index < 0)||(index >= static_cast<int>(impl->querylist.size())))
 		{
 			sendError(INDEX_RANGE);
@@ -504,14 +968,76 @@ namespace OPI
 		return prop;
 	}
 
+	SplitPropagator* Host::createSplitPropagator(const char* name, Propagator* devicePropagator, Propagator* hostPropagator)
+	{
+		SplitPropagator* prop = new SplitPropagator(name, devicePropagator, hostPropagator);
+		addPropagator(prop);
+		return prop;
+	}
+
 	/**
 	 * \cond INTERNAL_DOCUMENTATION
 	 */
 	GpuSupport* Host::getGPUSupport() const
 	{
+		// the support library is loaded and initialized on the first request
+		if(impl->gpuSupportPending)
+			loadGPUSupport();
 		return impl->gpuSupport;
 	}
 
+	void Host::loadGPUSupport() const
+	{
+		std::lock_guard<std::mutex> lock(impl->gpuSupportMutex);
+		if(!impl->gpuSupportPending)
+			return;
+		const bool opencl = (impl->gpuSupportPlatform == PLATFORM_OPENCL);
+		std::string gpuFrameworkName = (opencl ? "OpenCL" : "CUDA");
+		std::cout << "Loading support library " << impl->gpuSupportFileName << std::endl;
+
+		impl->gpuSupportPluginHandle = new DynLib(impl->gpuSupportFileName, true);
+		if(impl->gpuSupportPluginHandle)
+		{
+			procCreateGpuSupport proc_create_support = (procCreateGpuSupport)impl->gpuSupportPluginHandle->loadFunction("createGpuSupport");
+			if(proc_create_support)
+			{
+				// plugin successfully loaded
+				GpuSupport* gpu = proc_create_support();
+				gpu->init(impl->gpuSupportPlatformNumber, impl->gpuSupportDeviceNumber);
+				gpu->setMemoryCacheLimit(impl->memoryCacheLimit);
+				impl->gpuSupport = gpu;
+			}
+			else {
+#ifdef WIN32
+				DWORD errorMessageID = ::GetLastError();
+				LPSTR messageBuffer = nullptr;
+				size_t size = FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+					NULL, errorMessageID, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&messageBuffer, 0, NULL);
+
+				std::string message(messageBuffer, size);
+#else
+				std::string message = "";
+#endif
+				std::cout << "[OPI] Unable to load GPU support library. " << message << std::endl;
+			}
+		}
+		else {
+			std::cout << "[OPI] Cannot find GPU support library (" << impl->gpuSupportFileName << ")."<< std::endl
+				<< "Check your path and make sure your " << gpuFrameworkName << " drivers are installed correctly." << std::endl;
+		}
+		impl->gpuSupportPending = false;
+	}
+
+
+	HostMemoryPool& Host::getHostMemoryPool() const
+	{
+		return impl->hostMemoryPool;
+	}
+
+	DeviceMemoryBudget& Host::getDeviceMemoryBudget() const
+	{
+		return impl->deviceMemoryBudget;
+	}
 
 	void Host::sendError(ErrorCode code) const
 	{
@@ -519,14 +1045,46 @@ namespace OPI
 		{
 			if(impl->errorCallback)
 				impl->errorCallback((void*)(this), code, impl->errorCallbackParameter);
-			impl->lastError = code;
+			std::lock_guard<std::mutex> lock(impl->errorMutex);
+			impl->lastErrors[std::this_thread::get_id()] = code;
+		}
+	}
+
+	void Host::recordTransfer(const std::string& data, Device source, Device destination, size_t bytes, double milliseconds) const
+	{
+		std::lock_guard<std::mutex> lock(impl->statisticsMutex);
+		TransferStatistics& entry = impl->transfers[std::make_pair(data, std::make_pair((int)source, (int)destination))];
+		if(entry.data.empty()) {
+			entry.data = data;
+			entry.source = source;
+			entry.destination = destination;
+			entry.transfers = 0;
+			entry.bytes = 0;
+			entry.milliseconds = 0.0;
+		}
+		entry.transfers++;
+		entry.bytes += bytes;
+		entry.milliseconds += milliseconds;
+	}
+
+	void Host::recordAllocation(const std::string& data, Device device, size_t bytes) const
+	{
+		std::lock_guard<std::mutex> lock(impl->statisticsMutex);
+		AllocationStatistics& entry = impl->allocations[std::make_pair(data, (int)device)];
+		if(entry.data.empty()) {
+			entry.data = data;
+			entry.device = device;
+			entry.allocations = 0;
+			entry.bytes = 0;
 		}
+		entry.allocations++;
+		entry.bytes += bytes;
 	}
 
 	cudaDeviceProp* Host::getCUDAProperties(int device) const
 	{
         if(hasCUDASupport())
-			return impl->gpuSupport->getDeviceProperties(device);
+			return getGPUSupport()->getDeviceProperties(device);
 		return 0;
 	}
 
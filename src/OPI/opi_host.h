@@ -16,6 +16,7 @@
  */
 #ifndef OPI_HOST_CPP_H
 #define OPI_HOST_CPP_H
+#include <functional>
 #include <string>
 #include <vector>
 #include "opi_common.h"
@@ -28,6 +29,7 @@ struct cudaDeviceProp;
 namespace OPI
 {
 	class CustomPropagator;
+	class SplitPropagator;
 	class Propagator;
 	class PerturbationModule;
 	class PropagatorIntegrator;
@@ -36,10 +38,79 @@ namespace OPI
 	class GpuSupport;
 	class DynLib;
 	class CollisionDetection;
+	class ThreadPool;
+	class HostMemoryPool;
+	class DeviceMemoryBudget;
 
 	//! Internal implementation data for the Host
 	class HostImpl;
 
+	class Host;
+
+	//! Phase of a traced operation, see Host::setTraceCallback()
+	enum TracePhase
+	{
+		TRACE_BEGIN = 0,
+		TRACE_END = 1
+	};
+
+	//! \brief Receives the begin and end of traced operations, see Host::setTraceCallback()
+	/** operation is e.g. "propagate", "calculate", "rebuild", "query", "detectPairs" or "transfer",
+	 * module the name of the module (or of the data for transfers), size the number of objects,
+	 * device the device the operation runs on, and timestamp the time in microseconds since the
+	 * Host was created. Begin and end of an operation are reported on the same thread.
+	 * \ingroup CPP_API_GROUP
+	 */
+	typedef void (*OPI_TraceCallback)(Host* host, TracePhase phase, const char* operation, const char* module, int size, Device device, double timestamp, void* privatedata);
+
+	//! \brief Transfers of one kind of data between two devices, see Host::getTransferStatistics()
+	//! \ingroup CPP_API_GROUP
+	struct TransferStatistics
+	{
+		//! The data that was transferred, e.g. "Orbit" or "IndexPairList"
+		std::string data;
+		//! The device the data was copied from
+		Device source;
+		//! The device the data was copied to
+		Device destination;
+		//! Number of copies
+		int transfers;
+		//! Number of bytes copied
+		long long bytes;
+		//! Time spent in the copy calls; prefetches only account for issuing the copy
+		double milliseconds;
+	};
+
+	//! \brief Device memory allocations for one kind of data, see Host::getAllocationStatistics()
+	//! \ingroup CPP_API_GROUP
+	struct AllocationStatistics
+	{
+		//! The data the memory was allocated for
+		std::string data;
+		//! The device the memory was allocated on
+		Device device;
+		//! Number of allocations
+		int allocations;
+		//! Number of bytes allocated
+		long long bytes;
+	};
+
+	//! \brief Device memory currently held by one field of a data object, see Host::getDeviceMemoryUsage()
+	//! \ingroup CPP_API_GROUP
+	struct DeviceMemoryUsage
+	{
+		//! Identifies the object the field belongs to, e.g. a Population; fields of one object share it
+		const void* owner;
+		//! The field, e.g. "Orbit" or "PerturbationPosition"
+		std::string data;
+		//! The device holding the memory
+		Device device;
+		//! Number of bytes held
+		long long bytes;
+		//! If the device holds data that the host memory does not have yet
+		bool newerThanHost;
+	};
+
 	/*!
 	 * \brief The Host loads and manages one or multiple Propagator Plugins.
 	 *
@@ -50,6 +121,16 @@ namespace OPI
 	 * When using C++, an instance of the Host class would be the part of your application responsible
 	 * for orbital propagation. The Host keeps a list of available propagators (usually loaded from
 	 * shared objects) and provides access to them.
+	 *
+	 * \par Thread safety
+	 * Load plugins and configure the Host before other threads start using it. After that,
+	 * different Populations (and other data objects) may be used from different threads at the
+	 * same time, e.g. one worker thread per GPU: the GPU device is selected per thread, the
+	 * synchronization state of every data object is locked, and getLastError() reports the
+	 * errors of the calling thread. The error callback is invoked on the thread the error occurred on.
+	 * A single Population can safely be accessed by several threads, but the memory returned by
+	 * its getters is not protected, and a Propagator instance is only safe to use from several
+	 * threads if it is reentrant().
 	 */
 	class Host
 	{
@@ -62,7 +143,9 @@ namespace OPI
 			enum gpuPlatform {
 				PLATFORM_NONE,
 				PLATFORM_CUDA,
-				PLATFORM_OPENCL
+				PLATFORM_OPENCL,
+				//! CUDA support with all data objects in managed memory, see getManagedMemory()
+				PLATFORM_CUDA_MANAGED
 			};
 
 			//! Check whether CUDA is supported on the current hardware.
@@ -73,13 +156,49 @@ namespace OPI
 			 * DistanceQuery, CollisionDetection (including the C and Fortran equivalents thereof),
 			 * or any other shared object that implements the Module interface.
 			 * The parameter platformSupport states whether support for CUDA (default) or OpenCL should be loaded.
+			 * PLATFORM_CUDA_MANAGED loads the CUDA support and keeps all data in managed memory.
+			 * The GPU support library is only loaded and initialized on the first request for a device,
+			 * e.g. by a GPU plugin, hasCUDASupport() or Population data on a GPU.
+			 * \see setLazyPluginLoading
 			 * \returns an ErrorCode containing information on any errors that occurred during the operation.
 			 */
             OPI_API_EXPORT ErrorCode loadPlugins(const char* plugindir, gpuPlatform platformSupport = PLATFORM_NONE, int platformNumber = 0, int deviceNumber = 0);
 
+			//! Sets whether loadPlugins defers loading plugins until they are requested
+			/** In lazy mode, loadPlugins only determines the name and type of every plugin. The
+			 * result is cached in a manifest file (opi_plugins.manifest) in the plugin directory, so
+			 * libraries that did not change since the last run are not opened at all. A plugin is
+			 * loaded on the first request for a module of its type: a request by name only loads the
+			 * plugin of that name, requests by index or count load all plugins of the type.
+			 * Lazy mode is disabled by default and affects subsequent calls to loadPlugins.
+			 */
+			OPI_API_EXPORT void setLazyPluginLoading(bool lazy);
+
+			//! Returns whether loadPlugins defers loading plugins until they are requested
+			OPI_API_EXPORT bool getLazyPluginLoading() const;
+
 			//! Sets an error callback for this host.
+			/** The callback may be invoked from any thread using this host. */
 			OPI_API_EXPORT void setErrorCallback(OPI_ErrorCallback callback, void* privatedata);
 
+			//! Sets a callback that is invoked at the begin and end of traced operations
+			/** Propagator::propagate, PerturbationModule::calculate, DistanceQuery::rebuild and
+			 * queryCubicPairs, CollisionDetection::detectPairs and
+			 * detectConjunctions and all data transfers are traced.
+			 * The callback may be invoked from any thread using this host; pass 0 to disable it.
+			 */
+			OPI_API_EXPORT void setTraceCallback(OPI_TraceCallback callback, void* privatedata);
+
+			//! Writes all traced operations to a file in the Chrome trace event format
+			/** The file can be opened with chrome://tracing or Perfetto. Every thread gets its own
+			 * track. Tracing to the file stops with stopTraceFile() or when the Host is destroyed.
+			 * \returns INVALID_ARGUMENT if the file cannot be opened.
+			 */
+			OPI_API_EXPORT ErrorCode startTraceFile(const char* filename);
+
+			//! Completes and closes the trace file
+			OPI_API_EXPORT void stopTraceFile();
+
 			//! Returns the number of available CUDA devices
 			OPI_API_EXPORT int getCudaDeviceCount() const;
 
@@ -95,6 +214,95 @@ namespace OPI
 			//! Returns the major capability number of the currently selected CUDA device.
 			OPI_API_EXPORT int getCurrentCudaDeviceCapability() const;
 
+			//! Sets whether Populations created by this host use page-locked host memory.
+			/** Page-locked (pinned) memory allows faster transfers to and from the GPU but is a
+			 * limited system resource. The setting applies to Populations, Perturbations and
+			 * index lists created afterwards and requires the GPU support to be loaded.
+			 * \see Population::setPinnedHostMemory
+			 */
+			OPI_API_EXPORT void setPinnedHostMemory(bool pinned);
+
+			//! Returns whether new Populations use page-locked host memory by default.
+			OPI_API_EXPORT bool getPinnedHostMemory() const;
+
+			//! Returns whether the data objects of this host are allocated in CUDA managed memory.
+			/** This is the case if the plugins were loaded with PLATFORM_CUDA_MANAGED and the
+			 * support library provides managed memory. Every field is then allocated once and the
+			 * host and all devices access it through the same pointer; synchronizing the data only
+			 * migrates its pages with prefetch hints instead of copying it. This suits systems with
+			 * coherent host and device memory. Pinned host memory has no effect in this mode.
+			 */
+			OPI_API_EXPORT bool getManagedMemory() const;
+
+			//! Sets how much freed memory the host keeps for reuse by new data objects
+			/** Memory released by Populations, Perturbations and index lists is cached by size
+			 * and handed out again to later allocations of similar size, so short-lived objects
+			 * do not pay for cudaMalloc, cudaFree or fresh pages every time. The limit applies to
+			 * each cache separately: large pageable host buffers, and GPU plus page-locked memory
+			 * in the GPU support. The default is 512 MB; zero disables caching.
+			 */
+			OPI_API_EXPORT void setMemoryCacheLimit(size_t bytes);
+
+			//! Returns the maximum number of bytes kept in each memory cache
+			OPI_API_EXPORT size_t getMemoryCacheLimit() const;
+
+			//! Frees all memory kept in the memory caches
+			OPI_API_EXPORT void releaseMemoryCache();
+
+			//! Limits the device memory held by Populations, Perturbations and index lists
+			/** Before a data object allocates device memory beyond the limit, the device copies
+			 * of the least recently used other objects are released; copies holding data that is
+			 * newer than the host memory are copied to the host first. Fields of the same object
+			 * are never released for each other, so the limit should leave room for the data one
+			 * propagation step uses, and device pointers of other objects must not be kept across
+			 * calls that may allocate. Memory in the GPU memory cache is not counted. The default
+			 * is zero, which sets no limit.
+			 */
+			OPI_API_EXPORT void setDeviceMemoryLimit(size_t bytes);
+
+			//! Returns the limit of device memory held by data objects, zero if there is none
+			OPI_API_EXPORT size_t getDeviceMemoryLimit() const;
+
+			//! Returns the device memory currently held by every field of every data object
+			/** Populations report their own fields with Population::getDeviceMemoryUsage(). A field
+			 * that another thread is using at the same time is reported as a single entry for the
+			 * device it was accessed on last, with newerThanHost set to false.
+			 */
+			OPI_API_EXPORT std::vector<DeviceMemoryUsage> getDeviceMemoryUsage() const;
+
+			//! Sets the number of threads the host uses for parallel work on the CPU.
+			/** This includes the thread calling into OPI. Set to zero (the default) to use one
+			 * thread per hardware thread. Must not be called while a parallel operation is running.
+			 * \see Propagator::propagateParallel
+			 */
+			OPI_API_EXPORT void setThreadCount(int numThreads);
+
+			//! Returns the number of threads the host uses for parallel work on the CPU.
+			OPI_API_EXPORT int getThreadCount() const;
+
+			//! Calls body(i) for every i in [0, count) on the host's threads and waits for all calls
+			/** The calling thread takes part, so this can be called from within another parallel
+			 * operation, e.g. by a plugin running under Propagator::propagateParallel, without
+			 * starting additional threads. The calls may run concurrently and in any order.
+			 */
+			OPI_API_EXPORT void runParallel(int count, const std::function<void(int)>& body) const;
+
+			//! Returns the transfers made by all data objects of this host since the last reset
+			/** Every data object (Population field, Perturbations field, index list) counts the
+			 * copies made during synchronization, so hidden back and forth copies between host and
+			 * GPU show up here. There is one entry per kind of data and pair of devices.
+			 */
+			OPI_API_EXPORT std::vector<TransferStatistics> getTransferStatistics() const;
+
+			//! Returns the device memory allocations of all data objects of this host since the last reset
+			OPI_API_EXPORT std::vector<AllocationStatistics> getAllocationStatistics() const;
+
+			//! Clears the transfer and allocation statistics
+			OPI_API_EXPORT void resetStatistics();
+
+			//! Prints the transfer and allocation statistics to the standard output, i.e. the log file if logToFile() is used
+			OPI_API_EXPORT void logStatistics() const;
+
 			//! Get a Propagator by index.
 			/** After loading the available plugins this function can
 			 * be used to get the Propagator with the given index. Indices are assigned in the order
@@ -138,6 +346,15 @@ namespace OPI
 			 */
             OPI_API_EXPORT CustomPropagator* createCustomPropagator(const char* name);
 
+			//! Adds a SplitPropagator with the given name to the list of available Propagators.
+			/** The SplitPropagator propagates complementary slices of every Population with the
+			 * devicePropagator and, on all threads of the Host, with the hostPropagator at the
+			 * same time. The split adapts to the throughput measured in previous propagations.
+			 * \see SplitPropagator
+			 * \returns a new instance of a SplitPropagator.
+			 */
+			OPI_API_EXPORT SplitPropagator* createSplitPropagator(const char* name, Propagator* devicePropagator, Propagator* hostPropagator);
+
             /* NOT YET IMPLEMENTED
 			//! Find a propagator module by name, returns 0 (null pointer) if not found
             PerturbationModule* getPerturbationModule(const char* name) const;
@@ -162,6 +379,7 @@ namespace OPI
 			//! Returns an distance query module by index, returns 0 (null pointer) if not found
 			OPI_API_EXPORT DistanceQuery* getDistanceQuery(int index) const;
 			//! Returns the number of known distance queries
+			/** This includes the built-in GridDistanceQuery "UniformGrid", which comes first. */
 			OPI_API_EXPORT int getDistanceQueryCount() const;
 
 			//! Adds and registers a Collision Detection module
@@ -174,18 +392,39 @@ namespace OPI
 			OPI_API_EXPORT int getCollisionDetectionCount() const;
 
 
-			//! Returns the code of the last occured Error of this host or its plugins
+			//! Returns the code of the last error of this host or its plugins on the calling thread
 			OPI_API_EXPORT ErrorCode getLastError() const;
 
 			//! \cond INTERNAL_DOCUMENTATION
 
 			//! Returns the CUDA Support object
 			OPI_API_EXPORT GpuSupport* getGPUSupport() const;
+
+			//! Returns the cache for pageable host memory of data objects
+			OPI_API_EXPORT HostMemoryPool& getHostMemoryPool() const;
+			//! Returns the device memory budget shared by all data objects
+			OPI_API_EXPORT DeviceMemoryBudget& getDeviceMemoryBudget() const;
 			//! Returns cuda device properties
 			OPI_API_EXPORT cudaDeviceProp* getCUDAProperties(int device = 0) const;
 
+			//! Returns the thread pool for parallel work on the CPU, creating it on first use
+			OPI_API_EXPORT ThreadPool& getThreadPool() const;
+
 			//! Sends an error through the registered callback
 			OPI_API_EXPORT void sendError(ErrorCode code) const;
+
+			//! Adds a copy of the given data to the transfer statistics
+			OPI_API_EXPORT void recordTransfer(const std::string& data, Device source, Device destination, size_t bytes, double milliseconds) const;
+			//! Adds an allocation for the given data to the allocation statistics
+			OPI_API_EXPORT void recordAllocation(const std::string& data, Device device, size_t bytes) const;
+
+			//! Returns true if a trace callback or trace file is set
+			OPI_API_EXPORT bool isTracing() const;
+			//! Returns the current time in microseconds since the creation of the Host
+			OPI_API_EXPORT double getTraceTime() const;
+			//! Reports the begin or end of an operation to the trace callback and file
+			/** If timestamp is negative, the current time is used. */
+			OPI_API_EXPORT void trace(TracePhase phase, const char* operation, const char* module, int size, Device device, double timestamp = -1.0) const;
 			//! \endcond
 		private:
 			Host(const Host& other);
@@ -193,6 +432,10 @@ namespace OPI
             void loadPlugin(Plugin* plugin, gpuPlatform platform, const char* configfile);
             bool pluginSupported(Module *plugin, gpuPlatform platform);
             std::string getPluginTypeString(int pluginType);
+			//! Loads and initializes the GPU support library requested by loadPlugins
+			void loadGPUSupport() const;
+			//! Loads the deferred plugins of the given type, or only the one with the given name
+			void loadPendingPlugins(int pluginType, const char* name) const;
 			Pimpl<HostImpl> impl;
 	};
 }
@@ -15,6 +15,8 @@
  * License along with this library.
  */
 #include "opi_indexlist.h"
+#include "opi_host.h"
+#include "opi_gpusupport.h"
 #include "internal/opi_synchronized_data.h"
 namespace OPI
 {
@@ -24,7 +26,28 @@ namespace OPI
 	class IndexListImpl
 	{
 		public:
-			IndexListImpl(Host& host): data(host) {}
+			IndexListImpl(Host& host): host(host), data(host, "IndexList", this) {}
+
+			// sorts the list on the device holding the latest data, returns false if this is not possible
+			bool sortOnDevice(bool unique)
+			{
+				Device device = data.getLatestDevice();
+				GpuSupport* gpu = host.getGPUSupport();
+				if(!gpu || device < DEVICE_CUDA || device > DEVICE_CUDA_LAST)
+					return false;
+				int* indices = data.getData(device, false);
+				int oldDevice = gpu->getCurrentDevice();
+				gpu->selectDevice(device - DEVICE_CUDA);
+				int size = gpu->sortIndices(indices, data.getSize(), unique);
+				gpu->selectDevice(oldDevice);
+				if(size < 0)
+					return false;
+				data.update(device);
+				data.resize(size);
+				return true;
+			}
+
+			Host& host;
 			SynchronizedData<int> data;
 	};
 	/**
@@ -47,7 +70,8 @@ namespace OPI
 
 	void IndexList::sort()
 	{
-		impl->data.sort();
+		if(!impl->sortOnDevice(false))
+			impl->data.sort();
 	}
 
 	void IndexList::reserve(int numPairs)
@@ -72,7 +96,8 @@ namespace OPI
 
 	void IndexList::removeDuplicates()
 	{
-		impl->data.removeDuplicates();
+		if(!impl->sortOnDevice(true))
+			impl->data.removeDuplicates();
 	}
 
 	void IndexList::update(Device device, int numPairs)
@@ -38,6 +38,7 @@ namespace OPI
 			//! Adds an index to the list
 			OPI_API_EXPORT void add(int index);
 			//! Sorts the list
+			/** If the latest data is on a GPU, the list is sorted there and stays on the device. */
 			OPI_API_EXPORT void sort();
 			//! Reserve memory to hold space for numPairs indices
 			OPI_API_EXPORT void reserve(int numPairs);
@@ -51,6 +52,7 @@ namespace OPI
 			OPI_API_EXPORT int* getData(Device device, bool no_sync = false) const;
 
 			//! Removes duplicate entries from this list
+			/** The list is sorted as well. As with sort(), this runs on the GPU holding the latest data. */
 			void removeDuplicates();
 		private:
 			//! Private implementation details (pimpl-idiom)
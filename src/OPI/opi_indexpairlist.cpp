@@ -15,7 +15,10 @@
  * License along with this library.
  */
 #include "opi_indexpairlist.h"
+#include "opi_host.h"
+#include "opi_gpusupport.h"
 #include "internal/opi_synchronized_data.h"
+#include <map>
 namespace OPI
 {
 	bool operator<(const IndexPair& pair1, const IndexPair& pair2)
@@ -54,8 +57,30 @@ namespace OPI
 	class IndexPairListImpl
 	{
 		public:
-			IndexPairListImpl(Host& host): data(host) {}
+			IndexPairListImpl(Host& host): host(host), data(host, "IndexPairList", this), hostCounter(0) {}
+			~IndexPairListImpl()
+			{
+				GpuSupport* gpu = host.getGPUSupport();
+				if(gpu) {
+					for(std::map<Device, int*>::iterator itr = deviceCounters.begin(); itr != deviceCounters.end(); ++itr)
+						gpu->free(itr->second);
+				}
+			}
+
+			// returns the GPU support if the device is a valid CUDA device
+			GpuSupport* cudaDevice(Device device) const
+			{
+				GpuSupport* gpu = host.getGPUSupport();
+				if(gpu && device >= DEVICE_CUDA && device <= DEVICE_CUDA_LAST && device - DEVICE_CUDA < gpu->getDeviceCount())
+					return gpu;
+				return 0;
+			}
+
+			Host& host;
 			SynchronizedData<IndexPair> data;
+			// append counters, one int per device
+			int hostCounter;
+			std::map<Device, int*> deviceCounters;
 	};
 	/**
 	 * @endcond
@@ -100,16 +125,32 @@ namespace OPI
 
 	void IndexPairList::removeDuplicates()
 	{
-		for(int i = 0; i < getPairsUsed(); ++i)
-		{
-			IndexPair* pairs = getData();
-			if(pairs[i].object1 > pairs[i].object2)
-			{
-				int tmp = pairs[i].object1;
-				pairs[i].object1 = pairs[i].object2;
-				pairs[i].object2 = tmp;
+		// the pairs stay on the GPU they were produced on
+		Device device = impl->data.getLatestDevice();
+		GpuSupport* gpu = impl->cudaDevice(device);
+		if(gpu) {
+			IndexPair* pairs = getData(device);
+			int oldDevice = gpu->getCurrentDevice();
+			gpu->selectDevice(device - DEVICE_CUDA);
+			int size = gpu->removeDuplicatePairs(pairs, getPairsUsed());
+			gpu->selectDevice(oldDevice);
+			if(size >= 0) {
+				update(device, size);
+				return;
 			}
 		}
+		IndexPair* pairs = getData();
+		parallelFor(getPairsUsed(), [pairs](int begin, int end) {
+			for(int i = begin; i < end; ++i)
+			{
+				if(pairs[i].object1 > pairs[i].object2)
+				{
+					int tmp = pairs[i].object1;
+					pairs[i].object1 = pairs[i].object2;
+					pairs[i].object2 = tmp;
+				}
+			}
+		});
 		impl->data.removeDuplicates();
 	}
 
@@ -123,4 +164,98 @@ namespace OPI
 		impl->data.update(device);
 		impl->data.resize(numPairs);
 	}
+
+	int* IndexPairList::getAppendCounter(Device device)
+	{
+		if(device == DEVICE_HOST)
+			return &impl->hostCounter;
+		GpuSupport* gpu = impl->cudaDevice(device);
+		if(!gpu) {
+			impl->host.sendError(INVALID_DEVICE);
+			return 0;
+		}
+		int*& counter = impl->deviceCounters[device];
+		if(!counter) {
+			int oldDevice = gpu->getCurrentDevice();
+			gpu->selectDevice(device - DEVICE_CUDA);
+			gpu->allocate((void**)&counter, sizeof(int));
+			gpu->selectDevice(oldDevice);
+			resetAppendCounter(device);
+		}
+		return counter;
+	}
+
+	ErrorCode IndexPairList::resetAppendCounter(Device device)
+	{
+		if(device == DEVICE_HOST) {
+			impl->hostCounter = 0;
+			return SUCCESS;
+		}
+		int* counter = getAppendCounter(device);
+		if(!counter)
+			return INVALID_DEVICE;
+		GpuSupport* gpu = impl->cudaDevice(device);
+		int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(device - DEVICE_CUDA);
+		if(!gpu->zeroMemory(counter, sizeof(int))) {
+			int zero = 0;
+			gpu->copy(counter, &zero, sizeof(int), 1, true);
+		}
+		gpu->selectDevice(oldDevice);
+		return SUCCESS;
+	}
+
+	int IndexPairList::getAppendCount(Device device) const
+	{
+		if(device == DEVICE_HOST)
+			return impl->hostCounter;
+		std::map<Device, int*>::const_iterator itr = impl->deviceCounters.find(device);
+		GpuSupport* gpu = impl->cudaDevice(device);
+		// nothing was appended on a device without a counter
+		if(itr == impl->deviceCounters.end() || !gpu)
+			return 0;
+		int count = 0;
+		int oldDevice = gpu->getCurrentDevice();
+		gpu->selectDevice(device - DEVICE_CUDA);
+		gpu->copy(&count, itr->second, sizeof(int), 1, false);
+		gpu->selectDevice(oldDevice);
+		return count;
+	}
+
+	bool IndexPairList::appendOverflowed(Device device) const
+	{
+		return getAppendCount(device) > getTotalSpace();
+	}
+
+	bool IndexPairList::commitAppend(Device device)
+	{
+		const int count = getAppendCount(device);
+		if(count > getTotalSpace()) {
+			reserve(count);
+			resetAppendCounter(device);
+			return false;
+		}
+		update(device, count);
+		return true;
+	}
+
+	ErrorCode IndexPairList::fill(Device device, const std::function<ErrorCode(IndexPair* pairs, int capacity, int* counter)>& append)
+	{
+		int* counter = getAppendCounter(device);
+		if(!counter)
+			return INVALID_DEVICE;
+		ErrorCode status = resetAppendCounter(device);
+		// the second attempt always fits since the list grows to the counted size
+		while(status == SUCCESS) {
+			const int capacity = getTotalSpace();
+			// host memory is only valid up to the size of the list
+			if(device == DEVICE_HOST)
+				impl->data.resize(capacity);
+			status = append((capacity > 0) ? getData(device, true) : 0, capacity, counter);
+			if(status == SUCCESS && commitAppend(device))
+				break;
+		}
+		impl->host.sendError(status);
+		return status;
+	}
 }
@@ -18,7 +18,9 @@
 #define OPI_INDEXPAIRLIST_H
 #include "opi_common.h"
 #include "opi_datatypes.h"
+#include "opi_error.h"
 #include "opi_pimpl_helper.h"
+#include <functional>
 namespace OPI
 {
 	class IndexPairListImpl;
@@ -47,12 +49,64 @@ namespace OPI
 			/// Returns the amount of object pairs this list can store
 			OPI_API_EXPORT int getTotalSpace() const;
 
+			/// Removes pairs that occur more than once, regardless of the order of the two objects
+			/** The remaining pairs are sorted and have the smaller index first. If the latest data
+			 * is on a GPU, this runs on that device and the pairs stay there.
+			 */
 			OPI_API_EXPORT void removeDuplicates();
 			/// Returns a device-specific pointer to the data
 			IndexPair* getData(Device device = DEVICE_HOST, bool no_sync = false) const;
+
+			/**
+			 * @name Appending on a device
+			 * Kernels can append pairs to the memory returned by getData() through a counter
+			 * that lives in memory of the same device: every pair atomically increments the
+			 * counter and is only written if the old value is below getTotalSpace() (see
+			 * appendIndexPair() for CUDA kernels). The counter keeps counting beyond the
+			 * capacity, so the required size is known after an overflow. commitAppend() then
+			 * either stores the number of pairs or grows the list for another attempt; fill()
+			 * runs this loop for a given append function, and is the only way to append on the
+			 * host since host memory is only valid up to getPairsUsed() otherwise.
+			 */
+			///@{
+			/// Returns the append counter in memory of the given device, or 0 on error
+			OPI_API_EXPORT int* getAppendCounter(Device device = DEVICE_HOST);
+			/// Sets the append counter of the given device to zero
+			OPI_API_EXPORT ErrorCode resetAppendCounter(Device device = DEVICE_HOST);
+			/// Returns the value of the append counter; only the counter is copied to the host
+			OPI_API_EXPORT int getAppendCount(Device device = DEVICE_HOST) const;
+			/// Returns true if more pairs were appended on the device than the list can store
+			OPI_API_EXPORT bool appendOverflowed(Device device = DEVICE_HOST) const;
+			/// Completes appending on a device
+			/** If all pairs fit, the list holds the appended pairs and true is returned.
+			 * Otherwise the list is enlarged to the number of pairs counted, the counter is
+			 * reset and false is returned, so the pairs have to be appended again.
+			 */
+			OPI_API_EXPORT bool commitAppend(Device device = DEVICE_HOST);
+			/// Fills the list on a device by calling append until all pairs fit
+			/** append receives the device memory of the list, its capacity and the zeroed
+			 * append counter of the device, and may return an error to abort.
+			 */
+			OPI_API_EXPORT ErrorCode fill(Device device, const std::function<ErrorCode(IndexPair* pairs, int capacity, int* counter)>& append);
+			///@}
 		private:
 			/// Private implementation details (pimpl-idiom)
 			Pimpl<IndexPairListImpl> impl;
 	};
+
+#ifdef __CUDACC__
+	//! Appends a pair from a CUDA kernel through the append counter of an IndexPairList
+	/** Pairs beyond the capacity are only counted. Returns false if the pair was not stored.
+	 * \ingroup CPP_API_GROUP
+	 */
+	__device__ inline bool appendIndexPair(IndexPair* pairs, int capacity, int* counter, int object1, int object2)
+	{
+		const int slot = atomicAdd(counter, 1);
+		if(slot >= capacity) return false;
+		pairs[slot].object1 = object1;
+		pairs[slot].object2 = object2;
+		return true;
+	}
+#endif
 }
 #endif // OPI_INDEXPAIRLIST_H
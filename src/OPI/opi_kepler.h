@@ -0,0 +1,112 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_KEPLER_H
+#define OPI_KEPLER_H
+
+#ifndef OPI_CUDA_PREFIX
+#define OPI_CUDA_PREFIX
+#endif
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+namespace OPI
+{
+	//! Default convergence tolerance of the Kepler solver, in radians
+	constexpr double KEPLER_TOLERANCE = 1e-12;
+	//! Default iteration limit of the Kepler solver
+	constexpr int KEPLER_MAX_ITERATIONS = 30;
+	//! Number of orbits solved together by solveKepler()
+	constexpr int KEPLER_LANES = 8;
+
+	//! Reduces the mean anomaly to [-pi, pi] and returns the multiple of 2*pi that was removed
+	OPI_CUDA_PREFIX inline double keplerReduceAnomaly(double& meanAnomaly)
+	{
+		const double offset = 2.0 * M_PI * floor((meanAnomaly + M_PI) / (2.0 * M_PI));
+		meanAnomaly -= offset;
+		return offset;
+	}
+
+	//! Returns a starting guess for the eccentric anomaly of a mean anomaly within [-pi, pi]
+	/** Uses a third order series for moderate eccentricities and Danby's guess for
+	 * highly eccentric orbits where the series converges poorly.
+	 */
+	OPI_CUDA_PREFIX inline double keplerStartingGuess(double meanAnomaly, double eccentricity)
+	{
+		if (eccentricity < 0.8) {
+			const double sin_ma = sin(meanAnomaly);
+			return meanAnomaly + eccentricity * sin_ma * (1.0 + eccentricity * cos(meanAnomaly));
+		}
+		return meanAnomaly + (meanAnomaly < 0.0 ? -0.85 : 0.85) * eccentricity;
+	}
+
+	//! Solves Kepler's equation M = E - e*sin(E) for the eccentric anomaly of an elliptical orbit
+	/** Newton iterations stop as soon as the correction drops below the given tolerance.
+	 * The result differs from the mean anomaly by less than pi, i.e. the number of revolutions
+	 * contained in the mean anomaly is kept.
+	 */
+	OPI_CUDA_PREFIX inline double solveKepler(double meanAnomaly, double eccentricity, double tolerance = KEPLER_TOLERANCE, int maxIterations = KEPLER_MAX_ITERATIONS)
+	{
+		double ma = meanAnomaly;
+		const double offset = keplerReduceAnomaly(ma);
+		double ea = keplerStartingGuess(ma, eccentricity);
+		for (int i=0; i<maxIterations; i++) {
+			const double step = (ea - eccentricity * sin(ea) - ma) / (1.0 - eccentricity * cos(ea));
+			ea -= step;
+			if (fabs(step) < tolerance) break;
+		}
+		return ea + offset;
+	}
+
+	//! Solves Kepler's equation for size orbits given as separate arrays (structure of arrays)
+	/** Orbits are processed in groups of KEPLER_LANES. The iterations of a group run over all
+	 * lanes in lockstep so the compiler can vectorize them; converged lanes are frozen, and
+	 * the group stops as soon as every lane has converged. The output array may be identical
+	 * to the meanAnomaly array. On CUDA devices, call the scalar solveKepler() once per thread
+	 * instead.
+	 */
+	inline void solveKepler(const double* meanAnomaly, const double* eccentricity, double* eccentricAnomaly, int size, double tolerance = KEPLER_TOLERANCE, int maxIterations = KEPLER_MAX_ITERATIONS)
+	{
+		for (int base=0; base<size; base+=KEPLER_LANES) {
+			const int lanes = (size - base < KEPLER_LANES) ? size - base : KEPLER_LANES;
+			double ma[KEPLER_LANES], ecc[KEPLER_LANES], ea[KEPLER_LANES], offset[KEPLER_LANES];
+			bool active[KEPLER_LANES];
+			// unused lanes of the last group solve a trivial equation
+			for (int l=0; l<KEPLER_LANES; l++) {
+				ma[l] = (l < lanes) ? meanAnomaly[base+l] : 0.0;
+				ecc[l] = (l < lanes) ? eccentricity[base+l] : 0.0;
+				offset[l] = keplerReduceAnomaly(ma[l]);
+				ea[l] = keplerStartingGuess(ma[l], ecc[l]);
+				active[l] = true;
+			}
+			for (int i=0; i<maxIterations; i++) {
+				int remaining = 0;
+				for (int l=0; l<KEPLER_LANES; l++) {
+					const double step = (ea[l] - ecc[l] * sin(ea[l]) - ma[l]) / (1.0 - ecc[l] * cos(ea[l]));
+					ea[l] -= active[l] ? step : 0.0;
+					active[l] = active[l] && (fabs(step) >= tolerance);
+					remaining += active[l] ? 1 : 0;
+				}
+				if (remaining == 0) break;
+			}
+			for (int l=0; l<lanes; l++)
+				eccentricAnomaly[base+l] = ea[l] + offset[l];
+		}
+	}
+}
+
+#endif
@@ -17,7 +17,8 @@
 #include "opi_module.h"
 
 #include "opi_host.h"
-#include <map>
+#include <deque>
+#include <unordered_map>
 #include <sstream>
 #include <fstream>
 #include <iostream>
@@ -296,15 +297,15 @@ namespace OPI
 						std::istringstream(*(ptr.v_string)) >> value;
 						break;
 					case TYPE_INTEGER_ARRAY:
-						if((element < 0 || element > size)) return INDEX_RANGE;
+						if((element < 0 || element >= size)) return INDEX_RANGE;
 						value = ptr.v_int[element];
 						break;
 					case TYPE_FLOAT_ARRAY:
-						if((element < 0 || element > size)) return INDEX_RANGE;
+						if((element < 0 || element >= size)) return INDEX_RANGE;
 						value = ptr.v_float[element];
 						break;
 					case TYPE_DOUBLE_ARRAY:
-						if((element < 0 || element > size)) return INDEX_RANGE;
+						if((element < 0 || element >= size)) return INDEX_RANGE;
 						value = ptr.v_double[element];
 						break;
 					case TYPE_UNKNOWN:
@@ -322,12 +323,46 @@ namespace OPI
 			std::string name;
 			std::string author;
 			std::string description;
-			std::map<std::string, Property> properties;
+			// properties in registration order, so indices stay valid when properties are added
+			std::deque<Property> properties;
+			std::deque<std::string> propertyNames;
+			std::unordered_map<std::string, int> propertyIndices;
             std::string configFileName;
 			void* privateData;
 			template<class T> ErrorCode setValue(const std::string& name, const T& value);
+			// adds a property unless one with the same name exists
+			void addProperty(const char* name, const Property& property);
+			// returns the index of a property or -1
+			int findProperty(const std::string& name) const;
+			// returns the property identified by the given index, or zero after reporting INDEX_RANGE
+			Property* getProperty(int index);
 	};
 
+	void ModuleImpl::addProperty(const char* name, const Property& property)
+	{
+		if(propertyIndices.insert(std::make_pair(std::string(name), (int)properties.size())).second)
+		{
+			properties.push_back(property);
+			propertyNames.push_back(std::string(name));
+		}
+	}
+
+	int ModuleImpl::findProperty(const std::string& name) const
+	{
+		std::unordered_map<std::string, int>::const_iterator itr = propertyIndices.find(name);
+		return (itr != propertyIndices.end()) ? itr->second : -1;
+	}
+
+	Property* ModuleImpl::getProperty(int index)
+	{
+		if((index < 0)||(index >= (int)properties.size()))
+		{
+			host->sendError(INDEX_RANGE);
+			return 0;
+		}
+		return &properties[index];
+	}
+
 	void Module::setHost(Host *newhost)
 	{
 		data->host = newhost;
@@ -353,7 +388,8 @@ namespace OPI
 			status = runEnable();
 		if(status == SUCCESS)
             data->enabled = true;
-        data->host->sendError(status);
+        // modules added to a CustomPropagator directly have no host
+        if(data->host) data->host->sendError(status);
 		return status;
 	}
 
@@ -366,7 +402,7 @@ namespace OPI
 			if(status == SUCCESS)
 				data->enabled = false;
 		}
-		data->host->sendError(status);
+		if(data->host) data->host->sendError(status);
 		return status;
 	}
 
@@ -422,58 +458,58 @@ namespace OPI
 
     void Module::registerProperty(const char* name, int *location)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false)));
+        data->addProperty(name, Property(location, false));
 	}
 
     void Module::registerProperty(const char* name, float *location)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false)));
+        data->addProperty(name, Property(location, false));
 	}
 
     void Module::registerProperty(const char* name, double *location)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false)));
+        data->addProperty(name, Property(location, false));
 	}
 
     void Module::registerProperty(const char* name, std::string *location)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location)));
+        data->addProperty(name, Property(location));
 	}
 
     void Module::registerProperty(const char* name, int *location, int size)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false, size)));
+        data->addProperty(name, Property(location, false, size));
 	}
 
     void Module::registerProperty(const char* name, float *location, int size)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false, size)));
+        data->addProperty(name, Property(location, false, size));
 	}
 
     void Module::registerProperty(const char* name, double *location, int size)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(location, false, size)));
+        data->addProperty(name, Property(location, false, size));
 	}
 
 
     void Module::createProperty(const char* name, int value)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(&value, true)));
+        data->addProperty(name, Property(&value, true));
 	}
 
     void Module::createProperty(const char* name, float value)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(&value, true)));
+        data->addProperty(name, Property(&value, true));
 	}
 
     void Module::createProperty(const char* name, double value)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(&value, true)));
+        data->addProperty(name, Property(&value, true));
 	}
 
     void Module::createProperty(const char* name, const char* value)
 	{
-        data->properties.insert(std::make_pair(std::string(name), Property(std::string(value))));
+        data->addProperty(name, Property(std::string(value)));
 	}
 
 	template<class T>
@@ -481,9 +517,10 @@ namespace OPI
 	{
 		ErrorCode result = INVALID_PROPERTY;
 		// find property
-		if(properties.count(name) > 0)
+		const int index = findProperty(name);
+		if(index >= 0)
 		{
-            result = properties[name].setValue(value);
+            result = properties[index].setValue(value);
 		}
 		host->sendError(result);
 		return SUCCESS;
@@ -506,10 +543,11 @@ namespace OPI
 	{
 		ErrorCode result = INVALID_PROPERTY;
 		// find property
-        if(data->properties.count(std::string(name)) > 0)
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
 		{
 			result = SUCCESS;
-            Property& property = data->properties[std::string(name)];
+            Property& property = data->properties[index];
 			// check the type
 			switch(property.type)
 			{
@@ -560,65 +598,86 @@ namespace OPI
 
     int Module::getPropertyInt(const char* name, int element)
 	{
-        if(data->properties.count(std::string(name)) > 0)
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
+			return getPropertyInt(index, element);
+		data->host->sendError(INVALID_PROPERTY);
+		return 0;
+	}
+
+	int Module::getPropertyInt(int index, int element)
+	{
+		Property* property = data->getProperty(index);
+		if(property)
 		{
-			int value;
-            ErrorCode error_status = data->properties[std::string(name)].getValue(value, element);
+			int value = 0;
+			ErrorCode error_status = property->getValue(value, element);
 			data->host->sendError(error_status);
 			return value;
 		}
-		data->host->sendError(INVALID_PROPERTY);
 		return 0;
 	}
 
-	int Module::getPropertyInt(int index, int element)
+    float Module::getPropertyFloat(const char* name, int element)
 	{
-		return getPropertyInt(getPropertyName(index), element);
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
+			return getPropertyFloat(index, element);
+		data->host->sendError(INVALID_PROPERTY);
+		return 0.0f;
 	}
 
-    float Module::getPropertyFloat(const char* name, int element)
+	float Module::getPropertyFloat(int index, int element)
 	{
-        if(data->properties.count(std::string(name)) > 0)
+		Property* property = data->getProperty(index);
+		if(property)
 		{
-			float value;
-            ErrorCode error_status = data->properties[std::string(name)].getValue(value, element);
+			float value = 0.0f;
+			ErrorCode error_status = property->getValue(value, element);
 			data->host->sendError(error_status);
 			return value;
 		}
-		data->host->sendError(INVALID_PROPERTY);
 		return 0.0f;
 	}
 
-	float Module::getPropertyFloat(int index, int element)
+    double Module::getPropertyDouble(const char* name, int element)
 	{
-		return getPropertyFloat(getPropertyName(index), element);
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
+			return getPropertyDouble(index, element);
+		data->host->sendError(INVALID_PROPERTY);
+		return 0.0;
 	}
 
-    double Module::getPropertyDouble(const char* name, int element)
+	double Module::getPropertyDouble(int index, int element)
 	{
-        if(data->properties.count(std::string(name)) > 0)
+		Property* property = data->getProperty(index);
+		if(property)
 		{
-			double value;
-            ErrorCode error_status = data->properties[std::string(name)].getValue(value, element);
+			double value = 0.0;
+			ErrorCode error_status = property->getValue(value, element);
 			data->host->sendError(error_status);
 			return value;
 		}
-		data->host->sendError(INVALID_PROPERTY);
 		return 0.0;
 	}
 
-	double Module::getPropertyDouble(int index, int element)
+    const char* Module::getPropertyString(const char* name, int element)
 	{
-		return getPropertyDouble(getPropertyName(index), element);
+		const int index = data->findProperty(std::string(name));
+		if(index >= 0)
+			return getPropertyString(index, element);
+		data->host->sendError(INVALID_PROPERTY);
+		return "";
 	}
 
-    const char* Module::getPropertyString(const char* name, int element)
+    const char* Module::getPropertyString(int index, int element)
 	{
 		static std::string internal_bufferstring;
 		internal_bufferstring = "";
-        if(data->properties.count(std::string(name)) > 0)
+		if(Property* found = data->getProperty(index))
 		{
-            Property& property = data->properties[std::string(name)];
+            Property& property = *found;
 			// check the type
 			switch(property.type)
 			{
@@ -688,11 +747,6 @@ namespace OPI
         return internal_bufferstring.c_str();
 	}
 
-    const char* Module::getPropertyString(int index, int element)
-	{
-        return getPropertyString(getPropertyName(index), element);
-	}
-
 
 	void Module::setPrivateData(void* private_data)
 	{
@@ -711,56 +765,55 @@ namespace OPI
 
     bool Module::hasProperty(const char* name) const
 	{
-        return data->properties.count(std::string(name)) > 0;
+        return data->findProperty(std::string(name)) >= 0;
+	}
+
+	int Module::getPropertyIndex(const char* name) const
+	{
+		const int index = data->findProperty(std::string(name));
+		if(index < 0)
+			data->host->sendError(INVALID_PROPERTY);
+		return index;
 	}
 
     const char* Module::getPropertyName(int index) const
 	{
-		static std::string dummystring = "";
-		if((index < 0)||(index >= (int)(data->properties.size())))
+		if((index < 0)||(index >= (int)(data->propertyNames.size())))
 		{
 			data->host->sendError(INDEX_RANGE);
-            return dummystring.c_str();
+            return "";
 		}
-		std::map<std::string, Property>::iterator itr = data->properties.begin();
-		for(int i=0; i < index; i++)
-			itr++;
-        return (itr->first).c_str();
+        return data->propertyNames[index].c_str();
 	}
 
 	PropertyType Module::getPropertyType(int index) const
 	{
-		static std::string dummystring = "";
-		if((index < 0)||(index >= (int)(data->properties.size())))
-		{
-			data->host->sendError(INDEX_RANGE);
-			return TYPE_UNKNOWN;
-		}
-		std::map<std::string, Property>::iterator itr = data->properties.begin();
-		for(int i=0; i < index; i++)
-			itr++;
-		return itr->second.type;
+		Property* property = data->getProperty(index);
+		return property ? property->type : TYPE_UNKNOWN;
 	}
 
     PropertyType Module::getPropertyType(const char* name) const
 	{
-        if(data->properties.count(std::string(name)) > 0)
-            return data->properties[std::string(name)].type;
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
+            return data->properties[index].type;
 		data->host->sendError(INVALID_PROPERTY);
 		return TYPE_UNKNOWN;
 	}
 
     int Module::getPropertySize(const char* name) const
 	{
-        if(data->properties.count(std::string(name)) > 0)
-            return data->properties[std::string(name)].size;
+		const int index = data->findProperty(std::string(name));
+        if(index >= 0)
+            return data->properties[index].size;
 		data->host->sendError(INVALID_PROPERTY);
 		return 0;
 	}
 
 	int Module::getPropertySize(int index) const
 	{
-		return getPropertySize(getPropertyName(index));
+		Property* property = data->getProperty(index);
+		return property ? property->size : 0;
 	}
 
     void Module::loadConfigFile()
@@ -878,6 +931,11 @@ namespace OPI
         return 0;
     }
 
+    int Module::supportsStepCapture()
+    {
+        return 0;
+    }
+
     int Module::minimumOPIVersionRequired()
     {
         return 0;
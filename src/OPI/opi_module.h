@@ -142,24 +142,32 @@ namespace OPI
             OPI_API_EXPORT ErrorCode setProperty(const char* name, double* value, int n);
 			//! Gets the value of a given property
             OPI_API_EXPORT int getPropertyInt(const char* name, int element = 0);
-			//! Gets the value of a given property
+			//! Gets the value of the property identified by the given index
+			/** Index based access needs no string lookup, so plugins can resolve the index of a
+			 * property once with getPropertyIndex and read its current value in the hot path.
+			 */
 			OPI_API_EXPORT int getPropertyInt(int index, int element = 0);
 			//! Gets the value of a given property
             OPI_API_EXPORT float getPropertyFloat(const char* name, int element = 0);
-			//! Gets the value of a given property
+			//! Gets the value of the property identified by the given index
 			OPI_API_EXPORT float getPropertyFloat(int index, int element = 0);
 			//! Gets the value of a given property
             OPI_API_EXPORT double getPropertyDouble(const char* name, int element = 0);
-			//! Gets the value of a given property
+			//! Gets the value of the property identified by the given index
 			OPI_API_EXPORT double getPropertyDouble(int index, int element = 0);
 			//! Gets the value of a given property
             OPI_API_EXPORT const char* getPropertyString(const char* name, int element = 0);
-			//! Gets the value of a given property
+			//! Gets the value of the property identified by the given index
             OPI_API_EXPORT const char* getPropertyString(int index, int element = 0);
 
 			// property information functions
 			//! Returns the amount of registered properties
+			/** Properties are indexed from 0 to getPropertyCount() - 1 in the order they were
+			 * registered or created. Adding properties does not change the index of existing ones.
+			 */
 			OPI_API_EXPORT int getPropertyCount() const;
+			//! Returns the index of a property, or -1 if it is not registered
+			OPI_API_EXPORT int getPropertyIndex(const char* name) const;
 			//! Returns the name of the property identified by the given index
             OPI_API_EXPORT const char* getPropertyName(int index) const;
 			//! Checks if a property is registered
@@ -193,6 +201,19 @@ namespace OPI
              */
             virtual int requiresOpenCL();
 
+            /**
+             * @brief Check whether the device work of this module can be recorded into a CUDA graph.
+             *
+             * A CustomPropagator with step capture enabled records one step of its modules and
+             * integrator and replays it in the following steps without calling them. Modules
+             * returning 1 queue all device work on Perturbations::getStream(), read julian_day
+             * and dt from Perturbations::getStepParameters() if it is not null, and keep their
+             * device buffers between steps. Host work and synchronous copies are not possible
+             * while recording.
+             * @return 1 if step capture is supported, 0 otherwise (the default).
+             */
+            virtual int supportsStepCapture();
+
             /**
              * @brief minimumOPIVersionRequired Returns the minimum OPI API level that this module requires.
              *
@@ -1,5 +1,8 @@
 
 #include "opi_perturbation_module.h"
+#include "opi_indexlist.h"
+#include "opi_population.h"
+#include "internal/opi_trace.h"
 namespace OPI
 {
 	class PerturbationModuleImpl
@@ -17,9 +20,15 @@ namespace OPI
 
     ErrorCode PerturbationModule::calculate(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode, IndexList* indices)
 	{
+		TraceScope trace(population.getHostPointer(), "calculate", getName(), indices ? indices->getSize() : population.getSize(), traceDevice(*this));
         return runCalculation(population, delta, julian_day, dt, mode, indices);
 	}
 
+	int PerturbationModule::perturbationFields()
+	{
+		return FIELD_ORBIT | FIELD_POSITION | FIELD_VELOCITY | FIELD_ACCELERATION | FIELD_BYTES;
+	}
+
     ErrorCode PerturbationModule::runCalculation(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode, IndexList* indices)
 	{
 		return NOT_IMPLEMENTED;
@@ -47,6 +47,14 @@ namespace OPI
 			 */
             OPI_API_EXPORT ErrorCode calculate(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
 
+			//! Returns the fields of the Perturbations this module writes, as FieldMask flags
+			/**
+			 * A CustomPropagator only allocates and synchronizes the fields its modules declare.
+			 * The default covers all fields except the PartialsMatrix, which modules computing
+			 * variational equations have to add.
+			 */
+			virtual int perturbationFields();
+
 		protected:
             virtual ErrorCode runCalculation(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
 
@@ -20,8 +20,10 @@
 #include "opi_gpusupport.h"
 #include "internal/opi_synchronized_data.h"
 #include "internal/miniz.h"
+#include "internal/opi_parallel.h"
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <sstream>
@@ -37,12 +39,14 @@ namespace OPI
     {
 		PerturbationRawData(Host& _host) :
                 host(_host),
-                data_orbit(host),
-                data_position(host),
-                data_velocity(host),
-                data_acceleration(host),
-                data_partials(host),
-                data_bytes(host)
+                data_orbit(host, "PerturbationOrbit", this),
+                data_position(host, "PerturbationPosition", this),
+                data_velocity(host, "PerturbationVelocity", this),
+                data_acceleration(host, "PerturbationAcceleration", this),
+                data_partials(host, "PerturbationPartials", this),
+                data_bytes(host, "PerturbationBytes", this),
+                stream(0),
+                stepParameters(0)
             {
 
             }
@@ -62,15 +66,95 @@ namespace OPI
             // data size
             int size;
             int byteArraySize;
+            // the requested fields (FieldMask)
+            int fields;
+            // set while a CustomPropagator records a step
+            void* stream;
+            const StepParameters* stepParameters;
+
+            // the requested fields and those that were allocated by accessing them
+            int activeFields()
+            {
+                int active = fields;
+                if (data_orbit.hasData()) active |= FIELD_ORBIT;
+                if (data_position.hasData()) active |= FIELD_POSITION;
+                if (data_velocity.hasData()) active |= FIELD_VELOCITY;
+                if (data_acceleration.hasData()) active |= FIELD_ACCELERATION;
+                if (data_partials.hasData()) active |= FIELD_PARTIALS;
+                if (data_bytes.hasData()) active |= FIELD_BYTES;
+                return active;
+            }
     };
+
+    // the fields a Perturbations object consists of
+    static const int PERTURBATION_FIELDS = FIELD_ORBIT | FIELD_POSITION | FIELD_VELOCITY | FIELD_ACCELERATION | FIELD_PARTIALS | FIELD_BYTES;
+
+    // sets the elements [first, last) of a field to zero on the host
+    template< class T >
+    static void zeroElements(SynchronizedData<T>& field, size_t first, size_t last)
+    {
+        T* values = field.getData(DEVICE_HOST, false);
+        memset(reinterpret_cast<char*>(values + first), 0, sizeof(T) * (last - first));
+        field.update(DEVICE_HOST);
+    }
+
+    // copies count elements of a field, or clears them if the source field is not in use
+    template< class T >
+    static void copyElements(SynchronizedData<T>& target, bool targetActive, SynchronizedData<T>& source, bool sourceActive, size_t first, size_t count, size_t offset)
+    {
+        if (sourceActive)
+        {
+            const T* in = source.getData(DEVICE_HOST, false);
+            std::copy(in + first, in + first + count, target.getData(DEVICE_HOST, false) + offset);
+            target.update(DEVICE_HOST);
+        }
+        else if (targetActive) zeroElements(target, offset, offset + count);
+    }
+
+    // copies element i of source to element list[i] of target, or clears it if the source field is not in use
+    template< class T >
+    static void scatterElements(SynchronizedData<T>& target, bool targetActive, SynchronizedData<T>& source, bool sourceActive, const int* list, int count, int targetSize)
+    {
+        if (!sourceActive && !targetActive) return;
+        const T* in = sourceActive ? source.getData(DEVICE_HOST, false) : 0;
+        T* out = target.getData(DEVICE_HOST, false);
+        for (int i = 0; i < count; i++)
+        {
+            if (list[i] >= targetSize) continue;
+            if (in) out[list[i]] = in[i];
+            else memset(reinterpret_cast<char*>(&out[list[i]]), 0, sizeof(T));
+        }
+        target.update(DEVICE_HOST);
+    }
+
+    // copies element list[i] of source to element i of target if the source field is in use
+    template< class T >
+    static void gatherElements(SynchronizedData<T>& target, SynchronizedData<T>& source, bool sourceActive, const int* list, int count)
+    {
+        if (!sourceActive) return;
+        const T* in = source.getData(DEVICE_HOST, false);
+        T* out = target.getData(DEVICE_HOST, false);
+        for (int i = 0; i < count; i++)
+            out[i] = in[list[i]];
+        target.update(DEVICE_HOST);
+    }
+
+    // removes elements from a field, unallocated fields only change their size
+    template< class T >
+    static void removeElements(SynchronizedData<T>& field, int index, int count, int newSize)
+    {
+        if (field.hasData()) field.remove(index, count);
+        else field.resize(newSize);
+    }
     /**
      * \endcond
      */
 
-    Perturbations::Perturbations(const Population& population): data(population.getHostPointer())
+    Perturbations::Perturbations(const Population& population, int fields): data(population.getHostPointer())
     {
         data->size = 0;
         data->byteArraySize = 1;
+        data->fields = fields & PERTURBATION_FIELDS;
         //data->lastPropagatorName = population.getLastPropagatorName();
         resize(population.getSize());
     }
@@ -79,6 +163,7 @@ namespace OPI
     {
         data->size = 0;
         data->byteArraySize = 1;
+        data->fields = source.getFields();
         //data->lastPropagatorName = source.getLastPropagatorName();
         int s = source.getSize();
         int b = source.getByteArraySize();
@@ -91,47 +176,34 @@ namespace OPI
     {
         data->size = 0;
         data->byteArraySize = 1;
+        data->fields = source.getFields();
         //data->lastPropagatorName = source.getLastPropagatorName();
         int s = list.getSize();
         int b = source.getByteArraySize();
         resize(s);
         resizeByteArray(b);
-        int* listdata = list.getData(DEVICE_HOST);
-
-        Orbit* orbits = source.getDeltaOrbit(DEVICE_HOST, false);
-        Vector3* pos = source.getDeltaPosition(DEVICE_HOST, false);
-        Vector3* vel = source.getDeltaVelocity(DEVICE_HOST, false);
-        Vector3* acc = source.getDeltaAcceleration(DEVICE_HOST, false);
-        PartialsMatrix* pmx = source.getPartialsMatrix(DEVICE_HOST, false);
-        char* bytes = source.getBytes(DEVICE_HOST, false);
-
-        Orbit* thisOrbit = getDeltaOrbit();
-        Vector3* thisPos = getDeltaPosition();
-        Vector3* thisVel = getDeltaVelocity();
-        Vector3* thisAcc = getDeltaAcceleration();
-        PartialsMatrix* thisPmx = getPartialsMatrix();
-        char* thisBytes = getBytes();
-
-        for(int i = 0; i < list.getSize(); ++i)
+        const int* listdata = list.getData(DEVICE_HOST);
+
+        const int fields = data->fields;
+        PerturbationRawData& other = **source.data;
+        gatherElements(data->data_orbit, other.data_orbit, (fields & FIELD_ORBIT) != 0, listdata, s);
+        gatherElements(data->data_position, other.data_position, (fields & FIELD_POSITION) != 0, listdata, s);
+        gatherElements(data->data_velocity, other.data_velocity, (fields & FIELD_VELOCITY) != 0, listdata, s);
+        gatherElements(data->data_acceleration, other.data_acceleration, (fields & FIELD_ACCELERATION) != 0, listdata, s);
+        gatherElements(data->data_partials, other.data_partials, (fields & FIELD_PARTIALS) != 0, listdata, s);
+        if (fields & FIELD_BYTES)
         {
-            thisOrbit[i] = orbits[listdata[i]];
-            thisPos[i] = pos[listdata[i]];
-            thisVel[i] = vel[listdata[i]];
-            thisAcc[i] = acc[listdata[i]];
-            thisPmx[i] = pmx[listdata[i]];
-            for (int j=0; j<b; j++)
+            const char* bytes = source.getBytes(DEVICE_HOST, false);
+            char* thisBytes = getBytes();
+            for(int i = 0; i < s; ++i)
             {
-                thisBytes[i*b+j] = bytes[listdata[i]*b+j];
+                for (int j=0; j<b; j++)
+                {
+                    thisBytes[i*b+j] = bytes[listdata[i]*b+j];
+                }
             }
+            update(DATA_BYTES);
         }
-
-        update(DATA_ORBIT);
-        update(DATA_PROPERTIES);
-        update(DATA_POSITION);
-        update(DATA_VELOCITY);
-        update(DATA_ACCELERATION);
-        update(DATA_PARTIALS);
-        update(DATA_BYTES);
     }
 
     Perturbations::~Perturbations()
@@ -159,22 +231,17 @@ namespace OPI
             bool copyBytes =(data->byteArraySize == source.getByteArraySize());
             if (!copyBytes) std::cout << "Warning: Copying perturbations without the byte array" << std::endl;
 
-            // TODO Use std::copy instead
-            memcpy(&getDeltaOrbit()[offset], &source.getDeltaOrbit(DEVICE_HOST, false)[firstIndex], length*sizeof(Orbit));
-            memcpy(&getDeltaPosition()[offset], &source.getDeltaPosition(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getDeltaVelocity()[offset], &source.getDeltaVelocity(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getDeltaAcceleration()[offset], &source.getDeltaAcceleration(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getPartialsMatrix()[offset], &source.getPartialsMatrix(DEVICE_HOST, false)[firstIndex], length*sizeof(PartialsMatrix));
-            if (copyBytes) memcpy(&getBytes()[offset], &source.getBytes(DEVICE_HOST, false)[firstIndex], data->byteArraySize*length*sizeof(char));
-            else memset(&getBytes()[offset], 0, data->byteArraySize*length*sizeof(char));
-
-            update(DATA_ORBIT);
-            update(DATA_PROPERTIES);
-            update(DATA_POSITION);
-            update(DATA_VELOCITY);
-            update(DATA_ACCELERATION);
-            update(DATA_PARTIALS);
-            if (copyBytes) update(DATA_BYTES);
+            // fields that are used by neither object are skipped
+            const int fields = data->activeFields();
+            const int sourceFields = source.data->activeFields();
+            PerturbationRawData& other = **source.data;
+            copyElements(data->data_orbit, (fields & FIELD_ORBIT) != 0, other.data_orbit, (sourceFields & FIELD_ORBIT) != 0, firstIndex, length, offset);
+            copyElements(data->data_position, (fields & FIELD_POSITION) != 0, other.data_position, (sourceFields & FIELD_POSITION) != 0, firstIndex, length, offset);
+            copyElements(data->data_velocity, (fields & FIELD_VELOCITY) != 0, other.data_velocity, (sourceFields & FIELD_VELOCITY) != 0, firstIndex, length, offset);
+            copyElements(data->data_acceleration, (fields & FIELD_ACCELERATION) != 0, other.data_acceleration, (sourceFields & FIELD_ACCELERATION) != 0, firstIndex, length, offset);
+            copyElements(data->data_partials, (fields & FIELD_PARTIALS) != 0, other.data_partials, (sourceFields & FIELD_PARTIALS) != 0, firstIndex, length, offset);
+            const size_t b = data->byteArraySize;
+            copyElements(data->data_bytes, (fields & FIELD_BYTES) != 0, other.data_bytes, copyBytes && (sourceFields & FIELD_BYTES) != 0, firstIndex * b, length * b, offset * b);
         }
         else std::cout << "Cannot copy perturbation: Trying to copy " << length << " objects with offset " << offset << " but size is " << length << std::endl;
     }
@@ -411,28 +478,56 @@ namespace OPI
             data->data_acceleration.resize(size);
             data->data_partials.resize(size);
             data->data_bytes.resize(size*byteArraySize);
-            //initialize new elements to zero
+            //initialize new elements of the requested fields to zero, the others are
+            //allocated when they are first accessed
             if (size > data->size)
             {
-                for (int i=data->size; i<size; i++)
-                {
-                    data->data_orbit.set(Orbit(0.0,0.0,0.0,0.0,0.0,0.0),i);
-                    data->data_position.set(Vector3(0.0,0.0,0.0),i);
-                    data->data_velocity.set(Vector3(0.0,0.0,0.0),i);
-                    data->data_acceleration.set(Vector3(0.0,0.0,0.0),i);
-                    data->data_partials.set(PartialsMatrix(0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0),i); //FIXME: This sucks
-                }
-                data->data_orbit.update(DEVICE_HOST);
-                data->data_position.update(DEVICE_HOST);
-                data->data_velocity.update(DEVICE_HOST);
-                data->data_acceleration.update(DEVICE_HOST);
-                data->data_partials.update(DEVICE_HOST);
+                const int fields = data->activeFields();
+                if (fields & FIELD_ORBIT) zeroElements(data->data_orbit, data->size, size);
+                if (fields & FIELD_POSITION) zeroElements(data->data_position, data->size, size);
+                if (fields & FIELD_VELOCITY) zeroElements(data->data_velocity, data->size, size);
+                if (fields & FIELD_ACCELERATION) zeroElements(data->data_acceleration, data->size, size);
+                if (fields & FIELD_PARTIALS) zeroElements(data->data_partials, data->size, size);
             }
             data->size = size;
             data->byteArraySize = byteArraySize;
         }
     }
 
+    int Perturbations::getFields() const
+    {
+        return data->activeFields();
+    }
+
+    void* Perturbations::getStream() const
+    {
+        return data->stream;
+    }
+
+    const StepParameters* Perturbations::getStepParameters() const
+    {
+        return data->stepParameters;
+    }
+
+    void Perturbations::setStepContext(void* stream, const StepParameters* parameters)
+    {
+        data->stream = stream;
+        data->stepParameters = parameters;
+    }
+
+    void Perturbations::requestFields(int fields)
+    {
+        const int added = fields & PERTURBATION_FIELDS & ~data->activeFields();
+        data->fields |= added;
+        if (data->size == 0) return;
+        if (added & FIELD_ORBIT) zeroElements(data->data_orbit, 0, data->size);
+        if (added & FIELD_POSITION) zeroElements(data->data_position, 0, data->size);
+        if (added & FIELD_VELOCITY) zeroElements(data->data_velocity, 0, data->size);
+        if (added & FIELD_ACCELERATION) zeroElements(data->data_acceleration, 0, data->size);
+        if (added & FIELD_PARTIALS) zeroElements(data->data_partials, 0, data->size);
+        if (added & FIELD_BYTES) zeroElements(data->data_bytes, 0, (size_t)data->size * data->byteArraySize);
+    }
+
     void Perturbations::resizeByteArray(int size)
     {
         data->data_bytes.resize(data->size * size);
@@ -518,74 +613,64 @@ namespace OPI
 
     void Perturbations::insert(Perturbations& source, IndexList& list)
     {
-        int* listdata = list.getData(DEVICE_HOST);
-
-        Orbit* orbits = source.getDeltaOrbit(DEVICE_HOST, false);
-        Vector3* pos = source.getDeltaPosition(DEVICE_HOST, false);
-        Vector3* vel = source.getDeltaVelocity(DEVICE_HOST, false);
-        Vector3* acc = source.getDeltaAcceleration(DEVICE_HOST, false);
-        PartialsMatrix* pmx = source.getPartialsMatrix(DEVICE_HOST, false);
-        char* bytes = source.getBytes(DEVICE_HOST, false);
-
-        Orbit* thisOrbit = getDeltaOrbit();
-        Vector3* thisPos = getDeltaPosition();
-        Vector3* thisVel = getDeltaVelocity();
-        Vector3* thisAcc = getDeltaAcceleration();
-        PartialsMatrix* thisPmx = getPartialsMatrix();
-        char* thisBytes = getBytes();
+        const int* listdata = list.getData(DEVICE_HOST);
+        const int count = source.getSize();
 
         if (getByteArraySize() != source.getByteArraySize())
         {
             std::cout << "Warning: Cannot insert byte array into perturbations!" << std::endl;
         }
 
-        if (list.getSize() >= source.getSize())
+        if (list.getSize() >= count)
         {
-            for(int i = 0; i < list.getSize(); ++i)
+            for(int i = 0; i < count; ++i)
+            {
+                if (listdata[i] >= getSize())
+                    std::cout << "Cannot insert - index out of range: " << listdata[i] << std::endl;
+            }
+
+            // fields that are used by neither object are skipped
+            const int fields = data->activeFields();
+            const int sourceFields = source.data->activeFields();
+            PerturbationRawData& other = **source.data;
+            scatterElements(data->data_orbit, (fields & FIELD_ORBIT) != 0, other.data_orbit, (sourceFields & FIELD_ORBIT) != 0, listdata, count, data->size);
+            scatterElements(data->data_position, (fields & FIELD_POSITION) != 0, other.data_position, (sourceFields & FIELD_POSITION) != 0, listdata, count, data->size);
+            scatterElements(data->data_velocity, (fields & FIELD_VELOCITY) != 0, other.data_velocity, (sourceFields & FIELD_VELOCITY) != 0, listdata, count, data->size);
+            scatterElements(data->data_acceleration, (fields & FIELD_ACCELERATION) != 0, other.data_acceleration, (sourceFields & FIELD_ACCELERATION) != 0, listdata, count, data->size);
+            scatterElements(data->data_partials, (fields & FIELD_PARTIALS) != 0, other.data_partials, (sourceFields & FIELD_PARTIALS) != 0, listdata, count, data->size);
+            if (getByteArraySize() == source.getByteArraySize() && (sourceFields & FIELD_BYTES))
             {
-                int l = listdata[i];
-                if (l < getSize())
+                const char* bytes = source.getBytes(DEVICE_HOST, false);
+                char* thisBytes = getBytes();
+                int b = getByteArraySize();
+                for(int i = 0; i < count; ++i)
                 {
-                    thisOrbit[l] = orbits[i];
-                    thisPos[l] = pos[i];
-                    thisVel[l] = vel[i];
-                    thisAcc[l] = acc[i];
-                    thisPmx[l] = pmx[i];
-                    if (getByteArraySize() == source.getByteArraySize())
+                    int l = listdata[i];
+                    if (l >= getSize()) continue;
+                    for (int j=0; j<b; j++)
                     {
-                        int b = getByteArraySize();
-                        for (int j=0; j<b; j++)
-                        {
-                            thisBytes[l*b+j] = bytes[i*b+j];
-                        }
+                        thisBytes[l*b+j] = bytes[i*b+j];
                     }
                 }
-                else {
-                    std::cout << "Cannot insert - index out of range: " << l << std::endl;
-                }
+                update(DATA_BYTES);
             }
         }
         else {
             std::cout << "Cannot insert - not enough elements in index list!" << std::endl;
         }
-
-        update(DATA_ORBIT);
-        update(DATA_POSITION);
-        update(DATA_VELOCITY);
-        update(DATA_ACCELERATION);
-        update(DATA_PARTIALS);
-        update(DATA_BYTES);
     }
 
     void Perturbations::remove(int index)
     {
-        data->data_acceleration.remove(index);
-        data->data_orbit.remove(index);
-        data->data_position.remove(index);
-        data->data_velocity.remove(index);
-        data->data_partials.remove(index);
-        data->data_bytes.remove(index*data->byteArraySize, data->byteArraySize);
-        data->size--;
+        if (index < 0 || index >= data->size) return;
+        const int size = data->size - 1;
+        removeElements(data->data_acceleration, index, 1, size);
+        removeElements(data->data_orbit, index, 1, size);
+        removeElements(data->data_position, index, 1, size);
+        removeElements(data->data_velocity, index, 1, size);
+        removeElements(data->data_partials, index, 1, size);
+        removeElements(data->data_bytes, index*data->byteArraySize, data->byteArraySize, size*data->byteArraySize);
+        data->size = size;
     }
 
     ErrorCode Perturbations::update(int type, Device device)
@@ -618,6 +703,106 @@ namespace OPI
         return status;
     }
 
+    /**
+     * \cond INTERNAL_DOCUMENTATION
+     */
+
+    // adds the values of source to target on the given device, falling back to the host
+    template< class T >
+    static void accumulateField(SynchronizedData<T>& target, SynchronizedData<T>& source, int size, Device device, GpuSupport* gpu)
+    {
+        // every component of the perturbation types is a double
+        const size_t count = (size_t)size * (sizeof(T) / sizeof(double));
+        if (gpu && (device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST))
+        {
+            const double* in = reinterpret_cast<const double*>(source.getData(device, false));
+            double* out = reinterpret_cast<double*>(target.getData(device, false));
+            int oldDevice = gpu->getCurrentDevice();
+            gpu->selectDevice(device - DEVICE_CUDA);
+            bool added = gpu->addDoubles(out, in, count);
+            gpu->selectDevice(oldDevice);
+            if (added)
+            {
+                target.update(device);
+                return;
+            }
+        }
+        const double* in = reinterpret_cast<const double*>(source.getData(DEVICE_HOST, false));
+        double* out = reinterpret_cast<double*>(target.getData(DEVICE_HOST, false));
+        parallelFor((int)((count + 1023) / 1024), [=](int begin, int end) {
+            const size_t last = std::min(count, (size_t)end * 1024);
+            for (size_t i = (size_t)begin * 1024; i < last; i++)
+                out[i] += in[i];
+        }, 16);
+        target.update(DEVICE_HOST);
+    }
+
+    // sets all values of a field to zero on the given device, falling back to the host
+    template< class T >
+    static void zeroField(SynchronizedData<T>& field, size_t size, Device device, GpuSupport* gpu)
+    {
+        if (gpu && (device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST))
+        {
+            // the old contents are discarded, so no transfer is required
+            T* ptr = field.getData(device, true);
+            int oldDevice = gpu->getCurrentDevice();
+            gpu->selectDevice(device - DEVICE_CUDA);
+            bool cleared = gpu->zeroMemory(ptr, sizeof(T) * size);
+            gpu->selectDevice(oldDevice);
+            if (cleared)
+            {
+                field.update(device);
+                return;
+            }
+        }
+        char* ptr = reinterpret_cast<char*>(field.getData(DEVICE_HOST, true));
+        const size_t bytes = sizeof(T) * size;
+        parallelFor((int)((bytes + 65535) / 65536), [=](int begin, int end) {
+            const size_t first = (size_t)begin * 65536;
+            memset(ptr + first, 0, std::min(bytes, (size_t)end * 65536) - first);
+        }, 16);
+        field.update(DEVICE_HOST);
+    }
+
+    //! \endcond
+
+    ErrorCode Perturbations::accumulate(const Perturbations& other, Device device)
+    {
+        ErrorCode status = SUCCESS;
+        if (other.getSize() != data->size)
+        {
+            std::cout << "Cannot accumulate perturbations: Sizes differ (" << data->size << " and " << other.getSize() << ")" << std::endl;
+            status = INVALID_ARGUMENT;
+        }
+        else
+        {
+            // only the fields in use by the other object contribute to the sum
+            GpuSupport* gpu = data->host.getGPUSupport();
+            const int fields = other.data->activeFields();
+            if (fields & FIELD_ORBIT) accumulateField(data->data_orbit, other.data->data_orbit, data->size, device, gpu);
+            if (fields & FIELD_POSITION) accumulateField(data->data_position, other.data->data_position, data->size, device, gpu);
+            if (fields & FIELD_VELOCITY) accumulateField(data->data_velocity, other.data->data_velocity, data->size, device, gpu);
+            if (fields & FIELD_ACCELERATION) accumulateField(data->data_acceleration, other.data->data_acceleration, data->size, device, gpu);
+            if (fields & FIELD_PARTIALS) accumulateField(data->data_partials, other.data->data_partials, data->size, device, gpu);
+        }
+        data->host.sendError(status);
+        return status;
+    }
+
+    ErrorCode Perturbations::zero(Device device)
+    {
+        // fields that are not in use hold no memory that could be cleared
+        GpuSupport* gpu = data->host.getGPUSupport();
+        const int fields = data->activeFields();
+        if (fields & FIELD_ORBIT) zeroField(data->data_orbit, data->size, device, gpu);
+        if (fields & FIELD_POSITION) zeroField(data->data_position, data->size, device, gpu);
+        if (fields & FIELD_VELOCITY) zeroField(data->data_velocity, data->size, device, gpu);
+        if (fields & FIELD_ACCELERATION) zeroField(data->data_acceleration, data->size, device, gpu);
+        if (fields & FIELD_PARTIALS) zeroField(data->data_partials, data->size, device, gpu);
+        if (fields & FIELD_BYTES) zeroField(data->data_bytes, (size_t)data->size * data->byteArraySize, device, gpu);
+        return SUCCESS;
+    }
+
     int Perturbations::getSize() const
     {
         return data->size;
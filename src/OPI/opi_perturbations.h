@@ -31,22 +31,38 @@ namespace OPI
     struct IndexPair;
     class IndexList;
 
+    //! \brief Scalar parameters of a propagation step, see Perturbations::getStepParameters()
+    //! \ingroup CPP_API_GROUP
+    struct StepParameters
+    {
+        //! The julian_day argument of the step
+        double julian_day;
+        //! The dt argument of the step
+        double dt;
+    };
+
     /*! \brief This class contains device-synchronizable perturbation information.
      * \ingroup CPP_API_GROUP
      *
      * The purpose of this class is to hold the changes in the object parameters that a
      * Perturbation Module applies to a given population. Like the Population class it can
      * be synchronized to a GPU computing device automatically.
+     *
+     * Only the requested fields (see FieldMask) are allocated, cleared, accumulated and copied.
+     * Accessing any other field allocates it on first use, filled with zeros, and adds it to
+     * the fields in use, so a PartialsMatrix never occupies device memory unless it is
+     * requested or written.
      */
     class Perturbations
     {
         public:
             /**
-             * @brief Perturbations Creates a new Perturbations object, optionally with a given size.
-             * @param host A pointer to the OPI Host that this instance is intended for.
-             * @param size The number of elements. It should match the size of the corresponding Population.
+             * @brief Perturbations Creates a new Perturbations object with the size of a Population.
+             * @param population The Population the perturbations are computed for.
+             * @param fields A combination of FieldMask flags selecting the fields to allocate.
+             * Flags of fields that Perturbations do not hold are ignored.
              */
-            OPI_API_EXPORT Perturbations(const Population& population);
+            OPI_API_EXPORT Perturbations(const Population& population, int fields = FIELD_ALL);
 
             /**
              * @brief Population Copy constructor
@@ -120,6 +136,21 @@ namespace OPI
              */
 			OPI_API_EXPORT int getByteArraySize() const;
 
+            /**
+             * @brief getFields Returns the fields in use.
+             * @return The requested fields and those allocated by accessing them, as
+             * FieldMask flags.
+             */
+            OPI_API_EXPORT int getFields() const;
+
+            /**
+             * @brief requestFields Adds fields to the ones in use.
+             *
+             * The added fields are allocated on the host and set to zero.
+             * @param fields A combination of FieldMask flags.
+             */
+            OPI_API_EXPORT void requestFields(int fields);
+
             /**
              * @brief getLastPropagatorName Returns the name of the last plugin the Population
              * was propagated with.
@@ -164,6 +195,29 @@ namespace OPI
             //! Notify about updates on the specified device
 			OPI_API_EXPORT ErrorCode update(int type, Device device = DEVICE_HOST);
 
+            /**
+             * @brief accumulate Adds the perturbations of another object to this one.
+             *
+             * All fields except the byte array are summed element by element. On a CUDA or
+             * OpenCL device the sum is computed by a kernel, so the results of several
+             * PerturbationModules can be combined without leaving the device; on the host
+             * all cores are used.
+             * @param other The perturbations to be added. Must have the same size.
+             * @param device The device on which the sum is computed and stored.
+             * @return OPI::SUCCESS, or OPI::INVALID_ARGUMENT if the sizes differ.
+             */
+            OPI_API_EXPORT ErrorCode accumulate(const Perturbations& other, Device device = DEVICE_HOST);
+
+            /**
+             * @brief zero Sets all perturbations, including the byte array, to zero.
+             *
+             * The memory is cleared on the given device without any transfers, so the object
+             * can be reused as an accumulator for the next propagation step.
+             * @param device The device on which the data is cleared.
+             * @return OPI::SUCCESS
+             */
+            OPI_API_EXPORT ErrorCode zero(Device device = DEVICE_HOST);
+
             //! Retrieve the orbital parameters on the specified device
 			OPI_API_EXPORT Orbit* getDeltaOrbit(Device device = DEVICE_HOST, bool no_sync = false) const;
             //! Retrieve the position in cartesian coordinates on the specified device
@@ -177,6 +231,18 @@ namespace OPI
             //! Retrieve the arbitrary binary information on the specified device
 			OPI_API_EXPORT char* getBytes(Device device = DEVICE_HOST, bool no_sync = false) const;
 
+            //! Returns the stream on which modules queue their device work, zero for the default stream
+            OPI_API_EXPORT void* getStream() const;
+            //! Returns the parameters of the step in device memory while a step is recorded, null otherwise
+            /**
+             * Kernels recorded into a graph are replayed with the arguments they were recorded
+             * with, so modules supporting step capture (see Module::supportsStepCapture()) read
+             * julian_day and dt from here; the propagator uploads them before every replay.
+             */
+            OPI_API_EXPORT const StepParameters* getStepParameters() const;
+            //! Sets the stream and step parameters returned to the modules, used by CustomPropagator
+            OPI_API_EXPORT void setStepContext(void* stream, const StepParameters* parameters);
+
         protected:
             Host& getHostPointer() const;
 
@@ -0,0 +1,115 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_pipeline.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_indexpairlist.h"
+#include "opi_propagator.h"
+#include "opi_query.h"
+#include "opi_gpusupport.h"
+#include <memory>
+#include <thread>
+namespace OPI
+{
+	//! \cond INTERNAL_DOCUMENTATION
+	class ScreeningPipelineImpl
+	{
+		public:
+			ScreeningPipelineImpl(): propagator(0), query(0), mode(MODE_SINGLE_EPOCH), indices(0) { }
+
+			Propagator* propagator;
+			DistanceQuery* query;
+			PropagationMode mode;
+			IndexList* indices;
+	};
+	//! \endcond
+
+	ScreeningPipeline::ScreeningPipeline(Propagator& propagator, DistanceQuery& query)
+	{
+		impl->propagator = &propagator;
+		impl->query = &query;
+	}
+
+	ScreeningPipeline::~ScreeningPipeline()
+	{
+	}
+
+	void ScreeningPipeline::setPropagationMode(PropagationMode mode, IndexList* indices)
+	{
+		impl->mode = mode;
+		impl->indices = indices;
+	}
+
+	ErrorCode ScreeningPipeline::run(Population& population, double julian_day, double dt, int steps, float cube_size, const PairHandler& handler)
+	{
+		if (steps <= 0)
+			return SUCCESS;
+		Host& host = population.getHostPointer();
+		Propagator& propagator = *impl->propagator;
+		DistanceQuery& query = *impl->query;
+
+		// device selections are per thread, the worker uses the device of the calling thread
+		GpuSupport* gpu = host.getGPUSupport();
+		const int device = gpu ? gpu->getCurrentDevice() : 0;
+
+		ErrorCode status = propagator.propagate(population, julian_day, dt, impl->mode, impl->indices);
+		if (status != SUCCESS)
+			return status;
+
+		// the snapshot buffer is allocated with the first copy and reused for all later steps
+		std::unique_ptr<Population> snapshot(new Population(population));
+		IndexPairList pairs(host);
+		for (int step = 0; step < steps; step++)
+		{
+			// the query structure can only be refitted while the number of objects stays the same
+			bool rebuildQuery = (step == 0);
+			if (step > 0) {
+				if (snapshot->getSize() != population.getSize()) {
+					snapshot.reset(new Population(population));
+					rebuildQuery = true;
+				}
+				else
+					snapshot->copy(population, 0, population.getSize(), 0);
+			}
+			const double epoch = julian_day + (step + 1) * dt / 86400.0;
+			const bool propagateNext = (step + 1 < steps);
+			ErrorCode propagation = SUCCESS;
+			// the propagator of the next step only touches population, the query and the
+			// handler only touch the snapshot; the propagation gets its own thread instead of a
+			// pool task so that it overlaps the screening even if the pool has a single thread
+			std::thread worker;
+			if (propagateNext)
+				worker = std::thread([&]() {
+					if (gpu)
+						gpu->selectDevice(device);
+					propagation = propagator.propagate(population, epoch, dt, impl->mode, impl->indices);
+				});
+			ErrorCode screening = rebuildQuery ? query.rebuild(*snapshot) : query.refit(*snapshot);
+			if (screening == SUCCESS)
+				screening = query.queryCubicPairs(*snapshot, pairs, cube_size);
+			if (screening == SUCCESS && handler)
+				handler(step, epoch, *snapshot, pairs);
+			if (worker.joinable())
+				worker.join();
+			if (screening != SUCCESS)
+				return screening;
+			if (propagation != SUCCESS)
+				return propagation;
+		}
+		return SUCCESS;
+	}
+}
@@ -0,0 +1,72 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_PIPELINE_H
+#define OPI_PIPELINE_H
+#include "opi_common.h"
+#include "opi_error.h"
+#include "opi_datatypes.h"
+#include "opi_pimpl_helper.h"
+#ifdef __cplusplus
+#include <functional>
+namespace OPI
+{
+	class Population;
+	class IndexList;
+	class IndexPairList;
+	class Propagator;
+	class DistanceQuery;
+
+	class ScreeningPipelineImpl;
+	//! \brief Runs a propagate, rebuild and query loop with overlapping steps
+	/** The pipeline holds a second Population as a snapshot buffer. After each propagation step
+	 * the state is copied into the snapshot, on the device holding the data (see
+	 * Population::copy()). The next propagation step then runs concurrently with the distance
+	 * query and the handling of the pairs found in the snapshot, so the propagator keeps the
+	 * device busy while the host processes the results of the previous step.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class ScreeningPipeline
+	{
+		public:
+			//! Called for every step with its index, the epoch after it, the state and the pairs found
+			/** The snapshot and the pairs are only valid during the call. The handler runs
+			 * concurrently with the propagation of the next step and must not access the
+			 * Population passed to run().
+			 */
+			typedef std::function<void(int step, double julian_day, Population& snapshot, IndexPairList& pairs)> PairHandler;
+
+			OPI_API_EXPORT ScreeningPipeline(Propagator& propagator, DistanceQuery& query);
+			OPI_API_EXPORT ~ScreeningPipeline();
+
+			//! Sets the propagation mode and index list passed to the propagator, see Propagator::propagate()
+			OPI_API_EXPORT void setPropagationMode(PropagationMode mode, IndexList* indices = nullptr);
+
+			//! Propagates population by steps steps of dt seconds and screens the state after every step
+			/** Step k propagates from julian_day + k * dt / 86400. After every step all pairs
+			 * within a cube of cube_size are passed to handler. When run() returns, population
+			 * holds the state after the last step. The loop stops at the first error of the
+			 * propagator or the query and returns it.
+			 */
+			OPI_API_EXPORT ErrorCode run(Population& population, double julian_day, double dt, int steps, float cube_size, const PairHandler& handler);
+
+		private:
+			Pimpl<ScreeningPipelineImpl> impl;
+	};
+}
+#endif
+
+#endif
@@ -19,14 +19,25 @@
 #include "opi_gpusupport.h"
 #include "opi_indexlist.h"
 #include "internal/opi_synchronized_data.h"
+#include "internal/opi_memory_map.h"
+#include "internal/opi_name_arena.h"
+#include "internal/opi_parallel.h"
+#include "internal/opi_validation.h"
+#include "internal/opi_reduction.h"
+#include "internal/opi_sampling.h"
+#include "internal/opi_spatial_hash.h"
 #include "internal/miniz.h"
 #include "internal/json.hpp"
 #include <iostream>
 #include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 #include <cassert>
 #include <fstream>
 #include <sstream>
 #include <string.h> //memcpy
+#include <cstddef>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -43,16 +54,21 @@ namespace OPI
 	{
 			ObjectRawData(Host& _host):
 				host(_host),
-				data_orbit(host),
-                data_properties(host),
-				data_position(host),
-				data_velocity(host),
-                data_acceleration(host),
-                data_epoch(host),
-                data_covariance(host),
-                data_bytes(host)
+				data_orbit(host, "Orbit", this),
+                data_properties(host, "ObjectProperties", this),
+				data_position(host, "Position", this),
+				data_velocity(host, "Velocity", this),
+                data_acceleration(host, "Acceleration", this),
+                data_epoch(host, "Epoch", this),
+                data_covariance(host, "Covariance", this),
+                data_bytes(host, "Bytes", this),
+                partitionCount(0),
+                partitionDevice(DEVICE_CUDA)
 			{
-
+                for (int i=0; i<COVARIANCE_STORAGE_VARIANTS; i++) compactCovarianceRevision[i] = COVARIANCE_OUTDATED;
+                epochBoundsRevision = COVARIANCE_OUTDATED;
+                idIndexRevision = COVARIANCE_OUTDATED;
+                idIndexDuplicates = false;
 			}
 
 			Host& host;
@@ -66,15 +82,151 @@ namespace OPI
             SynchronizedData<Covariance> data_covariance;
             SynchronizedData<char> data_bytes;
 
+            // compact variants of the covariances indexed by CovarianceStorage, created on first use
+            static const int COVARIANCE_STORAGE_VARIANTS = 4;
+            static const unsigned long long COVARIANCE_OUTDATED = ~0ULL;
+            std::unique_ptr<SynchronizedData<char> > compactCovariance[COVARIANCE_STORAGE_VARIANTS];
+            // revision of the covariances each variant was converted from
+            unsigned long long compactCovarianceRevision[COVARIANCE_STORAGE_VARIANTS];
+
+            // earliest and latest current epoch, valid while the epochs have epochBoundsRevision
+            unsigned long long epochBoundsRevision;
+            double earliestEpoch;
+            double latestEpoch;
+
+            // object index by ObjectProperties::id, valid while the properties have idIndexRevision
+            std::unordered_map<int, int> idIndex;
+            unsigned long long idIndexRevision;
+            // set if an ID belongs to more than one object; the index then holds one of them
+            bool idIndexDuplicates;
+
             // non-synchronized data
-            std::vector<std::string> object_names;
+            NameArena object_names;
             std::string lastPropagatorName;
             std::string description;
 
 			// data size
 			int size;
             int byteArraySize;
+
+            // devices holding a slice of the population each
+            int partitionCount;
+            Device partitionDevice;
 	};
+
+	// first object of a partition; the slices differ by at most one object in size
+	static int partitionStart(const ObjectRawData* data, int partition)
+	{
+		return (int)(((long long)data->size * partition) / data->partitionCount);
+	}
+
+	// sets the slices of all data arrays, count -1 removes them
+	static void setSlices(ObjectRawData* data, Device device, int offset, int count)
+	{
+		const int b = data->byteArraySize;
+		data->data_orbit.setSlice(device, offset, count);
+		data->data_properties.setSlice(device, offset, count);
+		data->data_position.setSlice(device, offset, count);
+		data->data_velocity.setSlice(device, offset, count);
+		data->data_acceleration.setSlice(device, offset, count);
+		data->data_epoch.setSlice(device, offset, count);
+		data->data_covariance.setSlice(device, offset, count);
+		data->data_bytes.setSlice(device, offset * b, (count < 0) ? -1 : count * b);
+	}
+
+	// distributes the objects across the partition devices
+	static void applyPartition(ObjectRawData* data)
+	{
+		for (int i = 0; i < data->partitionCount; i++)
+		{
+			const int first = partitionStart(data, i);
+			setSlices(data, (Device)(data->partitionDevice + i), first, partitionStart(data, i + 1) - first);
+		}
+	}
+
+	// checks if the latest data of any field is on a GPU
+	static bool hasDeviceField(ObjectRawData* data)
+	{
+		const Device devices[] = {
+			data->data_orbit.getLatestDevice(), data->data_properties.getLatestDevice(),
+			data->data_position.getLatestDevice(), data->data_velocity.getLatestDevice(),
+			data->data_acceleration.getLatestDevice(), data->data_epoch.getLatestDevice(),
+			data->data_covariance.getLatestDevice(), data->data_bytes.getLatestDevice()
+		};
+		for (size_t i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+			if (devices[i] >= DEVICE_CUDA && devices[i] <= DEVICE_CUDA_LAST) return true;
+		return false;
+	}
+
+	// removes the marked objects of a field on the GPU holding its latest data, or on the host
+	template <class T>
+	static void removeMarkedObjects(SynchronizedData<T>& field, const std::vector<char>& mask, IndexList* kept, int arraySize = 1)
+	{
+		if (!kept || !field.compactOnDevice(*kept, arraySize)) field.removeMarked(mask, arraySize);
+	}
+
+	// the ID index can be used if the properties have not changed since it was last updated
+	static bool idIndexValid(ObjectRawData* data)
+	{
+		return data->idIndexRevision == data->data_properties.getRevision();
+	}
+
+	// the ID index can be kept up to date by an operation if the IDs can be read on the host
+	// without a transfer and removing an ID cannot leave another object with it unindexed
+	static bool idIndexMaintainable(ObjectRawData* data)
+	{
+		return idIndexValid(data) && !data->idIndexDuplicates && data->partitionCount == 0
+			&& data->data_properties.hasData() && data->data_properties.getLatestDevice() == DEVICE_HOST;
+	}
+
+	// builds the ID index from the properties on the host
+	static void buildIdIndex(ObjectRawData* data)
+	{
+		data->idIndex.clear();
+		data->idIndexDuplicates = false;
+		if (data->data_properties.hasData())
+		{
+			const ObjectProperties* properties = data->data_properties.getData(DEVICE_HOST, false);
+			data->idIndex.reserve(data->size);
+			for (int i = 0; i < data->size; i++)
+			{
+				if (!data->idIndex.insert(std::make_pair(properties[i].id, i)).second)
+					data->idIndexDuplicates = true;
+			}
+		}
+		data->idIndexRevision = data->data_properties.getRevision();
+	}
+
+	// adds count objects, indices[i] or first + i, to the ID index and marks it as up to date
+	static void indexIds(ObjectRawData* data, const int* indices, int first, int count)
+	{
+		if (data->data_properties.getLatestDevice() != DEVICE_HOST) return;
+		const ObjectProperties* properties = data->data_properties.getData(DEVICE_HOST, false);
+		for (int i = 0; i < count; i++)
+		{
+			const int object = indices ? indices[i] : first + i;
+			if (object < 0 || object >= data->size) continue;
+			std::pair<std::unordered_map<int, int>::iterator, bool> entry = data->idIndex.insert(std::make_pair(properties[object].id, object));
+			if (!entry.second && entry.first->second != object) data->idIndexDuplicates = true;
+		}
+		data->idIndexRevision = data->data_properties.getRevision();
+	}
+
+	// moves the ID index entries to newIndex[former index], removing those that map to -1
+	static void remapIdIndex(ObjectRawData* data, const std::vector<int>& newIndex)
+	{
+		for (std::unordered_map<int, int>::iterator itr = data->idIndex.begin(); itr != data->idIndex.end(); )
+		{
+			const int object = newIndex[itr->second];
+			if (object < 0) itr = data->idIndex.erase(itr);
+			else
+			{
+				itr->second = object;
+				++itr;
+			}
+		}
+		data->idIndexRevision = data->data_properties.getRevision();
+	}
 	/**
 	 * \endcond
 	 */
@@ -111,50 +263,20 @@ namespace OPI
         int b = source.getByteArraySize();
         resize(s);
         resizeByteArray(b);
-        int* listdata = list.getData(DEVICE_HOST);
-
-        Orbit* orbits = source.getOrbit(DEVICE_HOST, false);
-        ObjectProperties* props = source.getObjectProperties(DEVICE_HOST, false);
-        Vector3* pos = source.getPosition(DEVICE_HOST, false);
-        Vector3* vel = source.getVelocity(DEVICE_HOST, false);
-        Vector3* acc = source.getAcceleration(DEVICE_HOST, false);
-        Epoch* ep = source.getEpoch(DEVICE_HOST, false);
-        Covariance* cov = source.getCovariance(DEVICE_HOST, false);
-        char* bytes = source.getBytes(DEVICE_HOST, false);
-
-        Orbit* thisOrbit = getOrbit();
-        ObjectProperties* thisProps = getObjectProperties();
-        Vector3* thisPos = getPosition();
-        Vector3* thisVel = getVelocity();
-        Vector3* thisAcc = getAcceleration();
-        Epoch* thisEp = getEpoch();
-        Covariance* thisCov = getCovariance();
-        char* thisBytes = getBytes();
-
-        for(int i = 0; i < list.getSize(); ++i)
-        {
-            thisOrbit[i] = orbits[listdata[i]];
-            thisProps[i] = props[listdata[i]];
-            thisPos[i] = pos[listdata[i]];
-            thisVel[i] = vel[listdata[i]];
-            thisAcc[i] = acc[listdata[i]];
-            thisEp[i] = ep[listdata[i]];
-            thisCov[i] = cov[listdata[i]];
-            data->object_names[i] = source.getObjectName(i);
-            for (int j=0; j<b; j++)
-            {
-                thisBytes[i*b+j] = bytes[listdata[i]*b+j];
-            }
-        }
 
-        update(DATA_ORBIT);
-        update(DATA_PROPERTIES);
-        update(DATA_POSITION);
-        update(DATA_VELOCITY);
-        update(DATA_ACCELERATION);
-        update(DATA_EPOCH);
-        update(DATA_COVARIANCE);
-        update(DATA_BYTES);
+        // the fields are gathered where their latest data is, so only s objects are transferred
+        ObjectRawData* other = *source.data;
+        data->data_orbit.gatherFrom(other->data_orbit, list);
+        data->data_properties.gatherFrom(other->data_properties, list);
+        data->data_position.gatherFrom(other->data_position, list);
+        data->data_velocity.gatherFrom(other->data_velocity, list);
+        data->data_acceleration.gatherFrom(other->data_acceleration, list);
+        data->data_epoch.gatherFrom(other->data_epoch, list);
+        data->data_covariance.gatherFrom(other->data_covariance, list);
+        if (b > 0) data->data_bytes.gatherFrom(other->data_bytes, list, b);
+
+        if (other->object_names.hasNames())
+            data->object_names.gather(other->object_names, list.getData(DEVICE_HOST), s);
     }
 
 	Population::~Population()
@@ -165,6 +287,7 @@ namespace OPI
     {
         const int oldSize = data->size;
         const int newSize = oldSize + other.getSize();
+        const bool indexed = idIndexMaintainable(*data);
 
         // use the byte array size from this population
         // byte array data from appended population will only be copied
@@ -172,6 +295,7 @@ namespace OPI
         resize(newSize, data->byteArraySize);
 
         copy(other, 0, other.getSize(), oldSize);
+        if (indexed) indexIds(*data, nullptr, oldSize, newSize - oldSize);
     }
 
     void Population::copy(const Population& source, int firstIndex, int length, int offset)
@@ -181,157 +305,210 @@ namespace OPI
             bool copyBytes = (data->byteArraySize == source.getByteArraySize());
             //if (!copyBytes) std::cout << "Warning: Copying population without the byte array" << std::endl;
 
-            // TODO Use std::copy instead
-            memcpy(&getOrbit()[offset], &source.getOrbit(DEVICE_HOST, false)[firstIndex], length*sizeof(Orbit));
-            memcpy(&getObjectProperties()[offset], &source.getObjectProperties(DEVICE_HOST, false)[firstIndex], length*sizeof(ObjectProperties));
-            memcpy(&getPosition()[offset], &source.getPosition(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getVelocity()[offset], &source.getVelocity(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getAcceleration()[offset], &source.getAcceleration(DEVICE_HOST, false)[firstIndex], length*sizeof(Vector3));
-            memcpy(&getEpoch()[offset], &source.getEpoch(DEVICE_HOST, false)[firstIndex], length*sizeof(Epoch));
-            memcpy(&getCovariance()[offset], &source.getCovariance(DEVICE_HOST, false)[firstIndex], length*sizeof(Covariance));
-            for (int i=0; i<length; i++) data->object_names[offset+i] = source.getObjectName(firstIndex+i);
-            if (copyBytes) memcpy(&getBytes()[offset], &source.getBytes(DEVICE_HOST, false)[firstIndex], data->byteArraySize*length*sizeof(char));
-            else memset(&getBytes()[offset], 0, data->byteArraySize*length*sizeof(char));
-
-            update(DATA_ORBIT);
-            update(DATA_PROPERTIES);
-            update(DATA_POSITION);
-            update(DATA_VELOCITY);
-            update(DATA_ACCELERATION);
-            update(DATA_EPOCH);
-            update(DATA_COVARIANCE);
-            if (copyBytes) update(DATA_BYTES);
+            // every field is copied where its latest data is, so device-resident
+            // populations are merged without transfers through host memory
+            ObjectRawData* other = *source.data;
+            data->data_orbit.copyFrom(other->data_orbit, firstIndex, length, offset);
+            data->data_properties.copyFrom(other->data_properties, firstIndex, length, offset);
+            data->data_position.copyFrom(other->data_position, firstIndex, length, offset);
+            data->data_velocity.copyFrom(other->data_velocity, firstIndex, length, offset);
+            data->data_acceleration.copyFrom(other->data_acceleration, firstIndex, length, offset);
+            data->data_epoch.copyFrom(other->data_epoch, firstIndex, length, offset);
+            data->data_covariance.copyFrom(other->data_covariance, firstIndex, length, offset);
+            if (other->object_names.hasNames() || data->object_names.hasNames())
+                data->object_names.copy(other->object_names, firstIndex, length, offset);
+            const int b = data->byteArraySize;
+            if (copyBytes) data->data_bytes.copyFrom(other->data_bytes, firstIndex, length, offset, b);
+            else if (data->data_bytes.hasData()) data->data_bytes.zeroRange(offset*b, length*b);
         }
         else std::cout << "Cannot copy population: Trying to copy " << length << " objects with offset " << offset << " but size is " << length << std::endl;
     }
 
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+    // Block identifiers of the chunked file format that are not data types
+    static const int BLOCK_END = -1;
+    static const int BLOCK_OBJECT_NAMES = -2;
+    // Number of objects per compressed chunk
+    static const int CHUNK_OBJECTS = 16384;
+    // Magic number of the uncompressed, mappable variant of the file format
+    static const int MAPPABLE_FILE_MAGIC = 47629;
+    // Alignment of the columns in mappable files; a multiple of all common page sizes
+    static const unsigned long long MAPPABLE_FILE_ALIGNMENT = 65536;
+    // Magic number of the columnar export format written by writeColumns()
+    static const int COLUMN_FILE_MAGIC = 47630;
+    // Alignment of the exported columns, enough for vectorized loads
+    static const unsigned long long COLUMN_FILE_ALIGNMENT = 64;
+    // Element types of the exported columns
+    static const int COLUMN_FLOAT64 = 0;
+    static const int COLUMN_INT32 = 1;
+    static const int COLUMN_UINT8 = 2;
+
+    // Returns the field mask bit for a block type
+    static int fieldOfBlock(int type)
+    {
+        if (type == BLOCK_OBJECT_NAMES) return FIELD_NAMES;
+        if (type >= 0 && type <= DATA_PARTIALS) return (1 << type);
+        return FIELD_NONE;
+    }
+
+    static void writeInt(std::ostream& out, int value)
+    {
+        out.write(reinterpret_cast<char*>(&value), sizeof(int));
+    }
+
+    static int readInt(std::istream& in)
+    {
+        int value = 0;
+        in.read(reinterpret_cast<char*>(&value), sizeof(int));
+        return value;
+    }
+
+    // Compresses and writes a single chunk, preceded by its uncompressed and compressed size
+    static bool writeChunk(std::ostream& out, const char* source, unsigned long long length, std::vector<unsigned char>& buffer)
+    {
+        mz_ulong compressedSize = compressBound((mz_ulong)length);
+        buffer.resize(compressedSize > 0 ? compressedSize : 1);
+        if (compress(buffer.data(), &compressedSize, reinterpret_cast<const unsigned char*>(source), (mz_ulong)length) != Z_OK) return false;
+        unsigned long long compressedLength = compressedSize;
+        out.write(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+        out.write(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+        out.write(reinterpret_cast<const char*>(buffer.data()), compressedLength);
+        return out.good();
+    }
+
+    // Writes a field block, split into chunks of CHUNK_OBJECTS objects
+    static bool writeBlock(std::ostream& out, int type, int elementSize, const char* source, int numObjects, std::vector<unsigned char>& buffer)
+    {
+        writeInt(out, type);
+        writeInt(out, elementSize);
+        for (int first = 0; first < numObjects; first += CHUNK_OBJECTS)
+        {
+            int count = std::min(CHUNK_OBJECTS, numObjects - first);
+            if (!writeChunk(out, source + (size_t)first * elementSize, (unsigned long long)count * elementSize, buffer)) return false;
+        }
+        return true;
+    }
+
+    // Reads the size information of the next chunk
+    static bool readChunkHeader(std::istream& in, unsigned long long& length, unsigned long long& compressedLength)
+    {
+        in.read(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+        in.read(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+        return in.good();
+    }
+
+    // Reads and decompresses the data of a chunk whose header has already been read
+    static bool decompressChunk(std::istream& in, char* destination, unsigned long long length, unsigned long long compressedLength, std::vector<unsigned char>& buffer)
+    {
+        buffer.resize(compressedLength > 0 ? compressedLength : 1);
+        in.read(reinterpret_cast<char*>(buffer.data()), compressedLength);
+        mz_ulong destinationLength = (mz_ulong)length;
+        return in.good()
+            && uncompress(reinterpret_cast<unsigned char*>(destination), &destinationLength, buffer.data(), (mz_ulong)compressedLength) == Z_OK
+            && destinationLength == length;
+    }
+
+    // Reads and decompresses a chunk of known size directly into the destination
+    static bool readChunk(std::istream& in, char* destination, unsigned long long expectedLength, std::vector<unsigned char>& buffer)
+    {
+        unsigned long long length, compressedLength;
+        if (!readChunkHeader(in, length, compressedLength) || length != expectedLength) return false;
+        return decompressChunk(in, destination, length, compressedLength, buffer);
+    }
+
+    // Skips the given number of chunks without decompressing them
+    static bool skipChunks(std::istream& in, int numChunks)
+    {
+        for (int i = 0; i < numChunks; i++)
+        {
+            unsigned long long length, compressedLength;
+            if (!readChunkHeader(in, length, compressedLength)) return false;
+            in.seekg(compressedLength, std::ios::cur);
+        }
+        return in.good();
+    }
+
+	/**
+	 * \endcond
+	 */
+
 	/**
 	 * \detail
-	 * The File will contain a 32-bit integer containing the number of Objects.
+	 * The file starts with an uncompressed header containing a magic number, the revision
+	 * number, the number of objects, the last propagator name, the description and the
+	 * number of objects per chunk.
 	 * Following are the blocks of data consisting of:
 	 * A 32-bit integer declaring the type of the block, followed by another 32-bit integer defining the size of one entry
-	 * followed by entry_size * number_of_objects bytes containing the actual data
+	 * followed by one or more chunks of up to chunk_size objects. Every chunk is compressed separately and
+	 * starts with two 64-bit integers holding its uncompressed and compressed size.
+	 * Object names are stored in a block of type -2 with variable-sized entries; a block of type -1 ends the file.
+	 * Data is compressed and written one chunk at a time, so no copy of the whole population is kept in memory.
 	 *
 	 * This will not work between machines with different endianness!
 	 */
     void Population::write(const char* filename)
     {
-		int temp;
-        int versionNumber = OPI_DATA_REVISION_NUMBER;
-        int magic = 47627;
-        int nameLength = data->lastPropagatorName.length();        
-        int descLength = data->description.length();
-        std::stringstream out;
-        out.write(reinterpret_cast<char*>(&magic), sizeof(int));
-        out.write(reinterpret_cast<char*>(&versionNumber), sizeof(int));
-        out.write(reinterpret_cast<char*>(&data->size), sizeof(int));
-        out.write(reinterpret_cast<char*>(&nameLength), sizeof(int));
-        out.write(reinterpret_cast<const char*>(data->lastPropagatorName.c_str()), data->lastPropagatorName.length());
-        out.write(reinterpret_cast<char*>(&descLength), sizeof(int));
-        out.write(reinterpret_cast<const char*>(data->description.c_str()), data->description.length());
-        for (int i=0; i<data->size; i++)
-        {
-            int objectNameLength = data->object_names[i].length();
-            out.write(reinterpret_cast<char*>(&objectNameLength), sizeof(int));
-            if (objectNameLength > 0)
-            {
-                out.write(reinterpret_cast<const char*>(data->object_names[i].c_str()), objectNameLength);
-            }
-        }
-        if(data->data_orbit.hasData())
+        std::ofstream out(filename, std::ofstream::binary);
+        if (!out.is_open())
         {
-            temp = DATA_ORBIT;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Orbit);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getOrbit()), sizeof(Orbit) * data->size);
+            std::cout << "Unable to open file " << filename << "!" << std::endl;
+            return;
         }
-        if(data->data_properties.hasData())
+        writeInt(out, 47627);
+        writeInt(out, OPI_DATA_REVISION_NUMBER);
+        writeInt(out, data->size);
+        writeInt(out, data->lastPropagatorName.length());
+        out.write(data->lastPropagatorName.c_str(), data->lastPropagatorName.length());
+        writeInt(out, data->description.length());
+        out.write(data->description.c_str(), data->description.length());
+        writeInt(out, CHUNK_OBJECTS);
+
+        std::vector<unsigned char> buffer;
+        bool ok = true;
+
+        if (data->object_names.hasNames())
         {
-            temp = DATA_PROPERTIES;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(ObjectProperties);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getObjectProperties()), sizeof(ObjectProperties) * data->size);
-        }
-        if(data->data_position.hasData())
-        {
-            temp = DATA_POSITION;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Vector3);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getPosition()), sizeof(Vector3) * data->size);
-        }
-        if(data->data_velocity.hasData())
-        {
-            temp = DATA_VELOCITY;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Vector3);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getVelocity()), sizeof(Vector3) * data->size);
-        }
-        if(data->data_acceleration.hasData())
-        {
-            temp = DATA_ACCELERATION;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Vector3);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getAcceleration()), sizeof(Vector3) * data->size);
-        }
-        if(data->data_epoch.hasData())
-        {
-            temp = DATA_EPOCH;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Epoch);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getEpoch()), sizeof(Epoch) * data->size);
-        }
-        if(data->data_covariance.hasData())
-        {
-            temp = DATA_COVARIANCE;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = sizeof(Covariance);
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getCovariance()), sizeof(Covariance) * data->size);
-        }
-        if(data->data_bytes.hasData())
-        {
-            temp = DATA_BYTES;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            temp = data->byteArraySize;
-            out.write(reinterpret_cast<char*>(&temp), sizeof(int));
-            out.write(reinterpret_cast<char*>(getBytes()), data->byteArraySize * data->size);
-        }
-
-        // Convert stringstream to byte array. Do not use .str() because it will terminate at \0.
-        unsigned long long uncompressedSize = out.tellp();
-        char* bytes = new char[uncompressedSize];
-        out.read(bytes, uncompressedSize);
-
-        // Compress char array using miniz and write to file.
-        unsigned long compressedSize = compressBound(uncompressedSize);
-        unsigned char* compressedData = new unsigned char[compressedSize];
-        int status = compress(compressedData, (mz_ulong*)&compressedSize, (const unsigned char *)bytes, (mz_ulong)uncompressedSize);
-        if (status == Z_OK)
-        {
-            std::ofstream outfile(filename, std::ofstream::binary);
-            outfile.write((const char*)compressedData, compressedSize);
-            // Append uncompressed data size
-            outfile.write(reinterpret_cast<char*>(&uncompressedSize), sizeof(unsigned long long));
-            outfile.close();
-        }
-        else {
-            std::cout << "Failed to compress population data!" << std::endl;
+            writeInt(out, BLOCK_OBJECT_NAMES);
+            writeInt(out, 0);
+            for (int first = 0; first < data->size && ok; first += CHUNK_OBJECTS)
+            {
+                std::string names;
+                int last = std::min(data->size, first + CHUNK_OBJECTS);
+                for (int i=first; i<last; i++)
+                {
+                    int objectNameLength = data->object_names.length(i);
+                    names.append(reinterpret_cast<char*>(&objectNameLength), sizeof(int));
+                    names.append(data->object_names.get(i), objectNameLength);
+                }
+                ok = writeChunk(out, names.data(), names.length(), buffer);
+            }
         }
-        delete[] compressedData;
-        delete[] bytes;
+        if(ok && data->data_orbit.hasData())
+            ok = writeBlock(out, DATA_ORBIT, sizeof(Orbit), reinterpret_cast<char*>(getOrbit()), data->size, buffer);
+        if(ok && data->data_properties.hasData())
+            ok = writeBlock(out, DATA_PROPERTIES, sizeof(ObjectProperties), reinterpret_cast<char*>(getObjectProperties()), data->size, buffer);
+        if(ok && data->data_position.hasData())
+            ok = writeBlock(out, DATA_POSITION, sizeof(Vector3), reinterpret_cast<char*>(getPosition()), data->size, buffer);
+        if(ok && data->data_velocity.hasData())
+            ok = writeBlock(out, DATA_VELOCITY, sizeof(Vector3), reinterpret_cast<char*>(getVelocity()), data->size, buffer);
+        if(ok && data->data_acceleration.hasData())
+            ok = writeBlock(out, DATA_ACCELERATION, sizeof(Vector3), reinterpret_cast<char*>(getAcceleration()), data->size, buffer);
+        if(ok && data->data_epoch.hasData())
+            ok = writeBlock(out, DATA_EPOCH, sizeof(Epoch), reinterpret_cast<char*>(getEpoch()), data->size, buffer);
+        if(ok && data->data_covariance.hasData())
+            ok = writeBlock(out, DATA_COVARIANCE, sizeof(Covariance), reinterpret_cast<char*>(getCovariance()), data->size, buffer);
+        if(ok && data->data_bytes.hasData())
+            ok = writeBlock(out, DATA_BYTES, data->byteArraySize, getBytes(), data->size, buffer);
+        writeInt(out, BLOCK_END);
+        out.close();
+        if (!ok) std::cout << "Failed to write population data!" << std::endl;
     }
 
-	/**
-	 * \detail
-	 * See Population::write for more information
-	 */
-    ErrorCode Population::read(const char* filename)
+    // Reads files of revision 1 and 2 that were compressed as a whole
+    static ErrorCode readLegacyFile(Population& population, ObjectRawData* data, const char* filename, FieldMask fields)
 	{
         std::ifstream infile(filename, std::ifstream::binary);
         if (infile.is_open())
@@ -372,7 +549,7 @@ namespace OPI
                     if (versionNumber >= 1)
                     {
                         in.read(reinterpret_cast<char*>(&number_of_objects), sizeof(int));
-                        resize(number_of_objects);
+                        population.resize(number_of_objects);
                         data->size = number_of_objects;
                         in.read(reinterpret_cast<char*>(&propagatorNameLength), sizeof(int));
                         char* propagatorName = new char[propagatorNameLength];
@@ -393,7 +570,7 @@ namespace OPI
                             {
                                 char* objectName = new char[objectNameLength];
                                 in.read(objectName, objectNameLength);
-                                data->object_names[i] = std::string(objectName, objectNameLength);
+                                data->object_names.set(i, objectName, objectNameLength);
                                 delete[] objectName;
                             }
                         }
@@ -406,12 +583,17 @@ namespace OPI
                             if(!in.eof())
                             {
                                 in.read(reinterpret_cast<char*>(&size), sizeof(int));
+                                if (!(fields & fieldOfBlock(type)))
+                                {
+                                    in.seekg((std::streamoff)number_of_objects * size, std::ios::cur);
+                                    continue;
+                                }
                                 switch(type)
                                 {
                                 case DATA_ORBIT:
                                     if(size == sizeof(Orbit))
                                     {
-                                        Orbit* orbit = getOrbit(DEVICE_HOST, true);
+                                        Orbit* orbit = population.getOrbit(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(orbit), sizeof(Orbit) * number_of_objects);
                                         data->data_orbit.update(DEVICE_HOST);
                                         break;
@@ -419,7 +601,7 @@ namespace OPI
                                 case DATA_PROPERTIES:
                                     if(size == sizeof(ObjectProperties))
                                     {
-                                        ObjectProperties* prop = getObjectProperties(DEVICE_HOST, true);
+                                        ObjectProperties* prop = population.getObjectProperties(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(prop), sizeof(ObjectProperties) * number_of_objects);
                                         data->data_properties.update(DEVICE_HOST);
                                         break;
@@ -427,7 +609,7 @@ namespace OPI
                                 case DATA_POSITION:
                                     if(size == sizeof(Vector3))
                                     {
-                                        Vector3* pos = getPosition(DEVICE_HOST, true);
+                                        Vector3* pos = population.getPosition(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(pos), sizeof(Vector3) * number_of_objects);
                                         data->data_position.update(DEVICE_HOST);
                                         break;
@@ -435,7 +617,7 @@ namespace OPI
                                 case DATA_VELOCITY:
                                     if(size == sizeof(Vector3))
                                     {
-                                        Vector3* vel = getVelocity(DEVICE_HOST, true);
+                                        Vector3* vel = population.getVelocity(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(vel), sizeof(Vector3) * number_of_objects);
                                         data->data_velocity.update(DEVICE_HOST);
                                         break;
@@ -443,7 +625,7 @@ namespace OPI
                                 case DATA_ACCELERATION:
                                     if(size == sizeof(Vector3))
                                     {
-                                        Vector3* acc = getAcceleration(DEVICE_HOST, true);
+                                        Vector3* acc = population.getAcceleration(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(acc), sizeof(Vector3) * number_of_objects);
                                         data->data_acceleration.update(DEVICE_HOST);
                                         break;
@@ -451,7 +633,7 @@ namespace OPI
                                 case DATA_EPOCH:
                                     if(size == sizeof(Epoch))
                                     {
-                                        Epoch* ep = getEpoch(DEVICE_HOST, true);
+                                        Epoch* ep = population.getEpoch(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(ep), sizeof(Epoch) * number_of_objects);
                                         data->data_epoch.update(DEVICE_HOST);
                                         break;
@@ -459,7 +641,7 @@ namespace OPI
                                 case DATA_COVARIANCE:
                                     if(size == sizeof(Covariance))
                                     {
-                                        Covariance* cov = getCovariance(DEVICE_HOST, true);
+                                        Covariance* cov = population.getCovariance(DEVICE_HOST, true);
                                         in.read(reinterpret_cast<char*>(cov), sizeof(Covariance) * number_of_objects);
                                         data->data_covariance.update(DEVICE_HOST);
                                         break;
@@ -467,8 +649,8 @@ namespace OPI
                                 case DATA_BYTES:
                                     if(size == size) //TODO
                                     {
-                                        resizeByteArray(size);
-                                        char* bytes = getBytes(DEVICE_HOST, true);
+                                        population.resizeByteArray(size);
+                                        char* bytes = population.getBytes(DEVICE_HOST, true);
                                         in.read(bytes, size * number_of_objects * sizeof(char));
                                         data->data_bytes.update(DEVICE_HOST);
                                         break;
@@ -493,21 +675,430 @@ namespace OPI
 		return SUCCESS;
 	}
 
+
+    // Entry of the column table of mappable files
+    struct MappedColumn
+    {
+        int type;
+        int elementSize;
+        unsigned long long offset;
+        unsigned long long length;
+    };
+
+    // Maps a range of a column of a mappable file into a SynchronizedData object
+    template< class DataType >
+    static bool mapColumn(SynchronizedData<DataType>& target, const char* filename, const MappedColumn& column, int first, int numObjects)
+    {
+        if (column.length < (unsigned long long)(first + numObjects) * sizeof(DataType)) return false;
+        if (numObjects == 0) return true;
+        std::shared_ptr<MemoryMap> mapping(new MemoryMap(filename, column.offset + (unsigned long long)first * sizeof(DataType), (size_t)numObjects * sizeof(DataType)));
+        if (!mapping->isValid()) return false;
+        target.adoptHostMemory(mapping, numObjects);
+        return true;
+    }
+
+    // Reads the header of a mappable file and maps its columns
+    static ErrorCode readMappableFile(Population& population, ObjectRawData* data, const char* filename, std::ifstream& in, FieldMask fields, int firstIndex, int numObjects)
+    {
+        int versionNumber = readInt(in);
+        if (versionNumber < 3 || versionNumber > OPI_DATA_REVISION_NUMBER)
+        {
+            std::cout << "Unknown file version" << std::endl;
+            return INVALID_DATA;
+        }
+        int number_of_objects = readInt(in);
+        int nameLength = readInt(in);
+        std::string propagatorName(std::max(nameLength, 0), '\0');
+        in.read(&propagatorName[0], propagatorName.length());
+        int descLength = readInt(in);
+        std::string description(std::max(descLength, 0), '\0');
+        in.read(&description[0], description.length());
+        int numColumns = readInt(in);
+        if (!in.good() || number_of_objects < 0 || numColumns < 0)
+        {
+            std::cout << filename << " does not appear to be an OPI population file." << std::endl;
+            return INVALID_DATA;
+        }
+        std::vector<MappedColumn> columns(numColumns);
+        for (int i=0; i<numColumns; i++)
+        {
+            columns[i].type = readInt(in);
+            columns[i].elementSize = readInt(in);
+            in.read(reinterpret_cast<char*>(&columns[i].offset), sizeof(unsigned long long));
+            in.read(reinterpret_cast<char*>(&columns[i].length), sizeof(unsigned long long));
+        }
+        if (!in.good()) return INVALID_DATA;
+        if (firstIndex > number_of_objects) return INDEX_RANGE;
+        if (numObjects < 0 || firstIndex + numObjects > number_of_objects) numObjects = number_of_objects - firstIndex;
+
+        population.resize(numObjects);
+        data->lastPropagatorName = propagatorName;
+        data->description = description;
+
+        bool ok = true;
+        for (int i=0; i<numColumns && ok; i++)
+        {
+            const MappedColumn& column = columns[i];
+            if (!(fields & fieldOfBlock(column.type))) continue;
+            switch(column.type)
+            {
+                case BLOCK_OBJECT_NAMES:
+                {
+                    // names are variable-sized and therefore read instead of mapped
+                    in.seekg(column.offset);
+                    std::string name;
+                    for (int j=0; j<firstIndex + numObjects && ok; j++)
+                    {
+                        int objectNameLength = readInt(in);
+                        ok = in.good() && objectNameLength >= 0;
+                        if (ok && j < firstIndex) in.seekg(objectNameLength, std::ios::cur);
+                        else if (ok && objectNameLength > 0)
+                        {
+                            name.resize(objectNameLength);
+                            in.read(&name[0], objectNameLength);
+                            data->object_names.set(j - firstIndex, name.data(), objectNameLength);
+                        }
+                    }
+                    break;
+                }
+                case DATA_ORBIT: ok = mapColumn(data->data_orbit, filename, column, firstIndex, numObjects); break;
+                case DATA_PROPERTIES: ok = mapColumn(data->data_properties, filename, column, firstIndex, numObjects); break;
+                case DATA_POSITION: ok = mapColumn(data->data_position, filename, column, firstIndex, numObjects); break;
+                case DATA_VELOCITY: ok = mapColumn(data->data_velocity, filename, column, firstIndex, numObjects); break;
+                case DATA_ACCELERATION: ok = mapColumn(data->data_acceleration, filename, column, firstIndex, numObjects); break;
+                case DATA_EPOCH: ok = mapColumn(data->data_epoch, filename, column, firstIndex, numObjects); break;
+                case DATA_COVARIANCE: ok = mapColumn(data->data_covariance, filename, column, firstIndex, numObjects); break;
+                case DATA_BYTES:
+                    if (column.elementSize > 0)
+                    {
+                        population.resizeByteArray(column.elementSize);
+                        ok = mapColumn(data->data_bytes, filename, column, firstIndex * column.elementSize, numObjects * column.elementSize);
+                    }
+                    break;
+                default:
+                    std::cout << "Found unknown block id " << column.type << std::endl;
+            }
+        }
+        if (!ok)
+        {
+            std::cout << "Failed to map population data! " << std::endl;
+            return INVALID_DATA;
+        }
+        return SUCCESS;
+    }
+
+	/**
+	 * \detail
+	 * The uncompressed variant starts with a header containing a magic number, the revision number,
+	 * the number of objects, the last propagator name, the description and a table of columns.
+	 * Each table entry holds the block type and entry size as 32-bit integers, followed by the offset
+	 * and length of the column data as 64-bit integers. Data columns start at offsets aligned to 64 KiB
+	 * and contain the raw array contents. Object names are stored as a 32-bit length followed by
+	 * the characters for every object.
+	 *
+	 * This will not work between machines with different endianness!
+	 */
+    void Population::writeUncompressed(const char* filename)
+    {
+        std::ofstream out(filename, std::ofstream::binary);
+        if (!out.is_open())
+        {
+            std::cout << "Unable to open file " << filename << "!" << std::endl;
+            return;
+        }
+
+        // collect the columns to be written
+        std::vector<MappedColumn> columns;
+        std::vector<const char*> sources;
+        std::string names;
+        if (data->object_names.hasNames())
+        {
+            for (int i=0; i<data->size; i++)
+            {
+                int objectNameLength = data->object_names.length(i);
+                names.append(reinterpret_cast<char*>(&objectNameLength), sizeof(int));
+                names.append(data->object_names.get(i), objectNameLength);
+            }
+            MappedColumn column = { BLOCK_OBJECT_NAMES, 0, 0, names.length() };
+            columns.push_back(column);
+            sources.push_back(names.data());
+        }
+        const unsigned long long n = data->size;
+#define OPI_ADD_COLUMN(field, type, elementSize, pointer) \
+        if (data->field.hasData()) { \
+            MappedColumn column = { type, (int)(elementSize), 0, n * (elementSize) }; \
+            columns.push_back(column); \
+            sources.push_back(reinterpret_cast<const char*>(pointer)); \
+        }
+        OPI_ADD_COLUMN(data_orbit, DATA_ORBIT, sizeof(Orbit), getOrbit())
+        OPI_ADD_COLUMN(data_properties, DATA_PROPERTIES, sizeof(ObjectProperties), getObjectProperties())
+        OPI_ADD_COLUMN(data_position, DATA_POSITION, sizeof(Vector3), getPosition())
+        OPI_ADD_COLUMN(data_velocity, DATA_VELOCITY, sizeof(Vector3), getVelocity())
+        OPI_ADD_COLUMN(data_acceleration, DATA_ACCELERATION, sizeof(Vector3), getAcceleration())
+        OPI_ADD_COLUMN(data_epoch, DATA_EPOCH, sizeof(Epoch), getEpoch())
+        OPI_ADD_COLUMN(data_covariance, DATA_COVARIANCE, sizeof(Covariance), getCovariance())
+        OPI_ADD_COLUMN(data_bytes, DATA_BYTES, data->byteArraySize, getBytes())
+#undef OPI_ADD_COLUMN
+
+        // assign aligned offsets behind the header
+        unsigned long long offset = 7 * sizeof(int) + data->lastPropagatorName.length() + data->description.length()
+                + columns.size() * (2 * sizeof(int) + 2 * sizeof(unsigned long long));
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            offset = (offset + MAPPABLE_FILE_ALIGNMENT - 1) / MAPPABLE_FILE_ALIGNMENT * MAPPABLE_FILE_ALIGNMENT;
+            columns[i].offset = offset;
+            offset += columns[i].length;
+        }
+
+        writeInt(out, MAPPABLE_FILE_MAGIC);
+        writeInt(out, OPI_DATA_REVISION_NUMBER);
+        writeInt(out, data->size);
+        writeInt(out, data->lastPropagatorName.length());
+        out.write(data->lastPropagatorName.c_str(), data->lastPropagatorName.length());
+        writeInt(out, data->description.length());
+        out.write(data->description.c_str(), data->description.length());
+        writeInt(out, columns.size());
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            writeInt(out, columns[i].type);
+            writeInt(out, columns[i].elementSize);
+            out.write(reinterpret_cast<char*>(&columns[i].offset), sizeof(unsigned long long));
+            out.write(reinterpret_cast<char*>(&columns[i].length), sizeof(unsigned long long));
+        }
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            // pad up to the column offset
+            std::vector<char> padding(columns[i].offset - (unsigned long long)out.tellp(), 0);
+            out.write(padding.data(), padding.size());
+            out.write(sources[i], columns[i].length);
+        }
+        out.close();
+        if (!out.good()) std::cout << "Failed to write population data!" << std::endl;
+    }
+
+	/**
+	 * \detail
+	 * See Population::write for more information. Files of revision 1 and 2, which were
+	 * compressed as a whole, can still be read. Files written with Population::writeUncompressed
+	 * are mapped into memory instead of being read.
+	 */
+    ErrorCode Population::read(const char* filename)
+    {
+        return read(filename, FIELD_ALL);
+    }
+
+    ErrorCode Population::read(const char* filename, FieldMask fields, int firstIndex, int numObjects)
+    {
+        std::ifstream in(filename, std::ifstream::binary);
+        if (!in.is_open())
+        {
+            std::cout << "Unable to open file " << filename << "!" << std::endl;
+            return SUCCESS;
+        }
+        if (firstIndex < 0) return INDEX_RANGE;
+        int magic = readInt(in);
+        if (magic == MAPPABLE_FILE_MAGIC)
+        {
+            return readMappableFile(*this, *data, filename, in, fields, firstIndex, numObjects);
+        }
+        // older revisions have no uncompressed header
+        if (magic != 47627)
+        {
+            in.close();
+            if (firstIndex == 0 && numObjects < 0)
+                return readLegacyFile(*this, *data, filename, fields);
+            // legacy files are read completely, then the requested range is copied
+            Population full(getHostPointer());
+            ErrorCode status = readLegacyFile(full, *(full.data), filename, fields);
+            if (status != SUCCESS) return status;
+            if (firstIndex > full.getSize()) return INDEX_RANGE;
+            if (numObjects < 0 || firstIndex + numObjects > full.getSize()) numObjects = full.getSize() - firstIndex;
+            resize(numObjects, full.getByteArraySize());
+            data->lastPropagatorName = full.getLastPropagatorName();
+            data->description = full.getDescription();
+            copy(full, firstIndex, numObjects, 0);
+            return SUCCESS;
+        }
+        int versionNumber = readInt(in);
+        if (versionNumber < 3 || versionNumber > OPI_DATA_REVISION_NUMBER)
+        {
+            std::cout << "Unknown file version" << std::endl;
+            return INVALID_DATA;
+        }
+        int number_of_objects = readInt(in);
+        int nameLength = readInt(in);
+        std::string propagatorName(std::max(nameLength, 0), '\0');
+        in.read(&propagatorName[0], propagatorName.length());
+        int descLength = readInt(in);
+        std::string description(std::max(descLength, 0), '\0');
+        in.read(&description[0], description.length());
+        int chunkObjects = readInt(in);
+        if (!in.good() || number_of_objects < 0 || chunkObjects <= 0)
+        {
+            std::cout << filename << " does not appear to be an OPI population file." << std::endl;
+            return INVALID_DATA;
+        }
+        if (firstIndex > number_of_objects) return INDEX_RANGE;
+        if (numObjects < 0 || firstIndex + numObjects > number_of_objects) numObjects = number_of_objects - firstIndex;
+        const int lastIndex = firstIndex + numObjects;
+        resize(numObjects);
+        data->lastPropagatorName = propagatorName;
+        data->description = description;
+        const int numChunks = (number_of_objects + chunkObjects - 1) / chunkObjects;
+
+        std::vector<unsigned char> buffer;
+        std::vector<char> chunk;
+        bool ok = true;
+        while (ok)
+        {
+            int type = readInt(in);
+            if (!in.good() || type == BLOCK_END) break;
+            int size = readInt(in);
+            if (!(fields & fieldOfBlock(type)))
+            {
+                ok = skipChunks(in, numChunks);
+                continue;
+            }
+            char* destination = 0;
+            switch(type)
+            {
+                case BLOCK_OBJECT_NAMES:
+                {
+                    for (int c = 0; c < numChunks && ok; c++)
+                    {
+                        int chunkFirst = c * chunkObjects;
+                        int chunkLast = std::min(number_of_objects, chunkFirst + chunkObjects);
+                        if (chunkLast <= firstIndex || chunkFirst >= lastIndex)
+                        {
+                            ok = skipChunks(in, 1);
+                            continue;
+                        }
+                        unsigned long long length = 0, compressedLength = 0;
+                        ok = readChunkHeader(in, length, compressedLength);
+                        if (ok) chunk.resize(length);
+                        ok = ok && length > 0 && decompressChunk(in, chunk.data(), length, compressedLength, buffer);
+                        size_t position = 0;
+                        for (int i = chunkFirst; i < chunkLast && ok; i++)
+                        {
+                            int objectNameLength = 0;
+                            ok = (position + sizeof(int) <= chunk.size());
+                            if (!ok) break;
+                            memcpy(&objectNameLength, &chunk[position], sizeof(int));
+                            position += sizeof(int);
+                            ok = (objectNameLength >= 0 && position + objectNameLength <= chunk.size());
+                            if (ok && i >= firstIndex && i < lastIndex)
+                                data->object_names.set(i - firstIndex, &chunk[position], objectNameLength);
+                            position += objectNameLength;
+                        }
+                    }
+                    continue;
+                }
+                case DATA_ORBIT:
+                    if (size == sizeof(Orbit)) destination = reinterpret_cast<char*>(getOrbit(DEVICE_HOST, true));
+                    break;
+                case DATA_PROPERTIES:
+                    if (size == sizeof(ObjectProperties)) destination = reinterpret_cast<char*>(getObjectProperties(DEVICE_HOST, true));
+                    break;
+                case DATA_POSITION:
+                    if (size == sizeof(Vector3)) destination = reinterpret_cast<char*>(getPosition(DEVICE_HOST, true));
+                    break;
+                case DATA_VELOCITY:
+                    if (size == sizeof(Vector3)) destination = reinterpret_cast<char*>(getVelocity(DEVICE_HOST, true));
+                    break;
+                case DATA_ACCELERATION:
+                    if (size == sizeof(Vector3)) destination = reinterpret_cast<char*>(getAcceleration(DEVICE_HOST, true));
+                    break;
+                case DATA_EPOCH:
+                    if (size == sizeof(Epoch)) destination = reinterpret_cast<char*>(getEpoch(DEVICE_HOST, true));
+                    break;
+                case DATA_COVARIANCE:
+                    if (size == sizeof(Covariance)) destination = reinterpret_cast<char*>(getCovariance(DEVICE_HOST, true));
+                    break;
+                case DATA_BYTES:
+                    if (size > 0)
+                    {
+                        resizeByteArray(size);
+                        destination = getBytes(DEVICE_HOST, true);
+                    }
+                    break;
+            }
+            if (destination)
+            {
+                for (int c = 0; c < numChunks && ok; c++)
+                {
+                    int chunkFirst = c * chunkObjects;
+                    int chunkLast = std::min(number_of_objects, chunkFirst + chunkObjects);
+                    unsigned long long chunkLength = (unsigned long long)(chunkLast - chunkFirst) * size;
+                    if (chunkLast <= firstIndex || chunkFirst >= lastIndex)
+                    {
+                        // chunk lies outside of the requested range
+                        ok = skipChunks(in, 1);
+                    }
+                    else if (chunkFirst >= firstIndex && chunkLast <= lastIndex)
+                    {
+                        ok = readChunk(in, destination + (size_t)(chunkFirst - firstIndex) * size, chunkLength, buffer);
+                    }
+                    else {
+                        // chunk is only partially requested
+                        chunk.resize(chunkLength);
+                        ok = readChunk(in, chunk.data(), chunkLength, buffer);
+                        int overlapFirst = std::max(firstIndex, chunkFirst);
+                        int overlapLast = std::min(lastIndex, chunkLast);
+                        if (ok) memcpy(destination + (size_t)(overlapFirst - firstIndex) * size,
+                                       chunk.data() + (size_t)(overlapFirst - chunkFirst) * size,
+                                       (size_t)(overlapLast - overlapFirst) * size);
+                    }
+                }
+                update(type);
+            }
+            else {
+                std::cout << "Found unknown block id " << type << std::endl;
+                ok = skipChunks(in, numChunks);
+            }
+        }
+        if (!ok)
+        {
+            std::cout << "Failed to decompress population data! " << std::endl;
+            return INVALID_DATA;
+        }
+        return SUCCESS;
+    }
+
     void Population::writeJSON(const char* filename)
     {
-        json objects;
+        std::ofstream outfile(filename);
+        if (!outfile.is_open())
+        {
+            std::cout << "Unable to open file " << filename << "!" << std::endl;
+            return;
+        }
+        const Vector3* position = getPosition(DEVICE_HOST, false);
+        const Vector3* velocity = getVelocity(DEVICE_HOST, false);
+        const Vector3* acceleration = getAcceleration(DEVICE_HOST, false);
+        const Orbit* orbit = getOrbit(DEVICE_HOST, false);
+        const Epoch* epoch = getEpoch(DEVICE_HOST, false);
+        const ObjectProperties* properties = getObjectProperties(DEVICE_HOST, false);
+        const Covariance* covariance = getCovariance(DEVICE_HOST, false);
+
+        // the document is written object by object so the memory use does not depend on the
+        // population size; the output is identical to dumping the complete document
+        outfile << "{\n  \"description\": " << json(getDescription()).dump()
+                << ",\n  \"earliest_epoch\": " << json(getEarliestEpoch()).dump()
+                << ",\n  \"latest_epoch\": " << json(getLatestEpoch()).dump()
+                << ",\n  \"objects\": " << (getSize() > 0 ? "[\n" : "null");
+        std::string objectString;
         for (int i=0; i<getSize(); i++)
         {
             json o;
-            Vector3 p = getPosition()[i];
-            Vector3 v = getVelocity()[i];
-            Vector3 a = getAcceleration()[i];
-            Orbit orb = getOrbit()[i];
-            Epoch e = getEpoch()[i];
-            ObjectProperties pr = getObjectProperties()[i];
-            Covariance c = getCovariance()[i];
-            if (std::string(getObjectName(i)) != "")
-                o["name"] = getObjectName(i);
+            const Vector3& p = position[i];
+            const Vector3& v = velocity[i];
+            const Vector3& a = acceleration[i];
+            const Orbit& orb = orbit[i];
+            const Epoch& e = epoch[i];
+            const ObjectProperties& pr = properties[i];
+            const Covariance& c = covariance[i];
+            if (data->object_names.length(i) > 0)
+                o["name"] = data->object_names.get(i);
             if (!isZero(p))
                 o["position"] = {{"x",p.x}, {"y",p.y}, {"z",p.z}};
             if (!isZero(v))
@@ -524,41 +1115,207 @@ namespace OPI
                 o["covariance"] = {c.k1_k1, c.k2_k1, c.k2_k2, c.k3_k1, c.k3_k2, c.k3_k3, c.k4_k1, c.k4_k2, c.k4_k3, c.k4_k4, c.k5_k1, c.k5_k2, c.k5_k3, c.k5_k4, c.k5_k5,
                         c.k6_k1, c.k6_k2, c.k6_k3, c.k6_k4, c.k6_k5, c.k6_k6, c.d1_k1, c.d1_k2, c.d1_k3, c.d1_k4, c.d1_k5, c.d1_k6, c.d1_d1,
                         c.d2_k1, c.d2_k2, c.d2_k3, c.d2_k4, c.d2_k5, c.d2_k6, c.d2_d1, c.d2_d2};
-            objects.push_back(o);
+
+            // indent the object to its level within the document
+            const std::string dumped = o.dump(2);
+            objectString.assign("    ");
+            for (size_t j=0; j<dumped.size(); j++)
+            {
+                objectString.push_back(dumped[j]);
+                if (dumped[j] == '\n') objectString.append("    ");
+            }
+            objectString.append(i + 1 < getSize() ? ",\n" : "\n  ]");
+            outfile.write(objectString.c_str(), objectString.size());
         }
-        json jp;
-        jp["description"] = getDescription();
-        jp["earliest_epoch"] = getEarliestEpoch();
-        jp["latest_epoch"] = getLatestEpoch();
-        jp["objects"] = objects;
-        std::ofstream outfile(filename);
-        std::string jsonString = jp.dump(2);
-        outfile.write(jsonString.c_str(), jsonString.size());
+        outfile << "\n}";
         outfile.close();
     }
 
-    void Population::resize(int size, int byteArraySize)
-	{
-		if(data->size != size)
-		{
-			data->data_orbit.resize(size);
-			data->data_properties.resize(size);
-			data->data_position.resize(size);
-			data->data_velocity.resize(size);
-            data->data_acceleration.resize(size);
-            data->data_epoch.resize(size);
-            data->data_covariance.resize(size);
-            data->data_bytes.resize(size*byteArraySize);
-            data->object_names.resize(size);
-			data->size = size;
-            data->byteArraySize = byteArraySize;
-		}
-	}
-
-    void Population::resizeByteArray(int size)
+    // A column of the columnar export, copied from a field of elementSize bytes every stride bytes
+    struct ExportColumn
     {
-        data->data_bytes.resize(data->size * size);
+        std::string name;
+        int type;
+        int elementSize;
+        const char* source;
+        size_t stride;
+        unsigned long long offset;
+        unsigned long long length;
+    };
+
+    void Population::writeColumns(const char* filename)
+    {
+        std::ofstream out(filename, std::ofstream::binary);
+        if (!out.is_open())
+        {
+            std::cout << "Unable to open file " << filename << "!" << std::endl;
+            return;
+        }
+
+        // collect the columns to be written, one per component of each field
+        const int n = data->size;
+        std::vector<ExportColumn> columns;
+#define OPI_EXPORT_COLUMN(field, pointer, Type, member, columnName, columnType, size) \
+        if (data->field.hasData()) { \
+            ExportColumn column = { columnName, columnType, (int)(size), reinterpret_cast<const char*>(pointer) + offsetof(Type, member), sizeof(Type), 0, (unsigned long long)n * (size) }; \
+            columns.push_back(column); \
+        }
+#define OPI_EXPORT_DOUBLE(field, pointer, Type, member, columnName) OPI_EXPORT_COLUMN(field, pointer, Type, member, columnName, COLUMN_FLOAT64, sizeof(double))
+        const Orbit* orbit = getOrbit(DEVICE_HOST, false);
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, semi_major_axis, "orbit.sma")
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, eccentricity, "orbit.ecc")
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, inclination, "orbit.inc")
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, raan, "orbit.raan")
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, arg_of_perigee, "orbit.aop")
+        OPI_EXPORT_DOUBLE(data_orbit, orbit, Orbit, mean_anomaly, "orbit.ma")
+        const ObjectProperties* properties = getObjectProperties(DEVICE_HOST, false);
+        OPI_EXPORT_COLUMN(data_properties, properties, ObjectProperties, id, "properties.id", COLUMN_INT32, sizeof(int))
+        OPI_EXPORT_DOUBLE(data_properties, properties, ObjectProperties, mass, "properties.mass")
+        OPI_EXPORT_DOUBLE(data_properties, properties, ObjectProperties, diameter, "properties.dia")
+        OPI_EXPORT_DOUBLE(data_properties, properties, ObjectProperties, area_to_mass, "properties.a2m")
+        OPI_EXPORT_DOUBLE(data_properties, properties, ObjectProperties, drag_coefficient, "properties.cd")
+        OPI_EXPORT_DOUBLE(data_properties, properties, ObjectProperties, reflectivity, "properties.cr")
+        const Vector3* position = getPosition(DEVICE_HOST, false);
+        OPI_EXPORT_DOUBLE(data_position, position, Vector3, x, "position.x")
+        OPI_EXPORT_DOUBLE(data_position, position, Vector3, y, "position.y")
+        OPI_EXPORT_DOUBLE(data_position, position, Vector3, z, "position.z")
+        const Vector3* velocity = getVelocity(DEVICE_HOST, false);
+        OPI_EXPORT_DOUBLE(data_velocity, velocity, Vector3, x, "velocity.x")
+        OPI_EXPORT_DOUBLE(data_velocity, velocity, Vector3, y, "velocity.y")
+        OPI_EXPORT_DOUBLE(data_velocity, velocity, Vector3, z, "velocity.z")
+        const Vector3* acceleration = getAcceleration(DEVICE_HOST, false);
+        OPI_EXPORT_DOUBLE(data_acceleration, acceleration, Vector3, x, "acceleration.x")
+        OPI_EXPORT_DOUBLE(data_acceleration, acceleration, Vector3, y, "acceleration.y")
+        OPI_EXPORT_DOUBLE(data_acceleration, acceleration, Vector3, z, "acceleration.z")
+        const Epoch* epoch = getEpoch(DEVICE_HOST, false);
+        OPI_EXPORT_DOUBLE(data_epoch, epoch, Epoch, beginning_of_life, "epoch.bol")
+        OPI_EXPORT_DOUBLE(data_epoch, epoch, Epoch, end_of_life, "epoch.eol")
+        OPI_EXPORT_DOUBLE(data_epoch, epoch, Epoch, current_epoch, "epoch.current")
+        if (data->data_covariance.hasData())
+        {
+            // the covariance components are named like the members, e.g. covariance.k2_k1
+            static const char* covarianceNames[] = {
+                "k1_k1", "k2_k1", "k2_k2", "k3_k1", "k3_k2", "k3_k3", "k4_k1", "k4_k2", "k4_k3", "k4_k4",
+                "k5_k1", "k5_k2", "k5_k3", "k5_k4", "k5_k5", "k6_k1", "k6_k2", "k6_k3", "k6_k4", "k6_k5", "k6_k6",
+                "d1_k1", "d1_k2", "d1_k3", "d1_k4", "d1_k5", "d1_k6", "d1_d1",
+                "d2_k1", "d2_k2", "d2_k3", "d2_k4", "d2_k5", "d2_k6", "d2_d1", "d2_d2" };
+            const char* covariance = reinterpret_cast<const char*>(getCovariance(DEVICE_HOST, false));
+            for (int c=0; c<Columns<Covariance>::components(); c++)
+            {
+                ExportColumn column = { std::string("covariance.") + covarianceNames[c], COLUMN_FLOAT64, (int)sizeof(double),
+                                        covariance + c * sizeof(double), sizeof(Covariance), 0, (unsigned long long)n * sizeof(double) };
+                columns.push_back(column);
+            }
+        }
+#undef OPI_EXPORT_DOUBLE
+#undef OPI_EXPORT_COLUMN
+        if (data->byteArraySize > 0 && data->data_bytes.hasData())
+        {
+            const int b = data->byteArraySize;
+            ExportColumn column = { "bytes", COLUMN_UINT8, b, getBytes(DEVICE_HOST, false), (size_t)b, 0, (unsigned long long)n * b };
+            columns.push_back(column);
+        }
+
+        // object names are stored like strings in Arrow: n+1 offsets into the concatenated names
+        std::vector<int> nameOffsets;
+        if (data->object_names.hasNames())
+        {
+            nameOffsets.resize(n + 1, 0);
+            for (int i=0; i<n; i++) nameOffsets[i+1] = nameOffsets[i] + data->object_names.length(i);
+            ExportColumn offsets = { "name.offsets", COLUMN_INT32, (int)sizeof(int), reinterpret_cast<const char*>(nameOffsets.data()), sizeof(int), 0, (unsigned long long)(n + 1) * sizeof(int) };
+            ExportColumn names = { "name.data", COLUMN_UINT8, 1, 0, 1, 0, (unsigned long long)nameOffsets[n] };
+            columns.push_back(offsets);
+            columns.push_back(names);
+        }
+
+        // assign aligned offsets behind the header
+        unsigned long long offset = 4 * sizeof(int);
+        for (size_t i=0; i<columns.size(); i++)
+            offset += 3 * sizeof(int) + columns[i].name.length() + 2 * sizeof(unsigned long long);
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            offset = (offset + COLUMN_FILE_ALIGNMENT - 1) / COLUMN_FILE_ALIGNMENT * COLUMN_FILE_ALIGNMENT;
+            columns[i].offset = offset;
+            offset += columns[i].length;
+        }
+
+        writeInt(out, COLUMN_FILE_MAGIC);
+        writeInt(out, OPI_DATA_REVISION_NUMBER);
+        writeInt(out, n);
+        writeInt(out, columns.size());
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            writeInt(out, columns[i].name.length());
+            out.write(columns[i].name.c_str(), columns[i].name.length());
+            writeInt(out, columns[i].type);
+            writeInt(out, columns[i].elementSize);
+            out.write(reinterpret_cast<char*>(&columns[i].offset), sizeof(unsigned long long));
+            out.write(reinterpret_cast<char*>(&columns[i].length), sizeof(unsigned long long));
+        }
+
+        // components are collected in chunks, so only a small buffer is needed
+        std::vector<char> buffer;
+        for (size_t i=0; i<columns.size(); i++)
+        {
+            const ExportColumn& column = columns[i];
+            std::vector<char> padding(column.offset - (unsigned long long)out.tellp(), 0);
+            out.write(padding.data(), padding.size());
+            if (!column.source)
+            {
+                for (int j=0; j<n; j++) out.write(data->object_names.get(j), data->object_names.length(j));
+                continue;
+            }
+            const int count = (int)(column.length / column.elementSize);
+            buffer.resize((size_t)CHUNK_OBJECTS * column.elementSize);
+            for (int first = 0; first < count; first += CHUNK_OBJECTS)
+            {
+                const int chunk = std::min(CHUNK_OBJECTS, count - first);
+                for (int j=0; j<chunk; j++)
+                    memcpy(&buffer[(size_t)j * column.elementSize], column.source + (size_t)(first + j) * column.stride, column.elementSize);
+                out.write(buffer.data(), (size_t)chunk * column.elementSize);
+            }
+        }
+        if (!out.good()) std::cout << "Error writing file " << filename << "!" << std::endl;
+        out.close();
+    }
+
+    void Population::resize(int size, int byteArraySize)
+	{
+		if(data->size != size)
+		{
+			data->data_orbit.resize(size);
+			data->data_properties.resize(size);
+			data->data_position.resize(size);
+			data->data_velocity.resize(size);
+            data->data_acceleration.resize(size);
+            data->data_epoch.resize(size);
+            data->data_covariance.resize(size);
+            data->data_bytes.resize(size*byteArraySize);
+            data->object_names.resize(size);
+			data->size = size;
+            data->byteArraySize = byteArraySize;
+            applyPartition(*data);
+		}
+	}
+
+    void Population::resizeByteArray(int size)
+    {
+        data->data_bytes.resize(data->size * size);
         data->byteArraySize = size;
+        applyPartition(*data);
+    }
+
+    void Population::shrinkToFit()
+    {
+        data->data_orbit.shrinkToFit();
+        data->data_properties.shrinkToFit();
+        data->data_position.shrinkToFit();
+        data->data_velocity.shrinkToFit();
+        data->data_acceleration.shrinkToFit();
+        data->data_epoch.shrinkToFit();
+        data->data_covariance.shrinkToFit();
+        data->data_bytes.shrinkToFit();
+        data->object_names.shrinkToFit();
     }
 
     const char* Population::getLastPropagatorName() const
@@ -584,7 +1341,7 @@ namespace OPI
     const char* Population::getObjectName(int index) const
     {
         if (index < data->size)
-            return data->object_names[index].c_str();
+            return data->object_names.get(index);
         else return "";
     }
 
@@ -592,7 +1349,7 @@ namespace OPI
     {
         if (index < data->size)
         {
-            data->object_names[index] = std::string(name);
+            data->object_names.set(index, name, (int)strlen(name));
         }
         else std::cout << "Cannot set object name: Index (" << index << ") out of range!" << std::endl;
     }
@@ -673,89 +1430,400 @@ namespace OPI
         return data->data_bytes.getData(device, no_sync);
     }
 
+    Columns<Orbit> Population::getOrbitColumns(Device device, bool no_sync) const
+    {
+        return Columns<Orbit>(data->data_orbit.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<ObjectProperties> Population::getObjectPropertiesColumns(Device device, bool no_sync) const
+    {
+        return Columns<ObjectProperties>(data->data_properties.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<Vector3> Population::getPositionColumns(Device device, bool no_sync) const
+    {
+        return Columns<Vector3>(data->data_position.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<Vector3> Population::getVelocityColumns(Device device, bool no_sync) const
+    {
+        return Columns<Vector3>(data->data_velocity.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<Vector3> Population::getAccelerationColumns(Device device, bool no_sync) const
+    {
+        return Columns<Vector3>(data->data_acceleration.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<Epoch> Population::getEpochColumns(Device device, bool no_sync) const
+    {
+        return Columns<Epoch>(data->data_epoch.getColumns(device, no_sync), getSize());
+    }
+
+    Columns<Covariance> Population::getCovarianceColumns(Device device, bool no_sync) const
+    {
+        return Columns<Covariance>(data->data_covariance.getColumns(device, no_sync), getSize());
+    }
+
+    // Number of elements of a covariance storage variant, and if they are stored as floats
+    static int covarianceStorageElements(CovarianceStorage storage, bool& single)
+    {
+        single = (storage == COVARIANCE_FLOAT || storage == COVARIANCE_STATE_ONLY_FLOAT);
+        // the kinematic block k1_k1 to k6_k6 is at the start of the packed triangle
+        return (storage == COVARIANCE_STATE_ONLY || storage == COVARIANCE_STATE_ONLY_FLOAT) ? 21 : sizeof(Covariance) / sizeof(double);
+    }
+
+    // Converts full covariances to a storage variant on the host, or expands the variant back
+    template< class T >
+    static void convertCovariance(T* compact, Covariance* covariance, int size, int elements, bool toCompact)
+    {
+        parallelFor(size, [=](int begin, int end) {
+            for (int i=begin; i<end; i++)
+            {
+                double* full = reinterpret_cast<double*>(covariance + i);
+                T* variant = compact + (size_t)i * elements;
+                if (toCompact) for (int c=0; c<elements; c++) variant[c] = (T)full[c];
+                else for (int c=0; c<elements; c++) full[c] = variant[c];
+            }
+        });
+    }
+
+    int Population::getCovarianceStorageSize(CovarianceStorage storage)
+    {
+        bool single;
+        switch (storage)
+        {
+            case COVARIANCE_FULL:
+            case COVARIANCE_STATE_ONLY:
+            case COVARIANCE_FLOAT:
+            case COVARIANCE_STATE_ONLY_FLOAT:
+                return covarianceStorageElements(storage, single) * (single ? sizeof(float) : sizeof(double));
+            default:
+                return 0;
+        }
+    }
+
+    void* Population::getCompactCovariance(CovarianceStorage storage, Device device, bool no_sync) const
+    {
+        if (storage == COVARIANCE_FULL) return getCovariance(device, no_sync);
+        const int elementSize = getCovarianceStorageSize(storage);
+        if (elementSize == 0)
+        {
+            data->host.sendError(INVALID_TYPE);
+            return 0;
+        }
+        std::unique_ptr<SynchronizedData<char> >& compact = data->compactCovariance[storage];
+        if (!compact) compact.reset(new SynchronizedData<char>(data->host, "CompactCovariance", *data));
+        if (compact->getSize() != data->size * elementSize)
+        {
+            compact->resize(data->size * elementSize);
+            data->compactCovarianceRevision[storage] = ObjectRawData::COVARIANCE_OUTDATED;
+        }
+        // the caller overwrites the variant and calls updateCompactCovariance() afterwards
+        if (no_sync) return compact->getData(device, true);
+
+        if (data->compactCovarianceRevision[storage] != data->data_covariance.getRevision())
+        {
+            bool single;
+            const int elements = covarianceStorageElements(storage, single);
+            bool converted = false;
+            if (!data->data_covariance.hasData())
+            {
+                // covariances that were never set are zero, they are not allocated for the conversion
+                memset(compact->getData(DEVICE_HOST, true), 0, (size_t)data->size * elementSize);
+                compact->update(DEVICE_HOST);
+                converted = true;
+            }
+            // convert on the device holding the latest covariances, so they are not downloaded
+            const Device latest = data->data_covariance.getLatestDevice();
+            GpuSupport* gpu = data->host.getGPUSupport();
+            if (!converted && gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST && data->partitionCount == 0)
+            {
+                const Covariance* covariance = data->data_covariance.getData(latest, false);
+                char* destination = compact->getData(latest, true);
+                const int oldDevice = gpu->getCurrentDevice();
+                gpu->selectDevice(latest - DEVICE_CUDA);
+                converted = gpu->compactCovariance(destination, covariance, data->size, elements, single);
+                gpu->selectDevice(oldDevice);
+                if (converted) compact->update(latest);
+            }
+            if (!converted)
+            {
+                Covariance* covariance = data->data_covariance.getData(DEVICE_HOST, false);
+                char* destination = compact->getData(DEVICE_HOST, true);
+                if (single) convertCovariance(reinterpret_cast<float*>(destination), covariance, data->size, elements, true);
+                else convertCovariance(reinterpret_cast<double*>(destination), covariance, data->size, elements, true);
+                compact->update(DEVICE_HOST);
+            }
+            // read after the synchronization, which may write back pending columns
+            data->compactCovarianceRevision[storage] = data->data_covariance.getRevision();
+        }
+        return compact->getData(device, false);
+    }
+
+    ErrorCode Population::updateCompactCovariance(CovarianceStorage storage, Device device)
+    {
+        if (storage == COVARIANCE_FULL) return update(DATA_COVARIANCE, device);
+        ErrorCode status = SUCCESS;
+        if (getCovarianceStorageSize(storage) == 0) status = INVALID_TYPE;
+        else if (!data->compactCovariance[storage]) status = INVALID_ARGUMENT;
+        if (status != SUCCESS)
+        {
+            data->host.sendError(status);
+            return status;
+        }
+        SynchronizedData<char>& compact = *data->compactCovariance[storage];
+        compact.update(device);
+
+        // expand on the host, only the variant is transferred
+        bool single;
+        const int elements = covarianceStorageElements(storage, single);
+        char* source = compact.getData(DEVICE_HOST, false);
+        // elements outside of the variant have to be kept
+        const bool complete = (elements * sizeof(double) == sizeof(Covariance));
+        Covariance* covariance = data->data_covariance.getData(DEVICE_HOST, complete);
+        if (single) convertCovariance(reinterpret_cast<float*>(source), covariance, data->size, elements, false);
+        else convertCovariance(reinterpret_cast<double*>(source), covariance, data->size, elements, false);
+        data->data_covariance.update(DEVICE_HOST);
+        // the other variants are outdated now, this one is not
+        data->compactCovarianceRevision[storage] = data->data_covariance.getRevision();
+        return SUCCESS;
+    }
+
 	void Population::remove(IndexList &list)
 	{
-		list.sort();
+		// mark all objects to be removed, then compact every array in a single pass
+		std::vector<char> mask(data->size, 0);
 		int* listdata = list.getData(DEVICE_HOST);
-		int offset = 0;
+		int removed = 0;
 		for(int i = 0; i < list.getSize(); ++i)
 		{
-			remove(listdata[i] - offset);
-			offset++;
+			int index = listdata[i];
+			if (index >= 0 && index < data->size && !mask[index])
+			{
+				mask[index] = 1;
+				removed++;
+			}
+		}
+		if (removed == 0) return;
+		const bool indexed = idIndexMaintainable(*data);
+
+		// fields on a GPU are compacted there, which only transfers the indices of the remaining objects
+		std::unique_ptr<IndexList> kept;
+		if (hasDeviceField(*data))
+		{
+			kept.reset(new IndexList(data->host));
+			kept->reserve(data->size - removed);
+			kept->update(DEVICE_HOST, data->size - removed);
+			int* keptdata = kept->getData(DEVICE_HOST, true);
+			for (int i = 0, k = 0; i < data->size; i++)
+				if (!mask[i]) keptdata[k++] = i;
+			kept->update(DEVICE_HOST, data->size - removed);
+		}
+		removeMarkedObjects(data->data_orbit, mask, kept.get());
+		removeMarkedObjects(data->data_properties, mask, kept.get());
+		removeMarkedObjects(data->data_position, mask, kept.get());
+		removeMarkedObjects(data->data_velocity, mask, kept.get());
+		removeMarkedObjects(data->data_acceleration, mask, kept.get());
+		removeMarkedObjects(data->data_epoch, mask, kept.get());
+		removeMarkedObjects(data->data_covariance, mask, kept.get());
+		removeMarkedObjects(data->data_bytes, mask, kept.get(), data->byteArraySize);
+
+		data->object_names.removeMarked(mask);
+		if (indexed)
+		{
+			std::vector<int> newIndex(data->size);
+			int next = 0;
+			for (int i = 0; i < data->size; i++) newIndex[i] = mask[i] ? -1 : next++;
+			remapIdIndex(*data, newIndex);
 		}
+		data->size -= removed;
+		applyPartition(*data);
 	}
 
+    ErrorCode Population::reorder(IndexList& permutation)
+    {
+        const int n = data->size;
+        ErrorCode status = (permutation.getSize() == n) ? SUCCESS : INVALID_ARGUMENT;
+        const int* indices = permutation.getData(DEVICE_HOST);
+        std::vector<char> seen(n, 0);
+        for (int i=0; i<n && status == SUCCESS; i++)
+        {
+            if (indices[i] < 0 || indices[i] >= n || seen[indices[i]]) status = INVALID_ARGUMENT;
+            else seen[indices[i]] = 1;
+        }
+        if (status != SUCCESS)
+        {
+            std::cout << "Cannot reorder population: The index list is not a permutation of all " << n << " objects" << std::endl;
+            data->host.sendError(status);
+            return status;
+        }
+
+        const bool indexed = idIndexValid(*data);
+        data->data_orbit.permute(permutation);
+        data->data_properties.permute(permutation);
+        data->data_position.permute(permutation);
+        data->data_velocity.permute(permutation);
+        data->data_acceleration.permute(permutation);
+        data->data_epoch.permute(permutation);
+        data->data_covariance.permute(permutation);
+        if (data->byteArraySize > 0) data->data_bytes.permute(permutation, data->byteArraySize);
+
+        data->object_names.permute(indices);
+        if (indexed)
+        {
+            std::vector<int> newIndex(n);
+            for (int i=0; i<n; i++) newIndex[indices[i]] = i;
+            remapIdIndex(*data, newIndex);
+        }
+        return SUCCESS;
+    }
+
+    ErrorCode Population::getSpatialOrder(IndexList& permutation) const
+    {
+        const int n = data->size;
+        if (!data->data_position.hasData())
+        {
+            data->host.sendError(INVALID_ARGUMENT);
+            return INVALID_ARGUMENT;
+        }
+        if (n == 0)
+        {
+            permutation.update(DEVICE_HOST, 0);
+            return SUCCESS;
+        }
+        const Vector3* position = getPosition(DEVICE_HOST);
+        Vector3 lower = position[0];
+        Vector3 upper = position[0];
+        for (int i=1; i<n; i++)
+        {
+            lower.x = std::min(lower.x, position[i].x); upper.x = std::max(upper.x, position[i].x);
+            lower.y = std::min(lower.y, position[i].y); upper.y = std::max(upper.y, position[i].y);
+            lower.z = std::min(lower.z, position[i].z); upper.z = std::max(upper.z, position[i].z);
+        }
+        // map the bounding box onto 2^21 cells per axis
+        const double cells = (double)((1 << 21) - 1);
+        const double scale = cells / std::max(1e-9, std::max(upper.x - lower.x, std::max(upper.y - lower.y, upper.z - lower.z)));
+
+        // sorting by key and index keeps objects within the same cell in their current order
+        std::vector<std::pair<unsigned long long, int> > keys(n);
+        parallelFor(n, [&](int begin, int end) {
+            for (int i=begin; i<end; i++)
+            {
+                const unsigned int x = (unsigned int)std::min(cells, (position[i].x - lower.x) * scale);
+                const unsigned int y = (unsigned int)std::min(cells, (position[i].y - lower.y) * scale);
+                const unsigned int z = (unsigned int)std::min(cells, (position[i].z - lower.z) * scale);
+                keys[i] = std::make_pair(spatialMortonKey(x, y, z), i);
+            }
+        });
+        parallelSort(keys.begin(), keys.end());
+
+        permutation.reserve(n);
+        permutation.update(DEVICE_HOST, n);
+        int* indices = permutation.getData(DEVICE_HOST, true);
+        for (int i=0; i<n; i++) indices[i] = keys[i].second;
+        permutation.update(DEVICE_HOST, n);
+        return SUCCESS;
+    }
+
     void Population::insert(Population& source, IndexList& list)
     {
-        int* listdata = list.getData(DEVICE_HOST);
-
-        Orbit* orbits = source.getOrbit(DEVICE_HOST, false);
-        ObjectProperties* props = source.getObjectProperties(DEVICE_HOST, false);
-        Vector3* pos = source.getPosition(DEVICE_HOST, false);
-        Vector3* vel = source.getVelocity(DEVICE_HOST, false);
-        Vector3* acc = source.getAcceleration(DEVICE_HOST, false);
-        Epoch* ep = source.getEpoch(DEVICE_HOST, false);
-        Covariance* cov = source.getCovariance(DEVICE_HOST, false);
-        char* bytes = source.getBytes(DEVICE_HOST, false);
-
-        Orbit* thisOrbit = getOrbit();
-        ObjectProperties* thisProps = getObjectProperties();
-        Vector3* thisPos = getPosition();
-        Vector3* thisVel = getVelocity();
-        Vector3* thisAcc = getAcceleration();
-        Epoch* thisEp = getEpoch();
-        Covariance* thisCov = getCovariance();
-        char* thisBytes = getBytes();
+        if (list.getSize() < source.getSize())
+        {
+            std::cout << "Cannot insert - not enough elements in index list!" << std::endl;
+            return;
+        }
+        const int* listdata = list.getData(DEVICE_HOST);
+        for (int i = 0; i < source.getSize(); ++i)
+        {
+            if (listdata[i] < 0 || listdata[i] >= getSize())
+                std::cout << "Cannot insert - index out of range: " << listdata[i] << std::endl;
+        }
+
+        // the IDs of the overwritten objects leave the index before the new ones are added
+        const bool indexed = idIndexMaintainable(*data);
+        if (indexed)
+        {
+            const ObjectProperties* properties = data->data_properties.getData(DEVICE_HOST, false);
+            for (int i = 0; i < source.getSize(); ++i)
+            {
+                if (listdata[i] < 0 || listdata[i] >= getSize()) continue;
+                std::unordered_map<int, int>::iterator entry = data->idIndex.find(properties[listdata[i]].id);
+                if (entry != data->idIndex.end() && entry->second == listdata[i]) data->idIndex.erase(entry);
+            }
+        }
 
+        // the fields are scattered where their latest data is, the other objects stay in place
+        ObjectRawData* other = *source.data;
+        data->data_orbit.scatterFrom(other->data_orbit, list);
+        data->data_properties.scatterFrom(other->data_properties, list);
+        data->data_position.scatterFrom(other->data_position, list);
+        data->data_velocity.scatterFrom(other->data_velocity, list);
+        data->data_acceleration.scatterFrom(other->data_acceleration, list);
+        data->data_epoch.scatterFrom(other->data_epoch, list);
+        data->data_covariance.scatterFrom(other->data_covariance, list);
         if (getByteArraySize() != source.getByteArraySize())
         {
             std::cout << "Warning: Cannot insert byte array into population!" << std::endl;
         }
+        else if (getByteArraySize() > 0)
+        {
+            data->data_bytes.scatterFrom(other->data_bytes, list, getByteArraySize());
+        }
+        if (indexed) indexIds(*data, listdata, 0, source.getSize());
+    }
 
-        if (list.getSize() >= source.getSize())
+    int Population::findById(int id) const
+    {
+        if (!idIndexValid(*data)) buildIdIndex(*data);
+        std::unordered_map<int, int>::const_iterator entry = data->idIndex.find(id);
+        return (entry != data->idIndex.end()) ? entry->second : -1;
+    }
+
+    ErrorCode Population::updateById(Population& update, IndexList* unmatched)
+    {
+        if (&update == this || !update.data->data_properties.hasData())
         {
-            for(int i = 0; i < list.getSize(); ++i)
+            data->host.sendError(INVALID_ARGUMENT);
+            return INVALID_ARGUMENT;
+        }
+        const ObjectProperties* properties = update.getObjectProperties(DEVICE_HOST);
+        const int count = update.getSize();
+        IndexList sources(data->host);
+        IndexList targets(data->host);
+        sources.reserve(count);
+        targets.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            const int index = findById(properties[i].id);
+            if (index >= 0)
             {
-                int l = listdata[i];
-                if (l < getSize())
-                {
-                    thisOrbit[l] = orbits[i];
-                    thisProps[l] = props[i];
-                    thisPos[l] = pos[i];
-                    thisVel[l] = vel[i];
-                    thisAcc[l] = acc[i];
-                    thisEp[l] = ep[i];
-                    thisCov[l] = cov[i];
-                    if (getByteArraySize() == source.getByteArraySize())
-                    {
-                        int b = getByteArraySize();
-                        for (int j=0; j<b; j++)
-                        {
-                            thisBytes[l*b+j] = bytes[i*b+j];
-                        }
-                    }
-                }
-                else {
-                    std::cout << "Cannot insert - index out of range: " << l << std::endl;
-                }
+                sources.add(i);
+                targets.add(index);
             }
+            else if (unmatched) unmatched->add(i);
         }
-        else {
-            std::cout << "Cannot insert - not enough elements in index list!" << std::endl;
-        }
+        if (targets.getSize() == 0) return SUCCESS;
 
-        update(DATA_ORBIT);
-        update(DATA_PROPERTIES);
-        update(DATA_POSITION);
-        update(DATA_VELOCITY);
-        update(DATA_ACCELERATION);
-        update(DATA_EPOCH);
-        update(DATA_COVARIANCE);
-        update(DATA_BYTES);
+        // unmatched objects are left out of a copy first, so insert() can scatter the rest
+        std::unique_ptr<Population> matched;
+        if (targets.getSize() < count) matched.reset(new Population(update, sources));
+        Population& source = matched ? *matched : update;
+        insert(source, targets);
+
+        // names are only replaced by the update if it has one
+        const int* target = targets.getData(DEVICE_HOST);
+        for (int i = 0; i < targets.getSize(); i++)
+        {
+            if (source.data->object_names.length(i) > 0)
+                data->object_names.set(target[i], source.data->object_names.get(i), source.data->object_names.length(i));
+        }
+        return SUCCESS;
     }
 
 	void Population::remove(int index)
 	{
+		const bool indexed = idIndexMaintainable(*data) && index >= 0 && index < data->size;
 		data->data_acceleration.remove(index);
 		data->data_orbit.remove(index);
 		data->data_position.remove(index);
@@ -764,7 +1832,17 @@ namespace OPI
         data->data_epoch.remove(index);
         data->data_covariance.remove(index);
         data->data_bytes.remove(index*data->byteArraySize, data->byteArraySize);
+		if (index >= 0 && index < data->object_names.size())
+			data->object_names.remove(index);
+		if (indexed)
+		{
+			std::vector<int> newIndex(data->size);
+			for (int i = 0; i < data->size; i++) newIndex[i] = (i < index) ? i : i - 1;
+			newIndex[index] = -1;
+			remapIdIndex(*data, newIndex);
+		}
 		data->size--;
+		applyPartition(*data);
 	}
 
 	ErrorCode Population::update(int type, Device device)
@@ -803,6 +1881,242 @@ namespace OPI
 		return status;
 	}
 
+	bool Population::hasData(int type) const
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return data->data_orbit.hasData();
+			case DATA_PROPERTIES: return data->data_properties.hasData();
+			case DATA_POSITION: return data->data_position.hasData();
+			case DATA_VELOCITY: return data->data_velocity.hasData();
+			case DATA_ACCELERATION: return data->data_acceleration.hasData();
+			case DATA_EPOCH: return data->data_epoch.hasData();
+			case DATA_COVARIANCE: return data->data_covariance.hasData();
+			case DATA_BYTES: return data->data_bytes.hasData();
+			default: return false;
+		}
+	}
+
+	Device Population::getLatestDevice(int type) const
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return data->data_orbit.getLatestDevice();
+			case DATA_PROPERTIES: return data->data_properties.getLatestDevice();
+			case DATA_POSITION: return data->data_position.getLatestDevice();
+			case DATA_VELOCITY: return data->data_velocity.getLatestDevice();
+			case DATA_ACCELERATION: return data->data_acceleration.getLatestDevice();
+			case DATA_EPOCH: return data->data_epoch.getLatestDevice();
+			case DATA_COVARIANCE: return data->data_covariance.getLatestDevice();
+			case DATA_BYTES: return data->data_bytes.getLatestDevice();
+			default: return DEVICE_NOT_SET;
+		}
+	}
+
+	unsigned long long Population::getRevision(int type) const
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return data->data_orbit.getRevision();
+			case DATA_PROPERTIES: return data->data_properties.getRevision();
+			case DATA_POSITION: return data->data_position.getRevision();
+			case DATA_VELOCITY: return data->data_velocity.getRevision();
+			case DATA_ACCELERATION: return data->data_acceleration.getRevision();
+			case DATA_EPOCH: return data->data_epoch.getRevision();
+			case DATA_COVARIANCE: return data->data_covariance.getRevision();
+			case DATA_BYTES: return data->data_bytes.getRevision();
+			default: return 0;
+		}
+	}
+
+	std::vector<DeviceMemoryUsage> Population::getDeviceMemoryUsage() const
+	{
+		std::vector<DeviceMemoryUsage> all = data->host.getDeviceMemoryUsage();
+		std::vector<DeviceMemoryUsage> usage;
+		for (size_t i = 0; i < all.size(); i++)
+			if (all[i].owner == *data) usage.push_back(all[i]);
+		return usage;
+	}
+
+	ErrorCode Population::update(int type, Device device, int first, int count)
+	{
+		ErrorCode status = SUCCESS;
+		switch(type)
+		{
+			case DATA_ORBIT:
+				data->data_orbit.update(device, first, count);
+				break;
+			case DATA_PROPERTIES:
+				data->data_properties.update(device, first, count);
+				break;
+			case DATA_VELOCITY:
+				data->data_velocity.update(device, first, count);
+				break;
+			case DATA_POSITION:
+				data->data_position.update(device, first, count);
+				break;
+			case DATA_ACCELERATION:
+				data->data_acceleration.update(device, first, count);
+				break;
+			case DATA_EPOCH:
+				data->data_epoch.update(device, first, count);
+				break;
+			case DATA_COVARIANCE:
+				data->data_covariance.update(device, first, count);
+				break;
+			case DATA_BYTES:
+				data->data_bytes.update(device, first * data->byteArraySize, count * data->byteArraySize);
+				break;
+			default:
+				status = INVALID_TYPE;
+		}
+		data->host.sendError(status);
+		return status;
+	}
+
+    ErrorCode Population::updateColumns(int type, Device device)
+    {
+        ErrorCode status = SUCCESS;
+        switch(type)
+        {
+            case DATA_ORBIT:
+                data->data_orbit.updateColumns(device);
+                break;
+            case DATA_PROPERTIES:
+                data->data_properties.updateColumns(device);
+                break;
+            case DATA_VELOCITY:
+                data->data_velocity.updateColumns(device);
+                break;
+            case DATA_POSITION:
+                data->data_position.updateColumns(device);
+                break;
+            case DATA_ACCELERATION:
+                data->data_acceleration.updateColumns(device);
+                break;
+            case DATA_EPOCH:
+                data->data_epoch.updateColumns(device);
+                break;
+            case DATA_COVARIANCE:
+                data->data_covariance.updateColumns(device);
+                break;
+            default:
+                status = INVALID_TYPE;
+        }
+        data->host.sendError(status);
+        return status;
+    }
+
+    ErrorCode Population::prefetch(int type, Device device)
+    {
+        ErrorCode status = SUCCESS;
+        switch(type)
+        {
+            case DATA_ORBIT:
+                data->data_orbit.prefetch(device);
+                break;
+            case DATA_PROPERTIES:
+                data->data_properties.prefetch(device);
+                break;
+            case DATA_VELOCITY:
+                data->data_velocity.prefetch(device);
+                break;
+            case DATA_POSITION:
+                data->data_position.prefetch(device);
+                break;
+            case DATA_ACCELERATION:
+                data->data_acceleration.prefetch(device);
+                break;
+            case DATA_EPOCH:
+                data->data_epoch.prefetch(device);
+                break;
+            case DATA_COVARIANCE:
+                data->data_covariance.prefetch(device);
+                break;
+            case DATA_BYTES:
+                data->data_bytes.prefetch(device);
+                break;
+            default:
+                status = INVALID_TYPE;
+        }
+        data->host.sendError(status);
+        return status;
+    }
+
+    ErrorCode Population::partition(int numDevices, Device firstDevice)
+    {
+        ErrorCode status = SUCCESS;
+        GpuSupport* gpu = data->host.getGPUSupport();
+        if (numDevices < 0 || firstDevice < DEVICE_CUDA || firstDevice + numDevices - 1 > DEVICE_CUDA_LAST
+            || (numDevices > 0 && (!gpu || firstDevice - DEVICE_CUDA + numDevices > gpu->getDeviceCount())))
+        {
+            status = INVALID_DEVICE;
+        }
+        else
+        {
+            // the old partition devices hold all objects again
+            for (int i = 0; i < data->partitionCount; i++)
+                setSlices(*data, (Device)(data->partitionDevice + i), 0, -1);
+            data->partitionCount = numDevices;
+            data->partitionDevice = firstDevice;
+            applyPartition(*data);
+        }
+        data->host.sendError(status);
+        return status;
+    }
+
+    int Population::getPartitionCount() const
+    {
+        return data->partitionCount;
+    }
+
+    int Population::getPartitionOffset(Device device) const
+    {
+        const int partition = device - data->partitionDevice;
+        if (partition >= 0 && partition < data->partitionCount)
+            return partitionStart(*data, partition);
+        return 0;
+    }
+
+    int Population::getPartitionSize(Device device) const
+    {
+        const int partition = device - data->partitionDevice;
+        if (partition >= 0 && partition < data->partitionCount)
+            return partitionStart(*data, partition + 1) - partitionStart(*data, partition);
+        return data->size;
+    }
+
+    ErrorCode Population::scatter(int type)
+    {
+        ErrorCode status = SUCCESS;
+        // the uploads to the different devices overlap
+        for (int i = 0; i < data->partitionCount && status == SUCCESS; i++)
+            status = prefetch(type, data->partitionDevice + i);
+        return status;
+    }
+
+    ErrorCode Population::gather(int type)
+    {
+        return prefetch(type, DEVICE_HOST);
+    }
+
+    void Population::setPinnedHostMemory(bool pinned)
+    {
+        data->data_orbit.setPinnedHostMemory(pinned);
+        data->data_properties.setPinnedHostMemory(pinned);
+        data->data_position.setPinnedHostMemory(pinned);
+        data->data_velocity.setPinnedHostMemory(pinned);
+        data->data_acceleration.setPinnedHostMemory(pinned);
+        data->data_epoch.setPinnedHostMemory(pinned);
+        data->data_covariance.setPinnedHostMemory(pinned);
+        data->data_bytes.setPinnedHostMemory(pinned);
+    }
+
+    bool Population::isPinnedHostMemory() const
+    {
+        return data->data_orbit.isPinnedHostMemory();
+    }
+
 	int Population::getSize() const
 	{
 		return data->size;
@@ -818,241 +2132,374 @@ namespace OPI
         return data->host;
     }
 
-    double Population::getLatestEpoch() const
+    // reduces a component on the device holding the latest data, or on the host
+    template< class DataType >
+    static void reduceField(ObjectRawData* data, SynchronizedData<DataType>& field, int component, int operation,
+                            double lowerBound, double upperBound, double& result, int& validObjects)
     {
-        const double mjd1950 = 2433282.5;
-        double latestEpoch = 0.0;
-        for (int i=0; i<getSize(); i++)
+        const int stride = (int)(sizeof(DataType) / sizeof(double));
+        const Device latest = field.getLatestDevice();
+        GpuSupport* gpu = data->host.getGPUSupport();
+        if (gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST && data->partitionCount == 0)
         {
-            double currentEpoch = getEpoch()[i].current_epoch;
-            if (currentEpoch < mjd1950)
+            const double* values = reinterpret_cast<const double*>(field.getData(latest, false));
+            const int oldDevice = gpu->getCurrentDevice();
+            gpu->selectDevice(latest - DEVICE_CUDA);
+            bool reduced = gpu->reduceComponent(values, stride, data->size, component, operation, lowerBound, upperBound, &result, &validObjects);
+            gpu->selectDevice(oldDevice);
+            if (reduced) return;
+        }
+        const double* values = reinterpret_cast<const double*>(field.getData(DEVICE_HOST, false));
+        std::mutex resultMutex;
+        result = reductionIdentity(operation);
+        validObjects = 0;
+        parallelFor(data->size, [&](int begin, int end) {
+            double partial = reductionIdentity(operation);
+            int count = 0;
+            for (int i = begin; i < end; i++)
             {
-                return 0.0;
-            }
-            else {
-                latestEpoch = std::max(latestEpoch, currentEpoch);
+                const double value = values[(size_t)i * stride + component];
+                if (reductionValid(value, lowerBound, upperBound))
+                {
+                    partial = reductionCombine(operation, partial, value);
+                    count++;
+                }
             }
+            std::lock_guard<std::mutex> lock(resultMutex);
+            result = reductionCombine(operation, result, partial);
+            validObjects += count;
+        });
+    }
+
+    ErrorCode Population::reduce(int type, int component, ReductionOperation operation, double& result, int* validObjects,
+                                 double lowerBound, double upperBound) const
+    {
+        int components = 0;
+        switch(type)
+        {
+            case DATA_ORBIT: components = Columns<Orbit>::components(); break;
+            case DATA_PROPERTIES: components = Columns<ObjectProperties>::components(); break;
+            case DATA_POSITION:
+            case DATA_VELOCITY:
+            case DATA_ACCELERATION: components = Columns<Vector3>::components(); break;
+            case DATA_EPOCH: components = Columns<Epoch>::components(); break;
+            case DATA_COVARIANCE: components = Columns<Covariance>::components(); break;
+            default:
+                data->host.sendError(INVALID_TYPE);
+                return INVALID_TYPE;
         }
-        return latestEpoch;
+        if (component < 0 || component >= components || operation < REDUCTION_MIN || operation > REDUCTION_SUM)
+        {
+            data->host.sendError(INVALID_ARGUMENT);
+            return INVALID_ARGUMENT;
+        }
+        int count = 0;
+        switch(type)
+        {
+            case DATA_ORBIT: reduceField(*data, data->data_orbit, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_PROPERTIES: reduceField(*data, data->data_properties, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_POSITION: reduceField(*data, data->data_position, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_VELOCITY: reduceField(*data, data->data_velocity, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_ACCELERATION: reduceField(*data, data->data_acceleration, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_EPOCH: reduceField(*data, data->data_epoch, component, operation, lowerBound, upperBound, result, count); break;
+            case DATA_COVARIANCE: reduceField(*data, data->data_covariance, component, operation, lowerBound, upperBound, result, count); break;
+        }
+        if (validObjects) *validObjects = count;
+        return SUCCESS;
     }
 
-    double Population::getEarliestEpoch() const
+    // returns the data of a field taking part in sampleClones(), or null
+    template <class DataType>
+    static DataType* sampledField(SynchronizedData<DataType>& field, bool used, Device device, bool no_sync)
+    {
+        return used ? field.getData(device, no_sync) : nullptr;
+    }
+
+    ErrorCode Population::sampleClones(Population& clones, int clonesPerObject, CovarianceType type, unsigned long long seed) const
+    {
+        const bool stateVectors = (type == CV_STATE_VECTORS || type == CV_STATE_VECTORS_NO_DYNAMICS);
+        const bool hasOrbit = data->data_orbit.hasData();
+        const bool hasState = data->data_position.hasData() && data->data_velocity.hasData();
+        ErrorCode status = SUCCESS;
+        if (samplingDimension(type) == 0) status = INVALID_TYPE;
+        else if (&clones == this || clonesPerObject <= 0 || (long long)data->size * clonesPerObject > std::numeric_limits<int>::max())
+            status = INVALID_ARGUMENT;
+        else if (stateVectors ? !hasState : !hasOrbit) status = INVALID_ARGUMENT;
+        if (status != SUCCESS)
+        {
+            data->host.sendError(status);
+            return status;
+        }
+
+        const int size = data->size;
+        const int total = size * clonesPerObject;
+        clones.resize(total, data->byteArraySize);
+        ObjectRawData* target = *clones.data;
+        const bool hasProperties = data->data_properties.hasData();
+        const bool hasEpoch = data->data_epoch.hasData();
+
+        // sample on the device holding the latest covariances, so they are not downloaded
+        const Device latest = data->data_covariance.getLatestDevice();
+        GpuSupport* gpu = data->host.getGPUSupport();
+        bool sampled = false;
+        if (gpu && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST && data->partitionCount == 0 && target->partitionCount == 0)
+        {
+            const Covariance* covariance = data->data_covariance.getData(latest, false);
+            const Orbit* orbit = sampledField(data->data_orbit, hasOrbit, latest, false);
+            const Vector3* position = sampledField(data->data_position, hasState, latest, false);
+            const Vector3* velocity = sampledField(data->data_velocity, hasState, latest, false);
+            const ObjectProperties* properties = sampledField(data->data_properties, hasProperties, latest, false);
+            const Epoch* epoch = sampledField(data->data_epoch, hasEpoch, latest, false);
+            Orbit* cloneOrbit = sampledField(target->data_orbit, hasOrbit, latest, true);
+            Vector3* clonePosition = sampledField(target->data_position, hasState, latest, true);
+            Vector3* cloneVelocity = sampledField(target->data_velocity, hasState, latest, true);
+            ObjectProperties* cloneProperties = sampledField(target->data_properties, hasProperties, latest, true);
+            Epoch* cloneEpoch = sampledField(target->data_epoch, hasEpoch, latest, true);
+            const int oldDevice = gpu->getCurrentDevice();
+            gpu->selectDevice(latest - DEVICE_CUDA);
+            sampled = gpu->sampleClones(covariance, orbit, position, velocity, properties, epoch, size, clonesPerObject, type, seed,
+                                        cloneOrbit, clonePosition, cloneVelocity, cloneProperties, cloneEpoch);
+            gpu->selectDevice(oldDevice);
+        }
+        const Device device = sampled ? latest : DEVICE_HOST;
+        if (!sampled)
+        {
+            const Covariance* covariance = data->data_covariance.getData(DEVICE_HOST, false);
+            const Orbit* orbit = sampledField(data->data_orbit, hasOrbit, DEVICE_HOST, false);
+            const Vector3* position = sampledField(data->data_position, hasState, DEVICE_HOST, false);
+            const Vector3* velocity = sampledField(data->data_velocity, hasState, DEVICE_HOST, false);
+            const ObjectProperties* properties = sampledField(data->data_properties, hasProperties, DEVICE_HOST, false);
+            const Epoch* epoch = sampledField(data->data_epoch, hasEpoch, DEVICE_HOST, false);
+            Orbit* cloneOrbit = sampledField(target->data_orbit, hasOrbit, DEVICE_HOST, true);
+            Vector3* clonePosition = sampledField(target->data_position, hasState, DEVICE_HOST, true);
+            Vector3* cloneVelocity = sampledField(target->data_velocity, hasState, DEVICE_HOST, true);
+            ObjectProperties* cloneProperties = sampledField(target->data_properties, hasProperties, DEVICE_HOST, true);
+            Epoch* cloneEpoch = sampledField(target->data_epoch, hasEpoch, DEVICE_HOST, true);
+            const int dimension = samplingDimension(type);
+            parallelFor(size, [&](int begin, int end) {
+                double factor[SAMPLING_FACTOR_SIZE];
+                for (int i = begin; i < end; i++)
+                {
+                    factorCovariance(covariance[i], dimension, factor);
+                    for (int c = 0; c < clonesPerObject; c++)
+                    {
+                        const int clone = i * clonesPerObject + c;
+                        sampleClone(factor, type, seed, clone,
+                                    orbit ? orbit + i : nullptr, position ? position + i : nullptr, velocity ? velocity + i : nullptr,
+                                    properties ? properties + i : nullptr, epoch ? epoch + i : nullptr,
+                                    cloneOrbit ? cloneOrbit + clone : nullptr, clonePosition ? clonePosition + clone : nullptr,
+                                    cloneVelocity ? cloneVelocity + clone : nullptr, cloneProperties ? cloneProperties + clone : nullptr,
+                                    cloneEpoch ? cloneEpoch + clone : nullptr);
+                    }
+                }
+            });
+        }
+        if (hasOrbit) clones.update(DATA_ORBIT, device);
+        if (hasState)
+        {
+            clones.update(DATA_POSITION, device);
+            clones.update(DATA_VELOCITY, device);
+        }
+        if (hasProperties) clones.update(DATA_PROPERTIES, device);
+        if (hasEpoch) clones.update(DATA_EPOCH, device);
+        return SUCCESS;
+    }
+
+    // computes both epoch bounds if the epochs have changed since the last call
+    static void updateEpochBounds(ObjectRawData* data)
     {
+        const unsigned long long revision = data->data_epoch.getRevision();
+        if (data->epochBoundsRevision == revision) return;
         const double mjd1950 = 2433282.5;
-        double earliestEpoch = 9999999.0;
-        for (int i=0; i<getSize(); i++)
+        // kept from the per-object loop for empty populations
+        data->earliestEpoch = 9999999.0;
+        data->latestEpoch = 0.0;
+        if (data->size > 0 && !data->data_epoch.hasData())
         {
-            double currentEpoch = getEpoch()[i].current_epoch;
-            if (currentEpoch < mjd1950)
+            // epochs that were never set are zero
+            data->earliestEpoch = 0.0;
+        }
+        else if (data->size > 0)
+        {
+            const int component = OPI_COMPONENT(Epoch, current_epoch);
+            double earliest, latest;
+            int valid;
+            reduceField(data, data->data_epoch, component, REDUCTION_MIN, -HUGE_VAL, HUGE_VAL, earliest, valid);
+            if (valid > 0 && earliest < mjd1950)
             {
-                return 0.0;
+                data->earliestEpoch = 0.0;
             }
-            else {
-                earliestEpoch = std::min(earliestEpoch, currentEpoch);
+            else if (valid > 0)
+            {
+                reduceField(data, data->data_epoch, component, REDUCTION_MAX, -HUGE_VAL, HUGE_VAL, latest, valid);
+                data->earliestEpoch = earliest;
+                data->latestEpoch = latest;
             }
         }
-        return earliestEpoch;
+        // read after the reduction, which may write back pending columns
+        data->epochBoundsRevision = data->data_epoch.getRevision();
     }
 
-    std::string Population::validate(IndexList& invalidObjects) const
+    double Population::getLatestEpoch() const
     {
-        //0: No object has a current epoch set
-        //1: All objects have a current epoch set
-        //-1: Some objects have a current epoch set while others do not (bad)
-        int epochCheck = 0;
-        std::stringstream report;
-        for (int i=0; i<data->size; i++)
-        {
-            bool valid = true;
+        updateEpochBounds(*data);
+        return data->latestEpoch;
+    }
 
-            // get ID, or -1 if object has no properties set
-            int id = -1;
+    double Population::getEarliestEpoch() const
+    {
+        updateEpochBounds(*data);
+        return data->earliestEpoch;
+    }
 
-            // check properties
-            ObjectProperties props = getObjectProperties(DEVICE_HOST)[i];
-            if (data->data_properties.hasData() && !isZero(props))
-            {
-                id = props.id;
-                if (hasNaN(props))
-                {
-                    report << i << "/" << id << "/Properties: NaN detected" << std::endl;
-                    valid = false;
-                }
-                if (props.drag_coefficient < 1e-32)
-                {
-                    report << i << "/" << id << "/Properties: Invalid drag coefficient" << std::endl;
-                    valid = false;
-                }
-                if (props.mass < 1e-12)
-                {
-                    report << i << "/" << id << "/Properties: Invalid mass" << std::endl;
-                    valid = false;
-                }
-                if (props.diameter < 1e-12)
-                {
-                    report << i << "/" << id << "/Properties: Invalid diameter" << std::endl;
-                    valid = false;
-                }
-                if (props.area_to_mass <= 0.0)
-                {
-                    report << i << "/" << id << "/Properties: Invalid area to mass ratio" << std::endl;
-                    valid = false;
-                }
-                if (props.reflectivity < 0.0 || props.reflectivity > 2.0)
-                {
-                    report << i << "/" << id << "/Properties: Invalid reflectivity coefficient" << std::endl;
-                    valid = false;
-                }
-            }
+    std::string Population::validate(IndexList& invalidObjects) const
+    {
+        std::vector<int> errors(data->size);
+        const int flags = validate(invalidObjects, errors.data());
+        return getValidationReport(errors.data(), flags);
+    }
 
-            // check orbit and epoch
-            Orbit orbit = getOrbit(DEVICE_HOST)[i];
-            Epoch epoch = getEpoch(DEVICE_HOST)[i];
-            const double mjd1950 = 2433282.5;
-            if (data->data_orbit.hasData() && !isZero(orbit))
+    int Population::validate(IndexList& invalidObjects, int* errors, Device device) const
+    {
+        const int n = data->size;
+        std::vector<int> objectErrors;
+        if (!errors)
+        {
+            objectErrors.resize(n);
+            errors = objectErrors.data();
+        }
+        // objects with an orbit that have a current epoch set, and that have none
+        int epochCounts[2] = { 0, 0 };
+        bool validated = false;
+        if (device >= DEVICE_CUDA && device <= DEVICE_CUDA_LAST && n > 0)
+        {
+            GpuSupport* gpu = data->host.getGPUSupport();
+            if (gpu)
             {
-                if (hasNaN(orbit))
-                {
-                    report << i << "/" << id << "/Orbit: NaN detected" << std::endl;
-                    valid = false;
-                }
-                if (orbit.semi_major_axis < 6378.0 && epoch.end_of_life <= 0.0) {
-                    report << i << "/" << id << "/Orbit: SMA too small, and object has not been marked as decayed (EOL = 0)" << std::endl;
-                    valid = false;
-                }
-                if (orbit.eccentricity <= 0.0 || orbit.eccentricity >= 1.0)
-                {
-                    report << i << "/" << id << "/Orbit: Eccentricity not within valid range" << std::endl;
-                    valid = false;
-                }
-                if (orbit.inclination < -2*M_PI || orbit.inclination > 2*M_PI
-                    || orbit.raan < -2*M_PI || orbit.raan > 2*M_PI
-                    || orbit.arg_of_perigee < -2*M_PI || orbit.arg_of_perigee > 2*M_PI
-                    || orbit.mean_anomaly < -2*M_PI || orbit.mean_anomaly > 2*M_PI)
+                const ObjectProperties* properties = data->data_properties.hasData() ? getObjectProperties(device) : 0;
+                const Orbit* orbit = data->data_orbit.hasData() ? getOrbit(device) : 0;
+                const Epoch* epoch = data->data_epoch.hasData() ? getEpoch(device) : 0;
+                const Vector3* position = data->data_position.hasData() ? getPosition(device) : 0;
+                const Vector3* velocity = data->data_velocity.hasData() ? getVelocity(device) : 0;
+                // only the flags are transferred back
+                SynchronizedData<int> deviceErrors(data->host, "ValidationFlags");
+                deviceErrors.resize(n);
+                int* flags = deviceErrors.getData(device, true);
+                const int oldDevice = gpu->getCurrentDevice();
+                gpu->selectDevice(device - DEVICE_CUDA);
+                validated = gpu->validateObjects(properties, orbit, epoch, position, velocity, n, flags, epochCounts);
+                gpu->selectDevice(oldDevice);
+                if (validated)
                 {
-                    report << i << "/" << id << "/Orbit: One or more angles outside radian range" << std::endl;
-                    valid = false;
-                }
-                if (epoch.end_of_life > 0.0 && epoch.beginning_of_life > 0.0 && epoch.end_of_life < epoch.beginning_of_life)
-                {
-                    report << i << "/" << id << "/Orbit: EOL date precedes BOL date" << std::endl;
-                    valid = false;
-                }
-                if (epoch.current_epoch < mjd1950)
-                {
-                    if (i == 0) epochCheck = 0;
-                    else if (epochCheck == 1) epochCheck = -1;
-                }
-                else {
-                    if (i == 0) epochCheck = 1;
-                    else if (epochCheck == 0) epochCheck = -1;
+                    deviceErrors.update(device);
+                    memcpy(errors, deviceErrors.getData(DEVICE_HOST, false), n * sizeof(int));
                 }
             }
-
-            // check state vector
-            Vector3 pos = getPosition(DEVICE_HOST)[i];
-            Vector3 vel = getVelocity(DEVICE_HOST)[i];
-            if (data->data_position.hasData() && !isZero(pos))
-            {
-                if (data->data_velocity.hasData() && !isZero(vel))
+        }
+        if (!validated)
+        {
+            const ObjectProperties* properties = data->data_properties.hasData() ? getObjectProperties(DEVICE_HOST) : 0;
+            const Orbit* orbit = data->data_orbit.hasData() ? getOrbit(DEVICE_HOST) : 0;
+            const Epoch* epoch = data->data_epoch.hasData() ? getEpoch(DEVICE_HOST) : 0;
+            const Vector3* position = data->data_position.hasData() ? getPosition(DEVICE_HOST) : 0;
+            const Vector3* velocity = data->data_velocity.hasData() ? getVelocity(DEVICE_HOST) : 0;
+            std::atomic<int> withEpoch(0), withoutEpoch(0);
+            parallelFor(n, [&](int begin, int end) {
+                int counts[3] = { 0, 0, 0 };
+                for (int i=begin; i<end; i++)
                 {
-                    if (length(pos) <= 6378.0 && epoch.end_of_life <= 0.0)
-                    {
-                        report << i << "/" << id << "/StateVector: Object is inside Earth and has not been marked as decayed (EOL = 0)" << std::endl;
-                        valid = false;
-                    }
-                    if (length(pos) <= 0.0)
-                    {
-                        report << i << "/" << id << "/StateVector: Invalid velocity" << std::endl;
-                        valid = false;
-                    }
-                }
-                else {
-                    report << i << "/" << id << "/StateVector: Object has position but no velocity set" << std::endl;
-                    valid = false;
+                    int epochState;
+                    errors[i] = validateObject(properties ? properties + i : 0, orbit ? orbit + i : 0, epoch ? epoch + i : 0,
+                                               position ? position + i : 0, velocity ? velocity + i : 0, epochState);
+                    counts[epochState]++;
                 }
-            }
-
-            if (isZero(orbit) && isZero(pos) && isZero(vel))
-            {
-                report << i << "/" << id << "/StateVector: Object has neither state vector nor orbit set" << std::endl;
-                valid = false;
-            }
-
-            if (!valid) invalidObjects.add(i);
+                withEpoch += counts[VALIDATION_EPOCH_SET];
+                withoutEpoch += counts[VALIDATION_EPOCH_NOT_SET];
+            });
+            epochCounts[0] = withEpoch;
+            epochCounts[1] = withoutEpoch;
         }
 
-        if (epochCheck == -1) report << "Population: Not all objects have a current epoch set." << std::endl;
+        int flags = VALIDATION_NONE;
+        int invalid = 0;
+        for (int i=0; i<n; i++)
+        {
+            flags |= errors[i];
+            if (errors[i] != VALIDATION_NONE) invalid++;
+        }
+        if (invalid > 0)
+        {
+            invalidObjects.reserve(invalidObjects.getSize() + invalid);
+            for (int i=0; i<n; i++)
+                if (errors[i] != VALIDATION_NONE) invalidObjects.add(i);
+        }
+        if (epochCounts[0] > 0 && epochCounts[1] > 0) flags |= VALIDATION_MIXED_EPOCHS;
+        return flags;
+    }
 
+    std::string Population::getValidationReport(const int* errors, int flags) const
+    {
+        static const struct { int flag; const char* message; } messages[] = {
+            { VALIDATION_PROPERTIES_NAN, "Properties: NaN detected" },
+            { VALIDATION_DRAG_COEFFICIENT, "Properties: Invalid drag coefficient" },
+            { VALIDATION_MASS, "Properties: Invalid mass" },
+            { VALIDATION_DIAMETER, "Properties: Invalid diameter" },
+            { VALIDATION_AREA_TO_MASS, "Properties: Invalid area to mass ratio" },
+            { VALIDATION_REFLECTIVITY, "Properties: Invalid reflectivity coefficient" },
+            { VALIDATION_ORBIT_NAN, "Orbit: NaN detected" },
+            { VALIDATION_DECAYED, "Orbit: SMA too small, and object has not been marked as decayed (EOL = 0)" },
+            { VALIDATION_ECCENTRICITY, "Orbit: Eccentricity not within valid range" },
+            { VALIDATION_ANGLES, "Orbit: One or more angles outside radian range" },
+            { VALIDATION_LIFETIME, "Orbit: EOL date precedes BOL date" },
+            { VALIDATION_INSIDE_EARTH, "StateVector: Object is inside Earth and has not been marked as decayed (EOL = 0)" },
+            { VALIDATION_VELOCITY, "StateVector: Invalid velocity" },
+            { VALIDATION_NO_VELOCITY, "StateVector: Object has position but no velocity set" },
+            { VALIDATION_NO_STATE, "StateVector: Object has neither state vector nor orbit set" }
+        };
+        std::stringstream report;
+        const ObjectProperties* properties = data->data_properties.hasData() ? getObjectProperties(DEVICE_HOST) : 0;
+        for (int i=0; errors && i<data->size; i++)
+        {
+            if (errors[i] == VALIDATION_NONE) continue;
+            // the ID, or -1 if the object has no properties set
+            const int id = (properties && !isZero(properties[i])) ? properties[i].id : -1;
+            for (size_t m=0; m<sizeof(messages)/sizeof(messages[0]); m++)
+                if (errors[i] & messages[m].flag) report << i << "/" << id << "/" << messages[m].message << std::endl;
+        }
+        if (flags & VALIDATION_MIXED_EPOCHS) report << "Population: Not all objects have a current epoch set." << std::endl;
         return report.str();
     }
 
-    // adapted from SGP4 reference implementation by D. Vallado e.a.
-    // https://celestrak.com/publications/AIAA/2006-6753/
     ErrorCode Population::convertOrbitsToStateVectors()
     {
         if (data->data_orbit.hasData())
         {
-            for (int i=0; i<getSize(); i++)
+            // convert on the device holding the latest orbits to avoid a round trip to the host
+            Device device = data->data_orbit.getLatestDevice();
+            GpuSupport* gpu = data->host.getGPUSupport();
+            if (gpu && (device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST))
             {
-                Orbit o = getOrbit()[i];
-
-                double ta = trueAnomaly(o);
-                double argp = o.arg_of_perigee;
-                const double arglat = argp + ta;
-                double raan = o.raan;
-                const double small = 1e-15;
-
-                if (o.eccentricity < small)
+                int oldDevice = gpu->getCurrentDevice();
+                gpu->selectDevice(device - DEVICE_CUDA);
+                bool converted = gpu->convertOrbitsToStateVectors(getOrbit(device), getPosition(device, true), getVelocity(device, true), getSize());
+                gpu->selectDevice(oldDevice);
+                if (converted)
                 {
-                    // circular equatorial
-                    if ((o.inclination < small) || (fabs(o.inclination-M_PI) < small))
-                    {
-                        argp = 0.0;
-                        raan = 0.0;
-                        ta = o.raan + arglat;
-                    }
-                    else {
-                        // circular inclined
-                        argp = 0.0;
-                        ta = arglat;
-                    }
-                }
-                else {
-                    // elliptical equatorial
-                    if ((o.inclination < small) || (fabs(o.inclination-M_PI) < small))
-                    {
-                        argp = o.raan + o.arg_of_perigee;
-                        raan = 0.0;
-                    }
+                    update(DATA_POSITION, device);
+                    update(DATA_VELOCITY, device);
+                    return SUCCESS;
                 }
-
-                // ----------  form pqw position and velocity vectors ----------
-                double p = o.semi_major_axis * (1.0 - pow(o.eccentricity, 2.0));
-                const double mu = 398600.4418;
-                const double temp = p / (1.0 + o.eccentricity * cos(ta));
-                Vector3 r;
-				r.x = temp*cos(ta);
-				r.y = temp*sin(ta);
-				r.z = 0.0;
-                if (fabs(p) < 1e-8 ) p = 1e-8;
-
-                Vector3 v;
-				v.x = -sin(ta) * sqrt(mu/p);
-                v.y = (o.eccentricity + cos(ta)) * sqrt(mu/p);
-                v.z = 0.0;
-
-                r = rotateZ(r,-argp);
-                r = rotateX(r,-o.inclination);
-                r = rotateZ(r,-raan);
-                getPosition()[i] = r;
-
-                v = rotateZ(v,-argp);
-                v = rotateX(v,-o.inclination);
-                v = rotateZ(v,-raan);
-                getVelocity()[i] = v;
             }
 
+            const Orbit* orbit = getOrbit();
+            Vector3* position = getPosition(DEVICE_HOST, true);
+            Vector3* velocity = getVelocity(DEVICE_HOST, true);
+            parallelFor(getSize(), [=](int begin, int end)
+            {
+                for (int i=begin; i<end; i++)
+                    orbitToStateVector(orbit[i], position[i], velocity[i]);
+            });
+
             update(DATA_POSITION);
             update(DATA_VELOCITY);
             return SUCCESS;
@@ -1060,216 +2507,40 @@ namespace OPI
         else return INVALID_DATA;
     }
 
-    // adapted from SGP4 reference implementation by D. Vallado e.a.
-    // https://celestrak.com/publications/AIAA/2006-6753/
     ErrorCode Population::convertStateVectorsToOrbits()
     {
-        ErrorCode e = SUCCESS;
         if (data->data_position.hasData() && data->data_velocity.hasData())
         {
-            enum typeorbit_t {
-                CIRCULAR_EQUATORIAL,
-                CIRCULAR_INCLINED,
-                ELLIPTICAL_EQUATORIAL,
-                ELLIPTICAL_INCLINED
-            } typeorbit;
-
-            const double twopi = 2.0 * M_PI;
-            const double halfpi = 0.5 * M_PI;
-            const double small = 1e-15;
-            const double mu = 398600.4418;
-            const double nan = std::numeric_limits<double>::quiet_NaN();
-
-            for (int i=0; i<getSize(); i++)
+            // convert on the device holding the latest positions to avoid a round trip to the host
+            Device device = data->data_position.getLatestDevice();
+            GpuSupport* gpu = data->host.getGPUSupport();
+            if (gpu && (device >= DEVICE_CUDA) && (device <= DEVICE_CUDA_LAST))
             {
-                Vector3 r = getPosition()[i];
-                Vector3 v = getVelocity()[i];
-                Orbit o;
-
-                const double magr = length(r);
-                const double magv = length(v);
-
-                Vector3 hbar = cross(r,v);
-                const double magh = length(hbar);
-
-                if (magh > small)
+                int invalidObjects = 0;
+                int oldDevice = gpu->getCurrentDevice();
+                gpu->selectDevice(device - DEVICE_CUDA);
+                bool converted = gpu->convertStateVectorsToOrbits(getPosition(device), getVelocity(device), getOrbit(device, true), getSize(), &invalidObjects);
+                gpu->selectDevice(oldDevice);
+                if (converted)
                 {
-                    // ------------------  find h n and e vectors   ----------------
-                    Vector3 nbar;
-					nbar.x = -hbar.y;
-					nbar.y = hbar.x;
-					nbar.z = 0.0;
-                    const double magn = length(nbar);
-                    const double c1 = magv*magv - mu/magr;
-                    const double rdotv = r * v;
-                    Vector3 ebar = (r*c1 - v*rdotv) / mu;
-                    o.eccentricity = length(ebar);
-
-                    // ------------  find a e and semi-latus rectum   ----------
-                    const double sme = (magv*magv*0.5) - (mu / magr);
-                    if (fabs(sme) > small)
-                    {
-                        o.semi_major_axis = -mu / (2.0 *sme);
-                    }
-                    else {
-                        o.semi_major_axis = std::numeric_limits<double>::infinity();
-                        e = INVALID_DATA;
-                    }
-                    //const double p = magh*magh / mu;
-
-                    // -----------------  find inclination   -------------------
-                    const double hk = hbar.z / magh;
-                    o.inclination = acos(hk);
-
-                    // --------  determine type of orbit for later use  --------
-                    // ------ elliptical, parabolic, hyperbolic inclined -------
-                    typeorbit = ELLIPTICAL_INCLINED;
-                    if (o.eccentricity < small)
-                    {
-                        // ----------------  circular equatorial ---------------
-                        if ((o.inclination < small) || (fabs(o.inclination - M_PI) < small))
-                            typeorbit = CIRCULAR_EQUATORIAL;
-                        else
-                            // --------------  circular inclined ---------------
-                            typeorbit = CIRCULAR_INCLINED;
-                    }
-                    else {
-                        // - elliptical, parabolic, hyperbolic equatorial --
-                        if ((o.inclination < small) || (fabs(o.inclination - M_PI) < small))
-                            typeorbit = ELLIPTICAL_EQUATORIAL;
-                    }
-
-                    // ----------  find longitude of ascending node ------------
-                    if (magn > small)
-                    {
-                        double temp = nbar.x / magn;
-                        if (temp > 1.0) temp = 1.0;
-                        else if (temp < -1.0) temp = -1.0;
-                        o.raan = acos(temp);
-                        if (nbar.y < 0.0) o.raan = twopi - o.raan;
-                    }
-                    else {
-                        o.raan = nan;
-                        e = INVALID_DATA;
-                    }
-
-                    // ---------------- find argument of perigee ---------------
-                    if (typeorbit == ELLIPTICAL_INCLINED)
-                    {
-                        o.arg_of_perigee = angle(nbar,ebar);
-                        if (ebar.z < 0.0) o.arg_of_perigee = twopi - o.arg_of_perigee;
-                    }
-                    else {
-                        o.arg_of_perigee = nan;
-                        e = INVALID_DATA;
-                    }
-
-                    // ------------  find true anomaly at epoch    -------------
-                    double nu = nan;
-                    if (typeorbit == ELLIPTICAL_EQUATORIAL || typeorbit == ELLIPTICAL_INCLINED)
-                    {
-                        nu = angle(ebar,r);
-                        if (rdotv < 0.0) nu = twopi - nu;
-                    }
-
-                    // ----  find argument of latitude - circular inclined -----
-                    double arglat = nan;
-                    if (typeorbit == CIRCULAR_INCLINED)
-                    {
-                        arglat = angle(nbar,r);
-                        if (r.z < 0.0) arglat = twopi - arglat;
-                        o.mean_anomaly = arglat;
-                    }
-
-                    // -- find longitude of perigee - elliptical equatorial ----
-                    double lonper = nan;
-                    if ((o.eccentricity > small) && (typeorbit == ELLIPTICAL_EQUATORIAL))
-                    {
-                        double temp = ebar.x / o.eccentricity;
-                        if (temp > 1.0) temp = 1.0;
-                        else if (temp < -1.0) temp = -1.0;
-                        lonper = acos(temp);
-                        if (ebar.y < 0.0) lonper = twopi - lonper;
-                        if (o.inclination > halfpi) lonper = twopi - lonper;
-                    }
-
-                    // -------- find true longitude - circular equatorial ------
-                    double truelon = nan;
-                    if ((magr>small) && (typeorbit == CIRCULAR_EQUATORIAL))
-                    {
-                        double temp = r.x / magr;
-                        if (temp > 1.0) temp = 1.0;
-                        else if (temp < -1.0) temp = -1.0;
-                        truelon = acos(temp);
-                        if (r.y < 0.0) truelon = twopi - truelon;
-                        if (o.inclination > halfpi) truelon = twopi - truelon;
-                        o.mean_anomaly = truelon;
-                    }
-
-                    // ------------ find mean anomaly for all orbits -----------
-                    if (typeorbit == ELLIPTICAL_EQUATORIAL || typeorbit == ELLIPTICAL_INCLINED)
-                    {
-                        // get mean anomaly from true anomaly
-                        const double ecc = o.eccentricity;
-                        double ea = std::numeric_limits<double>::infinity();
-                        double ma = std::numeric_limits<double>::infinity();
-
-                        if (fabs(ecc) < small)
-                        {
-                            // circular
-                            ea = nu;
-                            ma = nu;
-                        }
-                        else if (ecc < 1.0 - small)
-                        {
-                            // elliptical
-                            const double sine = (sqrt(1.0 - pow(ecc,2.0)) * sin(nu)) / (1.0 + ecc*cos(nu));
-                            const double cose = (ecc + cos(nu)) / (1.0 + ecc*cos(nu));
-                            ea = atan2(sine, cose);
-                            ma = ea - ecc*sin(ea);
-                        }
-                        else if (ecc > 1.0 + small)
-                        {
-                            // hyperbolic
-                            if ((ecc > 1.0) && (fabs(nu) + 0.00001 < M_PI - acos(1.0 / ecc)))
-                            {
-                                const double sine = (sqrt(pow(ecc, 2.0) - 1.0) * sin(nu)) / (1.0 + ecc*cos(nu));
-								//ea = asinh(sine);
-								//Unfortunately, some compilers don't implement all standard functions.
-								//Yes, I'm looking at you, Visual Studio!
-								ea = log(sine + sqrt(1+pow(sine,2.0)));
-                                ma = ecc*sinh(ea) - ea;
-                            }
-                        }
-                        else if (fabs(nu) < 168.0*M_PI / 180.0)
-                        {
-                            // parabolic
-                            ea = tan(nu*0.5);
-                            ma = ea + pow(ea,3.0)/3.0;
-                        }
-
-                        if (ecc < 1.0)
-                        {
-                            ma = fmod(ma, 2.0 * M_PI);
-                            if (ma < 0.0) ma += 2.0*M_PI;
-                        }
-
-                        o.mean_anomaly = ma;
-                    }
+                    update(DATA_ORBIT, device);
+                    return (invalidObjects > 0) ? INVALID_DATA : SUCCESS;
                 }
-                else {
-                    o.semi_major_axis = nan;
-                    o.eccentricity = nan;
-                    o.inclination = nan;
-                    o.raan = nan;
-                    o.arg_of_perigee = nan;
-                    o.mean_anomaly = nan;
-                    e = INVALID_DATA;
-                }
-                getOrbit()[i] = o;
             }
+
+            const Vector3* position = getPosition();
+            const Vector3* velocity = getVelocity();
+            Orbit* orbit = getOrbit(DEVICE_HOST, true);
+            std::atomic<bool> valid(true);
+            parallelFor(getSize(), [=, &valid](int begin, int end)
+            {
+                bool rangeValid = true;
+                for (int i=begin; i<end; i++)
+                    rangeValid &= stateVectorToOrbit(position[i], velocity[i], orbit[i]);
+                if (!rangeValid) valid = false;
+            });
             update(DATA_ORBIT);
-            return e;
+            return valid ? SUCCESS : INVALID_DATA;
         }
         else return INVALID_DATA;
     }
@@ -19,14 +19,18 @@
 #include "opi_common.h"
 #include "opi_error.h"
 #include "opi_datatypes.h"
+#include "opi_columns.h"
 #include "opi_pimpl_helper.h"
 #include <string>
+#include <limits>
+#include <vector>
 
 /* Revision number of the OPI data file format, stored for backwards compatibility
  * 001 - Initial value for OPI-2019
  * 002 - Added description field
+ * 003 - Uncompressed header, fields stored as separately compressed chunks
  */
-#define OPI_DATA_REVISION_NUMBER 2
+#define OPI_DATA_REVISION_NUMBER 3
 
 namespace OPI
 {
@@ -35,6 +39,7 @@ namespace OPI
 	struct ObjectProperties;
 	struct Vector3;
 	struct IndexPair;
+	struct DeviceMemoryUsage;
 	class IndexList;
 
 	/*! \brief This class contains all parameters required for processing orbital objects.
@@ -72,10 +77,11 @@ namespace OPI
             /**
              * @brief Population Copy constructor (indexed copy)
              *
-             * Creates a selective deep copy of a Population on the host. Only
-             * elements that appear in the given index list are copied to the new Population.
-             * Like the full copy, the operation happens entirely on the host so device
-             * data is synchronized. This may be even slower than the full copy in some cases.
+             * Creates a selective deep copy of a Population. Only elements that appear
+             * in the given index list are copied to the new Population. Each data field is
+             * gathered on the device holding its latest data, so fields that are on a GPU
+             * stay there and only the selected objects are copied. Other fields are gathered
+             * on the host.
              *
              * @param source The Population to be copied from.
              * @param list An IndexList containing the indices of the elements of the source
@@ -114,6 +120,15 @@ namespace OPI
              */
 			OPI_API_EXPORT void resizeByteArray(int size);
 
+            /**
+             * @brief shrinkToFit Releases host and device memory not required for the current size.
+             *
+             * Reducing the size of a Population keeps its memory allocated so it can grow again
+             * without reallocation. This function frees the unused part. Device memory is
+             * reallocated on the next access, so the data is synchronized to the host first.
+             */
+            OPI_API_EXPORT void shrinkToFit();
+
             /**
              * @brief getSize Returns the number of elements in the Population.
              * @return Number of elements.
@@ -152,17 +167,63 @@ namespace OPI
             /**
              * @brief getEarliestEpoch Find the earliest epoch from the object's current_epoch fields.
              * @return 0.0 if any object has an invalid (i.e. lower than Jan 1st, 1950) current epoch set,
-             * otherwise the earliest Julian date found.
+             * otherwise the earliest Julian date found. Both bounds are computed together on the device
+             * holding the epochs and cached until the epochs are updated.
              */
             OPI_API_EXPORT double getEarliestEpoch() const;
 
             /**
              * @brief getLatestEpoch Find the latest epoch from the object's current_epoch fields.
              * @return 0.0 if any object has an invalid (i.e. lower than Jan 1st, 1950) current epoch set,
-             * otherwise the latest Julian date found.
+             * otherwise the latest Julian date found. Both bounds are computed together on the device
+             * holding the epochs and cached until the epochs are updated.
              */
             OPI_API_EXPORT double getLatestEpoch() const;
 
+            /**
+             * @brief reduce Computes the minimum, maximum or sum of one component of a data type.
+             *
+             * The reduction runs on the device holding the latest data if the GPU support provides
+             * it, so only the result is transferred, and on all host threads otherwise. Values that
+             * are NaN or outside [lowerBound, upperBound] are skipped.
+             * @param type The data type, e.g. DATA_EPOCH; DATA_BYTES has no components.
+             * @param component The 8-byte component of the type, see OPI_COMPONENT.
+             * @param operation The reduction to perform.
+             * @param result Receives the result; 0.0 for an empty sum, +/- infinity for the minimum
+             * and maximum if no value is valid.
+             * @param validObjects If not zero, receives the number of values taken into account.
+             * @param lowerBound The smallest value taken into account.
+             * @param upperBound The largest value taken into account.
+             * @return INVALID_TYPE if the type has no components, INVALID_ARGUMENT for an unknown
+             * component or operation, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode reduce(int type, int component, ReductionOperation operation, double& result, int* validObjects = 0,
+                                            double lowerBound = -std::numeric_limits<double>::infinity(),
+                                            double upperBound = std::numeric_limits<double>::infinity()) const;
+
+            /**
+             * @brief sampleClones Generates Monte Carlo clones of all objects from their covariances.
+             *
+             * The covariance of every object is factored once, then its clones are drawn with a
+             * counter-based generator, so the same seed yields the same clones on every device. The
+             * clones are generated on the device holding the latest covariances if the GPU support
+             * provides it, so neither the objects nor the clones pass through host memory, and on
+             * all host threads otherwise. Clone c of object i is stored at index i * clonesPerObject + c.
+             *
+             * The kinematic parameters are offsets of the position and velocity or of the orbit,
+             * depending on the type; the other representation is converted from them if this
+             * Population holds it. The dynamic parameters, unless unused, are offsets of the drag and
+             * reflectivity coefficients. Properties and epochs are copied from the object.
+             * @param clones Receives the clones, it is resized to getSize() * clonesPerObject objects.
+             * @param clonesPerObject The number of clones of every object.
+             * @param type The meaning of the covariances, see Propagator::covarianceType().
+             * @param seed Selects the random sequence.
+             * @return INVALID_TYPE for equinoctial elements or CV_NONE, INVALID_ARGUMENT if clones is
+             * this Population, the number of clones is not positive or too large, or the kinematic
+             * representation of the type is missing, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode sampleClones(Population& clones, int clonesPerObject, CovarianceType type, unsigned long long seed = 0) const;
+
             /**
              * @brief setObjectName Set the name of the given object.
              * Names are host-only attributes and do not get synchronized to the GPU.
@@ -218,27 +279,230 @@ namespace OPI
              * that may have been stored there). Therefore, the IndexList must have at least
              * as many elements as the source population, and values stored within may not
              * exceed the size of this population.
+             * Each data field is scattered on the device holding its latest data, so for
+             * fields on a GPU only the source elements are transferred.
              * @param source The Population from which the elements are copied.
              * @param list A list of indices into the destination Population.
              */
 			OPI_API_EXPORT void insert(Population& source, IndexList& list);
 
+            /**
+             * @brief findById Returns the index of the object with the given catalogue ID.
+             *
+             * The lookup uses a hash index of ObjectProperties::id that is built on the host on
+             * first use. insert(), append(), remove() and reorder() keep it up to date; any other
+             * change of the properties rebuilds it on the next lookup.
+             * @param id The ID to look for.
+             * @return The index of the object, or -1 if no object has the ID. If several objects
+             * share the ID, the index of one of them.
+             */
+            OPI_API_EXPORT int findById(int id) const;
+
+            /**
+             * @brief updateById Overwrites objects with the objects of the same ID from another Population.
+             *
+             * Every object of the update replaces the object of this Population with the same
+             * ObjectProperties::id, as if inserted with insert(), so fields the update does not
+             * hold are cleared for the replaced objects. Object names are replaced where the
+             * update has one.
+             * @param update The Population holding the new object data. It must contain
+             * object properties.
+             * @param unmatched If not null, receives the indices into update of all objects
+             * whose ID was not found, e.g. to append them afterwards.
+             * @return INVALID_ARGUMENT if update is this Population or has no properties,
+             * SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode updateById(Population& update, IndexList* unmatched = nullptr);
+
 			//! Removes an object
 			OPI_API_EXPORT void remove(int index);
 			//! Removes a number of objects
+			/** The remaining objects keep their order. Fields whose latest data is on a GPU are
+			 * compacted there, so only the indices of the remaining objects are transferred.
+			 */
 			OPI_API_EXPORT void remove(IndexList& list);
 
+            /**
+             * @brief reorder Rearranges all objects according to a permutation.
+             *
+             * Object i of the reordered Population is the former object permutation[i]. All data
+             * fields, the byte array and the object names are reordered in a single pass; each field
+             * is rearranged on the device that holds its latest data, so device-resident data is not
+             * transferred. Results computed on the reordered Population can be mapped back to the
+             * original order with the same permutation.
+             * @param permutation A list of getSize() indices containing every object exactly once.
+             * @return INVALID_ARGUMENT if the list is not a permutation of all objects, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode reorder(IndexList& permutation);
+
+            /**
+             * @brief getSpatialOrder Computes a permutation that sorts the objects by their position.
+             *
+             * The positions are mapped onto a Morton (Z-order) curve through the bounding box of
+             * all objects, so objects close to each other in space end up close to each other in
+             * memory after calling reorder() with the result. Queries that read the positions of
+             * neighbours, such as the DistanceQuery kernels, then access memory more coherently.
+             * @param permutation Receives getSize() indices, the former index of each object in the
+             * sorted order.
+             * @return INVALID_ARGUMENT if the Population has no positions, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode getSpatialOrder(IndexList& permutation) const;
+
 			//! Stores the Object Data to disk
             OPI_API_EXPORT void write(const char* filename);
 			//! Loads the Object Data from disk
             OPI_API_EXPORT ErrorCode read(const char* filename);
 
+            /**
+             * @brief read Loads selected fields and a range of objects from disk.
+             *
+             * Blocks of fields not included in the mask are skipped without being decompressed
+             * or allocated, and only objects within the given range are loaded. The resulting
+             * Population contains numObjects objects, starting with object firstIndex of the file.
+             * @param filename The name of the file to read.
+             * @param fields A combination of FieldMask values selecting the fields to load.
+             * @param firstIndex Index of the first object to load.
+             * @param numObjects Number of objects to load; all remaining objects if negative.
+             * @return INDEX_RANGE if firstIndex exceeds the number of objects in the file,
+             * INVALID_DATA if the file is damaged, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode read(const char* filename, FieldMask fields, int firstIndex = 0, int numObjects = -1);
+
+            /**
+             * @brief writeUncompressed Stores the Object Data to disk in an uncompressed, columnar format.
+             *
+             * Files written by this function are larger but are opened with read() by mapping
+             * them into memory instead of reading and decompressing them. The mapping is private
+             * (copy-on-write): modifications of the loaded Population are not written back to the
+             * file, and the unmodified pages are shared between all processes reading the same file.
+             * @param filename The name of the file to write.
+             */
+            OPI_API_EXPORT void writeUncompressed(const char* filename);
+
             //! Stores the Object Data as a JSON file. Does not include the byte array.
+            /** The file is written object by object, so no document is built in memory. */
             OPI_API_EXPORT void writeJSON(const char* filename);
 
+            /**
+             * @brief writeColumns Exports the Object Data to disk in a binary, column-oriented format.
+             *
+             * Every component of every field is stored as a separate, contiguous column, named
+             * like the keys of the JSON export (e.g. orbit.sma, position.x, covariance.k2_k1).
+             * This suits analytics tools that process a few quantities of many objects, e.g. numpy
+             * arrays mapped at the column offsets. The file starts with four ints (magic number
+             * 47630, data revision, number of objects, number of columns), followed by a header per
+             * column: name length and name, element type (0: float64, 1: int32, 2: uint8), bytes
+             * per object, and the offset and length in bytes as 64-bit integers. Columns start at
+             * multiples of 64 bytes. Object names are stored as n+1 int32 "name.offsets" into the
+             * concatenated "name.data"; the byte array is a single "bytes" column. All values are
+             * in host byte order. The file cannot be loaded with read().
+             * @param filename The name of the file to write.
+             */
+            OPI_API_EXPORT void writeColumns(const char* filename);
+
 			//! Notify about updates on the specified device
 			OPI_API_EXPORT ErrorCode update(int type, Device device = DEVICE_HOST);
 
+			//! Returns true if memory for the given data type has been allocated on any device
+			/** Use this to check for optional data, e.g. accelerations, since the
+			 * get functions allocate the data on first access.
+			 */
+			OPI_API_EXPORT bool hasData(int type) const;
+			//! Returns the device holding the latest data of the given type
+			/** Pointers requested for this device are valid without a transfer. DEVICE_NOT_SET
+			 * is returned for unknown types and data that has not been set.
+			 */
+			OPI_API_EXPORT Device getLatestDevice(int type) const;
+			//! Returns a counter that changes whenever the data of the given type may have changed
+			/** It is increased by every update() and resize() and by requesting a pointer with
+			 * no_sync set, so equal revisions mean unchanged data. Zero is returned for unknown types.
+			 */
+			OPI_API_EXPORT unsigned long long getRevision(int type) const;
+			//! Returns the device memory currently held by the fields of this Population, one entry per field and device
+			/** When the Host's device memory limit is reached, the device copies of the Populations
+			 * used least recently are released first, see Host::setDeviceMemoryLimit().
+			 */
+			OPI_API_EXPORT std::vector<DeviceMemoryUsage> getDeviceMemoryUsage() const;
+
+            /**
+             * @brief update Notify about updates of some objects on the specified device.
+             *
+             * Only the count objects starting at first are transferred to devices (or the host)
+             * that held up-to-date data before, instead of the whole array. Use this after
+             * changing a few objects, e.g. fixing up some orbits on the host. If many separate
+             * ranges are updated, the data falls back to a full transfer.
+             * @param type The data type that was modified.
+             * @param device The device on which the objects were modified.
+             * @param first The index of the first modified object.
+             * @param count The number of modified objects.
+             * @return INVALID_TYPE if the data type is unknown, SUCCESS otherwise.
+             */
+			OPI_API_EXPORT ErrorCode update(int type, Device device, int first, int count);
+
+            /**
+             * @brief prefetch Starts an asynchronous upload of the given data type to the specified device.
+             *
+             * Every data type uses its own stream, so prefetching several types (e.g. orbit,
+             * properties and epoch) lets the uploads overlap with each other and with host work
+             * queued afterwards. The transfer is completed when the data is next requested on
+             * that device. Host data must not be modified in the meantime except through this
+             * Population's functions. Platforms without asynchronous transfers copy synchronously.
+             * @param type The data type to upload.
+             * @param device The device to upload to.
+             * @return INVALID_TYPE if the data type is unknown, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode prefetch(int type, Device device);
+
+            /**
+             * @brief setPinnedHostMemory Moves the host copies of all data arrays to page-locked
+             * (pinned) or back to pageable memory.
+             *
+             * Pinned memory can be transferred to the GPU via DMA at full bandwidth. The default is
+             * taken from Host::getPinnedHostMemory() when the Population is created. This setting
+             * has no effect if no GPU support is loaded. Pointers previously returned for
+             * DEVICE_HOST become invalid.
+             * @param pinned True to use pinned memory, false for pageable memory.
+             */
+            OPI_API_EXPORT void setPinnedHostMemory(bool pinned);
+
+            //! Returns true if the host copies of the data arrays are stored in pinned memory
+            OPI_API_EXPORT bool isPinnedHostMemory() const;
+
+            /**
+             * @brief partition Distributes the Population across several GPUs.
+             *
+             * Every device starting with firstDevice holds one contiguous slice of roughly
+             * getSize() / numDevices objects instead of a full copy, so the Population can be
+             * larger than the memory of a single GPU. In partitioned mode, all getters (e.g.
+             * getOrbit()) return a pointer to the device's slice when called for one of these
+             * devices; element 0 then refers to the object at getPartitionOffset(device). Each
+             * device can update its slice independently, and the host collects all modified
+             * slices the next time data is requested on the host. Slices are redistributed
+             * automatically when the size of the Population changes.
+             * @param numDevices The number of GPUs to use. Set to zero to hold the full Population
+             * on every device again.
+             * @param firstDevice The first device of the partition.
+             * @return INVALID_DEVICE if the devices are not available, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode partition(int numDevices, Device firstDevice = DEVICE_CUDA);
+
+            //! Returns the number of devices the Population is partitioned across, or zero
+            OPI_API_EXPORT int getPartitionCount() const;
+
+            //! Returns the index of the first object stored on the given device
+            /** This is zero for all devices that are not part of the partition. */
+            OPI_API_EXPORT int getPartitionOffset(Device device) const;
+
+            //! Returns the number of objects stored on the given device
+            /** This is getSize() for all devices that are not part of the partition. */
+            OPI_API_EXPORT int getPartitionSize(Device device) const;
+
+            //! Uploads the slices of the given data type to all devices of the partition
+            OPI_API_EXPORT ErrorCode scatter(int type);
+
+            //! Collects the slices of the given data type from all devices of the partition on the host
+            OPI_API_EXPORT ErrorCode gather(int type);
+
 			//! Retrieve the orbital parameters on the specified device
 			OPI_API_EXPORT Orbit* getOrbit(Device device = DEVICE_HOST, bool no_sync = false) const;
 			//! Retrieve the object properties on the specified device
@@ -256,6 +520,72 @@ namespace OPI
             //! Retrieve the arbitrary binary information on the specified device
 			OPI_API_EXPORT char* getBytes(Device device = DEVICE_HOST, bool no_sync = false) const;
 
+            /**
+             * @brief getOrbitColumns Retrieve the orbital parameters in structure-of-arrays layout.
+             *
+             * The columns are an additional copy of the data that is created when first requested
+             * and transposed again only if the data has changed in the meantime, on the device that
+             * holds the latest data if the GPU support provides a transposition kernel. Pointers
+             * returned by getOrbit() and the columns stay consistent: call updateColumns() after
+             * modifying the columns, and the next call of getOrbit() transposes them back.
+             * The same applies to all other get...Columns() functions.
+             * @param device The device on which the columns are requested.
+             * @param no_sync Skip the transposition, e.g. if all columns will be overwritten.
+             */
+			OPI_API_EXPORT Columns<Orbit> getOrbitColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve the object properties in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<ObjectProperties> getObjectPropertiesColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve the position in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<Vector3> getPositionColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve the velocity in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<Vector3> getVelocityColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve the acceleration in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<Vector3> getAccelerationColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve epoch information in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<Epoch> getEpochColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+			//! Retrieve the covariance information in structure-of-arrays layout, see getOrbitColumns()
+			OPI_API_EXPORT Columns<Covariance> getCovarianceColumns(Device device = DEVICE_HOST, bool no_sync = false) const;
+
+            /**
+             * @brief updateColumns Notify about updates of the structure-of-arrays data on the specified device.
+             * @param type The data type whose columns were modified; DATA_BYTES has no columns.
+             * @param device The device on which the columns were modified.
+             * @return INVALID_TYPE if the data type has no columns, SUCCESS otherwise.
+             */
+			OPI_API_EXPORT ErrorCode updateColumns(int type, Device device = DEVICE_HOST);
+
+            /**
+             * @brief getCompactCovariance Retrieve the covariances in a compact storage variant.
+             *
+             * Propagators that only need the kinematic block or single precision can request a variant
+             * that is smaller than the Covariance type, so only the variant is allocated on and transferred
+             * to the device. It is an additional copy that is converted from the covariances when first
+             * requested and again only after they have changed, on the device that holds the latest
+             * covariances if the GPU support provides the conversion. Call updateCompactCovariance() after
+             * modifying the variant to write it back.
+             * @param storage The storage variant; getCovarianceStorageSize() returns its size per object.
+             * @param device The device on which the covariances are requested.
+             * @param no_sync Skip the conversion, e.g. if the variant will be overwritten entirely.
+             * @return Pointer to the variant of all objects, a Covariance pointer for COVARIANCE_FULL.
+             * Zero if the storage variant is unknown.
+             */
+            OPI_API_EXPORT void* getCompactCovariance(CovarianceStorage storage, Device device = DEVICE_HOST, bool no_sync = false) const;
+
+            /**
+             * @brief updateCompactCovariance Writes a modified storage variant back to the covariances.
+             *
+             * The variant is transferred to the host, which moves less data than the full covariances,
+             * and expanded there. Elements that are not part of the variant keep their values.
+             * @param storage The storage variant that was modified.
+             * @param device The device on which the variant was modified.
+             * @return INVALID_TYPE if the storage variant is unknown, INVALID_ARGUMENT if it has not been
+             * requested before, SUCCESS otherwise.
+             */
+            OPI_API_EXPORT ErrorCode updateCompactCovariance(CovarianceStorage storage, Device device = DEVICE_HOST);
+
+            //! Returns the size in bytes of the covariance of one object in the given storage variant, 0 if it is unknown
+            OPI_API_EXPORT static int getCovarianceStorageSize(CovarianceStorage storage);
+
             /**
              * @brief validate Performs various checks on the Population data and generate a debug string.
              *
@@ -272,6 +602,30 @@ namespace OPI
              */
             OPI_API_EXPORT std::string validate(IndexList& invalidObjects) const;
 
+            /**
+             * @brief validate Performs the checks of validate() on all threads and returns the findings as bit flags.
+             *
+             * No report is formatted; call getValidationReport() if one is needed. On the host, the
+             * objects are checked in parallel. If a CUDA device is given and the GPU support provides
+             * the checks, they run on that device instead, which avoids downloading the Population if
+             * its data is already there; only the flags are transferred back.
+             * @param invalidObjects an IndexList to which indices of invalid objects will be added.
+             * @param errors An array of getSize() ints that receives the ValidationFlags of every object,
+             * zero for valid objects. May be null.
+             * @param device The device on which the checks are performed.
+             * @return The combination of the flags of all objects, plus VALIDATION_MIXED_EPOCHS if only some
+             * objects with an orbit have a current epoch set. VALIDATION_NONE if no problems are found.
+             */
+            OPI_API_EXPORT int validate(IndexList& invalidObjects, int* errors, Device device = DEVICE_HOST) const;
+
+            /**
+             * @brief getValidationReport Formats the findings of validate() as a human-readable string.
+             * @param errors The flags of every object, as returned by validate().
+             * @param flags The combination of flags returned by validate().
+             * @return The report, or an empty string if no problems were found.
+             */
+            OPI_API_EXPORT std::string getValidationReport(const int* errors, int flags) const;
+
         //protected:
 			OPI_API_EXPORT Host& getHostPointer() const;
 
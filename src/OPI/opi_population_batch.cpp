@@ -0,0 +1,147 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_population_batch.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_indexlist.h"
+#include "opi_propagator.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+namespace OPI
+{
+	//! \cond INTERNAL_DOCUMENTATION
+	class PopulationBatchImpl
+	{
+		public:
+			PopulationBatchImpl(Host& _host): host(_host), packed(new Population(_host)), offsets(new IndexList(_host)) { }
+
+			Host& host;
+			std::vector<Population*> members;
+			// offsets of the last pack(), one more entry than packed members
+			std::vector<int> offsetTable;
+			std::unique_ptr<Population> packed;
+			std::unique_ptr<IndexList> offsets;
+	};
+	//! \endcond
+
+	PopulationBatch::PopulationBatch(Host& host): impl(host)
+	{
+	}
+
+	PopulationBatch::~PopulationBatch()
+	{
+	}
+
+	int PopulationBatch::add(Population& member)
+	{
+		impl->members.push_back(&member);
+		return (int)impl->members.size() - 1;
+	}
+
+	void PopulationBatch::clear()
+	{
+		impl->members.clear();
+		impl->offsetTable.clear();
+		impl->packed.reset(new Population(impl->host));
+		impl->offsets.reset(new IndexList(impl->host));
+	}
+
+	int PopulationBatch::getMemberCount() const
+	{
+		return (int)impl->members.size();
+	}
+
+	Population& PopulationBatch::getMember(int index) const
+	{
+		return *impl->members[index];
+	}
+
+	int PopulationBatch::getOffset(int index) const
+	{
+		return (index >= 0 && index < (int)impl->offsetTable.size()) ? impl->offsetTable[index] : 0;
+	}
+
+	int PopulationBatch::getMemberSize(int index) const
+	{
+		return (index >= 0 && index + 1 < (int)impl->offsetTable.size()) ? impl->offsetTable[index + 1] - impl->offsetTable[index] : 0;
+	}
+
+	int PopulationBatch::findMember(int objectIndex) const
+	{
+		const std::vector<int>& table = impl->offsetTable;
+		if (table.empty() || objectIndex < 0 || objectIndex >= table.back())
+			return -1;
+		// the last offset not greater than the index, empty members share it with the next one
+		return (int)(std::upper_bound(table.begin(), table.end(), objectIndex) - table.begin()) - 1;
+	}
+
+	void PopulationBatch::pack()
+	{
+		const int count = (int)impl->members.size();
+		std::vector<int>& table = impl->offsetTable;
+		table.resize(count + 1);
+		table[0] = 0;
+		for (int m = 0; m < count; m++)
+			table[m + 1] = table[m] + impl->members[m]->getSize();
+
+		// the packed Population is sized once, then every member is copied where its data is
+		Population& packed = *impl->packed;
+		packed.resize(table[count], count > 0 ? impl->members[0]->getByteArraySize() : 1);
+		for (int m = 0; m < count; m++)
+		{
+			if (table[m + 1] > table[m])
+				packed.copy(*impl->members[m], 0, table[m + 1] - table[m], table[m]);
+		}
+
+		impl->offsets.reset(new IndexList(impl->host));
+		impl->offsets->reserve(count + 1);
+		for (int m = 0; m <= count; m++) impl->offsets->add(table[m]);
+	}
+
+	void PopulationBatch::unpack()
+	{
+		Population& packed = *impl->packed;
+		const int count = std::min((int)impl->members.size(), (int)impl->offsetTable.size() - 1);
+		for (int m = 0; m < count; m++)
+		{
+			Population& member = *impl->members[m];
+			const int size = getMemberSize(m);
+			if (member.getSize() != size || size == 0) continue;
+			member.copy(packed, getOffset(m), size, 0);
+			member.setLastPropagatorName(packed.getLastPropagatorName());
+		}
+	}
+
+	Population& PopulationBatch::getPopulation() const
+	{
+		return *impl->packed;
+	}
+
+	IndexList& PopulationBatch::getOffsets() const
+	{
+		return *impl->offsets;
+	}
+
+	ErrorCode PopulationBatch::propagate(Propagator& propagator, double julian_day, double dt, PropagationMode mode)
+	{
+		pack();
+		ErrorCode status = propagator.propagate(*impl->packed, julian_day, dt, mode);
+		if (status == SUCCESS) unpack();
+		return status;
+	}
+}
@@ -0,0 +1,87 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_POPULATION_BATCH_H
+#define OPI_POPULATION_BATCH_H
+#include "opi_common.h"
+#include "opi_error.h"
+#include "opi_datatypes.h"
+#include "opi_pimpl_helper.h"
+namespace OPI
+{
+	class Host;
+	class Population;
+	class IndexList;
+	class Propagator;
+
+	class PopulationBatchImpl;
+	//! \brief Packs many small Populations into one, so they are propagated in a single call
+	/** The members are copied one after another into a single packed Population, on the
+	 * device holding their data (see Population::copy()). The offset table holds the index of
+	 * the first object of every member within the packed Population, followed by the total
+	 * number of objects, so GPU plugins can find the members in device memory as well.
+	 *
+	 * The members are referenced, not owned, and must outlive the batch. They should use the
+	 * same byte array size as the first member; byte arrays of other sizes are not packed.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class PopulationBatch
+	{
+		public:
+			OPI_API_EXPORT PopulationBatch(Host& host);
+			OPI_API_EXPORT ~PopulationBatch();
+
+			//! Adds a member to the batch and returns its index
+			/** The member is copied into the packed Population by the next pack(). */
+			OPI_API_EXPORT int add(Population& member);
+			//! Removes all members and releases the packed Population
+			OPI_API_EXPORT void clear();
+
+			//! Returns the number of members
+			OPI_API_EXPORT int getMemberCount() const;
+			//! Returns a member by index
+			OPI_API_EXPORT Population& getMember(int index) const;
+			//! Returns the index of the first object of a member within the packed Population
+			OPI_API_EXPORT int getOffset(int index) const;
+			//! Returns the number of objects of a member at the time it was packed
+			OPI_API_EXPORT int getMemberSize(int index) const;
+			//! Returns the index of the member that holds an object of the packed Population, or -1
+			OPI_API_EXPORT int findMember(int objectIndex) const;
+
+			//! Copies all members into the packed Population and rebuilds the offset table
+			OPI_API_EXPORT void pack();
+			//! Copies the objects of the packed Population back into the members
+			/** Members whose size has changed since pack() are skipped. */
+			OPI_API_EXPORT void unpack();
+
+			//! Returns the packed Population
+			/** It can be propagated several times in a row before its results are unpacked. */
+			OPI_API_EXPORT Population& getPopulation() const;
+			//! Returns the offset table of the last pack(), getMemberCount() + 1 entries
+			OPI_API_EXPORT IndexList& getOffsets() const;
+
+			//! Packs the members, propagates them with a single call and unpacks the results
+			/** See Propagator::propagate(). The results are only unpacked on success; the
+			 * members are then marked as propagated by propagator.
+			 */
+			OPI_API_EXPORT ErrorCode propagate(Propagator& propagator, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH);
+
+		private:
+			Pimpl<PopulationBatchImpl> impl;
+	};
+}
+
+#endif
@@ -0,0 +1,116 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_propagation_handle.h"
+#include <mutex>
+#include <condition_variable>
+
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+	class PropagationHandleImpl
+	{
+		public:
+			PropagationHandleImpl():
+				finished(false),
+				settled(false),
+				result(SUCCESS),
+				callback(0),
+				callbackParameter(0)
+			{
+			}
+
+			// set when the result is available
+			bool finished;
+			// set when the callback has returned, the handle may be destroyed afterwards
+			bool settled;
+			ErrorCode result;
+			OPI_PropagationCallback callback;
+			void* callbackParameter;
+			mutable std::mutex mutex;
+			mutable std::condition_variable done;
+	};
+
+	//! \endcond
+
+	PropagationHandle::PropagationHandle()
+	{
+	}
+
+	PropagationHandle::~PropagationHandle()
+	{
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		impl->done.wait(lock, [&]{ return impl->settled; });
+	}
+
+	ErrorCode PropagationHandle::wait() const
+	{
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		impl->done.wait(lock, [&]{ return impl->finished; });
+		return impl->result;
+	}
+
+	bool PropagationHandle::isFinished() const
+	{
+		std::lock_guard<std::mutex> lock(impl->mutex);
+		return impl->finished;
+	}
+
+	ErrorCode PropagationHandle::getResult() const
+	{
+		std::lock_guard<std::mutex> lock(impl->mutex);
+		return impl->finished ? impl->result : NOT_IMPLEMENTED;
+	}
+
+	void PropagationHandle::setCallback(OPI_PropagationCallback callback, void* privatedata)
+	{
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		if(!impl->finished) {
+			impl->callback = callback;
+			impl->callbackParameter = privatedata;
+			return;
+		}
+		// the propagation has already finished, the callback is not stored
+		const ErrorCode result = impl->result;
+		lock.unlock();
+		if(callback)
+			callback(this, result, privatedata);
+	}
+
+	void PropagationHandle::complete(ErrorCode result)
+	{
+		OPI_PropagationCallback callback = 0;
+		void* privatedata = 0;
+		{
+			std::lock_guard<std::mutex> lock(impl->mutex);
+			if(impl->finished) return;
+			impl->finished = true;
+			impl->result = result;
+			callback = impl->callback;
+			privatedata = impl->callbackParameter;
+		}
+		impl->done.notify_all();
+		// the callback runs without the lock so that it can wait for the handle
+		if(callback)
+			callback(this, result, privatedata);
+		// notified with the lock held, the destructor may free the handle right after it is released
+		std::lock_guard<std::mutex> lock(impl->mutex);
+		impl->settled = true;
+		impl->done.notify_all();
+	}
+}
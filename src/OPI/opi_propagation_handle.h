@@ -0,0 +1,65 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_PROPAGATION_HANDLE_H
+#define OPI_PROPAGATION_HANDLE_H
+#include "opi_common.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+
+namespace OPI
+{
+	class PropagationHandleImpl;
+
+	//! \brief Tracks a propagation started by Propagator::propagateAsync()
+	/** The handle is completed once with the result of the propagation. Until then, the
+	 * Population and the IndexList passed to propagateAsync() must not be accessed or destroyed.
+	 * Destroying a handle waits for the propagation to finish.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class PropagationHandle
+	{
+		public:
+			//! Creates a handle for a pending propagation
+			OPI_API_EXPORT PropagationHandle();
+			OPI_API_EXPORT ~PropagationHandle();
+
+			//! Waits until the propagation has finished and returns its result
+			OPI_API_EXPORT ErrorCode wait() const;
+			//! Returns true if the propagation has finished, without waiting
+			OPI_API_EXPORT bool isFinished() const;
+			//! Returns the result of the propagation, or NOT_IMPLEMENTED if it has not finished yet
+			OPI_API_EXPORT ErrorCode getResult() const;
+
+			//! Sets a function that is called once when the propagation has finished
+			/** The callback receives this handle and the result. It runs on the thread that completes
+			 * the propagation, or right away on the calling thread if it has already finished. It may
+			 * call wait() but must not destroy the handle. Pass 0 to remove the callback.
+			 */
+			OPI_API_EXPORT void setCallback(OPI_PropagationCallback callback, void* privatedata);
+
+			//! Finishes the propagation with the given result and wakes all waiting threads
+			/** This is called by the Host, or by a propagator that queued the propagation itself,
+			 * see Propagator::runPropagationAsync(). Only the first call has an effect.
+			 */
+			OPI_API_EXPORT void complete(ErrorCode result);
+
+		private:
+			Pimpl<PropagationHandleImpl> impl;
+	};
+}
+
+#endif
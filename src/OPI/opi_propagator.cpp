@@ -18,26 +18,69 @@
 #include "opi_host.h"
 #include "opi_perturbation_module.h"
 #include "opi_indexlist.h"
+#include "opi_event_detector.h"
+#include "opi_gpusupport.h"
+#include "internal/opi_thread_pool.h"
+#include "internal/opi_trace.h"
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 
 namespace OPI
 {
 	/**
 	 * \cond INTERNAL_DOCUMENTATION
 	 */
+	// propagations started with propagateAsync(), shared with the pool tasks running them
+	struct AsyncState
+	{
+		AsyncState(): running(false), pending(0) { }
+
+		std::mutex mutex;
+		// asynchronous propagations of a propagator that is not reentrant run one after another
+		std::deque<std::function<void()> > queue;
+		// if a pool task is working through the queue
+		bool running;
+		// propagations submitted to the pool that have not finished yet
+		int pending;
+		// signalled when the queue is drained or a pending propagation has finished
+		std::condition_variable idle;
+	};
+
 	class PropagatorImpl
 	{
 		public:
 			PropagatorImpl():
-				allowPerturbationModules(false)
+				allowPerturbationModules(false),
+				gatherThreshold(0.0),
+				eventDetector(0),
+				async(std::make_shared<AsyncState>())
 			{
 			}
 
 			bool allowPerturbationModules;
+			double gatherThreshold;
+			EventDetector* eventDetector;
 			std::vector<PerturbationModule*> perturbationModules;
+			std::shared_ptr<AsyncState> async;
 	};
 
+	// compares first, so repeated calls of the same propagator do not copy the name
+	static void recordPropagatorName(Population& population, const char* name)
+	{
+		if (strcmp(population.getLastPropagatorName(), name) != 0)
+			population.setLastPropagatorName(name);
+	}
+
 	//! \endcond
 
     Propagator::Propagator()
@@ -46,6 +89,14 @@ namespace OPI
 
 	Propagator::~Propagator()
 	{
+		finishAsync();
+	}
+
+	void Propagator::finishAsync()
+	{
+		AsyncState& async = *data->async;
+		std::unique_lock<std::mutex> lock(async.mutex);
+		async.idle.wait(lock, [&]{ return async.queue.empty() && !async.running && async.pending == 0; });
 	}
 
 	void Propagator::useModules()
@@ -71,24 +122,385 @@ namespace OPI
     ErrorCode Propagator::propagate(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices)
 	{
 		ErrorCode status = SUCCESS;
+		TraceScope trace(population.getHostPointer(), "propagate", getName(), indices ? indices->getSize() : population.getSize(), traceDevice(*this));
 		// ensure this propagator is enabled
 		status = enable();
 		// an error occured?
 		if(status == SUCCESS)
-            status = runPropagation(population, julian_day, dt, mode, indices);
+		{
+			if (indices && data->gatherThreshold > 0.0 && indices->getSize() <= data->gatherThreshold * population.getSize())
+			{
+				// propagate a compact copy so transfers scale with the number of selected objects
+				Population selection(population, *indices);
+				status = runPropagation(selection, julian_day, dt, mode, nullptr);
+				if (status == SUCCESS) population.insert(selection, *indices);
+			}
+			else status = runPropagation(population, julian_day, dt, mode, indices);
+		}
+		if (status == SUCCESS && data->eventDetector)
+			status = data->eventDetector->detect(population, julian_day + dt / 86400.0);
 		getHost()->sendError(status);
-        if (status == SUCCESS && population.getLastPropagatorName() != getName())
-        {
-            population.setLastPropagatorName(getName());
-        }
+		if (status == SUCCESS) recordPropagatorName(population, getName());
+		return status;
+	}
+
+	ErrorCode Propagator::propagateFast(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices)
+	{
+		if (!isEnabled()) return propagate(population, julian_day, dt, mode, indices);
+		const ErrorCode status = runPropagation(population, julian_day, dt, mode, indices);
+		if (status == SUCCESS) recordPropagatorName(population, getName());
+		return status;
+	}
+
+	PropagationHandle* Propagator::propagateAsync(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices)
+	{
+		PropagationHandle* handle = new PropagationHandle();
+		ErrorCode status = enable();
+		// propagators that queue their work on a stream complete the handle themselves
+		if (status == SUCCESS)
+			status = runPropagationAsync(population, julian_day, dt, mode, indices, *handle);
+		if (status == SUCCESS)
+		{
+			recordPropagatorName(population, getName());
+			return handle;
+		}
+		if (status != NOT_IMPLEMENTED)
+		{
+			getHost()->sendError(status);
+			handle->complete(status);
+			return handle;
+		}
+
+		// device selections are per thread, the task uses the device of the calling thread
+		Host& host = population.getHostPointer();
+		GpuSupport* gpu = host.getGPUSupport();
+		const int device = gpu ? gpu->getCurrentDevice() : 0;
+		std::function<void()> task = [=, &population]() {
+			if (gpu)
+				gpu->selectDevice(device);
+			handle->complete(propagate(population, julian_day, dt, mode, indices));
+		};
+		ThreadPool& pool = host.getThreadPool();
+		std::shared_ptr<AsyncState> async = data->async;
+		if (reentrant())
+		{
+			{
+				std::lock_guard<std::mutex> lock(async->mutex);
+				async->pending++;
+			}
+			pool.submit([task, async]() {
+				task();
+				std::lock_guard<std::mutex> lock(async->mutex);
+				async->pending--;
+				async->idle.notify_all();
+			});
+			return handle;
+		}
+		std::lock_guard<std::mutex> lock(async->mutex);
+		async->queue.push_back(task);
+		if (!async->running)
+		{
+			// a single task works through the queue, so no pool thread waits for another one
+			async->running = true;
+			pool.submit([async]() {
+				while (true)
+				{
+					std::function<void()> next;
+					{
+						std::lock_guard<std::mutex> queueLock(async->mutex);
+						if (async->queue.empty())
+						{
+							async->running = false;
+							async->idle.notify_all();
+							return;
+						}
+						next = async->queue.front();
+						async->queue.pop_front();
+					}
+					next();
+				}
+			});
+		}
+		return handle;
+	}
+
+	ErrorCode Propagator::runPropagationAsync(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices, PropagationHandle& handle)
+	{
+		return NOT_IMPLEMENTED;
+	}
+
+	void Propagator::setGatherThreshold(double fraction)
+	{
+		data->gatherThreshold = std::max(0.0, std::min(1.0, fraction));
+	}
+
+	double Propagator::getGatherThreshold() const
+	{
+		return data->gatherThreshold;
+	}
+
+	void Propagator::setEventDetector(EventDetector* detector)
+	{
+		data->eventDetector = detector;
+	}
+
+	EventDetector* Propagator::getEventDetector() const
+	{
+		return data->eventDetector;
+	}
+
+	ErrorCode Propagator::propagateParallel(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices, int shardSize)
+	{
+		Host& host = population.getHostPointer();
+		ThreadPool& pool = host.getThreadPool();
+		const int numObjects = indices ? indices->getSize() : population.getSize();
+		if (shardSize <= 0)
+			shardSize = std::max(1, numObjects / (4 * pool.getThreadCount()));
+		const int numShards = (numObjects + shardSize - 1) / shardSize;
+		if (!reentrant() || numShards <= 1)
+			return propagate(population, julian_day, dt, mode, indices);
+
+		ErrorCode status = enable();
+		if (status == SUCCESS)
+		{
+			// copy the shards serially, the Population must not be synchronized concurrently
+			const int* selected = indices ? indices->getData(DEVICE_HOST) : nullptr;
+			std::vector<std::unique_ptr<IndexList> > lists(numShards);
+			std::vector<std::unique_ptr<Population> > shards(numShards);
+			for (int s=0; s<numShards; s++)
+			{
+				const int first = s * shardSize;
+				const int last = std::min(numObjects, first + shardSize);
+				lists[s].reset(new IndexList(host));
+				lists[s]->reserve(last - first);
+				for (int i=first; i<last; i++) lists[s]->add(selected ? selected[i] : i);
+				shards[s].reset(new Population(population, *lists[s]));
+			}
+
+			std::vector<ErrorCode> results(numShards, SUCCESS);
+			pool.run(numShards, [&](int s) {
+				results[s] = runPropagation(*shards[s], julian_day, dt, mode, nullptr);
+			});
+
+			// merge the results back into the Population
+			for (int s=0; s<numShards; s++)
+			{
+				if (results[s] == SUCCESS) population.insert(*shards[s], *lists[s]);
+				else if (status == SUCCESS) status = results[s];
+			}
+		}
+		getHost()->sendError(status);
+		if (status == SUCCESS) recordPropagatorName(population, getName());
 		return status;
 	}
 
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// the data types moved between the Population and the chunks of propagateStreamed()
+	static const int STREAMED_TYPES[] = { DATA_ORBIT, DATA_PROPERTIES, DATA_POSITION, DATA_VELOCITY, DATA_ACCELERATION, DATA_EPOCH, DATA_COVARIANCE, DATA_BYTES };
+	static const int STREAMED_TYPE_COUNT = sizeof(STREAMED_TYPES) / sizeof(STREAMED_TYPES[0]);
+
+	static size_t streamedElementSize(const Population& population, int type)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return sizeof(Orbit);
+			case DATA_PROPERTIES: return sizeof(ObjectProperties);
+			case DATA_POSITION:
+			case DATA_VELOCITY:
+			case DATA_ACCELERATION: return sizeof(Vector3);
+			case DATA_EPOCH: return sizeof(Epoch);
+			case DATA_COVARIANCE: return sizeof(Covariance);
+			case DATA_BYTES: return population.getByteArraySize();
+			default: return 0;
+		}
+	}
+
+	static char* streamedField(const Population& population, int type, Device device, bool no_sync)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return reinterpret_cast<char*>(population.getOrbit(device, no_sync));
+			case DATA_PROPERTIES: return reinterpret_cast<char*>(population.getObjectProperties(device, no_sync));
+			case DATA_POSITION: return reinterpret_cast<char*>(population.getPosition(device, no_sync));
+			case DATA_VELOCITY: return reinterpret_cast<char*>(population.getVelocity(device, no_sync));
+			case DATA_ACCELERATION: return reinterpret_cast<char*>(population.getAcceleration(device, no_sync));
+			case DATA_EPOCH: return reinterpret_cast<char*>(population.getEpoch(device, no_sync));
+			case DATA_COVARIANCE: return reinterpret_cast<char*>(population.getCovariance(device, no_sync));
+			case DATA_BYTES: return population.getBytes(device, no_sync);
+			default: return 0;
+		}
+	}
+
+	// moves chunks between the Population in host memory and the chunk Populations on the device
+	struct ChunkTransfer
+	{
+		ChunkTransfer(Population& _population, GpuSupport* _gpu, Device _device, int _chunkSize):
+			population(_population), gpu(_gpu), device(_device), stream(0), chunkSize(_chunkSize) { }
+
+		int count(int chunk) const { return std::min(chunkSize, population.getSize() - chunk * chunkSize); }
+
+		// copies the fields of the Population into device memory of the chunk
+		void upload(int chunk, Population& target)
+		{
+			const int first = chunk * chunkSize;
+			const int objects = count(chunk);
+			target.resize(objects, population.getByteArraySize());
+			std::vector<int> uploaded;
+			for (int t = 0; t < STREAMED_TYPE_COUNT; t++)
+			{
+				const int type = STREAMED_TYPES[t];
+				if (!population.hasData(type)) continue;
+				const size_t elementSize = streamedElementSize(population, type);
+				char* source = streamedField(population, type, DEVICE_HOST, false) + first * elementSize;
+				gpu->copyAsync(streamedField(target, type, device, true), source, elementSize, objects, true, stream);
+				uploaded.push_back(type);
+			}
+			gpu->synchronizeStream(stream);
+			for (size_t t = 0; t < uploaded.size(); t++) target.update(uploaded[t], device);
+		}
+
+		// copies all fields of the chunk back into its range of the Population
+		void download(int chunk, Population& source)
+		{
+			const int first = chunk * chunkSize;
+			const int objects = count(chunk);
+			std::vector<int> downloaded;
+			for (int t = 0; t < STREAMED_TYPE_COUNT; t++)
+			{
+				const int type = STREAMED_TYPES[t];
+				if (!source.hasData(type)) continue;
+				const size_t elementSize = streamedElementSize(population, type);
+				// fields created by the propagator are allocated on the host only
+				char* destination = streamedField(population, type, DEVICE_HOST, false) + first * elementSize;
+				if (source.getLatestDevice(type) == device)
+					gpu->copyAsync(destination, streamedField(source, type, device, false), elementSize, objects, false, stream);
+				else
+					memcpy(destination, streamedField(source, type, DEVICE_HOST, false), elementSize * objects);
+				downloaded.push_back(type);
+			}
+			gpu->synchronizeStream(stream);
+			for (size_t t = 0; t < downloaded.size(); t++) population.update(downloaded[t], DEVICE_HOST, first, objects);
+		}
+
+		Population& population;
+		GpuSupport* gpu;
+		Device device;
+		void* stream;
+		int chunkSize;
+	};
+
+	/**
+	 * \endcond
+	 */
+
+	ErrorCode Propagator::propagateStreamed(Population& population, double julian_day, double dt, PropagationMode mode, int chunkSize)
+	{
+		Host& host = population.getHostPointer();
+		GpuSupport* gpu = host.getGPUSupport();
+		const int size = population.getSize();
+		if (gpu && chunkSize <= 0)
+		{
+			// three chunks use half of the free memory, the propagator may need more
+			size_t objectSize = 0;
+			for (int t = 0; t < STREAMED_TYPE_COUNT; t++)
+				if (population.hasData(STREAMED_TYPES[t])) objectSize += streamedElementSize(population, STREAMED_TYPES[t]);
+			const size_t freeMemory = gpu->getFreeDeviceMemory();
+			chunkSize = (freeMemory > 0 && objectSize > 0) ? (int)std::min(freeMemory / (6 * objectSize), (size_t)size) : size;
+			chunkSize = std::max(chunkSize, 1);
+		}
+		if (!gpu || chunkSize >= size)
+			return propagate(population, julian_day, dt, mode);
+
+		ErrorCode status = enable();
+		if (status == SUCCESS)
+		{
+			// the chunks are transferred from the host, where the Population has to be up to date
+			for (int t = 0; t < STREAMED_TYPE_COUNT; t++)
+				if (population.hasData(STREAMED_TYPES[t])) streamedField(population, STREAMED_TYPES[t], DEVICE_HOST, false);
+			const int currentDevice = gpu->getCurrentDevice();
+			ChunkTransfer transfer(population, gpu, (Device)(DEVICE_CUDA + currentDevice), chunkSize);
+			transfer.stream = gpu->createStream();
+			const int numChunks = (size + chunkSize - 1) / chunkSize;
+			std::unique_ptr<Population> chunks[3];
+			for (int c = 0; c < 3; c++) chunks[c].reset(new Population(host));
+
+			transfer.upload(0, *chunks[0]);
+			for (int k = 0; k < numChunks && status == SUCCESS; k++)
+			{
+				// the worker downloads the previous chunk, then uploads the next one into its buffer
+				std::thread worker([&, k]() {
+					gpu->selectDevice(currentDevice);
+					if (k > 0) transfer.download(k - 1, *chunks[(k - 1) % 3]);
+					if (k + 1 < numChunks) transfer.upload(k + 1, *chunks[(k + 1) % 3]);
+				});
+				status = runPropagation(*chunks[k % 3], julian_day, dt, mode, nullptr);
+				worker.join();
+				if (status == SUCCESS && k == numChunks - 1) transfer.download(k, *chunks[k % 3]);
+			}
+			gpu->destroyStream(transfer.stream);
+		}
+		getHost()->sendError(status);
+		if (status == SUCCESS) recordPropagatorName(population, getName());
+		return status;
+	}
+
+	ErrorCode Propagator::propagateSteps(Population& population, IndexList& indices, const double* steps)
+	{
+		ErrorCode status = enable();
+		if(status == SUCCESS)
+			status = runStepPropagation(population, indices, steps);
+		getHost()->sendError(status);
+		if (status == SUCCESS) recordPropagatorName(population, getName());
+		return status;
+	}
+
+	ErrorCode Propagator::runStepPropagation(Population& population, IndexList& indices, const double* steps)
+	{
+		// smallest power of two that is still propagated; remainders below are dropped
+		const double minimumStep = 1.0 / 1024.0;
+		const int size = indices.getSize();
+		const int* index = indices.getData(DEVICE_HOST);
+		std::vector<double> remaining(steps, steps + size);
+		double largestStep = 0.0;
+		for (int i=0; i<size; i++) largestStep = std::max(largestStep, remaining[i]);
+		if (largestStep < minimumStep) return SUCCESS;
+
+		std::vector<int> batch;
+		batch.reserve(size);
+		for (double step = std::pow(2.0, std::floor(std::log2(largestStep))); step >= minimumStep; step *= 0.5)
+		{
+			batch.clear();
+			for (int i=0; i<size; i++)
+			{
+				if (remaining[i] >= step)
+				{
+					batch.push_back(index[i]);
+					remaining[i] -= step;
+				}
+			}
+			if (batch.empty()) continue;
+			IndexList batchObjects(population.getHostPointer());
+			batchObjects.reserve(batch.size());
+			for (size_t i=0; i<batch.size(); i++) batchObjects.add(batch[i]);
+			ErrorCode status = runPropagation(population, 0.0, step, MODE_INDIVIDUAL_EPOCHS, &batchObjects);
+			if (status != SUCCESS) return status;
+		}
+		return SUCCESS;
+	}
+
 	bool Propagator::backwardPropagation()
 	{
         return false;
 	}
 
+	bool Propagator::reentrant()
+	{
+		return false;
+	}
+
 	bool Propagator::cartesianCoordinates()
 	{
 		return false;
@@ -127,17 +539,22 @@ namespace OPI
             }
             std::cout << "Aligning to epoch " << std::setprecision(15) << latestEpoch << ". This may take a while." << std::endl;
 
-            OPI::ErrorCode error;
+            OPI::ErrorCode error = OPI::SUCCESS;
             int objectsAligned = 0;
             while (objectsAligned < population.getSize())
             {
+                // The cached bounds are reduced on the device, so the epochs are only
+                // downloaded if some objects still need to be propagated.
+                if ((latestEpoch - population.getEarliestEpoch()) * 86400.0 < 1) break;
                 objectsAligned = 0;
                 OPI::IndexList trailingObjects(population.getHostPointer());
+                OPI::IndexList closingObjects(population.getHostPointer());
+                std::vector<double> closingSteps;
+                const OPI::Epoch* epoch = population.getEpoch();
                 for (int i=0; i<population.getSize(); i++)
                 {
                     // Find objects that are trailing behind the object with the latest current epoch.
-                    const double currentEpoch = population.getEpoch()[i].current_epoch;
-                    const double deltaSeconds = (latestEpoch - currentEpoch) * 86400.0;
+                    const double deltaSeconds = (latestEpoch - epoch[i].current_epoch) * 86400.0;
                     if (deltaSeconds < 1)
                     {
                         // Current object is already aligned.
@@ -148,19 +565,20 @@ namespace OPI
                         // Current object is trailing by more than the given dt. Add to list.
                         trailingObjects.add(i);
                     }
-                    else if (deltaSeconds < dt)
+                    else
                     {
-                        // Object is close to the target epoch. Propagate individually.
-                        OPI::IndexList thisObject(population.getHostPointer());
-                        thisObject.add(i);
-                        //std::cout << "Object " << i << " closing in. Propagating for " << deltaSeconds << " seconds." << std::endl;
-                        error = propagate(population, 0.0, deltaSeconds, OPI::MODE_INDIVIDUAL_EPOCHS, &thisObject);
+                        // Object is close to the target epoch. Collect it together with its remaining step.
+                        closingObjects.add(i);
+                        closingSteps.push_back(deltaSeconds);
                     }
                 }
 
                 // Propagate all trailing objects.
                 if (trailingObjects.getSize() > 0) error = propagate(population, 0.0, dt, OPI::MODE_INDIVIDUAL_EPOCHS, &trailingObjects);
 
+                // Propagate all closing objects by their individual steps.
+                if (error == OPI::SUCCESS && closingObjects.getSize() > 0) error = propagateSteps(population, closingObjects, &closingSteps[0]);
+
                 // Check for errors
                 if (error == OPI::NOT_IMPLEMENTED)
                 {
@@ -21,6 +21,7 @@
 #include "opi_error.h"
 #include "opi_module.h"
 #include "opi_pimpl_helper.h"
+#include "opi_propagation_handle.h"
 #include <string>
 
 namespace OPI
@@ -28,6 +29,7 @@ namespace OPI
 	class Population;
 	class IndexList;
 	class PerturbationModule;
+	class EventDetector;
 
 	//! Contains the propagation implementation data
 	class PropagatorImpl;
@@ -72,11 +74,137 @@ namespace OPI
              * @param indices An IndexList containing the indices of the Population elements that
              * should be propagated. Defaults to null in which case all objects are propagated.
              * The plugin shall return NOT_IMPLEMENTED if an index list is set and indexed propagation
-             * is unsupported.
+             * is unsupported. If the list selects few enough objects (see setGatherThreshold()),
+             * they are propagated on a compact copy of the Population instead.
              * @return OPI::SUCCESS if propagation was successful, or other error code.
              */
             OPI_API_EXPORT ErrorCode propagate(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
 
+            /**
+             * @brief propagateFast Propagates without the per-call bookkeeping of propagate().
+             *
+             * Meant for loops that call an active propagator very often with small Populations,
+             * such as the single-object calls of refinement steps. If the propagator is already
+             * enabled, runPropagation() is called directly: errors are returned but not passed to
+             * the Host's error callback, and tracing, the gather threshold and the EventDetector
+             * do not apply. Otherwise, this function behaves exactly like propagate().
+             * The parameters are the same as for propagate().
+             * @return OPI::SUCCESS if propagation was successful, or other error code.
+             */
+            OPI_API_EXPORT ErrorCode propagateFast(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
+
+            /**
+             * @brief propagateSteps Propagates the indexed objects by individual time steps.
+             *
+             * Every object is propagated from its own current_epoch (individual epoch mode) by the
+             * time step given for it in the steps array. This is used by align() to move all objects
+             * that are close to the target epoch in one batch. Calls runStepPropagation().
+             * @param population The Population to be propagated.
+             * @param indices The indices of the Population elements that should be propagated.
+             * @param steps The time step, in seconds, for each entry of the index list.
+             * @return OPI::SUCCESS if propagation was successful, or other error code.
+             */
+            OPI_API_EXPORT ErrorCode propagateSteps(Population& population, IndexList& indices, const double* steps);
+
+            /**
+             * @brief propagateParallel Propagates a Population on all threads of the host.
+             *
+             * The objects (or the given indices) are split into shards of shardSize objects. Every
+             * shard is copied into a separate Population, propagated concurrently on the Host's thread
+             * pool and copied back. This only happens if the propagator is reentrant(); otherwise, or if
+             * there is just one shard, this function behaves exactly like propagate(). Since the copies
+             * are made on the host, this is intended for CPU propagators.
+             * @param population The Population to be propagated.
+             * @param julian_day The base date in Julian date format, see propagate().
+             * @param dt The time step, in seconds, from last propagation.
+             * @param mode Sets the propagation mode to single epoch (default) or individual epochs.
+             * @param indices An IndexList containing the indices of the objects to propagate. Defaults to
+             * null in which case all objects are propagated.
+             * @param shardSize The number of objects per shard. Defaults to zero which creates four
+             * shards per thread.
+             * @return OPI::SUCCESS if propagation of all shards was successful, or the error code of
+             * the first shard that failed. Results of failed shards are not copied back.
+             */
+            OPI_API_EXPORT ErrorCode propagateParallel(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr, int shardSize = 0);
+
+            /**
+             * @brief propagateStreamed Propagates a Population that does not fit into device memory.
+             *
+             * The Population stays in host memory and is split into chunks of chunkSize objects. Each
+             * chunk is uploaded into one of three chunk Populations on the current device, propagated
+             * there and downloaded back into its range of the Population. A second thread downloads
+             * the previous chunk and uploads the next one on a separate stream while the current chunk
+             * is propagated, so transfers overlap with the propagation. Only the three chunks are
+             * allocated on the device; page-locked host memory (see Host::setPinnedHostMemory()) speeds
+             * up the transfers. Without GPU support, or if the Population fits into a single chunk,
+             * this function behaves exactly like propagate().
+             * @param population The Population to be propagated.
+             * @param julian_day The base date in Julian date format, see propagate().
+             * @param dt The time step, in seconds, from last propagation.
+             * @param mode Sets the propagation mode to single epoch (default) or individual epochs.
+             * @param chunkSize The number of objects per chunk. Defaults to zero which uses half of
+             * the free device memory for the three chunks.
+             * @return OPI::SUCCESS if propagation of all chunks was successful, or the error code of
+             * the chunk that failed. Chunks following a failed chunk are not propagated.
+             */
+            OPI_API_EXPORT ErrorCode propagateStreamed(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, int chunkSize = 0);
+
+            /**
+             * @brief propagateAsync Starts a propagation and returns without waiting for it.
+             *
+             * Propagators that queue their work on a device stream do so in runPropagationAsync().
+             * All other propagations run propagate() on a thread of the Host's thread pool, using
+             * the CUDA device selected by the calling thread. Propagations of a propagator that is
+             * not reentrant() run one after another in the order they were started, so several
+             * Populations can be handed to different propagators, or to a reentrant one, at once.
+             * The Population and the index list must not be accessed until the propagation has
+             * finished.
+             * @param population The Population to be propagated.
+             * @param julian_day The base date in Julian date format, see propagate().
+             * @param dt The time step, in seconds, from last propagation.
+             * @param mode Sets the propagation mode to single epoch (default) or individual epochs.
+             * @param indices An IndexList containing the indices of the objects to propagate, see
+             * propagate().
+             * @return A handle that is completed with the result of the propagation. It is owned by
+             * the caller; destroying it waits for the propagation to finish. Destroying the
+             * propagator waits for all of its pending propagations as well.
+             */
+            OPI_API_EXPORT PropagationHandle* propagateAsync(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
+
+            /**
+             * @brief setGatherThreshold Enables propagating small index lists on a compact copy.
+             *
+             * If propagate() is called with an IndexList selecting at most fraction * size objects
+             * of the Population, these objects are gathered into a temporary Population, propagated
+             * without an index list and scattered back. Data fields that are on a GPU are gathered
+             * and scattered there, so the transfers scale with the number of selected objects
+             * instead of the Population size. This suits small follow-up propagations such as
+             * conjunction refinement. Propagators that keep internal state per object index
+             * should not be used in this mode.
+             * @param fraction The largest share of selected objects, between 0 and 1. Defaults to
+             * zero which disables gathering; 1 gathers for every indexed propagation.
+             */
+            OPI_API_EXPORT void setGatherThreshold(double fraction);
+
+            //! Returns the share of selected objects up to which indexed propagations are gathered
+            OPI_API_EXPORT double getGatherThreshold() const;
+
+            /**
+             * @brief setEventDetector Runs an EventDetector after every successful call of propagate().
+             *
+             * The detector checks the Population at julian_day + dt / 86400, or at the current
+             * epoch of each object if it has one. Its events can be read with
+             * EventDetector::getEvents() until the next propagation. If compaction is enabled,
+             * the events are removed, so index lists passed to the following steps have to
+             * refer to the compacted Population.
+             * @param detector The detector, or null to disable detection. It is not owned by
+             * the propagator.
+             */
+            OPI_API_EXPORT void setEventDetector(EventDetector* detector);
+
+            //! Returns the EventDetector that runs after every propagation step
+            OPI_API_EXPORT EventDetector* getEventDetector() const;
+
             //! Assigns a module to this propagator (not yet implemented)
 			/**
 			 * It depends on the used Propagator if the assigned modules will be used
@@ -94,6 +222,13 @@ namespace OPI
 			//! Check if this propagator is able to propagate backwards
 			OPI_API_EXPORT virtual bool backwardPropagation();
 	
+			//! Check if this propagator can be called concurrently for different Populations
+			/** C plugins declare this by exporting an OPI_Plugin_reentrant function that returns
+			 * a non-zero value. Defaults to false.
+			 * \see propagateParallel
+			 */
+			OPI_API_EXPORT virtual bool reentrant();
+
 			//! Check if this propagator supports generation of cartesian state vectors
 			OPI_API_EXPORT virtual bool cartesianCoordinates();
 
@@ -161,6 +296,32 @@ namespace OPI
 			//! The C Namespace equivalent for this function is OPI_Plugin_propagate
             virtual ErrorCode runPropagation(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr) = 0;
 
+			//! Propagates the indexed objects by individual time steps, in seconds
+			/** Propagators that can handle one time step per object in a single launch should
+			 * override this. The default implementation splits every step into powers of two
+			 * and calls runPropagation() in individual epoch mode once per power for all objects
+			 * containing it, so all steps are covered with a few dozen indexed calls and an
+			 * accuracy of about one millisecond.
+			 */
+			virtual ErrorCode runStepPropagation(Population& population, IndexList& indices, const double* steps);
+
+			//! Queues a propagation without waiting for it to finish
+			/** Propagators that submit their work to a device stream can override this to return
+			 * SUCCESS once the work is queued, and complete the handle with the result when it has
+			 * finished, e.g. from a stream callback. Any other error completes the handle right
+			 * away. The default returns NOT_IMPLEMENTED, in which case the Host runs runPropagation()
+			 * on its thread pool. The C Namespace equivalent for this function is
+			 * OPI_Plugin_propagateAsync.
+			 */
+			virtual ErrorCode runPropagationAsync(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices, PropagationHandle& handle);
+
+			//! Waits until all propagations started with propagateAsync() have finished
+			/** The destructor calls this, but the derived parts are destroyed before it runs.
+			 * Implementations whose members are used by runPropagation() call it first in their
+			 * own destructor.
+			 */
+			OPI_API_EXPORT void finishAsync();
+
 		private:
 			Pimpl<PropagatorImpl> data;
 
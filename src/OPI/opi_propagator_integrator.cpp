@@ -0,0 +1,43 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_propagator_integrator.h"
+namespace OPI
+{
+	class PropagatorIntegratorImpl
+	{
+		public:
+	};
+
+	PropagatorIntegrator::PropagatorIntegrator()
+	{
+	}
+
+	PropagatorIntegrator::~PropagatorIntegrator()
+	{
+	}
+
+	ErrorCode PropagatorIntegrator::integrate(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode, IndexList* indices)
+	{
+		return runIntegration(population, delta, julian_day, dt, mode, indices);
+	}
+
+	ErrorCode PropagatorIntegrator::runIntegration(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode, IndexList* indices)
+	{
+		return NOT_IMPLEMENTED;
+	}
+
+};
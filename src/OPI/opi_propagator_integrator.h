@@ -0,0 +1,58 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_PROPAGATOR_INTEGRATOR_H
+#define OPI_PROPAGATOR_INTEGRATOR_H
+
+#include "opi_common.h"
+#include "opi_module.h"
+#include "opi_perturbations.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+namespace OPI
+{
+	class Population;
+	class Perturbations;
+	class IndexList;
+
+	//! Contains the integrator implementation data
+	class PropagatorIntegratorImpl;
+
+	/*!
+	 * \brief This class represents an integrator which advances a Population in a CustomPropagator
+	 *
+	 * \ingroup CPP_API_GROUP
+	 * The integrator receives the perturbations of all PerturbationModules of a CustomPropagator,
+	 * summed into a single Perturbations object, and applies them to the Population.
+	 * \see CustomPropagator, PerturbationModule
+	 */
+	class PropagatorIntegrator: public Module
+	{
+		public:
+			OPI_API_EXPORT PropagatorIntegrator();
+			OPI_API_EXPORT virtual ~PropagatorIntegrator();
+			//! Advances the passed dataset by dt seconds using the summed perturbations in delta
+			OPI_API_EXPORT ErrorCode integrate(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
+
+		protected:
+			virtual ErrorCode runIntegration(Population& population, Perturbations& delta, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
+
+		private:
+			Pimpl<PropagatorIntegratorImpl> impl;
+	};
+}
+
+#endif
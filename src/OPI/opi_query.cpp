@@ -16,6 +16,7 @@
  */
 #include "opi_query.h"
 #include "opi_host.h"
+#include "internal/opi_trace.h"
 namespace OPI
 {
 	//! \cond INTERNAL_DOCUMENTATION
@@ -38,6 +39,7 @@ namespace OPI
 		if(population.getSize() == 0)
 			return SUCCESS;
 		ErrorCode status;
+		TraceScope trace(population.getHostPointer(), "rebuild", getName(), population.getSize(), traceDevice(*this));
 		// ensure this DistanceQuery is enabled
 		status = enable();
 		// an error occured?
@@ -48,11 +50,25 @@ namespace OPI
 		return status;
 	}
 
+	ErrorCode DistanceQuery::refit(Population &population, IndexList* changedIndices)
+	{
+		if(population.getSize() == 0)
+			return SUCCESS;
+		ErrorCode status;
+		TraceScope trace(population.getHostPointer(), "refit", getName(), population.getSize(), traceDevice(*this));
+		status = enable();
+		if(status == SUCCESS)
+			status = runRefit(population, changedIndices);
+		getHost()->sendError(status);
+		return status;
+	}
+
 	ErrorCode DistanceQuery::queryCubicPairs(Population &population, IndexPairList& pairs, float cube_size)
 	{
 		if(population.getSize() == 0)
 			return SUCCESS;
 		ErrorCode status;
+		TraceScope trace(population.getHostPointer(), "query", getName(), population.getSize(), traceDevice(*this));
 		// ensure this DistanceQuery is enabled
 		status = enable();
 		// an error occured?
@@ -69,6 +85,11 @@ namespace OPI
 			runDebugDraw();
 	}
 
+	ErrorCode DistanceQuery::runRefit(Population& population, IndexList* changedIndices)
+	{
+		return runRebuild(population);
+	}
+
 	void DistanceQuery::runDebugDraw()
 	{
 
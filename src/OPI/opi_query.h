@@ -26,6 +26,7 @@
 namespace OPI
 {
 	class Population;
+	class IndexList;
 	class IndexPairList;
 
 	class DistanceQueryImpl;
@@ -41,6 +42,13 @@ namespace OPI
 
 			//! Rebuilds the internal structure
 			OPI_API_EXPORT ErrorCode rebuild(Population& population);
+			//! Updates the internal structure after objects have moved
+			/** changedIndices lists the objects whose positions changed since the last rebuild()
+			 * or refit(); if it is null, all objects may have moved. The Population must have the
+			 * same size as at the last rebuild(). Queries that cannot update their structure
+			 * incrementally rebuild it.
+			 */
+			OPI_API_EXPORT ErrorCode refit(Population& population, IndexList* changedIndices = 0);
 			//! Make a query about objects which resides inside a cube of cube_size
 			OPI_API_EXPORT ErrorCode queryCubicPairs(Population& population, IndexPairList& pairs, float cube_size);
 			//! Tell the query object to visualize its internal structure
@@ -50,6 +58,8 @@ namespace OPI
 		protected:
 			//! Override this function to change the rebuild behaviour
 			virtual ErrorCode runRebuild(Population& population) = 0;
+			//! Override this function to update the structure incrementally, the default calls runRebuild()
+			virtual ErrorCode runRefit(Population& population, IndexList* changedIndices);
 			//! Override this function to change the query behaviour
 			virtual ErrorCode runCubicPairQuery(Population& population, IndexPairList& pairs, float cube_size) = 0;
 			//! Override this function to change the debug draw command
@@ -0,0 +1,162 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_split_propagator.h"
+#include "opi_host.h"
+#include "opi_indexlist.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+namespace OPI
+{
+	struct SplitPropagatorImpl
+	{
+		Propagator* devicePropagator;
+		Propagator* hostPropagator;
+		double deviceFraction;
+		bool adaptive;
+	};
+
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// propagates one slice and measures its run time in seconds
+	static ErrorCode propagateSlice(Propagator* propagator, bool parallel, Population& slice, double julian_day, double dt, PropagationMode mode, double& seconds)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ErrorCode status = parallel ? propagator->propagateParallel(slice, julian_day, dt, mode) : propagator->propagate(slice, julian_day, dt, mode);
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return status;
+	}
+
+	//! \endcond
+
+	SplitPropagator::SplitPropagator(const char* name, Propagator* devicePropagator, Propagator* hostPropagator)
+	{
+		setName(name);
+		impl->devicePropagator = devicePropagator;
+		impl->hostPropagator = hostPropagator;
+		impl->deviceFraction = 0.5;
+		impl->adaptive = true;
+	}
+
+	SplitPropagator::~SplitPropagator()
+	{
+		finishAsync();
+	}
+
+	void SplitPropagator::setDeviceFraction(double fraction)
+	{
+		impl->deviceFraction = std::max(0.0, std::min(1.0, fraction));
+	}
+
+	double SplitPropagator::getDeviceFraction() const
+	{
+		return impl->deviceFraction;
+	}
+
+	void SplitPropagator::setAdaptiveSplit(bool adaptive)
+	{
+		impl->adaptive = adaptive;
+	}
+
+	bool SplitPropagator::getAdaptiveSplit() const
+	{
+		return impl->adaptive;
+	}
+
+	ErrorCode SplitPropagator::runPropagation(Population& population, double julian_day, double dt, PropagationMode mode, IndexList* indices)
+	{
+		const int numObjects = indices ? indices->getSize() : population.getSize();
+		const int deviceObjects = (int)std::floor(impl->deviceFraction * numObjects + 0.5);
+		if (deviceObjects >= numObjects)
+			return impl->devicePropagator->propagate(population, julian_day, dt, mode, indices);
+		if (deviceObjects <= 0)
+			return impl->hostPropagator->propagateParallel(population, julian_day, dt, mode, indices);
+
+		// copy both slices serially, the Population must not be synchronized concurrently
+		Host& host = population.getHostPointer();
+		const int* selected = indices ? indices->getData(DEVICE_HOST) : nullptr;
+		IndexList deviceList(host);
+		IndexList hostList(host);
+		deviceList.reserve(deviceObjects);
+		hostList.reserve(numObjects - deviceObjects);
+		for (int i=0; i<numObjects; i++)
+			(i < deviceObjects ? deviceList : hostList).add(selected ? selected[i] : i);
+		Population deviceSlice(population, deviceList);
+		Population hostSlice(population, hostList);
+
+		// the device slice stays on the calling thread, which has the device selected
+		double hostSeconds = 0.0;
+		ErrorCode hostStatus = SUCCESS;
+		std::thread hostWorker([&]() {
+			hostStatus = propagateSlice(impl->hostPropagator, true, hostSlice, julian_day, dt, mode, hostSeconds);
+		});
+		double deviceSeconds = 0.0;
+		ErrorCode deviceStatus = propagateSlice(impl->devicePropagator, false, deviceSlice, julian_day, dt, mode, deviceSeconds);
+		hostWorker.join();
+
+		if (deviceStatus != SUCCESS) return deviceStatus;
+		if (hostStatus != SUCCESS) return hostStatus;
+		population.insert(deviceSlice, deviceList);
+		population.insert(hostSlice, hostList);
+
+		// give each side the share of its throughput, averaged with the previous split to
+		// smooth out the noise of single measurements
+		if (impl->adaptive && deviceSeconds > 0.0 && hostSeconds > 0.0)
+		{
+			const double deviceRate = deviceObjects / deviceSeconds;
+			const double hostRate = (numObjects - deviceObjects) / hostSeconds;
+			const double balanced = deviceRate / (deviceRate + hostRate);
+			impl->deviceFraction = 0.5 * (impl->deviceFraction + balanced);
+		}
+		return SUCCESS;
+	}
+
+	bool SplitPropagator::backwardPropagation()
+	{
+		return impl->devicePropagator->backwardPropagation() && impl->hostPropagator->backwardPropagation();
+	}
+
+	bool SplitPropagator::cartesianCoordinates()
+	{
+		return impl->devicePropagator->cartesianCoordinates();
+	}
+
+	ReferenceFrame SplitPropagator::referenceFrame()
+	{
+		return impl->devicePropagator->referenceFrame();
+	}
+
+	CovarianceType SplitPropagator::covarianceType()
+	{
+		return impl->devicePropagator->covarianceType();
+	}
+
+	int SplitPropagator::requiresCUDA()
+	{
+		return impl->devicePropagator->requiresCUDA();
+	}
+
+	int SplitPropagator::requiresOpenCL()
+	{
+		return impl->devicePropagator->requiresOpenCL();
+	}
+}
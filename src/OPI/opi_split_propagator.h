@@ -0,0 +1,74 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_SPLIT_PROPAGATOR_H
+#define OPI_SPLIT_PROPAGATOR_H
+
+#include "opi_propagator.h"
+namespace OPI
+{
+	struct SplitPropagatorImpl;
+
+	//! \brief This class represents a propagator which splits every propagation between a GPU and a CPU propagator.
+	/** The objects (or the given indices) are divided into two complementary slices. The first
+	 * slice is copied into a separate Population and propagated by the device propagator on the
+	 * calling thread, while the second slice is propagated by the host propagator on all threads
+	 * of the Host (see Propagator::propagateParallel()). Both slices are inserted back into the
+	 * Population afterwards.
+	 *
+	 * The fraction of objects given to the device propagator is adapted after every propagation
+	 * to the measured throughput of both sides, so that both finish at the same time. The two
+	 * propagators must use the same time conventions, reference frame and coordinates.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class SplitPropagator:
+			public Propagator
+	{
+		public:
+			//! Creates a split propagator with the given name from a device and a host propagator
+			OPI_API_EXPORT SplitPropagator(const char* name, Propagator* devicePropagator, Propagator* hostPropagator);
+			OPI_API_EXPORT ~SplitPropagator();
+
+			//! Sets the fraction of objects that is propagated by the device propagator
+			/** The value is clamped to [0, 1] and replaces the fraction measured so far. */
+			OPI_API_EXPORT void setDeviceFraction(double fraction);
+			//! Returns the fraction of objects that the next propagation gives to the device propagator
+			OPI_API_EXPORT double getDeviceFraction() const;
+			//! Sets whether the fraction is adapted to the measured throughput, enabled by default
+			OPI_API_EXPORT void setAdaptiveSplit(bool adaptive);
+			//! Returns whether the fraction is adapted to the measured throughput
+			OPI_API_EXPORT bool getAdaptiveSplit() const;
+
+			virtual bool backwardPropagation();
+			virtual bool cartesianCoordinates();
+			virtual ReferenceFrame referenceFrame();
+			virtual CovarianceType covarianceType();
+			virtual int requiresCUDA();
+			virtual int requiresOpenCL();
+
+		protected:
+			/// Propagates the two slices concurrently and adapts the split to their run times
+			/** If one of the slices is empty, the other propagator handles all objects on the
+			 * Population itself.
+			 */
+			virtual ErrorCode runPropagation(Population& population, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH, IndexList* indices = nullptr);
+
+		private:
+			Pimpl<SplitPropagatorImpl> impl;
+	};
+}
+
+#endif
@@ -0,0 +1,465 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_trajectory.h"
+#include "opi_host.h"
+#include "opi_population.h"
+#include "opi_gpusupport.h"
+#include "internal/miniz.h"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+namespace OPI
+{
+	/**
+	 * \cond INTERNAL_DOCUMENTATION
+	 */
+
+	// Magic number and version of trajectory files
+	static const int TRAJECTORY_FILE_MAGIC = 47631;
+	static const int TRAJECTORY_FILE_VERSION = 1;
+	// Fields that have a fixed size per object and can be recorded
+	static const int TRAJECTORY_FIELDS = FIELD_ORBIT | FIELD_PROPERTIES | FIELD_POSITION | FIELD_VELOCITY
+		| FIELD_ACCELERATION | FIELD_EPOCH | FIELD_COVARIANCE;
+	// Batches waiting for the writer before record() blocks
+	static const size_t TRAJECTORY_QUEUED_BATCHES = 2;
+
+	static size_t trajectoryElementSize(int type)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return sizeof(Orbit);
+			case DATA_PROPERTIES: return sizeof(ObjectProperties);
+			case DATA_POSITION:
+			case DATA_VELOCITY:
+			case DATA_ACCELERATION: return sizeof(Vector3);
+			case DATA_EPOCH: return sizeof(Epoch);
+			case DATA_COVARIANCE: return sizeof(Covariance);
+			default: return 0;
+		}
+	}
+
+	static char* trajectoryField(const Population& population, int type, Device device, bool no_sync = false)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return reinterpret_cast<char*>(population.getOrbit(device, no_sync));
+			case DATA_PROPERTIES: return reinterpret_cast<char*>(population.getObjectProperties(device, no_sync));
+			case DATA_POSITION: return reinterpret_cast<char*>(population.getPosition(device, no_sync));
+			case DATA_VELOCITY: return reinterpret_cast<char*>(population.getVelocity(device, no_sync));
+			case DATA_ACCELERATION: return reinterpret_cast<char*>(population.getAcceleration(device, no_sync));
+			case DATA_EPOCH: return reinterpret_cast<char*>(population.getEpoch(device, no_sync));
+			case DATA_COVARIANCE: return reinterpret_cast<char*>(population.getCovariance(device, no_sync));
+			default: return 0;
+		}
+	}
+
+	static void writeTrajectoryInt(std::ostream& out, int value)
+	{
+		out.write(reinterpret_cast<char*>(&value), sizeof(int));
+	}
+
+	static int readTrajectoryInt(std::istream& in)
+	{
+		int value = 0;
+		in.read(reinterpret_cast<char*>(&value), sizeof(int));
+		return value;
+	}
+
+	// Steps recorded for one batch, copied to the host
+	struct TrajectoryBatch
+	{
+		int objects;
+		std::vector<double> times;
+		std::vector<std::vector<char> > fields;
+	};
+
+	// Buffer of one recorded field for batch_steps steps
+	struct TrajectoryRing
+	{
+		int type;
+		size_t elementSize;
+		// steps whose data is on the host
+		std::vector<char> host;
+		// steps whose data was on a GPU, allocated on first use
+		char* device;
+		Device deviceId;
+		std::vector<char> onDevice;
+	};
+
+	class TrajectoryRecorderImpl
+	{
+		public:
+			TrajectoryRecorderImpl(Host& owningHost):
+				host(owningHost), batchSteps(0), numObjects(-1), recordedSteps(0), stopping(false), failed(false)
+			{
+			}
+
+			// frees the device memory of all rings
+			void releaseRings()
+			{
+				GpuSupport* gpu = host.getGPUSupport();
+				for(size_t r = 0; r < rings.size(); r++) {
+					if(rings[r].device && gpu) {
+						int oldDevice = gpu->getCurrentDevice();
+						gpu->selectDevice(rings[r].deviceId - DEVICE_CUDA);
+						gpu->free(rings[r].device);
+						gpu->selectDevice(oldDevice);
+					}
+				}
+				rings.clear();
+			}
+
+			// writes the queued batches until close() stops the thread
+			void writerLoop()
+			{
+				std::vector<unsigned char> buffer;
+				while(true) {
+					TrajectoryBatch batch;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+						if(queue.empty()) return;
+						batch.objects = queue.front().objects;
+						batch.times.swap(queue.front().times);
+						batch.fields.swap(queue.front().fields);
+					}
+					bool ok = writeBatch(batch, buffer);
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						queue.pop_front();
+						if(!ok) failed = true;
+					}
+					changed.notify_all();
+				}
+			}
+
+			bool writeBatch(const TrajectoryBatch& batch, std::vector<unsigned char>& buffer)
+			{
+				writeTrajectoryInt(out, (int)batch.times.size());
+				writeTrajectoryInt(out, batch.objects);
+				out.write(reinterpret_cast<const char*>(batch.times.data()), batch.times.size() * sizeof(double));
+				for(size_t f = 0; f < batch.fields.size(); f++) {
+					unsigned long long length = batch.fields[f].size();
+					mz_ulong compressedSize = compressBound((mz_ulong)length);
+					buffer.resize(compressedSize > 0 ? compressedSize : 1);
+					if(compress(buffer.data(), &compressedSize, reinterpret_cast<const unsigned char*>(batch.fields[f].data()), (mz_ulong)length) != Z_OK)
+						return false;
+					unsigned long long compressedLength = compressedSize;
+					out.write(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+					out.write(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+					out.write(reinterpret_cast<const char*>(buffer.data()), compressedLength);
+				}
+				out.flush();
+				return out.good();
+			}
+
+			Host& host;
+			std::ofstream out;
+			int batchSteps;
+			int numObjects;
+			int recordedSteps;
+			std::vector<double> times;
+			std::vector<TrajectoryRing> rings;
+
+			// batches handed to the writer thread
+			std::thread writer;
+			std::mutex mutex;
+			std::condition_variable changed;
+			std::deque<TrajectoryBatch> queue;
+			bool stopping;
+			bool failed;
+	};
+
+	// Reads the header of a trajectory file and returns the recorded types
+	static bool readTrajectoryHeader(std::istream& in, std::vector<int>& types)
+	{
+		if(readTrajectoryInt(in) != TRAJECTORY_FILE_MAGIC) return false;
+		if(readTrajectoryInt(in) != TRAJECTORY_FILE_VERSION) return false;
+		int numFields = readTrajectoryInt(in);
+		if(!in.good() || numFields <= 0 || numFields > DATA_PARTIALS) return false;
+		types.resize(numFields);
+		for(int f = 0; f < numFields; f++) {
+			types[f] = readTrajectoryInt(in);
+			if(trajectoryElementSize(types[f]) == 0) return false;
+		}
+		return in.good();
+	}
+
+	//! \endcond
+
+	TrajectoryRecorder::TrajectoryRecorder(Host& host):
+		impl(host)
+	{
+	}
+
+	TrajectoryRecorder::~TrajectoryRecorder()
+	{
+		close();
+	}
+
+	ErrorCode TrajectoryRecorder::open(const char* filename, int fields, int batch_steps)
+	{
+		if(impl->out.is_open() || fields == 0 || (fields & ~TRAJECTORY_FIELDS) || batch_steps <= 0)
+			return INVALID_ARGUMENT;
+		impl->out.open(filename, std::ofstream::binary);
+		if(!impl->out.is_open()) {
+			std::cout << "Unable to open file " << filename << "!" << std::endl;
+			return DIRECTORY_NOT_FOUND;
+		}
+		impl->batchSteps = batch_steps;
+		impl->numObjects = -1;
+		impl->recordedSteps = 0;
+		impl->times.clear();
+		impl->stopping = false;
+		impl->failed = false;
+		for(int type = DATA_ORBIT; type <= DATA_COVARIANCE; type++) {
+			if(fields & (1 << type)) {
+				TrajectoryRing ring;
+				ring.type = type;
+				ring.elementSize = trajectoryElementSize(type);
+				ring.device = 0;
+				ring.deviceId = DEVICE_NOT_SET;
+				ring.onDevice.assign(batch_steps, 0);
+				impl->rings.push_back(ring);
+			}
+		}
+		writeTrajectoryInt(impl->out, TRAJECTORY_FILE_MAGIC);
+		writeTrajectoryInt(impl->out, TRAJECTORY_FILE_VERSION);
+		writeTrajectoryInt(impl->out, (int)impl->rings.size());
+		for(size_t r = 0; r < impl->rings.size(); r++)
+			writeTrajectoryInt(impl->out, impl->rings[r].type);
+		TrajectoryRecorderImpl* recorder = *impl;
+		impl->writer = std::thread([recorder]() { recorder->writerLoop(); });
+		return SUCCESS;
+	}
+
+	ErrorCode TrajectoryRecorder::record(const Population& population, double julian_day)
+	{
+		if(!impl->out.is_open())
+			return INVALID_ARGUMENT;
+		const int size = population.getSize();
+		if(impl->numObjects < 0)
+			impl->numObjects = size;
+		else if(size != impl->numObjects)
+			return INVALID_ARGUMENT;
+
+		GpuSupport* gpu = impl->host.getGPUSupport();
+		const int slot = (int)impl->times.size();
+		for(size_t r = 0; r < impl->rings.size(); r++) {
+			TrajectoryRing& ring = impl->rings[r];
+			const size_t bytes = ring.elementSize * size;
+			// data on a GPU is copied within that device, the ring is allocated on first use
+			const Device latest = population.getLatestDevice(ring.type);
+			ring.onDevice[slot] = 0;
+			if(gpu && size > 0 && latest >= DEVICE_CUDA && latest <= DEVICE_CUDA_LAST) {
+				if(!ring.device) {
+					int oldDevice = gpu->getCurrentDevice();
+					gpu->selectDevice(latest - DEVICE_CUDA);
+					gpu->allocate(reinterpret_cast<void**>(&ring.device), bytes * impl->batchSteps);
+					gpu->selectDevice(oldDevice);
+					ring.deviceId = latest;
+				}
+				if(ring.device && ring.deviceId == latest) {
+					char* source = trajectoryField(population, ring.type, latest);
+					const int d = latest - DEVICE_CUDA;
+					if(gpu->copyPeer(ring.device + bytes * slot, d, source, d, ring.elementSize, size))
+						ring.onDevice[slot] = 1;
+				}
+			}
+			if(!ring.onDevice[slot]) {
+				ring.host.resize(bytes * impl->batchSteps);
+				if(bytes > 0)
+					memcpy(ring.host.data() + bytes * slot, trajectoryField(population, ring.type, DEVICE_HOST), bytes);
+			}
+		}
+		impl->times.push_back(julian_day);
+		impl->recordedSteps++;
+		if((int)impl->times.size() == impl->batchSteps)
+			return flush();
+		return SUCCESS;
+	}
+
+	ErrorCode TrajectoryRecorder::flush()
+	{
+		if(!impl->out.is_open())
+			return INVALID_ARGUMENT;
+		const int steps = (int)impl->times.size();
+		if(steps == 0)
+			return SUCCESS;
+		const int size = impl->numObjects;
+		GpuSupport* gpu = impl->host.getGPUSupport();
+		TrajectoryBatch batch;
+		batch.objects = size;
+		batch.times.swap(impl->times);
+		batch.fields.resize(impl->rings.size());
+		for(size_t r = 0; r < impl->rings.size(); r++) {
+			TrajectoryRing& ring = impl->rings[r];
+			const size_t bytes = ring.elementSize * size;
+			std::vector<char>& data = batch.fields[r];
+			data.resize(bytes * steps);
+			int deviceSteps = 0;
+			for(int s = 0; s < steps; s++)
+				deviceSteps += ring.onDevice[s];
+			int oldDevice = 0;
+			if(deviceSteps > 0) {
+				oldDevice = gpu->getCurrentDevice();
+				gpu->selectDevice(ring.deviceId - DEVICE_CUDA);
+			}
+			if(deviceSteps == steps) {
+				// a single transfer for the whole batch
+				gpu->copy(data.data(), ring.device, bytes, steps, false);
+			}
+			else {
+				for(int s = 0; s < steps; s++) {
+					if(ring.onDevice[s])
+						gpu->copy(data.data() + bytes * s, ring.device + bytes * s, bytes, 1, false);
+					else if(bytes > 0)
+						memcpy(data.data() + bytes * s, ring.host.data() + bytes * s, bytes);
+				}
+			}
+			if(deviceSteps > 0)
+				gpu->selectDevice(oldDevice);
+		}
+
+		std::unique_lock<std::mutex> lock(impl->mutex);
+		impl->changed.wait(lock, [this]() { return impl->queue.size() < TRAJECTORY_QUEUED_BATCHES; });
+		impl->queue.push_back(TrajectoryBatch());
+		impl->queue.back().objects = batch.objects;
+		impl->queue.back().times.swap(batch.times);
+		impl->queue.back().fields.swap(batch.fields);
+		lock.unlock();
+		impl->changed.notify_all();
+		return SUCCESS;
+	}
+
+	ErrorCode TrajectoryRecorder::close()
+	{
+		if(!impl->out.is_open())
+			return SUCCESS;
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(impl->mutex);
+			impl->stopping = true;
+		}
+		impl->changed.notify_all();
+		impl->writer.join();
+		impl->releaseRings();
+		impl->out.close();
+		if(impl->failed) {
+			std::cout << "Failed to write trajectory data!" << std::endl;
+			return UNKNOWN_ERROR;
+		}
+		return SUCCESS;
+	}
+
+	int TrajectoryRecorder::getRecordedSteps() const
+	{
+		return impl->recordedSteps;
+	}
+
+	int TrajectoryRecorder::getStepCount(const char* filename)
+	{
+		std::ifstream in(filename, std::ifstream::binary);
+		std::vector<int> types;
+		if(!in.is_open() || !readTrajectoryHeader(in, types))
+			return -1;
+		int count = 0;
+		while(in.peek() != EOF) {
+			int steps = readTrajectoryInt(in);
+			readTrajectoryInt(in);
+			in.seekg(steps * sizeof(double), std::ios_base::cur);
+			for(size_t f = 0; f < types.size(); f++) {
+				unsigned long long length = 0, compressedLength = 0;
+				in.read(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+				in.read(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+				in.seekg(compressedLength, std::ios_base::cur);
+			}
+			if(!in.good() || steps <= 0)
+				return -1;
+			count += steps;
+		}
+		return count;
+	}
+
+	ErrorCode TrajectoryRecorder::readStep(const char* filename, int step, Population& population, double* julian_day)
+	{
+		std::ifstream in(filename, std::ifstream::binary);
+		if(!in.is_open()) {
+			std::cout << "Unable to open file " << filename << "!" << std::endl;
+			return DIRECTORY_NOT_FOUND;
+		}
+		std::vector<int> types;
+		if(!readTrajectoryHeader(in, types))
+			return INVALID_DATA;
+		if(step < 0)
+			return INDEX_RANGE;
+		// skip whole batches until the one containing the step
+		int first = 0;
+		while(in.peek() != EOF) {
+			int steps = readTrajectoryInt(in);
+			int objects = readTrajectoryInt(in);
+			if(!in.good() || steps <= 0 || objects < 0)
+				return INVALID_DATA;
+			if(step >= first + steps) {
+				in.seekg(steps * sizeof(double), std::ios_base::cur);
+				for(size_t f = 0; f < types.size(); f++) {
+					unsigned long long length = 0, compressedLength = 0;
+					in.read(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+					in.read(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+					in.seekg(compressedLength, std::ios_base::cur);
+				}
+				first += steps;
+				continue;
+			}
+			const int index = step - first;
+			std::vector<double> times(steps);
+			in.read(reinterpret_cast<char*>(times.data()), steps * sizeof(double));
+			if(population.getSize() != objects)
+				population.resize(objects);
+			std::vector<unsigned char> compressed;
+			std::vector<unsigned char> data;
+			for(size_t f = 0; f < types.size(); f++) {
+				unsigned long long length = 0, compressedLength = 0;
+				in.read(reinterpret_cast<char*>(&length), sizeof(unsigned long long));
+				in.read(reinterpret_cast<char*>(&compressedLength), sizeof(unsigned long long));
+				const size_t bytes = trajectoryElementSize(types[f]) * objects;
+				if(!in.good() || length != bytes * steps)
+					return INVALID_DATA;
+				compressed.resize(compressedLength > 0 ? compressedLength : 1);
+				data.resize(length > 0 ? length : 1);
+				in.read(reinterpret_cast<char*>(compressed.data()), compressedLength);
+				mz_ulong uncompressedSize = (mz_ulong)length;
+				if(!in.good() || uncompress(data.data(), &uncompressedSize, compressed.data(), (mz_ulong)compressedLength) != Z_OK || uncompressedSize != length)
+					return INVALID_DATA;
+				if(bytes > 0) {
+					memcpy(trajectoryField(population, types[f], DEVICE_HOST, true), data.data() + bytes * index, bytes);
+					population.update(types[f], DEVICE_HOST);
+				}
+			}
+			if(julian_day)
+				*julian_day = times[index];
+			return SUCCESS;
+		}
+		return INDEX_RANGE;
+	}
+}
@@ -0,0 +1,83 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_TRAJECTORY_H
+#define OPI_TRAJECTORY_H
+#include "opi_common.h"
+#include "opi_datatypes.h"
+#include "opi_error.h"
+#include "opi_pimpl_helper.h"
+#ifdef __cplusplus
+namespace OPI
+{
+	class Host;
+	class Population;
+
+	class TrajectoryRecorderImpl;
+	//! \brief Records the time history of a Population into a compressed ephemeris file
+	/** record() copies the selected fields into a ring buffer of batch_steps states on the
+	 * device holding their latest data, so no transfer to the host is needed. When the buffer
+	 * is full, the batch is copied to the host with one transfer per field. A background thread
+	 * then compresses and writes it while recording continues. The file stores batches of
+	 * steps, each holding the Julian dates of its steps and one compressed chunk per field.
+	 * readStep() loads single steps. A recorder must only be used from one thread at a time.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class TrajectoryRecorder
+	{
+		public:
+			OPI_API_EXPORT TrajectoryRecorder(Host& host);
+			//! Closes the file if it is still open
+			OPI_API_EXPORT ~TrajectoryRecorder();
+
+			//! Creates the file and selects the recorded fields
+			/**
+			 * @param filename The name of the file to write.
+			 * @param fields A combination of FieldMask values; the byte array, partials and names cannot be recorded.
+			 * @param batch_steps The number of steps buffered before they are written.
+			 * @return INVALID_ARGUMENT if no fields or unsupported fields are selected or the recorder
+			 * is already open, DIRECTORY_NOT_FOUND if the file cannot be created, SUCCESS otherwise.
+			 */
+			OPI_API_EXPORT ErrorCode open(const char* filename, int fields = FIELD_POSITION | FIELD_VELOCITY | FIELD_EPOCH, int batch_steps = 16);
+			//! Records the current state of population as a step at julian_day
+			/** All steps must have the same number of objects. The population may be modified
+			 * as soon as this function returns.
+			 */
+			OPI_API_EXPORT ErrorCode record(const Population& population, double julian_day);
+			//! Writes all buffered steps to the file without closing it
+			OPI_API_EXPORT ErrorCode flush();
+			//! Writes all buffered steps and closes the file
+			/** Returns UNKNOWN_ERROR if writing any of the batches failed. */
+			OPI_API_EXPORT ErrorCode close();
+			//! Returns the number of steps recorded since open()
+			OPI_API_EXPORT int getRecordedSteps() const;
+
+			//! Returns the number of steps stored in a trajectory file, or -1 if it cannot be read
+			OPI_API_EXPORT static int getStepCount(const char* filename);
+			//! Loads a step of a trajectory file into population
+			/** The population is resized to the number of recorded objects and the recorded
+			 * fields are replaced. If julian_day is given, it receives the date of the step.
+			 * @return INDEX_RANGE if the file holds fewer steps, INVALID_DATA if it is damaged.
+			 */
+			OPI_API_EXPORT static ErrorCode readStep(const char* filename, int step, Population& population, double* julian_day = 0);
+
+		private:
+			Pimpl<TrajectoryRecorderImpl> impl;
+	};
+}
+#endif
+
+#endif
@@ -1,104 +1,367 @@
-#include <iostream>
-#include <iomanip>
-#include <stdint.h>
-#include <time.h>
-#include <sys/timeb.h>
-#include <cstdlib>
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
 #include "OPI/opi_cpp.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmark suite for the OPI host library and its plugins.
+// Every case is run for a number of warmup iterations and then timed repeatedly with a
+// monotonic clock; setup work needed before each sample is not part of the measurement.
 
-// needs -lrt (real-time lib)
-// 1970-01-01 epoch UTC time, 1 mcs resolution (divide by 1M to get time_t)
-uint64_t getTime()
+struct Options
 {
-		timespec ts;
-		clock_gettime(CLOCK_REALTIME, &ts);
-		return (uint64_t)ts.tv_sec * 1000000LL + (uint64_t)ts.tv_nsec / 1000LL;
+	Options(): pluginDir(""), propagator(""), query("UniformGrid"), warmup(2), repetitions(10),
+		cubeSize(10.0f), dt(60.0), format("json"), output(""), tempFile("opi_benchmark.tmp")
+	{
+		sizes.push_back(1000);
+		sizes.push_back(10000);
+		sizes.push_back(100000);
+		sizes.push_back(1000000);
+	}
+
+	std::string pluginDir;
+	std::string propagator;
+	std::string query;
+	std::vector<int> sizes;
+	int warmup;
+	int repetitions;
+	float cubeSize;
+	double dt;
+	std::string format;
+	std::string output;
+	std::string tempFile;
+};
+
+struct Result
+{
+	std::string name;
+	int size;
+	// duration of each repetition in milliseconds
+	std::vector<double> samples;
+};
+
+static void printUsage()
+{
+	std::cout << "Usage: benchmark [options]" << std::endl
+			  << "  --plugins <dir>        load plugins from this directory" << std::endl
+			  << "  --propagator <name>    propagator to benchmark (propagation is skipped without)" << std::endl
+			  << "  --query <name>         distance query to benchmark (default: UniformGrid)" << std::endl
+			  << "  --sizes <n,n,...>      population sizes (default: 1000,10000,100000,1000000)" << std::endl
+			  << "  --warmup <n>           untimed runs before each case (default: 2)" << std::endl
+			  << "  --repetitions <n>      timed runs of each case (default: 10)" << std::endl
+			  << "  --cube <km>            cube size of the pair query (default: 10)" << std::endl
+			  << "  --dt <s>               propagation step (default: 60)" << std::endl
+			  << "  --format <json|csv>    output format (default: json)" << std::endl
+			  << "  --output <file>        write the results to a file instead of stdout" << std::endl
+			  << "  --temp <file>          scratch file for the I/O cases (default: opi_benchmark.tmp)" << std::endl;
 }
-int main(int argc, char* argv[])
+
+static bool parseOptions(int argc, char* argv[], Options& options)
+{
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--help" || arg == "-h") return false;
+		if(i + 1 >= argc) {
+			std::cout << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		std::string value = argv[++i];
+		if(arg == "--plugins") options.pluginDir = value;
+		else if(arg == "--propagator") options.propagator = value;
+		else if(arg == "--query") options.query = value;
+		else if(arg == "--warmup") options.warmup = std::max(0, atoi(value.c_str()));
+		else if(arg == "--repetitions") options.repetitions = std::max(1, atoi(value.c_str()));
+		else if(arg == "--cube") options.cubeSize = (float)atof(value.c_str());
+		else if(arg == "--dt") options.dt = atof(value.c_str());
+		else if(arg == "--format") options.format = value;
+		else if(arg == "--output") options.output = value;
+		else if(arg == "--temp") options.tempFile = value;
+		else if(arg == "--sizes") {
+			options.sizes.clear();
+			std::stringstream list(value);
+			std::string item;
+			while(std::getline(list, item, ','))
+				if(atoi(item.c_str()) > 0) options.sizes.push_back(atoi(item.c_str()));
+		}
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+	return options.format == "json" || options.format == "csv";
+}
+
+// fills the population with random objects in low earth orbit, including state vectors
+static void generatePopulation(OPI::Population& population, int size, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<double> altitude(6778.0, 8378.0);
+	std::uniform_real_distribution<double> eccentricity(0.0, 0.02);
+	std::uniform_real_distribution<double> inclination(0.0, M_PI);
+	std::uniform_real_distribution<double> angle(0.0, 2.0 * M_PI);
+	std::uniform_real_distribution<double> diameter(0.01, 2.0);
+
+	population.resize(size);
+	OPI::Orbit* orbit = population.getOrbit(OPI::DEVICE_HOST, true);
+	OPI::ObjectProperties* props = population.getObjectProperties(OPI::DEVICE_HOST, true);
+	OPI::Epoch* epoch = population.getEpoch(OPI::DEVICE_HOST, true);
+	for(int i = 0; i < size; i++) {
+		orbit[i].semi_major_axis = altitude(random);
+		orbit[i].eccentricity = eccentricity(random);
+		orbit[i].inclination = inclination(random);
+		orbit[i].raan = angle(random);
+		orbit[i].arg_of_perigee = angle(random);
+		orbit[i].mean_anomaly = angle(random);
+		props[i].mass = 1.0;
+		props[i].diameter = diameter(random);
+		props[i].area_to_mass = 0.01;
+		props[i].drag_coefficient = 2.2;
+		props[i].reflectivity = 1.3;
+		props[i].id = i;
+		epoch[i].beginning_of_life = 0.0;
+		epoch[i].end_of_life = 0.0;
+		epoch[i].current_epoch = 2451545.0;
+	}
+	population.update(OPI::DATA_ORBIT, OPI::DEVICE_HOST);
+	population.update(OPI::DATA_PROPERTIES, OPI::DEVICE_HOST);
+	population.update(OPI::DATA_EPOCH, OPI::DEVICE_HOST);
+	population.convertOrbitsToStateVectors();
+}
+
+// runs setup before every sample and times body only
+static Result measure(const Options& options, const std::string& name, int size,
+					  const std::function<void()>& setup, const std::function<void()>& body)
+{
+	Result result;
+	result.name = name;
+	result.size = size;
+	for(int i = 0; i < options.warmup + options.repetitions; i++) {
+		setup();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		body();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		if(i >= options.warmup)
+			result.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::cerr << "  " << std::setw(22) << std::left << name << " n=" << size << std::endl;
+	return result;
+}
+
+static void noSetup() {}
+
+// nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+	return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static void runCases(OPI::Host& host, const Options& options, int size, std::vector<Result>& results)
 {
-	if(argc != 9) {
-		std::cout << "Usage:" << std::endl;
-		std::cout << "  benchmark <plugin_dir> <data_file> <propagator> <query_plugin> <iterations> <start_time> <dt> <result>" << std::endl;
+	OPI::Population population(host);
+	const bool cuda = host.hasCUDASupport();
+
+	results.push_back(measure(options, "generate", size, noSetup, [&]() {
+		generatePopulation(population, size, 1);
+	}));
+
+	if(cuda) {
+		results.push_back(measure(options, "sync_host_to_device", size,
+			[&]() { population.getOrbit(OPI::DEVICE_HOST); population.update(OPI::DATA_ORBIT, OPI::DEVICE_HOST); },
+			[&]() { population.getOrbit(OPI::DEVICE_CUDA); }));
+		results.push_back(measure(options, "sync_device_to_host", size,
+			[&]() { population.getOrbit(OPI::DEVICE_CUDA); population.update(OPI::DATA_ORBIT, OPI::DEVICE_CUDA); },
+			[&]() { population.getOrbit(OPI::DEVICE_HOST); }));
+	}
+
+	results.push_back(measure(options, "convert_orbits", size, noSetup, [&]() {
+		population.convertOrbitsToStateVectors();
+	}));
+
+	OPI::Propagator* propagator = options.propagator.empty() ? 0 : host.getPropagator(options.propagator.c_str());
+	if(propagator) {
+		double julian_day = 2451545.0;
+		results.push_back(measure(options, "propagate", size, noSetup, [&]() {
+			julian_day += options.dt / 86400.0;
+			propagator->propagate(population, julian_day, options.dt);
+		}));
+		population.convertOrbitsToStateVectors();
+	}
+
+	results.push_back(measure(options, "write", size, noSetup, [&]() {
+		population.write(options.tempFile.c_str());
+	}));
+	{
+		OPI::Population loaded(host);
+		results.push_back(measure(options, "read", size, noSetup, [&]() {
+			loaded.read(options.tempFile.c_str());
+		}));
 	}
-	else {
-		OPI::Host host;
-		host.loadPlugins(argv[1]);
-
-		OPI::Population data(host);
-
-		data.read(argv[2]);
-
-		OPI::Propagator* prop = host.getPropagator(argv[3]);
-		OPI::DistanceQuery* query = host.getDistanceQuery(argv[4]);
-		int iterations = atoi(argv[5]);
-		int start_time = atoi(argv[6]);
-		int dt = atoi(argv[7]);
-		uint64_t start;
-		uint64_t end;
-
-		std::ofstream file(argv[8]);
-
-		uint64_t average_propagation = 0;
-		uint64_t average_rebuild = 0;
-		uint64_t average_query = 0;
-
-		if(prop && query)
-		{
-			file << "# OPI Benchmark results " << std::endl;
-			file << "# Plugin dir: " << argv[1] << std::endl;
-			file << "# Input data: " << argv[2] << std::endl;
-			file << "# Propagator: " << argv[3] << std::endl;
-			file << "# Query: " << argv[4] << std::endl;
-			file << "# Iterations: " << iterations << std::endl;
-			file << "# Starting time: " << start_time << std::endl;
-			file << "# dt: " << dt << std::endl;
-			file << "# Population size: " << data.getSize() << std::endl;
-
-			start = getTime();
-			OPI::Orbit* orbit = data.getOrbit(OPI::DEVICE_CUDA);
-			OPI::ObjectProperties* props = data.getObjectProperties(OPI::DEVICE_CUDA);
-			end = getTime();
-			file << "# Initial cuda synchronisation time: " << (end - start) << std::endl;
-			file << "# time_propagation time_rebuild time_query collision_count" << std::endl;
-			for(int i = 0; i < iterations; ++i)
-			{
-				std::cout << "Running iteration " << i << " of " << iterations <<
-										 " using " << argv[3] << " and " << argv[4] << " on " << argv[2] << std::endl;
-				start = getTime();
-				prop->propagate(data, 0., start_time + i * dt, dt);
-				end = getTime();
-				average_propagation += end - start;
-				file << std::setw(8) << (end - start) << " ";
-
-				start = getTime();
-				query->rebuild(data);
-				end = getTime();
-				average_rebuild += end - start;
-				file << std::setw(8) << (end - start) << " ";
-
-				OPI::IndexPairList pairs(host);
-
-				pairs.reserve(4000000);
-
-				start = getTime();
-				query->queryCubicPairs(data, pairs, 10);
-				end = getTime();
-				average_query += end - start;
-				file << std::setw(8) << (end - start) << " ";
-
-				file << pairs.getPairsUsed() << std::endl;
+	std::remove(options.tempFile.c_str());
+
+	// every tenth object is removed or replaced
+	OPI::IndexList every10th(host);
+	for(int i = 0; i < size; i += 10)
+		every10th.add(i);
+	std::unique_ptr<OPI::Population> target;
+	OPI::Population subset(population, every10th);
+	results.push_back(measure(options, "remove", size,
+		[&]() { target.reset(new OPI::Population(population)); },
+		[&]() { target->remove(every10th); }));
+	results.push_back(measure(options, "insert", size,
+		[&]() { target.reset(new OPI::Population(population)); },
+		[&]() { target->insert(subset, every10th); }));
+	results.push_back(measure(options, "append", size,
+		[&]() { target.reset(new OPI::Population(population)); },
+		[&]() { target->append(subset); }));
+	target.reset();
+
+	OPI::DistanceQuery* query = options.query.empty() ? 0 : host.getDistanceQuery(options.query.c_str());
+	if(query) {
+		OPI::IndexPairList pairs(host);
+		// queries without a configured cell size use the cube size of the previous query
+		query->queryCubicPairs(population, pairs, options.cubeSize);
+		results.push_back(measure(options, "query_rebuild", size, noSetup, [&]() {
+			query->rebuild(population);
+		}));
+		// the positions are unchanged, so this measures checking all objects for motion
+		results.push_back(measure(options, "query_refit", size, noSetup, [&]() {
+			query->refit(population);
+		}));
+		results.push_back(measure(options, "query_pairs", size, noSetup, [&]() {
+			query->queryCubicPairs(population, pairs, options.cubeSize);
+		}));
+		results.push_back(measure(options, "pair_dedup", size,
+			[&]() { query->queryCubicPairs(population, pairs, options.cubeSize); },
+			[&]() { pairs.removeDuplicates(); }));
+	}
+
+	if(propagator && query) {
+		// four screening steps, once sequentially and once with propagation overlapping the queries
+		const int steps = 4;
+		double julian_day = 2451545.0;
+		OPI::IndexPairList pairs(host);
+		results.push_back(measure(options, "screening_sequential", size, noSetup, [&]() {
+			for(int step = 0; step < steps; step++) {
+				propagator->propagate(population, julian_day, options.dt);
+				julian_day += options.dt / 86400.0;
+				query->rebuild(population);
+				query->queryCubicPairs(population, pairs, options.cubeSize);
+				pairs.removeDuplicates();
 			}
+		}));
+		OPI::ScreeningPipeline pipeline(*propagator, *query);
+		results.push_back(measure(options, "screening_pipelined", size, noSetup, [&]() {
+			pipeline.run(population, julian_day, options.dt, steps, options.cubeSize,
+				[](int, double, OPI::Population&, OPI::IndexPairList& found) { found.removeDuplicates(); });
+			julian_day += steps * options.dt / 86400.0;
+		}));
+	}
+}
 
-			file << "# avg_prop/avg_rebuild/avg_query [ms]" << std::endl;
-			file << "# " << (average_propagation / (float)(iterations * 1000))
-					 << "/" << (average_rebuild / (float)(iterations * 1000))
-					 << "/" << (average_query / (float)(iterations * 1000)) << std::endl;
-		}
-		else
-		{
-			std::cout << "Propagator and/or Query Plugin not found!" << std::endl;
-		}
+static void writeJSON(std::ostream& out, const OPI::Host& host, const Options& options, const std::vector<Result>& results)
+{
+	out << "{" << std::endl;
+	out << "  \"opi_version\": \"" << OPI_API_VERSION_MAJOR << "." << OPI_API_VERSION_MINOR << "\"," << std::endl;
+	out << "  \"cuda\": " << (host.hasCUDASupport() ? "true" : "false") << "," << std::endl;
+	out << "  \"propagator\": \"" << options.propagator << "\"," << std::endl;
+	out << "  \"query\": \"" << options.query << "\"," << std::endl;
+	out << "  \"warmup\": " << options.warmup << "," << std::endl;
+	out << "  \"repetitions\": " << options.repetitions << "," << std::endl;
+	out << "  \"results\": [" << std::endl;
+	for(size_t r = 0; r < results.size(); r++) {
+		std::vector<double> sorted = results[r].samples;
+		std::sort(sorted.begin(), sorted.end());
+		double mean = 0.0;
+		for(size_t i = 0; i < sorted.size(); i++) mean += sorted[i];
+		mean /= sorted.size();
+		out << "    {\"case\": \"" << results[r].name << "\", \"size\": " << results[r].size
+			<< ", \"mean_ms\": " << mean << ", \"min_ms\": " << sorted.front()
+			<< ", \"p50_ms\": " << percentile(sorted, 50) << ", \"p90_ms\": " << percentile(sorted, 90)
+			<< ", \"p99_ms\": " << percentile(sorted, 99) << ", \"max_ms\": " << sorted.back()
+			<< ", \"samples_ms\": [";
+		for(size_t i = 0; i < results[r].samples.size(); i++)
+			out << (i > 0 ? ", " : "") << results[r].samples[i];
+		out << "]}" << (r + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl << "}" << std::endl;
+}
+
+static void writeCSV(std::ostream& out, const std::vector<Result>& results)
+{
+	out << "case,size,repetitions,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,max_ms" << std::endl;
+	for(size_t r = 0; r < results.size(); r++) {
+		std::vector<double> sorted = results[r].samples;
+		std::sort(sorted.begin(), sorted.end());
+		double mean = 0.0;
+		for(size_t i = 0; i < sorted.size(); i++) mean += sorted[i];
+		mean /= sorted.size();
+		out << results[r].name << "," << results[r].size << "," << sorted.size() << "," << mean << ","
+			<< sorted.front() << "," << percentile(sorted, 50) << "," << percentile(sorted, 90) << ","
+			<< percentile(sorted, 99) << "," << sorted.back() << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if(!parseOptions(argc, argv, options)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	OPI::Host host;
+	if(!options.pluginDir.empty())
+		host.loadPlugins(options.pluginDir.c_str());
+	if(!options.propagator.empty() && !host.getPropagator(options.propagator.c_str())) {
+		std::cout << "Propagator " << options.propagator << " not found!" << std::endl;
+		return EXIT_FAILURE;
 	}
+	if(!options.query.empty() && !host.getDistanceQuery(options.query.c_str())) {
+		std::cout << "Distance query " << options.query << " not found!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Result> results;
+	for(size_t s = 0; s < options.sizes.size(); s++) {
+		std::cerr << "Population size " << options.sizes[s] << std::endl;
+		runCases(host, options, options.sizes[s], results);
+	}
+
+	std::ofstream file;
+	if(!options.output.empty()) file.open(options.output.c_str());
+	std::ostream& out = options.output.empty() ? std::cout : file;
+	out << std::setprecision(6);
+	if(options.format == "csv")
+		writeCSV(out, results);
+	else
+		writeJSON(out, host, options, results);
 	return EXIT_SUCCESS;
 }
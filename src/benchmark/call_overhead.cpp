@@ -0,0 +1,153 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "OPI/opi_cpp.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Call overhead of the propagator interfaces.
+// Every propagator is called many times with a Population of a single object, which is how
+// refinement and alignment loops use it, once through propagate() and once through
+// propagateFast(). The null propagators built with this program do no work, so the times are
+// the cost of the interface alone: a propagator defined in this file, and plugins using the
+// C++, the C and the Fortran interface.
+
+#ifndef OPI_BENCHMARK_PLUGIN_DIR
+#define OPI_BENCHMARK_PLUGIN_DIR "plugins"
+#endif
+
+struct Options
+{
+	Options(): pluginDir(OPI_BENCHMARK_PLUGIN_DIR), calls(1000000), warmup(1), repetitions(5)
+	{
+		propagators.push_back("BenchmarkNullCPP");
+		propagators.push_back("BenchmarkNullC");
+		propagators.push_back("BenchmarkNullFortran");
+	}
+
+	std::string pluginDir;
+	std::vector<std::string> propagators;
+	int calls;
+	int warmup;
+	int repetitions;
+};
+
+// propagator without any work that is not loaded from a plugin
+class NullPropagator: public OPI::Propagator
+{
+	public:
+		NullPropagator()
+		{
+			setName("BenchmarkNullHost");
+		}
+
+		virtual OPI::ErrorCode runPropagation(OPI::Population& population, double julian_day, double dt, OPI::PropagationMode mode, OPI::IndexList* indices)
+		{
+			return OPI::SUCCESS;
+		}
+};
+
+static void printUsage()
+{
+	std::cout << "Usage: call_overhead [options]" << std::endl
+			  << "  --plugins <dir>        load plugins from this directory (default: " << OPI_BENCHMARK_PLUGIN_DIR << ")" << std::endl
+			  << "  --propagator <name>    also measure this propagator, can be repeated" << std::endl
+			  << "  --calls <n>            calls per timed run (default: 1000000)" << std::endl
+			  << "  --warmup <n>           untimed runs before each case (default: 1)" << std::endl
+			  << "  --repetitions <n>      timed runs of each case (default: 5)" << std::endl;
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options)
+{
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(arg == "--help" || arg == "-h") return false;
+		if(i + 1 >= argc) {
+			std::cout << "Missing value for " << arg << std::endl;
+			return false;
+		}
+		std::string value = argv[++i];
+		if(arg == "--plugins") options.pluginDir = value;
+		else if(arg == "--propagator") options.propagators.push_back(value);
+		else if(arg == "--calls") options.calls = std::max(1, atoi(value.c_str()));
+		else if(arg == "--warmup") options.warmup = std::max(0, atoi(value.c_str()));
+		else if(arg == "--repetitions") options.repetitions = std::max(1, atoi(value.c_str()));
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// returns the median time per call in nanoseconds, or a negative value if a call failed
+static double measure(const Options& options, OPI::Propagator& propagator, OPI::Population& population, bool fast)
+{
+	std::vector<double> samples;
+	double julian_day = 2451545.0;
+	for(int r = 0; r < options.warmup + options.repetitions; r++) {
+		OPI::ErrorCode status = OPI::SUCCESS;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(int i = 0; i < options.calls && status == OPI::SUCCESS; i++) {
+			status = fast ? propagator.propagateFast(population, julian_day, 1.0)
+						  : propagator.propagate(population, julian_day, 1.0);
+			julian_day += 1.0 / 86400.0;
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		if(status != OPI::SUCCESS)
+			return -1.0;
+		if(r >= options.warmup)
+			samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / options.calls);
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if(!parseOptions(argc, argv, options)) {
+		printUsage();
+		return EXIT_FAILURE;
+	}
+
+	OPI::Host host;
+	host.loadPlugins(options.pluginDir.c_str());
+	host.addPropagator(new NullPropagator());
+	options.propagators.insert(options.propagators.begin(), "BenchmarkNullHost");
+
+	OPI::Population population(host, 1);
+	population.getOrbit(OPI::DEVICE_HOST)[0].semi_major_axis = 7000.0;
+	population.update(OPI::DATA_ORBIT, OPI::DEVICE_HOST);
+
+	std::cout << "propagator,propagate_ns,propagate_fast_ns" << std::endl << std::setprecision(4);
+	for(size_t p = 0; p < options.propagators.size(); p++) {
+		OPI::Propagator* propagator = host.getPropagator(options.propagators[p].c_str());
+		if(!propagator) {
+			std::cerr << "Propagator " << options.propagators[p] << " not found, skipped" << std::endl;
+			continue;
+		}
+		const double regular = measure(options, *propagator, population, false);
+		const double fast = measure(options, *propagator, population, true);
+		std::cout << options.propagators[p] << "," << regular << "," << fast << std::endl;
+	}
+	return EXIT_SUCCESS;
+}
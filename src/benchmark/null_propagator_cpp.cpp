@@ -0,0 +1,44 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "OPI/opi_cpp.h"
+
+// Propagator plugin using the C++ interface that does no work, see call_overhead.cpp
+
+#define OPI_PLUGIN_NAME "BenchmarkNullCPP"
+#define OPI_PLUGIN_AUTHOR "ILR TU BS"
+#define OPI_PLUGIN_DESC "Null propagator for measuring the C++ plugin interface"
+
+#define OPI_PLUGIN_VERSION_MAJOR 0
+#define OPI_PLUGIN_VERSION_MINOR 1
+#define OPI_PLUGIN_VERSION_PATCH 0
+
+class NullCPP: public OPI::Propagator
+{
+	public:
+		NullCPP(OPI::Host& host)
+		{
+		}
+
+		virtual OPI::ErrorCode runPropagation(OPI::Population& population, double julian_day, double dt, OPI::PropagationMode mode, OPI::IndexList* indices)
+		{
+			return OPI::SUCCESS;
+		}
+};
+
+#define OPI_IMPLEMENT_CPP_PROPAGATOR NullCPP
+
+#include "OPI/opi_implement_plugin.h"
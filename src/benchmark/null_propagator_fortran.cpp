@@ -0,0 +1,32 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "OPI/opi_cpp.h"
+
+// Plugin information of the Fortran null propagator, the propagation function is
+// implemented in null_propagator_fortran.f90
+
+#define OPI_PLUGIN_NAME "BenchmarkNullFortran"
+#define OPI_PLUGIN_AUTHOR "ILR TU BS"
+#define OPI_PLUGIN_DESC "Null propagator for measuring the Fortran plugin interface"
+
+#define OPI_PLUGIN_VERSION_MAJOR 0
+#define OPI_PLUGIN_VERSION_MINOR 1
+#define OPI_PLUGIN_VERSION_PATCH 0
+
+#define OPI_DECLARE_PROPAGATOR_PLUGIN
+
+#include "OPI/opi_implement_plugin.h"
@@ -0,0 +1,15 @@
+! Propagator plugin implemented in Fortran that does no work, see call_overhead.cpp
+! The plugin information is declared in null_propagator_fortran.cpp
+function OPI_Plugin_propagate(propagator, population, julian_day, dt, mode, indices) result(error_code) &
+  bind(c, name="OPI_Plugin_propagate")
+  use ISO_C_BINDING
+  type(c_ptr), value :: propagator
+  type(c_ptr), value :: population
+  real(c_double), value :: julian_day
+  real(c_double), value :: dt
+  integer(c_int), value :: mode
+  type(c_ptr), value :: indices
+  integer(c_int) :: error_code
+
+  error_code = 0
+end function
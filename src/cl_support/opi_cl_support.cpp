@@ -15,8 +15,143 @@
  * License along with this library.
  */
 #include "opi_cl_support.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// device selected by each thread, by instance, so several Hosts can select different devices
+static thread_local std::map<unsigned long long, int> threadDevices;
+static std::atomic<unsigned long long> nextInstanceId(0);
 
-ClSupportImpl::ClSupportImpl()
+// OpenCL C versions of orbitToStateVector() and stateVectorToOrbit() from opi_datatypes.h,
+// and a transposition kernel for the structure-of-arrays layout
+static const char* supportKernelSource =
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+"typedef struct { double semi_major_axis, eccentricity, inclination, raan, arg_of_perigee, mean_anomaly; } Orbit;\n"
+"typedef struct { double x, y, z; } Vector3;\n"
+"#define MU 398600.4418\n"
+"#define SMALL 1e-15\n"
+"double dot3(Vector3 a, Vector3 b) { return a.x*b.x + a.y*b.y + a.z*b.z; }\n"
+"double length3(Vector3 a) { return sqrt(dot3(a, a)); }\n"
+"double angle3(Vector3 a, Vector3 b) {\n"
+"  double m = length3(a) * length3(b);\n"
+"  if (m > SMALL*SMALL) return acos(clamp(dot3(a, b) / m, -1.0, 1.0));\n"
+"  return NAN;\n"
+"}\n"
+"Vector3 rotX(Vector3 v, double a) { Vector3 r; r.x = v.x; r.y = cos(a)*v.y + sin(a)*v.z; r.z = cos(a)*v.z - sin(a)*v.y; return r; }\n"
+"Vector3 rotZ(Vector3 v, double a) { Vector3 r; r.x = cos(a)*v.x + sin(a)*v.y; r.y = cos(a)*v.y - sin(a)*v.x; r.z = v.z; return r; }\n"
+"__kernel void orbitsToStateVectors(__global const Orbit* orbit, __global Vector3* position, __global Vector3* velocity, int size) {\n"
+"  int i = get_global_id(0);\n"
+"  if (i >= size) return;\n"
+"  Orbit o = orbit[i];\n"
+"  double ea = o.mean_anomaly;\n"
+"  for (int k = 0; k < 5; k++) ea -= (ea - o.eccentricity*sin(ea) - o.mean_anomaly) / (1.0 - o.eccentricity*cos(ea));\n"
+"  double ch = cos(ea/2.0);\n"
+"  if (fabs(ch) < SMALL) ch = (ch < 0.0) ? -SMALL : SMALL;\n"
+"  double ta = 2.0 * atan(sqrt((1.0 + o.eccentricity)/(1.0 - o.eccentricity)) * sin(ea/2.0)/ch);\n"
+"  double argp = o.arg_of_perigee, raan = o.raan;\n"
+"  const double arglat = argp + ta;\n"
+"  const bool equatorial = (o.inclination < SMALL) || (fabs(o.inclination - M_PI) < SMALL);\n"
+"  if (o.eccentricity < SMALL) {\n"
+"    argp = 0.0;\n"
+"    if (equatorial) { raan = 0.0; ta = o.raan + arglat; } else ta = arglat;\n"
+"  }\n"
+"  else if (equatorial) { argp = o.raan + o.arg_of_perigee; raan = 0.0; }\n"
+"  double p = o.semi_major_axis * (1.0 - o.eccentricity*o.eccentricity);\n"
+"  const double temp = p / (1.0 + o.eccentricity*cos(ta));\n"
+"  Vector3 r; r.x = temp*cos(ta); r.y = temp*sin(ta); r.z = 0.0;\n"
+"  if (fabs(p) < 1e-8) p = 1e-8;\n"
+"  Vector3 v; v.x = -sin(ta)*sqrt(MU/p); v.y = (o.eccentricity + cos(ta))*sqrt(MU/p); v.z = 0.0;\n"
+"  position[i] = rotZ(rotX(rotZ(r, -argp), -o.inclination), -raan);\n"
+"  velocity[i] = rotZ(rotX(rotZ(v, -argp), -o.inclination), -raan);\n"
+"}\n"
+"__kernel void stateVectorsToOrbits(__global const Vector3* position, __global const Vector3* velocity, __global Orbit* orbit, int size, volatile __global int* invalidObjects) {\n"
+"  int i = get_global_id(0);\n"
+"  if (i >= size) return;\n"
+"  Vector3 r = position[i], v = velocity[i];\n"
+"  Orbit o; o.semi_major_axis = NAN; o.eccentricity = NAN; o.inclination = NAN; o.raan = NAN; o.arg_of_perigee = NAN; o.mean_anomaly = NAN;\n"
+"  bool valid = true;\n"
+"  const double twopi = 2.0*M_PI;\n"
+"  const double magr = length3(r), magv = length3(v);\n"
+"  Vector3 h; h.x = r.y*v.z - r.z*v.y; h.y = r.z*v.x - r.x*v.z; h.z = r.x*v.y - r.y*v.x;\n"
+"  const double magh = length3(h);\n"
+"  if (magh > SMALL) {\n"
+"    Vector3 n; n.x = -h.y; n.y = h.x; n.z = 0.0;\n"
+"    const double magn = length3(n);\n"
+"    const double c1 = magv*magv - MU/magr;\n"
+"    const double rdotv = dot3(r, v);\n"
+"    Vector3 e; e.x = (r.x*c1 - v.x*rdotv)/MU; e.y = (r.y*c1 - v.y*rdotv)/MU; e.z = (r.z*c1 - v.z*rdotv)/MU;\n"
+"    o.eccentricity = length3(e);\n"
+"    const double sme = magv*magv*0.5 - MU/magr;\n"
+"    if (fabs(sme) > SMALL) o.semi_major_axis = -MU/(2.0*sme);\n"
+"    else { o.semi_major_axis = INFINITY; valid = false; }\n"
+"    o.inclination = acos(h.z/magh);\n"
+"    const bool equatorial = (o.inclination < SMALL) || (fabs(o.inclination - M_PI) < SMALL);\n"
+"    const bool circular = (o.eccentricity < SMALL);\n"
+"    if (magn > SMALL) { o.raan = acos(clamp(n.x/magn, -1.0, 1.0)); if (n.y < 0.0) o.raan = twopi - o.raan; }\n"
+"    else valid = false;\n"
+"    if (!circular && !equatorial) { o.arg_of_perigee = angle3(n, e); if (e.z < 0.0) o.arg_of_perigee = twopi - o.arg_of_perigee; }\n"
+"    else valid = false;\n"
+"    if (circular && !equatorial) {\n"
+"      double arglat = angle3(n, r); if (r.z < 0.0) arglat = twopi - arglat;\n"
+"      o.mean_anomaly = arglat;\n"
+"    }\n"
+"    else if (circular && magr > SMALL) {\n"
+"      double truelon = acos(clamp(r.x/magr, -1.0, 1.0));\n"
+"      if (r.y < 0.0) truelon = twopi - truelon;\n"
+"      if (o.inclination > 0.5*M_PI) truelon = twopi - truelon;\n"
+"      o.mean_anomaly = truelon;\n"
+"    }\n"
+"    else if (!circular) {\n"
+"      double nu = angle3(e, r); if (rdotv < 0.0) nu = twopi - nu;\n"
+"      const double ecc = o.eccentricity;\n"
+"      double ea = INFINITY, ma = INFINITY;\n"
+"      if (ecc < 1.0 - SMALL) {\n"
+"        ea = atan2((sqrt(1.0 - ecc*ecc)*sin(nu))/(1.0 + ecc*cos(nu)), (ecc + cos(nu))/(1.0 + ecc*cos(nu)));\n"
+"        ma = ea - ecc*sin(ea);\n"
+"      }\n"
+"      else if (ecc > 1.0 + SMALL) {\n"
+"        if (fabs(nu) + 0.00001 < M_PI - acos(1.0/ecc)) {\n"
+"          const double sine = (sqrt(ecc*ecc - 1.0)*sin(nu))/(1.0 + ecc*cos(nu));\n"
+"          ea = asinh(sine);\n"
+"          ma = ecc*sinh(ea) - ea;\n"
+"        }\n"
+"      }\n"
+"      else if (fabs(nu) < 168.0*M_PI/180.0) { ea = tan(nu*0.5); ma = ea + ea*ea*ea/3.0; }\n"
+"      if (ecc < 1.0) { ma = fmod(ma, twopi); if (ma < 0.0) ma += twopi; }\n"
+"      o.mean_anomaly = ma;\n"
+"    }\n"
+"  }\n"
+"  else valid = false;\n"
+"  orbit[i] = o;\n"
+"  if (!valid) atomic_inc(invalidObjects);\n"
+"}\n"
+"__kernel void transposeDoubles(__global double* destination, __global const double* source, int rows, int columns) {\n"
+"  size_t i = get_global_id(0);\n"
+"  if (i >= (size_t)rows*columns) return;\n"
+"  destination[i] = source[(i % rows)*columns + i / rows];\n"
+"}\n"
+"__kernel void addDoubles(__global double* destination, __global const double* source, ulong count) {\n"
+"  size_t i = get_global_id(0);\n"
+"  if (i < count) destination[i] += source[i];\n"
+"}\n";
+
+ClSupportImpl::ClSupportImpl():
+	devices(NULL),
+	nDevices(0),
+	currentDevice(0),
+	instanceId(nextInstanceId++),
+	supportProgram(NULL),
+	supportProgramFailed(false),
+	orbitsToStateVectorsKernel(NULL),
+	stateVectorsToOrbitsKernel(NULL),
+	transposeKernel(NULL),
+	addKernel(NULL)
 {
 	
 }
@@ -43,6 +178,7 @@ void ClSupportImpl::init(int platformNumber, int deviceNumber)
             std::cout << "Platform " << i << ": " << string(vendor) << " " << string(name) << std::endl;
 
             clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 0, NULL, &nDevices);
+            delete[] devices;
             devices = new cl_device_id[nDevices];
             clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, nDevices, devices, &nDevices);
             for (unsigned int j = 0; j < nDevices; j++) {
@@ -56,12 +192,35 @@ void ClSupportImpl::init(int platformNumber, int deviceNumber)
         int currentPlatform = platformNumber;
         currentDevice = deviceNumber;
 
+        clGetDeviceIDs(platforms[currentPlatform], CL_DEVICE_TYPE_ALL, 0, NULL, &nDevices);
+        delete[] devices;
+        devices = new cl_device_id[nDevices];
         clGetDeviceIDs(platforms[currentPlatform], CL_DEVICE_TYPE_ALL, nDevices, devices, &nDevices);
+        // a single context for all devices of the platform, so buffers can be shared between them
         cl_context_properties props[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)(platforms[currentPlatform]), 0 };
-        context = clCreateContext(props, 1, devices, NULL, NULL, &error);
+        context = clCreateContext(props, nDevices, devices, NULL, NULL, &error);
         if (error != CL_SUCCESS) std::cerr << "Error creating context: " << error << std::endl;
-        defaultQueue = clCreateCommandQueue(context, devices[currentDevice], 0, &error);
-        if (error != CL_SUCCESS) std::cerr << "Error creating queue: " << error << std::endl;
+        defaultQueues.resize(nDevices);
+        for (unsigned int j = 0; j < nDevices; j++) {
+            defaultQueues[j] = clCreateCommandQueue(context, devices[j], 0, &error);
+            if (error != CL_SUCCESS) std::cerr << "Error creating queue: " << error << std::endl;
+        }
+
+        // OPI_CL_CACHE_DIR selects the program cache, an empty value disables it
+        const char* cacheVariable = getenv("OPI_CL_CACHE_DIR");
+        if (cacheVariable) cacheDirectory = cacheVariable;
+        else {
+            const char* temp = getenv("TMPDIR");
+            if (!temp) temp = getenv("TEMP");
+            cacheDirectory = string(temp ? temp : "/tmp") + "/opi_cl_cache";
+        }
+        if (!cacheDirectory.empty()) {
+#ifdef _WIN32
+            _mkdir(cacheDirectory.c_str());
+#else
+            mkdir(cacheDirectory.c_str(), 0755);
+#endif
+        }
     }
     else {
         std::cerr << "Unable to get OpenCL platform IDs: " << error << std::endl;
@@ -83,44 +242,298 @@ void ClSupportImpl::free(void *mem)
     //else cout << "Freed memory object at " << static_cast<cl_mem>(mem) << endl;
 }
 
+void ClSupportImpl::allocatePinned(void** a, size_t size)
+{
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	cl_int error;
+	*a = 0;
+	cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, &error);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error allocating pinned OpenCL host memory: " << error << std::endl;
+		return;
+	}
+	void* mapped = clEnqueueMapBuffer(currentQueue(), buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, &error);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error mapping pinned OpenCL host memory: " << error << std::endl;
+		clReleaseMemObject(buffer);
+		return;
+	}
+	pinnedBuffers[mapped] = buffer;
+	*a = mapped;
+}
+
+void ClSupportImpl::freePinned(void *mem)
+{
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	std::map<void*, cl_mem>::iterator itr = pinnedBuffers.find(mem);
+	if (itr != pinnedBuffers.end()) {
+		clEnqueueUnmapMemObject(currentQueue(), itr->second, mem, 0, NULL, NULL);
+		clFinish(currentQueue());
+		clReleaseMemObject(itr->second);
+		pinnedBuffers.erase(itr);
+	}
+}
+
 void ClSupportImpl::copy(void *destination, void *source, size_t size, unsigned int num_objects, bool host_to_device)
+{
+	copyRange(destination, source, 0, size, num_objects, host_to_device);
+}
+
+// buffers are handles, ranges of them are addressed with the offset arguments of the copy commands
+void ClSupportImpl::copyRange(void *destination, void *source, size_t offset, size_t size, unsigned int num_objects, bool host_to_device)
 {
 	cl_int error = CL_SUCCESS;
 	if (host_to_device) {
 		cl_mem destinationBuffer = static_cast<cl_mem>(destination);
-        error = clEnqueueWriteBuffer(defaultQueue, destinationBuffer, CL_TRUE, 0, size*num_objects, source, 0, NULL, NULL);
+        error = clEnqueueWriteBuffer(currentQueue(), destinationBuffer, CL_TRUE, offset, size*num_objects, source, 0, NULL, NULL);
 		if (error != CL_SUCCESS) std::cout << "Error copying Population data to OpenCL device: " << error << std::endl;
         //else cout << "Copied " << size << " bytes to device at " << destinationBuffer << endl;
 	}
 	else {
 		cl_mem sourceBuffer = static_cast<cl_mem>(source);
-        error = clEnqueueReadBuffer(defaultQueue, sourceBuffer, CL_TRUE, 0, size*num_objects, destination, 0, NULL, NULL);
+        error = clEnqueueReadBuffer(currentQueue(), sourceBuffer, CL_TRUE, offset, size*num_objects, destination, 0, NULL, NULL);
 		if (error != CL_SUCCESS) std::cout << "Error downloading Population data from OpenCL device: " << error << std::endl;
         //else cout << "Downloaded " << size << " bytes from device (" << sourceBuffer << " to " << destination << ")" << endl;
     }
 }
 
+bool ClSupportImpl::copyPeer(void *destination, int destDevice, void *source, int sourceDevice, size_t size, unsigned int num_objects)
+{
+	return copyPeerRange(destination, 0, destDevice, source, 0, sourceDevice, size, num_objects);
+}
+
+bool ClSupportImpl::copyPeerRange(void *destination, size_t destOffset, int destDevice, void *source, size_t sourceOffset, int sourceDevice, size_t size, unsigned int num_objects)
+{
+	// All devices share the same context, so buffers can be copied directly on the queue.
+	if ((destDevice < 0) || (destDevice >= (int)nDevices) || (sourceDevice < 0) || (sourceDevice >= (int)nDevices))
+		return false;
+	cl_int error = clEnqueueCopyBuffer(currentQueue(), static_cast<cl_mem>(source), static_cast<cl_mem>(destination), sourceOffset, destOffset, size*num_objects, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error copying Population data between OpenCL devices: " << error << std::endl;
+		return false;
+	}
+	clFinish(currentQueue());
+	return true;
+}
+
+void* ClSupportImpl::createStream()
+{
+	cl_int error;
+	cl_command_queue queue = clCreateCommandQueue(context, devices[getCurrentDevice()], 0, &error);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error creating OpenCL command queue: " << error << std::endl;
+		return NULL;
+	}
+	return queue;
+}
+
+void ClSupportImpl::destroyStream(void* stream)
+{
+	if (stream) clReleaseCommandQueue(static_cast<cl_command_queue>(stream));
+}
+
+void ClSupportImpl::synchronizeStream(void* stream)
+{
+	clFinish(stream ? static_cast<cl_command_queue>(stream) : currentQueue());
+}
+
+void ClSupportImpl::copyAsync(void *destination, void *source, size_t size, unsigned int num_objects, bool host_to_device, void* stream)
+{
+	copyRangeAsync(destination, source, 0, size, num_objects, host_to_device, stream);
+}
+
+void ClSupportImpl::copyRangeAsync(void *destination, void *source, size_t offset, size_t size, unsigned int num_objects, bool host_to_device, void* stream)
+{
+	cl_command_queue queue = stream ? static_cast<cl_command_queue>(stream) : currentQueue();
+	cl_int error = CL_SUCCESS;
+	if (host_to_device) {
+		error = clEnqueueWriteBuffer(queue, static_cast<cl_mem>(destination), CL_FALSE, offset, size*num_objects, source, 0, NULL, NULL);
+		if (error != CL_SUCCESS) std::cout << "Error copying Population data to OpenCL device: " << error << std::endl;
+	}
+	else {
+		error = clEnqueueReadBuffer(queue, static_cast<cl_mem>(source), CL_FALSE, offset, size*num_objects, destination, 0, NULL, NULL);
+		if (error != CL_SUCCESS) std::cout << "Error downloading Population data from OpenCL device: " << error << std::endl;
+	}
+}
+
+void* ClSupportImpl::recordEvent(void* stream)
+{
+	cl_event event = NULL;
+	cl_int error = clEnqueueMarkerWithWaitList(stream ? static_cast<cl_command_queue>(stream) : currentQueue(), 0, NULL, &event);
+	if (error != CL_SUCCESS) std::cout << "Error recording OpenCL event: " << error << std::endl;
+	return event;
+}
+
+void ClSupportImpl::synchronizeEvent(void* event)
+{
+	if (event) {
+		cl_event e = static_cast<cl_event>(event);
+		clWaitForEvents(1, &e);
+	}
+}
+
+void ClSupportImpl::destroyEvent(void* event)
+{
+	if (event) clReleaseEvent(static_cast<cl_event>(event));
+}
+
+bool ClSupportImpl::buildKernels()
+{
+	if (supportProgram || supportProgramFailed) return (orbitsToStateVectorsKernel && stateVectorsToOrbitsKernel && transposeKernel && addKernel);
+	cl_int error;
+	// built for all devices, so the kernels can be enqueued on the queue of any of them
+	supportProgram = buildCachedProgram(supportKernelSource, NULL, nDevices, devices);
+	if (!supportProgram) {
+		supportProgramFailed = true;
+		// the device probably lacks double precision support
+		std::cout << "Error building OpenCL support program" << std::endl;
+		return false;
+	}
+	orbitsToStateVectorsKernel = clCreateKernel(supportProgram, "orbitsToStateVectors", &error);
+	if (error != CL_SUCCESS) orbitsToStateVectorsKernel = NULL;
+	stateVectorsToOrbitsKernel = clCreateKernel(supportProgram, "stateVectorsToOrbits", &error);
+	if (error != CL_SUCCESS) stateVectorsToOrbitsKernel = NULL;
+	transposeKernel = clCreateKernel(supportProgram, "transposeDoubles", &error);
+	if (error != CL_SUCCESS) transposeKernel = NULL;
+	addKernel = clCreateKernel(supportProgram, "addDoubles", &error);
+	if (error != CL_SUCCESS) addKernel = NULL;
+	return (orbitsToStateVectorsKernel && stateVectorsToOrbitsKernel && transposeKernel && addKernel);
+}
+
+bool ClSupportImpl::convertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size)
+{
+	if (size <= 0) return true;
+	// kernel arguments are shared state, so only one thread may launch at a time
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	if (!buildKernels()) return false;
+	cl_mem orbitBuffer = static_cast<cl_mem>((void*)orbit);
+	cl_mem positionBuffer = static_cast<cl_mem>((void*)position);
+	cl_mem velocityBuffer = static_cast<cl_mem>((void*)velocity);
+	clSetKernelArg(orbitsToStateVectorsKernel, 0, sizeof(cl_mem), &orbitBuffer);
+	clSetKernelArg(orbitsToStateVectorsKernel, 1, sizeof(cl_mem), &positionBuffer);
+	clSetKernelArg(orbitsToStateVectorsKernel, 2, sizeof(cl_mem), &velocityBuffer);
+	clSetKernelArg(orbitsToStateVectorsKernel, 3, sizeof(int), &size);
+	size_t globalSize = size;
+	cl_int error = clEnqueueNDRangeKernel(currentQueue(), orbitsToStateVectorsKernel, 1, NULL, &globalSize, NULL, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error running OpenCL conversion kernel: " << error << std::endl;
+		return false;
+	}
+	return (clFinish(currentQueue()) == CL_SUCCESS);
+}
+
+bool ClSupportImpl::convertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects)
+{
+	*invalidObjects = 0;
+	if (size <= 0) return true;
+	// kernel arguments are shared state, so only one thread may launch at a time
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	if (!buildKernels()) return false;
+	cl_int error;
+	cl_mem counter = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(int), invalidObjects, &error);
+	if (error != CL_SUCCESS) return false;
+	cl_mem positionBuffer = static_cast<cl_mem>((void*)position);
+	cl_mem velocityBuffer = static_cast<cl_mem>((void*)velocity);
+	cl_mem orbitBuffer = static_cast<cl_mem>((void*)orbit);
+	clSetKernelArg(stateVectorsToOrbitsKernel, 0, sizeof(cl_mem), &positionBuffer);
+	clSetKernelArg(stateVectorsToOrbitsKernel, 1, sizeof(cl_mem), &velocityBuffer);
+	clSetKernelArg(stateVectorsToOrbitsKernel, 2, sizeof(cl_mem), &orbitBuffer);
+	clSetKernelArg(stateVectorsToOrbitsKernel, 3, sizeof(int), &size);
+	clSetKernelArg(stateVectorsToOrbitsKernel, 4, sizeof(cl_mem), &counter);
+	size_t globalSize = size;
+	error = clEnqueueNDRangeKernel(currentQueue(), stateVectorsToOrbitsKernel, 1, NULL, &globalSize, NULL, 0, NULL, NULL);
+	if (error == CL_SUCCESS)
+		error = clEnqueueReadBuffer(currentQueue(), counter, CL_TRUE, 0, sizeof(int), invalidObjects, 0, NULL, NULL);
+	if (error != CL_SUCCESS) std::cout << "Error running OpenCL conversion kernel: " << error << std::endl;
+	clReleaseMemObject(counter);
+	return (error == CL_SUCCESS);
+}
+
+bool ClSupportImpl::transpose(double* destination, const double* source, int rows, int columns)
+{
+	if (rows <= 0 || columns <= 0) return true;
+	// kernel arguments are shared state, so only one thread may launch at a time
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	if (!buildKernels()) return false;
+	cl_mem destinationBuffer = static_cast<cl_mem>((void*)destination);
+	cl_mem sourceBuffer = static_cast<cl_mem>((void*)source);
+	clSetKernelArg(transposeKernel, 0, sizeof(cl_mem), &destinationBuffer);
+	clSetKernelArg(transposeKernel, 1, sizeof(cl_mem), &sourceBuffer);
+	clSetKernelArg(transposeKernel, 2, sizeof(int), &rows);
+	clSetKernelArg(transposeKernel, 3, sizeof(int), &columns);
+	size_t globalSize = (size_t)rows * columns;
+	cl_int error = clEnqueueNDRangeKernel(currentQueue(), transposeKernel, 1, NULL, &globalSize, NULL, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error running OpenCL transposition kernel: " << error << std::endl;
+		return false;
+	}
+	return (clFinish(currentQueue()) == CL_SUCCESS);
+}
+
+bool ClSupportImpl::addDoubles(double* destination, const double* source, size_t count)
+{
+	if (count == 0) return true;
+	// kernel arguments are shared state, so only one thread may launch at a time
+	std::lock_guard<std::mutex> lock(kernelMutex);
+	if (!buildKernels()) return false;
+	cl_mem destinationBuffer = static_cast<cl_mem>((void*)destination);
+	cl_mem sourceBuffer = static_cast<cl_mem>((void*)source);
+	cl_ulong elements = count;
+	clSetKernelArg(addKernel, 0, sizeof(cl_mem), &destinationBuffer);
+	clSetKernelArg(addKernel, 1, sizeof(cl_mem), &sourceBuffer);
+	clSetKernelArg(addKernel, 2, sizeof(cl_ulong), &elements);
+	size_t globalSize = count;
+	cl_int error = clEnqueueNDRangeKernel(currentQueue(), addKernel, 1, NULL, &globalSize, NULL, 0, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error running OpenCL summation kernel: " << error << std::endl;
+		return false;
+	}
+	return (clFinish(currentQueue()) == CL_SUCCESS);
+}
+
+bool ClSupportImpl::zeroMemory(void* mem, size_t size)
+{
+	return zeroMemoryRange(mem, 0, size);
+}
+
+bool ClSupportImpl::zeroMemoryRange(void* mem, size_t offset, size_t size)
+{
+	if (size == 0) return true;
+	cl_mem buffer = static_cast<cl_mem>(mem);
+	cl_uchar pattern = 0;
+	cl_int error = clEnqueueFillBuffer(currentQueue(), buffer, &pattern, sizeof(cl_uchar), offset, size, 0, NULL, NULL);
+	if (error != CL_SUCCESS) return false;
+	return (clFinish(currentQueue()) == CL_SUCCESS);
+}
+
 void ClSupportImpl::shutdown()
 {
-	clReleaseCommandQueue(defaultQueue);
+	if (orbitsToStateVectorsKernel) clReleaseKernel(orbitsToStateVectorsKernel);
+	if (stateVectorsToOrbitsKernel) clReleaseKernel(stateVectorsToOrbitsKernel);
+	if (transposeKernel) clReleaseKernel(transposeKernel);
+	if (addKernel) clReleaseKernel(addKernel);
+	if (supportProgram) clReleaseProgram(supportProgram);
+	for (size_t i = 0; i < defaultQueues.size(); i++) clReleaseCommandQueue(defaultQueues[i]);
+	defaultQueues.clear();
 	clReleaseContext(context);
 }
 
 void ClSupportImpl::selectDevice(int device)
 {
-    if (device != currentDevice)
-    {
-        if (device < nDevices) {
-            //FIXME: Device switching not yet supported
-        }
-        else std::cout << "Invalid OpenCL device number - please select a number between 0 and "
-            << nDevices - 1 << "." << std::endl;
-    }
+    if (device >= 0 && device < (int)nDevices) threadDevices[instanceId] = device;
+    else std::cout << "Invalid OpenCL device number - please select a number between 0 and "
+        << nDevices - 1 << "." << std::endl;
 }
 
 int ClSupportImpl::getCurrentDevice()
 {
-	return currentDevice;
+	std::map<unsigned long long, int>::const_iterator selected = threadDevices.find(instanceId);
+	return (selected != threadDevices.end() && selected->second < (int)nDevices) ? selected->second : currentDevice;
+}
+
+cl_command_queue ClSupportImpl::currentQueue()
+{
+	return defaultQueues[getCurrentDevice()];
 }
 
 int ClSupportImpl::getDeviceCount()
@@ -160,12 +573,12 @@ cl_context* ClSupportImpl::getOpenCLContext()
 
 cl_command_queue* ClSupportImpl::getOpenCLQueue()
 {
-    return &defaultQueue;
+    return &defaultQueues[getCurrentDevice()];
 }
 
 cl_device_id* ClSupportImpl::getOpenCLDevice()
 {
-    return &devices[currentDevice];
+    return &devices[getCurrentDevice()];
 }
 
 cl_device_id** ClSupportImpl::getOpenCLDeviceList()
@@ -173,6 +586,129 @@ cl_device_id** ClSupportImpl::getOpenCLDeviceList()
     return &devices;
 }
 
+cl_program ClSupportImpl::buildOpenCLProgram(const char* source, const char* options)
+{
+	return buildCachedProgram(source, options, 1, &devices[getCurrentDevice()]);
+}
+
+// FNV-1a hash of a string, followed by a separator so that consecutive strings cannot be confused
+static unsigned long long hashString(unsigned long long hash, const std::string& text)
+{
+	for (size_t i = 0; i <= text.size(); i++) {
+		hash ^= (i < text.size()) ? (unsigned char)text[i] : 0;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static std::string deviceInfo(cl_device_id device, cl_device_info parameter)
+{
+	size_t length = 0;
+	if (clGetDeviceInfo(device, parameter, 0, NULL, &length) != CL_SUCCESS || length == 0) return "";
+	std::vector<char> value(length);
+	if (clGetDeviceInfo(device, parameter, length, value.data(), NULL) != CL_SUCCESS) return "";
+	return std::string(value.data());
+}
+
+std::string ClSupportImpl::programCacheFile(const char* source, const char* options, cl_device_id device)
+{
+	// binaries are only valid for the same source, options, device and driver
+	unsigned long long hash = 14695981039346656037ULL;
+	hash = hashString(hash, source);
+	hash = hashString(hash, options ? options : "");
+	hash = hashString(hash, deviceInfo(device, CL_DEVICE_VENDOR));
+	hash = hashString(hash, deviceInfo(device, CL_DEVICE_NAME));
+	hash = hashString(hash, deviceInfo(device, CL_DEVICE_VERSION));
+	hash = hashString(hash, deviceInfo(device, CL_DRIVER_VERSION));
+	std::stringstream file;
+	file << cacheDirectory << "/opi_" << std::hex << hash << ".clbin";
+	return file.str();
+}
+
+cl_program ClSupportImpl::buildCachedProgram(const char* source, const char* options, cl_uint numDevices, const cl_device_id* deviceList)
+{
+	cl_int error;
+	std::vector<std::string> files(numDevices);
+	std::vector<std::vector<unsigned char> > binaries(numDevices);
+	bool cached = !cacheDirectory.empty();
+	for (cl_uint i = 0; i < numDevices && !cacheDirectory.empty(); i++) {
+		files[i] = programCacheFile(source, options, deviceList[i]);
+		std::ifstream in(files[i].c_str(), std::ifstream::binary);
+		if (cached && in.is_open()) {
+			in.seekg(0, std::ios_base::end);
+			binaries[i].resize((size_t)in.tellg());
+			in.seekg(0, std::ios_base::beg);
+			in.read(reinterpret_cast<char*>(binaries[i].data()), binaries[i].size());
+			cached = in.good() && !binaries[i].empty();
+		}
+		else cached = false;
+	}
+	if (cached) {
+		std::vector<size_t> lengths(numDevices);
+		std::vector<const unsigned char*> pointers(numDevices);
+		std::vector<cl_int> status(numDevices);
+		for (cl_uint i = 0; i < numDevices; i++) {
+			lengths[i] = binaries[i].size();
+			pointers[i] = binaries[i].data();
+		}
+		cl_program program = clCreateProgramWithBinary(context, numDevices, deviceList, lengths.data(), pointers.data(), status.data(), &error);
+		if (error == CL_SUCCESS) {
+			if (clBuildProgram(program, numDevices, deviceList, options, NULL, NULL) == CL_SUCCESS) return program;
+			// binaries that the driver rejects are replaced below
+			clReleaseProgram(program);
+		}
+	}
+	cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &error);
+	if (error != CL_SUCCESS) {
+		std::cout << "Error creating OpenCL program: " << error << std::endl;
+		return NULL;
+	}
+	error = clBuildProgram(program, numDevices, deviceList, options, NULL, NULL);
+	if (error != CL_SUCCESS) {
+		size_t length = 0;
+		clGetProgramBuildInfo(program, deviceList[0], CL_PROGRAM_BUILD_LOG, 0, NULL, &length);
+		std::vector<char> log(length + 1, 0);
+		clGetProgramBuildInfo(program, deviceList[0], CL_PROGRAM_BUILD_LOG, length, log.data(), NULL);
+		std::cout << "Error building OpenCL program: " << error << std::endl << log.data() << std::endl;
+		clReleaseProgram(program);
+		return NULL;
+	}
+	if (!cacheDirectory.empty()) storeProgramBinaries(program, numDevices, deviceList, files);
+	return program;
+}
+
+void ClSupportImpl::storeProgramBinaries(cl_program program, cl_uint numDevices, const cl_device_id* deviceList, const std::vector<std::string>& files)
+{
+	// the program may list its devices in a different order
+	cl_uint programDevices = 0;
+	if (clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(cl_uint), &programDevices, NULL) != CL_SUCCESS || programDevices == 0) return;
+	std::vector<cl_device_id> ids(programDevices);
+	std::vector<size_t> sizes(programDevices);
+	clGetProgramInfo(program, CL_PROGRAM_DEVICES, programDevices * sizeof(cl_device_id), ids.data(), NULL);
+	clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, programDevices * sizeof(size_t), sizes.data(), NULL);
+	std::vector<std::vector<unsigned char> > binaries(programDevices);
+	std::vector<unsigned char*> pointers(programDevices);
+	for (cl_uint i = 0; i < programDevices; i++) {
+		binaries[i].resize(sizes[i]);
+		pointers[i] = binaries[i].data();
+	}
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, programDevices * sizeof(unsigned char*), pointers.data(), NULL) != CL_SUCCESS) return;
+	for (cl_uint i = 0; i < programDevices; i++) {
+		for (cl_uint j = 0; j < numDevices; j++) {
+			if (ids[i] != deviceList[j] || binaries[i].empty()) continue;
+			// written under a temporary name and renamed, so other processes never read partial files
+			const std::string temporary = files[j] + ".tmp";
+			std::ofstream out(temporary.c_str(), std::ofstream::binary);
+			out.write(reinterpret_cast<const char*>(binaries[i].data()), binaries[i].size());
+			out.close();
+			if (out.good()) {
+				std::remove(files[j].c_str());
+				std::rename(temporary.c_str(), files[j].c_str());
+			}
+			else std::remove(temporary.c_str());
+		}
+	}
+}
 
 extern "C"
 {
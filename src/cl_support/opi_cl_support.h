@@ -20,6 +20,10 @@
 
 #include <iostream>
 #include <sstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <stdlib.h>
 
 using namespace std;
@@ -34,8 +38,28 @@ public:
     virtual void init(int platformNumber = 0, int deviceNumber = 0);
 
     virtual void copy(void* a, void* b, size_t size, unsigned int num_objects, bool host_to_device);
+    virtual bool copyPeer(void* a, int destDevice, void* b, int sourceDevice, size_t size, unsigned int num_objects);
+    virtual void copyRange(void* a, void* b, size_t offset, size_t size, unsigned int num_objects, bool host_to_device);
+    virtual bool copyPeerRange(void* a, size_t destOffset, int destDevice, void* b, size_t sourceOffset, int sourceDevice, size_t size, unsigned int num_objects);
+    virtual void* createStream();
+    virtual void destroyStream(void* stream);
+    virtual void synchronizeStream(void* stream);
+    virtual void copyAsync(void* a, void* b, size_t size, unsigned int num_objects, bool host_to_device, void* stream);
+    virtual void copyRangeAsync(void* a, void* b, size_t offset, size_t size, unsigned int num_objects, bool host_to_device, void* stream);
+    virtual void* recordEvent(void* stream);
+    virtual void synchronizeEvent(void* event);
+    virtual void destroyEvent(void* event);
+    virtual bool convertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size);
+    virtual bool convertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects);
+    virtual bool transpose(double* destination, const double* source, int rows, int columns);
+    virtual bool addDoubles(double* destination, const double* source, size_t count);
+    virtual bool zeroMemory(void* mem, size_t size);
+    virtual bool zeroMemoryRange(void* mem, size_t offset, size_t size);
 	virtual void allocate(void** a, size_t size);
 	virtual void free(void* mem);
+	virtual bool supportsPinnedMemory() { return true; }
+	virtual void allocatePinned(void** a, size_t size);
+	virtual void freePinned(void* mem);
 	virtual void shutdown();
 	virtual void selectDevice(int device);
 	virtual int getCurrentDevice();
@@ -49,11 +73,41 @@ public:
     virtual cl_command_queue* getOpenCLQueue();
     virtual cl_device_id* getOpenCLDevice();
     virtual cl_device_id** getOpenCLDeviceList();
+    virtual cl_program buildOpenCLProgram(const char* source, const char* options);
 
 private:
+	// builds the support kernels on first use, returns false if they are not available
+	bool buildKernels();
+	// returns the default queue of the device selected by the calling thread
+	cl_command_queue currentQueue();
+	// builds a program for the given devices, using and filling the binary cache
+	cl_program buildCachedProgram(const char* source, const char* options, cl_uint numDevices, const cl_device_id* deviceList);
+	// returns the cache file for a program built for the given device
+	std::string programCacheFile(const char* source, const char* options, cl_device_id device);
+	// writes the binaries of a built program to the cache
+	void storeProgramBinaries(cl_program program, cl_uint numDevices, const cl_device_id* deviceList, const std::vector<std::string>& files);
+
     cl_context context;
-	cl_command_queue defaultQueue;
+	// one in-order default queue per device of the context
+	std::vector<cl_command_queue> defaultQueues;
 	cl_device_id* devices;
 	cl_uint nDevices;
+	// device used by threads that did not call selectDevice()
 	int currentDevice;
+	// identifies this instance in the per-thread device selections, unlike its address it
+	// is never reused by a later instance
+	const unsigned long long instanceId;
+	// directory holding the program binaries, empty if caching is disabled
+	std::string cacheDirectory;
+	// buffers backing the mapped pinned host allocations
+	std::map<void*, cl_mem> pinnedBuffers;
+	// program and kernels for the orbit/state vector conversion, transposition and summation
+	cl_program supportProgram;
+	bool supportProgramFailed;
+	cl_kernel orbitsToStateVectorsKernel;
+	cl_kernel stateVectorsToOrbitsKernel;
+	cl_kernel transposeKernel;
+	cl_kernel addKernel;
+	// guards the kernels and the pinned buffer map against concurrent use
+	std::mutex kernelMutex;
 };
@@ -0,0 +1,377 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#define OPI_CUDA_PREFIX __host__ __device__
+#include "../OPI/opi_common.h"
+#include "../OPI/opi_datatypes.h"
+#include "../OPI/internal/opi_validation.h"
+#include "../OPI/internal/opi_events.h"
+#include "../OPI/internal/opi_collision_probability.h"
+#include "../OPI/internal/opi_interpolation.h"
+#include "../OPI/internal/opi_reduction.h"
+#include "../OPI/internal/opi_sampling.h"
+
+#include <cuda_runtime.h>
+#include <algorithm>
+#include <vector>
+
+static const int CONVERSION_BLOCK_SIZE = 256;
+
+__global__ void kernel_orbitsToStateVectors(const OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size)
+		OPI::orbitToStateVector(orbit[idx], position[idx], velocity[idx]);
+}
+
+__global__ void kernel_stateVectorsToOrbits(const OPI::Vector3* position, const OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size) {
+		if (!OPI::stateVectorToOrbit(position[idx], velocity[idx], orbit[idx]))
+			atomicAdd(invalidObjects, 1);
+	}
+}
+
+bool cudaConvertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size)
+{
+	if (size <= 0) return true;
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_orbitsToStateVectors<<<blocks, CONVERSION_BLOCK_SIZE>>>(orbit, position, velocity, size);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+bool cudaConvertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects)
+{
+	*invalidObjects = 0;
+	if (size <= 0) return true;
+	int* deviceCount = 0;
+	if (cudaMalloc((void**)&deviceCount, sizeof(int)) != cudaSuccess) return false;
+	cudaMemset(deviceCount, 0, sizeof(int));
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_stateVectorsToOrbits<<<blocks, CONVERSION_BLOCK_SIZE>>>(position, velocity, orbit, size, deviceCount);
+	bool success = (cudaMemcpy(invalidObjects, deviceCount, sizeof(int), cudaMemcpyDeviceToHost) == cudaSuccess);
+	cudaFree(deviceCount);
+	return success;
+}
+
+__global__ void kernel_transpose(double* destination, const double* source, int rows, int columns)
+{
+	// one thread per destination element, so writes are coalesced; one of the two
+	// dimensions is the small number of components, so reads stay within few cache lines
+	size_t idx = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < (size_t)rows*columns) {
+		size_t row = idx / rows;
+		size_t column = idx % rows;
+		destination[idx] = source[column*columns + row];
+	}
+}
+
+bool cudaTranspose(double* destination, const double* source, int rows, int columns)
+{
+	if (rows <= 0 || columns <= 0) return true;
+	size_t elements = (size_t)rows*columns;
+	int blocks = (int)((elements + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+	kernel_transpose<<<blocks, CONVERSION_BLOCK_SIZE>>>(destination, source, rows, columns);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+__global__ void kernel_addDoubles(double* destination, const double* source, size_t count)
+{
+	size_t idx = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < count)
+		destination[idx] += source[idx];
+}
+
+bool cudaAddDoubles(double* destination, const double* source, size_t count)
+{
+	if (count == 0) return true;
+	int blocks = (int)((count + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+	kernel_addDoubles<<<blocks, CONVERSION_BLOCK_SIZE>>>(destination, source, count);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+// one thread per word of the gathered elements; words of an element are adjacent, so the
+// accesses of a warp are coalesced for types spanning several words
+template< class Word >
+__global__ void kernel_gatherElements(Word* destination, const Word* source, const int* indices, int count, int sourceCount, int words)
+{
+	size_t idx = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < (size_t)count*words) {
+		int index = indices[idx / words];
+		if (index >= 0 && index < sourceCount)
+			destination[idx] = source[(size_t)index*words + idx % words];
+	}
+}
+
+template< class Word >
+__global__ void kernel_scatterElements(Word* destination, int destinationCount, const Word* source, const int* indices, int count, int words)
+{
+	size_t idx = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < (size_t)count*words) {
+		int index = indices[idx / words];
+		if (index >= 0 && index < destinationCount)
+			destination[(size_t)index*words + idx % words] = source[idx];
+	}
+}
+
+bool cudaGatherElements(void* destination, const void* source, const int* indices, int count, int sourceCount, size_t elementSize)
+{
+	if (count <= 0 || elementSize == 0) return true;
+	// all Population types consist of doubles, the byte array is copied bytewise
+	bool wide = (elementSize % sizeof(unsigned long long) == 0);
+	int words = (int)(wide ? elementSize / sizeof(unsigned long long) : elementSize);
+	size_t elements = (size_t)count*words;
+	int blocks = (int)((elements + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+	if (wide)
+		kernel_gatherElements<<<blocks, CONVERSION_BLOCK_SIZE>>>((unsigned long long*)destination, (const unsigned long long*)source, indices, count, sourceCount, words);
+	else
+		kernel_gatherElements<<<blocks, CONVERSION_BLOCK_SIZE>>>((unsigned char*)destination, (const unsigned char*)source, indices, count, sourceCount, words);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+bool cudaScatterElements(void* destination, int destinationCount, const void* source, const int* indices, int count, size_t elementSize)
+{
+	if (count <= 0 || elementSize == 0) return true;
+	bool wide = (elementSize % sizeof(unsigned long long) == 0);
+	int words = (int)(wide ? elementSize / sizeof(unsigned long long) : elementSize);
+	size_t elements = (size_t)count*words;
+	int blocks = (int)((elements + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+	if (wide)
+		kernel_scatterElements<<<blocks, CONVERSION_BLOCK_SIZE>>>((unsigned long long*)destination, destinationCount, (const unsigned long long*)source, indices, count, words);
+	else
+		kernel_scatterElements<<<blocks, CONVERSION_BLOCK_SIZE>>>((unsigned char*)destination, destinationCount, (const unsigned char*)source, indices, count, words);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+__global__ void kernel_validateObjects(const OPI::ObjectProperties* properties, const OPI::Orbit* orbit, const OPI::Epoch* epoch,
+									   const OPI::Vector3* position, const OPI::Vector3* velocity, int size, int* errors, int* epochCounts)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size) {
+		int epochState;
+		errors[idx] = OPI::validateObject(properties ? properties + idx : 0, orbit ? orbit + idx : 0, epoch ? epoch + idx : 0,
+										  position ? position + idx : 0, velocity ? velocity + idx : 0, epochState);
+		if (epochState == OPI::VALIDATION_EPOCH_SET) atomicAdd(&epochCounts[0], 1);
+		else if (epochState == OPI::VALIDATION_EPOCH_NOT_SET) atomicAdd(&epochCounts[1], 1);
+	}
+}
+
+bool cudaValidateObjects(const OPI::ObjectProperties* properties, const OPI::Orbit* orbit, const OPI::Epoch* epoch,
+						 const OPI::Vector3* position, const OPI::Vector3* velocity, int size, int* errors, int* epochCounts)
+{
+	epochCounts[0] = 0;
+	epochCounts[1] = 0;
+	if (size <= 0) return true;
+	int* deviceCounts = 0;
+	if (cudaMalloc((void**)&deviceCounts, 2 * sizeof(int)) != cudaSuccess) return false;
+	cudaMemset(deviceCounts, 0, 2 * sizeof(int));
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_validateObjects<<<blocks, CONVERSION_BLOCK_SIZE>>>(properties, orbit, epoch, position, velocity, size, errors, deviceCounts);
+	bool success = (cudaMemcpy(epochCounts, deviceCounts, 2 * sizeof(int), cudaMemcpyDeviceToHost) == cudaSuccess);
+	cudaFree(deviceCounts);
+	return success;
+}
+
+__global__ void kernel_detectEvents(const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Epoch* epoch, int size,
+									int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size)
+		flags[idx] = OPI::detectObjectEvents(orbit ? orbit + idx : 0, position ? position + idx : 0, epoch ? epoch + idx : 0,
+											 criteria, perigeeAltitude, altitude, julianDay);
+}
+
+bool cudaDetectEvents(const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Epoch* epoch, int size,
+					  int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags)
+{
+	if (size <= 0) return true;
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_detectEvents<<<blocks, CONVERSION_BLOCK_SIZE>>>(orbit, position, epoch, size, criteria, perigeeAltitude, altitude, julianDay, flags);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+__global__ void kernel_collisionProbabilities(const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::Covariance* covariance,
+											  const OPI::ObjectProperties* properties, int size, const OPI::IndexPair* pairs, int count,
+											  double threshold, double* results, int* flags)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < count) {
+		const int a = pairs[idx].object1;
+		const int b = pairs[idx].object2;
+		double* result = results + (size_t)idx * OPI::COLLISION_PROBABILITY_RESULTS;
+		if (a < 0 || b < 0 || a >= size || b >= size) {
+			result[0] = result[1] = result[2] = 0.0;
+			flags[idx] = 0;
+			return;
+		}
+		// diameters are given in m, positions in km
+		const double radius = properties ? 0.0005 * (properties[a].diameter + properties[b].diameter) : 0.0;
+		result[2] = OPI::collisionProbability(position[a], velocity[a], position[b], velocity[b],
+											  covariance ? covariance + a : 0, covariance ? covariance + b : 0, radius, result[0], result[1]);
+		flags[idx] = (result[2] >= threshold) ? 1 : 0;
+	}
+}
+
+bool cudaCollisionProbabilities(const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::Covariance* covariance,
+								const OPI::ObjectProperties* properties, int size, const OPI::IndexPair* pairs, int count,
+								double threshold, double* results, int* flags)
+{
+	if (count <= 0) return true;
+	int blocks = (count + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_collisionProbabilities<<<blocks, CONVERSION_BLOCK_SIZE>>>(position, velocity, covariance, properties, size, pairs, count, threshold, results, flags);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+// one thread per element of the compact array, so writes are coalesced
+template< class T >
+__global__ void kernel_compactCovariance(T* destination, const double* source, int size, int elements)
+{
+	size_t idx = (size_t)blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < (size_t)size*elements) {
+		const int components = sizeof(OPI::Covariance) / sizeof(double);
+		destination[idx] = (T)source[(idx / elements)*components + idx % elements];
+	}
+}
+
+bool cudaCompactCovariance(void* destination, const OPI::Covariance* source, int size, int elements, bool singlePrecision)
+{
+	if (size <= 0 || elements <= 0) return true;
+	size_t count = (size_t)size*elements;
+	int blocks = (int)((count + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE);
+	if (singlePrecision)
+		kernel_compactCovariance<<<blocks, CONVERSION_BLOCK_SIZE>>>((float*)destination, (const double*)source, size, elements);
+	else
+		kernel_compactCovariance<<<blocks, CONVERSION_BLOCK_SIZE>>>((double*)destination, (const double*)source, size, elements);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+__global__ void kernel_interpolateHermite(OPI::Vector3* position, OPI::Vector3* velocity, const OPI::Vector3* p0, const OPI::Vector3* v0,
+										  const OPI::Vector3* p1, const OPI::Vector3* v1, int size, double h, double s)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size)
+		OPI::hermiteInterpolate(p0[idx], v0[idx], p1[idx], v1[idx], h, s, position[idx], velocity[idx]);
+}
+
+bool cudaInterpolateHermite(OPI::Vector3* position, OPI::Vector3* velocity, const OPI::Vector3* p0, const OPI::Vector3* v0,
+							const OPI::Vector3* p1, const OPI::Vector3* v1, int size, double h, double s)
+{
+	if (size <= 0) return true;
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_interpolateHermite<<<blocks, CONVERSION_BLOCK_SIZE>>>(position, velocity, p0, v0, p1, v1, size, h, s);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+__global__ void kernel_factorCovariance(const OPI::Covariance* covariance, int size, int dimension, double* factors)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size)
+		OPI::factorCovariance(covariance[idx], dimension, factors + (size_t)idx * OPI::SAMPLING_FACTOR_SIZE);
+}
+
+// one thread per clone, the factor of its object is shared by all clones of the object
+__global__ void kernel_sampleClones(const double* factors, const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Vector3* velocity,
+									const OPI::ObjectProperties* properties, const OPI::Epoch* epoch, int size, int clones, int covarianceType,
+									unsigned long long seed, OPI::Orbit* cloneOrbit, OPI::Vector3* clonePosition, OPI::Vector3* cloneVelocity,
+									OPI::ObjectProperties* cloneProperties, OPI::Epoch* cloneEpoch)
+{
+	int clone = blockIdx.x*blockDim.x + threadIdx.x;
+	if (clone < size * clones) {
+		const int i = clone / clones;
+		OPI::sampleClone(factors + (size_t)i * OPI::SAMPLING_FACTOR_SIZE, covarianceType, seed, clone,
+						 orbit ? orbit + i : 0, position ? position + i : 0, velocity ? velocity + i : 0,
+						 properties ? properties + i : 0, epoch ? epoch + i : 0,
+						 cloneOrbit ? cloneOrbit + clone : 0, clonePosition ? clonePosition + clone : 0,
+						 cloneVelocity ? cloneVelocity + clone : 0, cloneProperties ? cloneProperties + clone : 0,
+						 cloneEpoch ? cloneEpoch + clone : 0);
+	}
+}
+
+bool cudaSampleClones(const OPI::Covariance* covariance, const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Vector3* velocity,
+					  const OPI::ObjectProperties* properties, const OPI::Epoch* epoch, int size, int clones, int covarianceType,
+					  unsigned long long seed, OPI::Orbit* cloneOrbit, OPI::Vector3* clonePosition, OPI::Vector3* cloneVelocity,
+					  OPI::ObjectProperties* cloneProperties, OPI::Epoch* cloneEpoch)
+{
+	if (size <= 0 || clones <= 0) return true;
+	double* factors = 0;
+	if (cudaMalloc((void**)&factors, (size_t)size * OPI::SAMPLING_FACTOR_SIZE * sizeof(double)) != cudaSuccess) return false;
+	int blocks = (size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_factorCovariance<<<blocks, CONVERSION_BLOCK_SIZE>>>(covariance, size, OPI::samplingDimension(covarianceType), factors);
+	blocks = (size * clones + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE;
+	kernel_sampleClones<<<blocks, CONVERSION_BLOCK_SIZE>>>(factors, orbit, position, velocity, properties, epoch, size, clones, covarianceType,
+														   seed, cloneOrbit, clonePosition, cloneVelocity, cloneProperties, cloneEpoch);
+	bool success = (cudaDeviceSynchronize() == cudaSuccess);
+	cudaFree(factors);
+	return success;
+}
+
+// each thread reduces a grid-strided subset, the block combines them in shared memory and
+// writes one partial result, which are combined on the host
+__global__ void kernel_reduceComponent(const double* data, int stride, int size, int component, int operation,
+									   double lowerBound, double upperBound, double* partialResults, int* partialCounts)
+{
+	__shared__ double values[CONVERSION_BLOCK_SIZE];
+	__shared__ int counts[CONVERSION_BLOCK_SIZE];
+	double value = OPI::reductionIdentity(operation);
+	int count = 0;
+	for (int idx = blockIdx.x*blockDim.x + threadIdx.x; idx < size; idx += gridDim.x*blockDim.x) {
+		const double element = data[(size_t)idx*stride + component];
+		if (OPI::reductionValid(element, lowerBound, upperBound)) {
+			value = OPI::reductionCombine(operation, value, element);
+			count++;
+		}
+	}
+	values[threadIdx.x] = value;
+	counts[threadIdx.x] = count;
+	__syncthreads();
+	for (int half = blockDim.x / 2; half > 0; half /= 2) {
+		if (threadIdx.x < half) {
+			values[threadIdx.x] = OPI::reductionCombine(operation, values[threadIdx.x], values[threadIdx.x + half]);
+			counts[threadIdx.x] += counts[threadIdx.x + half];
+		}
+		__syncthreads();
+	}
+	if (threadIdx.x == 0) {
+		partialResults[blockIdx.x] = values[0];
+		partialCounts[blockIdx.x] = counts[0];
+	}
+}
+
+bool cudaReduceComponent(const double* data, int stride, int size, int component, int operation, double lowerBound, double upperBound, double* result, int* validCount)
+{
+	*result = OPI::reductionIdentity(operation);
+	*validCount = 0;
+	if (size <= 0) return true;
+	// enough blocks to occupy the device, few enough to combine their results on the host
+	const int maxBlocks = 1024;
+	int blocks = std::min((size + CONVERSION_BLOCK_SIZE - 1) / CONVERSION_BLOCK_SIZE, maxBlocks);
+	double* devicePartials = 0;
+	if (cudaMalloc((void**)&devicePartials, blocks * (sizeof(double) + sizeof(int))) != cudaSuccess) return false;
+	int* deviceCounts = (int*)(devicePartials + blocks);
+	kernel_reduceComponent<<<blocks, CONVERSION_BLOCK_SIZE>>>(data, stride, size, component, operation, lowerBound, upperBound, devicePartials, deviceCounts);
+	std::vector<double> partials(blocks);
+	std::vector<int> counts(blocks);
+	bool success = (cudaMemcpy(&partials[0], devicePartials, blocks * sizeof(double), cudaMemcpyDeviceToHost) == cudaSuccess)
+		&& (cudaMemcpy(&counts[0], deviceCounts, blocks * sizeof(int), cudaMemcpyDeviceToHost) == cudaSuccess);
+	cudaFree(devicePartials);
+	if (!success) return false;
+	for (int i = 0; i < blocks; i++) {
+		*result = OPI::reductionCombine(operation, *result, partials[i]);
+		*validCount += counts[i];
+	}
+	return true;
+}
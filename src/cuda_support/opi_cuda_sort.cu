@@ -0,0 +1,89 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#define OPI_CUDA_PREFIX __host__ __device__
+#include "../OPI/opi_common.h"
+#include "../OPI/opi_datatypes.h"
+
+#include <cuda_runtime.h>
+#include <thrust/device_ptr.h>
+#include <thrust/copy.h>
+#include <thrust/device_vector.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/sort.h>
+#include <thrust/transform.h>
+#include <thrust/unique.h>
+
+// pairs are sorted as 64 bit keys with the smaller object index in the upper half,
+// which matches the order of IndexPair and lets thrust use a radix sort
+struct PairToKey
+{
+	__device__ unsigned long long operator()(const OPI::IndexPair& pair) const
+	{
+		const unsigned int low = (unsigned int)min(pair.object1, pair.object2);
+		const unsigned int high = (unsigned int)max(pair.object1, pair.object2);
+		return ((unsigned long long)low << 32) | high;
+	}
+};
+
+struct KeyToPair
+{
+	__device__ OPI::IndexPair operator()(unsigned long long key) const
+	{
+		return OPI::IndexPair((int)(key >> 32), (int)(key & 0xffffffffULL));
+	}
+};
+
+struct IsFlagged
+{
+	__device__ bool operator()(int flags) const
+	{
+		return flags != 0;
+	}
+};
+
+int cudaSortIndices(int* indices, int size, bool unique)
+{
+	if (size <= 0) return 0;
+	thrust::device_ptr<int> data(indices);
+	thrust::sort(data, data + size);
+	int remaining = size;
+	if (unique)
+		remaining = (int)(thrust::unique(data, data + size) - data);
+	return (cudaDeviceSynchronize() == cudaSuccess) ? remaining : -1;
+}
+
+int cudaRemoveDuplicatePairs(OPI::IndexPair* pairs, int size)
+{
+	if (size <= 0) return 0;
+	thrust::device_ptr<OPI::IndexPair> data(pairs);
+	thrust::device_vector<unsigned long long> keys(size);
+	thrust::transform(data, data + size, keys.begin(), PairToKey());
+	thrust::sort(keys.begin(), keys.end());
+	const int remaining = (int)(thrust::unique(keys.begin(), keys.end()) - keys.begin());
+	thrust::transform(keys.begin(), keys.begin() + remaining, data, KeyToPair());
+	return (cudaDeviceSynchronize() == cudaSuccess) ? remaining : -1;
+}
+
+int cudaSelectFlagged(const int* flags, int size, int* indices)
+{
+	if (size <= 0) return 0;
+	thrust::device_ptr<const int> stencil(flags);
+	thrust::device_ptr<int> output(indices);
+	// copy_if keeps the order of the selected indices
+	const int selected = (int)(thrust::copy_if(thrust::counting_iterator<int>(0), thrust::counting_iterator<int>(size), stencil, output, IsFlagged()) - output);
+	return (cudaDeviceSynchronize() == cudaSuccess) ? selected : -1;
+}
@@ -0,0 +1,108 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#define OPI_CUDA_PREFIX __host__ __device__
+#include "../OPI/opi_common.h"
+#include "../OPI/opi_datatypes.h"
+#include "../OPI/opi_indexpairlist.h"
+#include "../OPI/internal/opi_spatial_hash.h"
+
+#include <cuda_runtime.h>
+#include <thrust/device_ptr.h>
+#include <thrust/sequence.h>
+#include <thrust/sort.h>
+
+static const int SPATIAL_HASH_BLOCK_SIZE = 256;
+
+__global__ void kernel_spatialHashKeys(const OPI::Vector3* position, unsigned int* keys, int size, double cellSize, unsigned int tableSize)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size) {
+		const OPI::Vector3 p = position[idx];
+		keys[idx] = OPI::spatialHashBucket(OPI::spatialHashCoordinate(p.x, cellSize),
+										   OPI::spatialHashCoordinate(p.y, cellSize),
+										   OPI::spatialHashCoordinate(p.z, cellSize), tableSize);
+	}
+}
+
+// the keys are sorted, so every bucket starts where the key changes
+__global__ void kernel_spatialHashRanges(const unsigned int* keys, int* cellStart, int* cellEnd, int size)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx < size) {
+		const unsigned int key = keys[idx];
+		if (idx == 0 || keys[idx - 1] != key) cellStart[key] = idx;
+		if (idx == size - 1 || keys[idx + 1] != key) cellEnd[key] = idx + 1;
+	}
+}
+
+// one thread per object in bucket order, so neighbouring threads search the same cells
+__global__ void kernel_spatialHashPairs(const OPI::Vector3* position, const int* indices, const int* cellStart, const int* cellEnd,
+										int size, double cellSize, unsigned int tableSize, double cubeSize,
+										OPI::IndexPair* pairs, int maxPairs, int* pairCount)
+{
+	int idx = blockIdx.x*blockDim.x + threadIdx.x;
+	if (idx >= size) return;
+	const int i = indices[idx];
+	const OPI::Vector3 p = position[i];
+	const long long cx = OPI::spatialHashCoordinate(p.x, cellSize);
+	const long long cy = OPI::spatialHashCoordinate(p.y, cellSize);
+	const long long cz = OPI::spatialHashCoordinate(p.z, cellSize);
+	unsigned int visited[27];
+	int numVisited = 0;
+	for (int dx = -1; dx <= 1; dx++)
+	for (int dy = -1; dy <= 1; dy++)
+	for (int dz = -1; dz <= 1; dz++) {
+		const unsigned int bucket = OPI::spatialHashBucket(cx + dx, cy + dy, cz + dz, tableSize);
+		bool seen = false;
+		for (int v = 0; v < numVisited; v++) seen = seen || (visited[v] == bucket);
+		if (seen) continue;
+		visited[numVisited++] = bucket;
+		const int start = cellStart[bucket];
+		if (start < 0) continue;
+		for (int m = start; m < cellEnd[bucket]; m++) {
+			const int j = indices[m];
+			const OPI::Vector3 q = position[j];
+			if (j > i && OPI::spatialHashInCube(p.x, p.y, p.z, q.x, q.y, q.z, cubeSize))
+				OPI::appendIndexPair(pairs, maxPairs, pairCount, i, j);
+		}
+	}
+}
+
+bool cudaBuildSpatialHash(const OPI::Vector3* position, int size, double cellSize, unsigned int tableSize, unsigned int* keys, int* indices, int* cellStart, int* cellEnd)
+{
+	if (cudaMemset(cellStart, 0xff, sizeof(int) * tableSize) != cudaSuccess) return false;
+	if (cudaMemset(cellEnd, 0xff, sizeof(int) * tableSize) != cudaSuccess) return false;
+	if (size <= 0) return true;
+	int blocks = (size + SPATIAL_HASH_BLOCK_SIZE - 1) / SPATIAL_HASH_BLOCK_SIZE;
+	kernel_spatialHashKeys<<<blocks, SPATIAL_HASH_BLOCK_SIZE>>>(position, keys, size, cellSize, tableSize);
+	// thrust uses a radix sort for integer keys
+	thrust::device_ptr<unsigned int> keyPtr(keys);
+	thrust::device_ptr<int> indexPtr(indices);
+	thrust::sequence(indexPtr, indexPtr + size);
+	thrust::sort_by_key(keyPtr, keyPtr + size, indexPtr);
+	kernel_spatialHashRanges<<<blocks, SPATIAL_HASH_BLOCK_SIZE>>>(keys, cellStart, cellEnd, size);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
+
+bool cudaQuerySpatialHash(const OPI::Vector3* position, const int* indices, const int* cellStart, const int* cellEnd, int size,
+						  double cellSize, unsigned int tableSize, double cubeSize, OPI::IndexPair* pairs, int maxPairs, int* pairCount)
+{
+	if (size <= 0) return true;
+	int blocks = (size + SPATIAL_HASH_BLOCK_SIZE - 1) / SPATIAL_HASH_BLOCK_SIZE;
+	kernel_spatialHashPairs<<<blocks, SPATIAL_HASH_BLOCK_SIZE>>>(position, indices, cellStart, cellEnd, size, cellSize, tableSize, cubeSize, pairs, maxPairs, pairCount);
+	return (cudaDeviceSynchronize() == cudaSuccess);
+}
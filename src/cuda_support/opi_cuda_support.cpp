@@ -15,14 +15,63 @@
  * License along with this library.
  */
 #include "../OPI/opi_gpusupport.h"
+#include "../OPI/internal/opi_memory_pool.h"
 
 #include <cuda_runtime.h>
 #include <iostream>
 #include <sstream>
 #include <stdlib.h>
+#include <map>
+#include <mutex>
 
 using namespace std;
 
+// conversion kernels, see opi_cuda_conversion.cu
+bool cudaConvertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size);
+bool cudaConvertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects);
+bool cudaTranspose(double* destination, const double* source, int rows, int columns);
+bool cudaAddDoubles(double* destination, const double* source, size_t count);
+bool cudaGatherElements(void* destination, const void* source, const int* indices, int count, int sourceCount, size_t elementSize);
+bool cudaScatterElements(void* destination, int destinationCount, const void* source, const int* indices, int count, size_t elementSize);
+bool cudaValidateObjects(const OPI::ObjectProperties* properties, const OPI::Orbit* orbit, const OPI::Epoch* epoch,
+						 const OPI::Vector3* position, const OPI::Vector3* velocity, int size, int* errors, int* epochCounts);
+bool cudaDetectEvents(const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Epoch* epoch, int size,
+					  int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags);
+bool cudaCollisionProbabilities(const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::Covariance* covariance,
+								const OPI::ObjectProperties* properties, int size, const OPI::IndexPair* pairs, int count,
+								double threshold, double* results, int* flags);
+bool cudaCompactCovariance(void* destination, const OPI::Covariance* source, int size, int elements, bool singlePrecision);
+bool cudaInterpolateHermite(OPI::Vector3* position, OPI::Vector3* velocity, const OPI::Vector3* p0, const OPI::Vector3* v0,
+							const OPI::Vector3* p1, const OPI::Vector3* v1, int size, double h, double s);
+bool cudaReduceComponent(const double* data, int stride, int size, int component, int operation, double lowerBound, double upperBound, double* result, int* validCount);
+bool cudaSampleClones(const OPI::Covariance* covariance, const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Vector3* velocity,
+					  const OPI::ObjectProperties* properties, const OPI::Epoch* epoch, int size, int clones, int covarianceType,
+					  unsigned long long seed, OPI::Orbit* cloneOrbit, OPI::Vector3* clonePosition, OPI::Vector3* cloneVelocity,
+					  OPI::ObjectProperties* cloneProperties, OPI::Epoch* cloneEpoch);
+// sorting, see opi_cuda_sort.cu
+int cudaSortIndices(int* indices, int size, bool unique);
+int cudaRemoveDuplicatePairs(OPI::IndexPair* pairs, int size);
+int cudaSelectFlagged(const int* flags, int size, int* indices);
+// uniform grid kernels, see opi_cuda_spatial_hash.cu
+bool cudaBuildSpatialHash(const OPI::Vector3* position, int size, double cellSize, unsigned int tableSize, unsigned int* keys, int* indices, int* cellStart, int* cellEnd);
+bool cudaQuerySpatialHash(const OPI::Vector3* position, const int* indices, const int* cellStart, const int* cellEnd, int size,
+						  double cellSize, unsigned int tableSize, double cubeSize, OPI::IndexPair* pairs, int maxPairs, int* pairCount);
+
+// a device or page-locked block handed out by the memory cache
+struct CachedBlock
+{
+	void* ptr;
+	size_t size;
+	// device the block belongs to, PINNED_BLOCK for page-locked host memory
+	int device;
+	// recorded when the block was freed, so work still queued on it is not overwritten
+	cudaEvent_t released;
+	// device the event was created on
+	int eventDevice;
+};
+
+static const int PINNED_BLOCK = -1;
+
 class CudaSupportImpl:
 		public OPI::GpuSupport
 {
@@ -33,8 +82,50 @@ class CudaSupportImpl:
         virtual void init(int platformNumber = 0, int deviceNumber = 0);
 
         virtual void copy(void* a, void* b, size_t size, unsigned int num_objects, bool host_to_device);
+        virtual bool copyPeer(void* a, int destDevice, void* b, int sourceDevice, size_t size, unsigned int num_objects);
+        virtual void* createStream();
+        virtual void destroyStream(void* stream);
+        virtual void synchronizeStream(void* stream);
+        virtual void copyAsync(void* a, void* b, size_t size, unsigned int num_objects, bool host_to_device, void* stream);
+        virtual void* recordEvent(void* stream);
+        virtual void synchronizeEvent(void* event);
+        virtual void destroyEvent(void* event);
+        virtual bool beginCapture(void* stream);
+        virtual void* endCapture(void* stream);
+        virtual bool launchGraph(void* graph, void* stream);
+        virtual void destroyGraph(void* graph);
+        virtual bool convertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size);
+        virtual bool convertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects);
+        virtual bool transpose(double* destination, const double* source, int rows, int columns);
+        virtual bool addDoubles(double* destination, const double* source, size_t count);
+        virtual bool gatherElements(void* destination, const void* source, const int* indices, int count, int sourceCount, size_t elementSize);
+        virtual bool scatterElements(void* destination, int destinationCount, const void* source, const int* indices, int count, size_t elementSize);
+        virtual bool validateObjects(const OPI::ObjectProperties* properties, const OPI::Orbit* orbit, const OPI::Epoch* epoch, const OPI::Vector3* position, const OPI::Vector3* velocity, int size, int* errors, int* epochCounts);
+        virtual bool detectEvents(const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Epoch* epoch, int size, int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags);
+        virtual bool computeCollisionProbabilities(const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::Covariance* covariance, const OPI::ObjectProperties* properties, int size, const OPI::IndexPair* pairs, int count, double threshold, double* results, int* flags);
+        virtual bool compactCovariance(void* destination, const OPI::Covariance* source, int size, int elements, bool singlePrecision);
+        virtual bool interpolateHermite(OPI::Vector3* position, OPI::Vector3* velocity, const OPI::Vector3* p0, const OPI::Vector3* v0, const OPI::Vector3* p1, const OPI::Vector3* v1, int size, double h, double s);
+        virtual bool reduceComponent(const double* data, int stride, int size, int component, int operation, double lowerBound, double upperBound, double* result, int* validCount);
+        virtual bool sampleClones(const OPI::Covariance* covariance, const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::ObjectProperties* properties, const OPI::Epoch* epoch, int size, int clones, int covarianceType, unsigned long long seed, OPI::Orbit* cloneOrbit, OPI::Vector3* clonePosition, OPI::Vector3* cloneVelocity, OPI::ObjectProperties* cloneProperties, OPI::Epoch* cloneEpoch);
+        virtual bool zeroMemory(void* mem, size_t size);
+        virtual int sortIndices(int* indices, int size, bool unique);
+        virtual int removeDuplicatePairs(OPI::IndexPair* pairs, int size);
+        virtual int selectFlagged(const int* flags, int size, int* indices);
+        virtual bool buildSpatialHash(const OPI::Vector3* position, int size, double cellSize, unsigned int tableSize, unsigned int* keys, int* indices, int* cellStart, int* cellEnd);
+        virtual bool querySpatialHash(const OPI::Vector3* position, const int* indices, const int* cellStart, const int* cellEnd, int size, double cellSize, unsigned int tableSize, double cubeSize, OPI::IndexPair* pairs, int maxPairs, int* pairCount);
 		virtual void allocate(void** a, size_t size);
 		virtual void free(void* mem);
+		virtual bool supportsPinnedMemory() { return true; }
+		virtual void allocatePinned(void** a, size_t size);
+		virtual void freePinned(void* mem);
+		virtual bool supportsManagedMemory();
+		virtual void allocateManaged(void** a, size_t size);
+		virtual void freeManaged(void* mem);
+		virtual void prefetchManaged(void* mem, size_t size, int device, void* stream);
+		virtual void adviseManaged(void* mem, size_t size, int device);
+		virtual void setMemoryCacheLimit(size_t bytes);
+		virtual void releaseMemoryCache();
+		virtual size_t getFreeDeviceMemory();
 		virtual void shutdown();
 		virtual void selectDevice(int device);
 		virtual int getCurrentDevice();
@@ -49,12 +140,39 @@ class CudaSupportImpl:
         virtual cl_device_id** getOpenCLDeviceList() { return NULL; }
 #endif
 	private:
+		// returns a cached block of the given device and size class, if there is one
+		bool takeCachedBlock(int device, size_t size, void** a);
+		// allocates a new block, freeing cached blocks of the device if it runs out of memory
+		void allocateBlock(int device, size_t size, void** a);
+		// returns a block to the cache, or frees it if the cache is full
+		void releaseBlock(void* mem, bool pinned);
+		// makes the default stream of the current device wait for the work queued so far on
+		// the streams from createStream() of the given device, or of all devices for PINNED_BLOCK
+		void waitForStreams(int device);
+		// frees a block and its event
+		void freeBlock(const CachedBlock& block);
+		// frees all cached blocks of a device, or all blocks if device is -2
+		void freeCachedBlocks(int device);
+
 		cudaDeviceProp* CUDAProperties;
+		std::mutex cacheMutex;
+		// free blocks by device and size
+		std::multimap<std::pair<int, size_t>, CachedBlock> cachedBlocks;
+		// blocks currently handed out, by address
+		std::map<void*, CachedBlock> usedBlocks;
+		size_t cachedBytes;
+		size_t cacheLimit;
+		std::mutex streamMutex;
+		// streams from createStream() and the device they were created on; they are
+		// non-blocking, so the default stream does not wait for them on its own
+		std::map<cudaStream_t, int> streams;
 };
 
 CudaSupportImpl::CudaSupportImpl()
 {
 	CUDAProperties = 0;
+	cachedBytes = 0;
+	cacheLimit = OPI::DEFAULT_MEMORY_CACHE_LIMIT;
 }
 
 CudaSupportImpl::~CudaSupportImpl()
@@ -105,14 +223,222 @@ void CudaSupportImpl::init(int platformNumber, int deviceNumber)
 	}
 }
 
+bool CudaSupportImpl::takeCachedBlock(int device, size_t size, void** a)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	// slightly larger blocks are fine, much larger ones are left for larger requests
+	std::multimap<std::pair<int, size_t>, CachedBlock>::iterator itr = cachedBlocks.lower_bound(std::make_pair(device, size));
+	for (; itr != cachedBlocks.end() && itr->first.first == device && itr->first.second <= size + size / 4; ++itr) {
+		if (cudaEventQuery(itr->second.released) == cudaSuccess) {
+			*a = itr->second.ptr;
+			cachedBytes -= itr->second.size;
+			usedBlocks[itr->second.ptr] = itr->second;
+			cachedBlocks.erase(itr);
+			return true;
+		}
+	}
+	return false;
+}
+
+void CudaSupportImpl::allocateBlock(int device, size_t size, void** a)
+{
+	*a = 0;
+	cudaError_t status = (device == PINNED_BLOCK) ? cudaHostAlloc(a, size, cudaHostAllocPortable) : cudaMalloc(a, size);
+	if (status == cudaErrorMemoryAllocation) {
+		// cached blocks may be what is missing
+		cudaGetLastError();
+		freeCachedBlocks(device);
+		status = (device == PINNED_BLOCK) ? cudaHostAlloc(a, size, cudaHostAllocPortable) : cudaMalloc(a, size);
+	}
+	if (status != cudaSuccess) {
+		*a = 0;
+		return;
+	}
+	CachedBlock block;
+	block.ptr = *a;
+	block.size = size;
+	block.device = device;
+	block.released = 0;
+	block.eventDevice = -1;
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	usedBlocks[*a] = block;
+}
+
+void CudaSupportImpl::releaseBlock(void* mem, bool pinned)
+{
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	std::map<void*, CachedBlock>::iterator itr = usedBlocks.find(mem);
+	if (itr == usedBlocks.end()) {
+		// not allocated through the cache
+		if (pinned) cudaFreeHost(mem);
+		else cudaFree(mem);
+		return;
+	}
+	CachedBlock block = itr->second;
+	usedBlocks.erase(itr);
+	if (cachedBytes + block.size > cacheLimit) {
+		lock.unlock();
+		freeBlock(block);
+		return;
+	}
+	// the event is recorded on the default stream of the device the block was used on,
+	// after the work queued on all streams of that device
+	const int oldDevice = getCurrentDevice();
+	if (block.device != PINNED_BLOCK && block.device != oldDevice) cudaSetDevice(block.device);
+	const int device = getCurrentDevice();
+	if (block.released && block.eventDevice != device) {
+		cudaEventDestroy(block.released);
+		block.released = 0;
+	}
+	if (!block.released) {
+		cudaEventCreateWithFlags(&block.released, cudaEventDisableTiming);
+		block.eventDevice = device;
+	}
+	// the block may still be in use by kernels or copies on other streams
+	waitForStreams(block.device);
+	cudaEventRecord(block.released, 0);
+	if (device != oldDevice) cudaSetDevice(oldDevice);
+	cachedBlocks.insert(std::make_pair(std::make_pair(block.device, block.size), block));
+	cachedBytes += block.size;
+}
+
+void CudaSupportImpl::waitForStreams(int device)
+{
+	const int current = getCurrentDevice();
+	std::lock_guard<std::mutex> lock(streamMutex);
+	for (std::map<cudaStream_t, int>::iterator itr = streams.begin(); itr != streams.end(); ++itr) {
+		if (device != PINNED_BLOCK && itr->second != device) continue;
+		// work recorded into a graph is not queued yet, and events cannot be recorded there
+		cudaStreamCaptureStatus capturing = cudaStreamCaptureStatusNone;
+		if (cudaStreamIsCapturing(itr->first, &capturing) != cudaSuccess || capturing != cudaStreamCaptureStatusNone) {
+			cudaGetLastError();
+			continue;
+		}
+		if (itr->second != current) cudaSetDevice(itr->second);
+		cudaEvent_t queued = 0;
+		const bool recorded = cudaEventCreateWithFlags(&queued, cudaEventDisableTiming) == cudaSuccess
+			&& cudaEventRecord(queued, itr->first) == cudaSuccess;
+		if (itr->second != current) cudaSetDevice(current);
+		if (recorded) cudaStreamWaitEvent(0, queued, 0);
+		else cudaGetLastError();
+		// the event is released once the wait has completed
+		if (queued) cudaEventDestroy(queued);
+	}
+}
+
+void CudaSupportImpl::freeBlock(const CachedBlock& block)
+{
+	// freeing synchronizes the device anyway, so there is no need to wait for the event
+	const int oldDevice = getCurrentDevice();
+	if (block.device == PINNED_BLOCK) cudaFreeHost(block.ptr);
+	else {
+		if (block.device != oldDevice) cudaSetDevice(block.device);
+		cudaFree(block.ptr);
+	}
+	if (block.released) cudaEventDestroy(block.released);
+	if (getCurrentDevice() != oldDevice) cudaSetDevice(oldDevice);
+}
+
+void CudaSupportImpl::freeCachedBlocks(int device)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (std::multimap<std::pair<int, size_t>, CachedBlock>::iterator itr = cachedBlocks.begin(); itr != cachedBlocks.end(); ) {
+		if (device == -2 || itr->first.first == device) {
+			cachedBytes -= itr->second.size;
+			freeBlock(itr->second);
+			cachedBlocks.erase(itr++);
+		}
+		else ++itr;
+	}
+}
+
 void CudaSupportImpl::allocate(void** a, size_t size)
 {
-	cudaMalloc(a, size);
+	const int device = getCurrentDevice();
+	size = OPI::memoryBlockSize(size);
+	if (!takeCachedBlock(device, size, a))
+		allocateBlock(device, size, a);
 }
 
 void CudaSupportImpl::free(void *mem)
 {
-	cudaFree(mem);
+	if (mem) releaseBlock(mem, false);
+}
+
+void CudaSupportImpl::allocatePinned(void** a, size_t size)
+{
+	// portable memory is page-locked for all devices, not just the current one
+	size = OPI::memoryBlockSize(size);
+	if (!takeCachedBlock(PINNED_BLOCK, size, a))
+		allocateBlock(PINNED_BLOCK, size, a);
+}
+
+void CudaSupportImpl::freePinned(void *mem)
+{
+	if (mem) releaseBlock(mem, true);
+}
+
+bool CudaSupportImpl::supportsManagedMemory()
+{
+	int managed = 0;
+	if (cudaDeviceGetAttribute(&managed, cudaDevAttrManagedMemory, getCurrentDevice()) != cudaSuccess) return false;
+	return managed != 0;
+}
+
+void CudaSupportImpl::allocateManaged(void** a, size_t size)
+{
+	// managed memory is not cached, its pages may reside on any device
+	if (cudaMallocManaged(a, size, cudaMemAttachGlobal) != cudaSuccess)
+		*a = 0;
+}
+
+void CudaSupportImpl::freeManaged(void *mem)
+{
+	if (mem) cudaFree(mem);
+}
+
+void CudaSupportImpl::prefetchManaged(void* mem, size_t size, int device, void* stream)
+{
+	if (!mem || size == 0) return;
+	if (device < 0) {
+		// kernels of the current device may still be writing the memory
+		cudaMemPrefetchAsync(mem, size, cudaCpuDeviceId, static_cast<cudaStream_t>(stream));
+		cudaDeviceSynchronize();
+	}
+	else cudaMemPrefetchAsync(mem, size, device, static_cast<cudaStream_t>(stream));
+	// devices without concurrent managed access do not support prefetching, which is only a hint
+	cudaGetLastError();
+}
+
+void CudaSupportImpl::adviseManaged(void* mem, size_t size, int device)
+{
+	if (!mem || size == 0) return;
+	cudaMemAdvise(mem, size, cudaMemAdviseSetAccessedBy, device < 0 ? cudaCpuDeviceId : device);
+	cudaGetLastError();
+}
+
+void CudaSupportImpl::setMemoryCacheLimit(size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cacheLimit = bytes;
+		if (cachedBytes <= cacheLimit) return;
+	}
+	freeCachedBlocks(-2);
+}
+
+void CudaSupportImpl::releaseMemoryCache()
+{
+	freeCachedBlocks(-2);
+}
+
+size_t CudaSupportImpl::getFreeDeviceMemory()
+{
+	// blocks kept in the cache are not included, they are only reused for similar sizes
+	size_t freeBytes = 0;
+	size_t totalBytes = 0;
+	if (cudaMemGetInfo(&freeBytes, &totalBytes) != cudaSuccess) return 0;
+	return freeBytes;
 }
 
 void CudaSupportImpl::copy(void *destination, void *source, size_t size, unsigned int num_objects, bool host_to_device)
@@ -120,8 +446,214 @@ void CudaSupportImpl::copy(void *destination, void *source, size_t size, unsigne
     cudaMemcpy(destination, source, size*num_objects, host_to_device ? cudaMemcpyHostToDevice : cudaMemcpyDeviceToHost);
 }
 
+bool CudaSupportImpl::copyPeer(void *destination, int destDevice, void *source, int sourceDevice, size_t size, unsigned int num_objects)
+{
+	int deviceCount = getDeviceCount();
+	if ((destDevice < 0) || (destDevice >= deviceCount) || (sourceDevice < 0) || (sourceDevice >= deviceCount))
+		return false;
+	if (destDevice != sourceDevice) {
+		int canAccessPeer = 0;
+		cudaDeviceCanAccessPeer(&canAccessPeer, destDevice, sourceDevice);
+		if (!canAccessPeer)
+			return false;
+		// peer access has to be enabled from the destination device; if it is already
+		// enabled the call returns an error that can safely be ignored and is cleared here
+		int oldDevice = getCurrentDevice();
+		cudaSetDevice(destDevice);
+		cudaDeviceEnablePeerAccess(sourceDevice, 0);
+		cudaGetLastError();
+		cudaSetDevice(oldDevice);
+	}
+	return (cudaMemcpyPeer(destination, destDevice, source, sourceDevice, size*num_objects) == cudaSuccess);
+}
+
+void* CudaSupportImpl::createStream()
+{
+	cudaStream_t stream = 0;
+	if (cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking) != cudaSuccess) return 0;
+	std::lock_guard<std::mutex> lock(streamMutex);
+	streams[stream] = getCurrentDevice();
+	return stream;
+}
+
+void CudaSupportImpl::destroyStream(void* stream)
+{
+	if (!stream) return;
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		streams.erase(static_cast<cudaStream_t>(stream));
+	}
+	cudaStreamDestroy(static_cast<cudaStream_t>(stream));
+}
+
+void CudaSupportImpl::synchronizeStream(void* stream)
+{
+	cudaStreamSynchronize(static_cast<cudaStream_t>(stream));
+}
+
+void CudaSupportImpl::copyAsync(void *destination, void *source, size_t size, unsigned int num_objects, bool host_to_device, void* stream)
+{
+	cudaMemcpyAsync(destination, source, size*num_objects, host_to_device ? cudaMemcpyHostToDevice : cudaMemcpyDeviceToHost, static_cast<cudaStream_t>(stream));
+}
+
+void* CudaSupportImpl::recordEvent(void* stream)
+{
+	cudaEvent_t event = 0;
+	cudaEventCreateWithFlags(&event, cudaEventDisableTiming);
+	cudaEventRecord(event, static_cast<cudaStream_t>(stream));
+	return event;
+}
+
+void CudaSupportImpl::synchronizeEvent(void* event)
+{
+	if (event) cudaEventSynchronize(static_cast<cudaEvent_t>(event));
+}
+
+void CudaSupportImpl::destroyEvent(void* event)
+{
+	if (event) cudaEventDestroy(static_cast<cudaEvent_t>(event));
+}
+
+bool CudaSupportImpl::beginCapture(void* stream)
+{
+	// the legacy default stream cannot be captured; other threads may keep using the device
+	return stream && cudaStreamBeginCapture(static_cast<cudaStream_t>(stream), cudaStreamCaptureModeThreadLocal) == cudaSuccess;
+}
+
+void* CudaSupportImpl::endCapture(void* stream)
+{
+	cudaGraph_t graph = 0;
+	if (cudaStreamEndCapture(static_cast<cudaStream_t>(stream), &graph) != cudaSuccess || !graph)
+	{
+		// clear the error of the invalidated capture
+		cudaGetLastError();
+		if (graph) cudaGraphDestroy(graph);
+		return 0;
+	}
+	cudaGraphExec_t exec = 0;
+#if CUDART_VERSION >= 11040
+	cudaError_t status = cudaGraphInstantiateWithFlags(&exec, graph, 0);
+#else
+	cudaError_t status = cudaGraphInstantiate(&exec, graph, NULL, NULL, 0);
+#endif
+	cudaGraphDestroy(graph);
+	if (status != cudaSuccess)
+	{
+		cudaGetLastError();
+		return 0;
+	}
+	return exec;
+}
+
+bool CudaSupportImpl::launchGraph(void* graph, void* stream)
+{
+	return graph && cudaGraphLaunch(static_cast<cudaGraphExec_t>(graph), static_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+void CudaSupportImpl::destroyGraph(void* graph)
+{
+	if (graph) cudaGraphExecDestroy(static_cast<cudaGraphExec_t>(graph));
+}
+
+bool CudaSupportImpl::convertOrbitsToStateVectors(OPI::Orbit* orbit, OPI::Vector3* position, OPI::Vector3* velocity, int size)
+{
+	return cudaConvertOrbitsToStateVectors(orbit, position, velocity, size);
+}
+
+bool CudaSupportImpl::convertStateVectorsToOrbits(OPI::Vector3* position, OPI::Vector3* velocity, OPI::Orbit* orbit, int size, int* invalidObjects)
+{
+	return cudaConvertStateVectorsToOrbits(position, velocity, orbit, size, invalidObjects);
+}
+
+bool CudaSupportImpl::transpose(double* destination, const double* source, int rows, int columns)
+{
+	return cudaTranspose(destination, source, rows, columns);
+}
+
+bool CudaSupportImpl::addDoubles(double* destination, const double* source, size_t count)
+{
+	return cudaAddDoubles(destination, source, count);
+}
+
+bool CudaSupportImpl::gatherElements(void* destination, const void* source, const int* indices, int count, int sourceCount, size_t elementSize)
+{
+	return cudaGatherElements(destination, source, indices, count, sourceCount, elementSize);
+}
+
+bool CudaSupportImpl::scatterElements(void* destination, int destinationCount, const void* source, const int* indices, int count, size_t elementSize)
+{
+	return cudaScatterElements(destination, destinationCount, source, indices, count, elementSize);
+}
+
+bool CudaSupportImpl::validateObjects(const OPI::ObjectProperties* properties, const OPI::Orbit* orbit, const OPI::Epoch* epoch, const OPI::Vector3* position, const OPI::Vector3* velocity, int size, int* errors, int* epochCounts)
+{
+	return cudaValidateObjects(properties, orbit, epoch, position, velocity, size, errors, epochCounts);
+}
+
+bool CudaSupportImpl::detectEvents(const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Epoch* epoch, int size, int criteria, double perigeeAltitude, double altitude, double julianDay, int* flags)
+{
+	return cudaDetectEvents(orbit, position, epoch, size, criteria, perigeeAltitude, altitude, julianDay, flags);
+}
+
+bool CudaSupportImpl::computeCollisionProbabilities(const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::Covariance* covariance, const OPI::ObjectProperties* properties, int size, const OPI::IndexPair* pairs, int count, double threshold, double* results, int* flags)
+{
+	return cudaCollisionProbabilities(position, velocity, covariance, properties, size, pairs, count, threshold, results, flags);
+}
+
+bool CudaSupportImpl::compactCovariance(void* destination, const OPI::Covariance* source, int size, int elements, bool singlePrecision)
+{
+	return cudaCompactCovariance(destination, source, size, elements, singlePrecision);
+}
+
+bool CudaSupportImpl::interpolateHermite(OPI::Vector3* position, OPI::Vector3* velocity, const OPI::Vector3* p0, const OPI::Vector3* v0, const OPI::Vector3* p1, const OPI::Vector3* v1, int size, double h, double s)
+{
+	return cudaInterpolateHermite(position, velocity, p0, v0, p1, v1, size, h, s);
+}
+
+bool CudaSupportImpl::reduceComponent(const double* data, int stride, int size, int component, int operation, double lowerBound, double upperBound, double* result, int* validCount)
+{
+	return cudaReduceComponent(data, stride, size, component, operation, lowerBound, upperBound, result, validCount);
+}
+
+bool CudaSupportImpl::sampleClones(const OPI::Covariance* covariance, const OPI::Orbit* orbit, const OPI::Vector3* position, const OPI::Vector3* velocity, const OPI::ObjectProperties* properties, const OPI::Epoch* epoch, int size, int clones, int covarianceType, unsigned long long seed, OPI::Orbit* cloneOrbit, OPI::Vector3* clonePosition, OPI::Vector3* cloneVelocity, OPI::ObjectProperties* cloneProperties, OPI::Epoch* cloneEpoch)
+{
+	return cudaSampleClones(covariance, orbit, position, velocity, properties, epoch, size, clones, covarianceType, seed,
+							cloneOrbit, clonePosition, cloneVelocity, cloneProperties, cloneEpoch);
+}
+
+bool CudaSupportImpl::zeroMemory(void* mem, size_t size)
+{
+	return (cudaMemset(mem, 0, size) == cudaSuccess);
+}
+
+int CudaSupportImpl::sortIndices(int* indices, int size, bool unique)
+{
+	return cudaSortIndices(indices, size, unique);
+}
+
+int CudaSupportImpl::removeDuplicatePairs(OPI::IndexPair* pairs, int size)
+{
+	return cudaRemoveDuplicatePairs(pairs, size);
+}
+
+int CudaSupportImpl::selectFlagged(const int* flags, int size, int* indices)
+{
+	return cudaSelectFlagged(flags, size, indices);
+}
+
+bool CudaSupportImpl::buildSpatialHash(const OPI::Vector3* position, int size, double cellSize, unsigned int tableSize, unsigned int* keys, int* indices, int* cellStart, int* cellEnd)
+{
+	return cudaBuildSpatialHash(position, size, cellSize, tableSize, keys, indices, cellStart, cellEnd);
+}
+
+bool CudaSupportImpl::querySpatialHash(const OPI::Vector3* position, const int* indices, const int* cellStart, const int* cellEnd, int size, double cellSize, unsigned int tableSize, double cubeSize, OPI::IndexPair* pairs, int maxPairs, int* pairCount)
+{
+	return cudaQuerySpatialHash(position, indices, cellStart, cellEnd, size, cellSize, tableSize, cubeSize, pairs, maxPairs, pairCount);
+}
+
 void CudaSupportImpl::shutdown()
 {
+	freeCachedBlocks(-2);
 	cudaThreadExit();
 }
 
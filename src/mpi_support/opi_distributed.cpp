@@ -0,0 +1,466 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#include "opi_distributed.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <math.h>
+
+namespace OPI
+{
+	//! \cond INTERNAL_DOCUMENTATION
+	class DistributedPopulationImpl
+	{
+		public:
+			DistributedPopulationImpl(Host& _host): host(_host), local(_host), screening(_host),
+				communicator(MPI_COMM_WORLD), rank(0), rankCount(1), globalSize(0), globalOffset(0), ownedCount(0) { }
+
+			Host& host;
+			Population local;
+			Population screening;
+			MPI_Comm communicator;
+			int rank;
+			int rankCount;
+			long long globalSize;
+			long long globalOffset;
+
+			// objects of the screening Population: the owned ones first, then the halo
+			int ownedCount;
+			std::vector<long long> screeningIndex;
+			std::vector<int> screeningOwner;
+	};
+
+	// the fields that can be copied to the screening Population
+	struct HaloField
+	{
+		int mask;
+		int type;
+		int elementSize;
+	};
+
+	static const HaloField HALO_FIELDS[] = {
+		{ FIELD_POSITION, DATA_POSITION, sizeof(Vector3) },
+		{ FIELD_ORBIT, DATA_ORBIT, sizeof(Orbit) },
+		{ FIELD_PROPERTIES, DATA_PROPERTIES, sizeof(ObjectProperties) },
+		{ FIELD_VELOCITY, DATA_VELOCITY, sizeof(Vector3) },
+		{ FIELD_ACCELERATION, DATA_ACCELERATION, sizeof(Vector3) },
+		{ FIELD_EPOCH, DATA_EPOCH, sizeof(Epoch) },
+		{ FIELD_COVARIANCE, DATA_COVARIANCE, sizeof(Covariance) }
+	};
+	static const int HALO_FIELD_COUNT = sizeof(HALO_FIELDS) / sizeof(HALO_FIELDS[0]);
+
+	static char* fieldData(Population& population, int type, bool no_sync)
+	{
+		switch(type)
+		{
+			case DATA_ORBIT: return reinterpret_cast<char*>(population.getOrbit(DEVICE_HOST, no_sync));
+			case DATA_PROPERTIES: return reinterpret_cast<char*>(population.getObjectProperties(DEVICE_HOST, no_sync));
+			case DATA_POSITION: return reinterpret_cast<char*>(population.getPosition(DEVICE_HOST, no_sync));
+			case DATA_VELOCITY: return reinterpret_cast<char*>(population.getVelocity(DEVICE_HOST, no_sync));
+			case DATA_ACCELERATION: return reinterpret_cast<char*>(population.getAcceleration(DEVICE_HOST, no_sync));
+			case DATA_EPOCH: return reinterpret_cast<char*>(population.getEpoch(DEVICE_HOST, no_sync));
+			case DATA_COVARIANCE: return reinterpret_cast<char*>(population.getCovariance(DEVICE_HOST, no_sync));
+			default: return 0;
+		}
+	}
+
+	static double component(const Vector3& v, int axis)
+	{
+		return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+	}
+
+	static bool fileExists(const std::string& filename)
+	{
+		std::ifstream in(filename.c_str(), std::ifstream::binary);
+		return in.is_open();
+	}
+
+	// combines the error codes of all ranks, SUCCESS is zero
+	static ErrorCode combineErrors(MPI_Comm communicator, ErrorCode status)
+	{
+		int local = status;
+		int combined = SUCCESS;
+		MPI_Allreduce(&local, &combined, 1, MPI_INT, MPI_MAX, communicator);
+		return static_cast<ErrorCode>(combined);
+	}
+	//! \endcond
+
+	DistributedPopulation::DistributedPopulation(Host& host, MPI_Comm communicator): impl(host)
+	{
+		impl->communicator = communicator;
+		MPI_Comm_rank(communicator, &impl->rank);
+		MPI_Comm_size(communicator, &impl->rankCount);
+	}
+
+	DistributedPopulation::~DistributedPopulation()
+	{
+	}
+
+	Population& DistributedPopulation::getLocal()
+	{
+		return impl->local;
+	}
+
+	int DistributedPopulation::getRank() const
+	{
+		return impl->rank;
+	}
+
+	int DistributedPopulation::getRankCount() const
+	{
+		return impl->rankCount;
+	}
+
+	long long DistributedPopulation::getGlobalSize() const
+	{
+		return impl->globalSize;
+	}
+
+	long long DistributedPopulation::getGlobalOffset() const
+	{
+		return impl->globalOffset;
+	}
+
+	void DistributedPopulation::updateLayout()
+	{
+		long long size = impl->local.getSize();
+		long long offset = 0;
+		MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, impl->communicator);
+		// the result is undefined on the first rank
+		impl->globalOffset = (impl->rank == 0) ? 0 : offset;
+		MPI_Allreduce(&size, &impl->globalSize, 1, MPI_LONG_LONG, MPI_SUM, impl->communicator);
+	}
+
+	std::string DistributedPopulation::getShardFileName(const char* filename, int rank, int rankCount)
+	{
+		std::ostringstream name;
+		name << filename << "." << rank << "-" << rankCount;
+		return name.str();
+	}
+
+	ErrorCode DistributedPopulation::read(const char* filename, FieldMask fields)
+	{
+		ErrorCode status = SUCCESS;
+		int single = (impl->rank == 0) ? fileExists(filename) : 0;
+		MPI_Bcast(&single, 1, MPI_INT, 0, impl->communicator);
+		if (single)
+		{
+			// only the header is needed to find the number of objects
+			int count = 0;
+			if (impl->rank == 0)
+			{
+				Population probe(impl->host);
+				status = probe.read(filename, FIELD_NONE);
+				count = (status == SUCCESS) ? probe.getSize() : -1;
+			}
+			MPI_Bcast(&count, 1, MPI_INT, 0, impl->communicator);
+			if (count < 0)
+			{
+				status = combineErrors(impl->communicator, status);
+				impl->host.sendError(status);
+				return status;
+			}
+			const int first = (int)(((long long)count * impl->rank) / impl->rankCount);
+			const int last = (int)(((long long)count * (impl->rank + 1)) / impl->rankCount);
+			status = impl->local.read(filename, fields, first, last - first);
+		}
+		else {
+			const std::string shard = getShardFileName(filename, impl->rank, impl->rankCount);
+			int found = fileExists(shard);
+			int allFound = 0;
+			MPI_Allreduce(&found, &allFound, 1, MPI_INT, MPI_MIN, impl->communicator);
+			if (!allFound)
+			{
+				if (impl->rank == 0)
+					std::cout << "Unable to find " << filename << " or its shards for " << impl->rankCount << " ranks!" << std::endl;
+				impl->host.sendError(DIRECTORY_NOT_FOUND);
+				return DIRECTORY_NOT_FOUND;
+			}
+			status = impl->local.read(shard.c_str(), fields);
+		}
+		status = combineErrors(impl->communicator, status);
+		updateLayout();
+		return status;
+	}
+
+	ErrorCode DistributedPopulation::write(const char* filename)
+	{
+		impl->local.write(getShardFileName(filename, impl->rank, impl->rankCount).c_str());
+		// all shards are complete when any rank returns
+		MPI_Barrier(impl->communicator);
+		return SUCCESS;
+	}
+
+	ErrorCode DistributedPopulation::propagate(Propagator& propagator, double julian_day, double dt, PropagationMode mode)
+	{
+		ErrorCode status = propagator.propagate(impl->local, julian_day, dt, mode);
+		return combineErrors(impl->communicator, status);
+	}
+
+	ErrorCode DistributedPopulation::exchangeHalo(double haloWidth, int fields)
+	{
+		MPI_Comm communicator = impl->communicator;
+		const int ranks = impl->rankCount;
+		Population& local = impl->local;
+		const int size = local.getSize();
+
+		// all ranks agree on the fields to transfer and on the presence of positions
+		int localFields = 0;
+		for (int f = 0; f < HALO_FIELD_COUNT; f++)
+			if (local.hasData(HALO_FIELDS[f].type)) localFields |= HALO_FIELDS[f].mask;
+		if (size == 0) localFields |= FIELD_POSITION;
+		int globalFields = 0;
+		int missingPositions = (localFields & FIELD_POSITION) ? 0 : 1;
+		int anyMissing = 0;
+		MPI_Allreduce(&missingPositions, &anyMissing, 1, MPI_INT, MPI_MAX, communicator);
+		if (anyMissing)
+		{
+			impl->host.sendError(INVALID_ARGUMENT);
+			return INVALID_ARGUMENT;
+		}
+		MPI_Allreduce(&localFields, &globalFields, 1, MPI_INT, MPI_BOR, communicator);
+		const int transferFields = (fields & globalFields) | FIELD_POSITION;
+
+		// the slabs are placed along the axis of the largest extent
+		const Vector3* position = local.getPosition();
+		double bounds[6] = { HUGE_VAL, HUGE_VAL, HUGE_VAL, HUGE_VAL, HUGE_VAL, HUGE_VAL };
+		for (int i = 0; i < size; i++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				bounds[a] = std::min(bounds[a], component(position[i], a));
+				bounds[a + 3] = std::min(bounds[a + 3], -component(position[i], a));
+			}
+		}
+		double globalBounds[6];
+		MPI_Allreduce(bounds, globalBounds, 6, MPI_DOUBLE, MPI_MIN, communicator);
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+			if (-globalBounds[a + 3] - globalBounds[a] > -globalBounds[axis + 3] - globalBounds[axis]) axis = a;
+
+		// the slab boundaries are quantiles of an equal share of samples from every rank
+		const int maxSamples = 1024;
+		const int numSamples = std::min(size, maxSamples);
+		std::vector<double> samples(numSamples);
+		for (int i = 0; i < numSamples; i++)
+			samples[i] = component(position[(int)(((long long)size * i) / numSamples)], axis);
+		std::vector<int> sampleCounts(ranks);
+		MPI_Allgather(&numSamples, 1, MPI_INT, &sampleCounts[0], 1, MPI_INT, communicator);
+		std::vector<int> sampleOffsets(ranks, 0);
+		for (int r = 1; r < ranks; r++) sampleOffsets[r] = sampleOffsets[r - 1] + sampleCounts[r - 1];
+		const int totalSamples = sampleOffsets[ranks - 1] + sampleCounts[ranks - 1];
+		std::vector<double> allSamples(std::max(totalSamples, 1));
+		MPI_Allgatherv(numSamples > 0 ? &samples[0] : 0, numSamples, MPI_DOUBLE, &allSamples[0], &sampleCounts[0], &sampleOffsets[0], MPI_DOUBLE, communicator);
+		allSamples.resize(totalSamples);
+		std::sort(allSamples.begin(), allSamples.end());
+		// slab r covers [slabBounds[r-1], slabBounds[r]), the outer slabs are unbounded
+		std::vector<double> slabBounds(ranks - 1, HUGE_VAL);
+		for (int r = 1; r < ranks && totalSamples > 0; r++)
+			slabBounds[r - 1] = allSamples[((long long)totalSamples * r) / ranks];
+
+		// collect the objects for every rank, owned objects before halo copies
+		std::vector<std::vector<int> > owned(ranks), halo(ranks);
+		std::vector<int> ownerOf(size);
+		for (int i = 0; i < size; i++)
+		{
+			const double c = component(position[i], axis);
+			const int owner = (int)(std::upper_bound(slabBounds.begin(), slabBounds.end(), c) - slabBounds.begin());
+			const int firstSlab = (int)(std::upper_bound(slabBounds.begin(), slabBounds.end(), c - haloWidth) - slabBounds.begin());
+			const int lastSlab = (int)(std::upper_bound(slabBounds.begin(), slabBounds.end(), c + haloWidth) - slabBounds.begin());
+			ownerOf[i] = owner;
+			owned[owner].push_back(i);
+			for (int s = firstSlab; s <= lastSlab; s++)
+				if (s != owner) halo[s].push_back(i);
+		}
+		std::vector<int> sendOrder;
+		std::vector<int> sendCounts(2 * ranks);
+		for (int r = 0; r < ranks; r++)
+		{
+			sendOrder.insert(sendOrder.end(), owned[r].begin(), owned[r].end());
+			sendOrder.insert(sendOrder.end(), halo[r].begin(), halo[r].end());
+			sendCounts[2 * r] = (int)owned[r].size();
+			sendCounts[2 * r + 1] = (int)(owned[r].size() + halo[r].size());
+		}
+		std::vector<int> receiveCounts(2 * ranks);
+		MPI_Alltoall(&sendCounts[0], 2, MPI_INT, &receiveCounts[0], 2, MPI_INT, communicator);
+
+		std::vector<int> sendTotals(ranks), sendOffsets(ranks, 0), receiveTotals(ranks), receiveOffsets(ranks, 0);
+		for (int r = 0; r < ranks; r++)
+		{
+			sendTotals[r] = sendCounts[2 * r + 1];
+			receiveTotals[r] = receiveCounts[2 * r + 1];
+			if (r > 0)
+			{
+				sendOffsets[r] = sendOffsets[r - 1] + sendTotals[r - 1];
+				receiveOffsets[r] = receiveOffsets[r - 1] + receiveTotals[r - 1];
+			}
+		}
+		const int numSent = (int)sendOrder.size();
+		const int numReceived = receiveOffsets[ranks - 1] + receiveTotals[ranks - 1];
+
+		// every source sends its owned objects first, they are moved to the front
+		std::vector<int> target(numReceived);
+		int ownedCount = 0;
+		for (int r = 0; r < ranks; r++) ownedCount += receiveCounts[2 * r];
+		int nextOwned = 0;
+		int nextHalo = ownedCount;
+		for (int r = 0; r < ranks; r++)
+		{
+			for (int j = 0; j < receiveTotals[r]; j++)
+				target[receiveOffsets[r] + j] = (j < receiveCounts[2 * r]) ? nextOwned++ : nextHalo++;
+		}
+
+		// global indices and owners
+		std::vector<long long> sendIndex(std::max(numSent, 1)), receiveIndex(std::max(numReceived, 1));
+		std::vector<int> sendOwner(std::max(numSent, 1)), receiveOwner(std::max(numReceived, 1));
+		for (int j = 0; j < numSent; j++)
+		{
+			sendIndex[j] = impl->globalOffset + sendOrder[j];
+			sendOwner[j] = ownerOf[sendOrder[j]];
+		}
+		MPI_Alltoallv(&sendIndex[0], &sendTotals[0], &sendOffsets[0], MPI_LONG_LONG,
+					  &receiveIndex[0], &receiveTotals[0], &receiveOffsets[0], MPI_LONG_LONG, communicator);
+		MPI_Alltoallv(&sendOwner[0], &sendTotals[0], &sendOffsets[0], MPI_INT,
+					  &receiveOwner[0], &receiveTotals[0], &receiveOffsets[0], MPI_INT, communicator);
+		impl->ownedCount = ownedCount;
+		impl->screeningIndex.resize(numReceived);
+		impl->screeningOwner.resize(numReceived);
+		for (int j = 0; j < numReceived; j++)
+		{
+			impl->screeningIndex[target[j]] = receiveIndex[j];
+			impl->screeningOwner[target[j]] = receiveOwner[j];
+		}
+
+		// the fields are transferred as whole elements, so the counts stay small
+		Population& screening = impl->screening;
+		screening.resize(numReceived);
+		std::vector<char> sendBuffer, receiveBuffer;
+		for (int f = 0; f < HALO_FIELD_COUNT; f++)
+		{
+			const HaloField& field = HALO_FIELDS[f];
+			if (!(transferFields & field.mask)) continue;
+			const size_t elementSize = field.elementSize;
+			const char* source = fieldData(local, field.type, false);
+			sendBuffer.resize(std::max((size_t)numSent, (size_t)1) * elementSize);
+			receiveBuffer.resize(std::max((size_t)numReceived, (size_t)1) * elementSize);
+			for (int j = 0; j < numSent; j++)
+				memcpy(&sendBuffer[j * elementSize], source + sendOrder[j] * elementSize, elementSize);
+			MPI_Datatype elementType;
+			MPI_Type_contiguous(field.elementSize, MPI_BYTE, &elementType);
+			MPI_Type_commit(&elementType);
+			MPI_Alltoallv(&sendBuffer[0], &sendTotals[0], &sendOffsets[0], elementType,
+						  &receiveBuffer[0], &receiveTotals[0], &receiveOffsets[0], elementType, communicator);
+			MPI_Type_free(&elementType);
+			char* destination = fieldData(screening, field.type, true);
+			for (int j = 0; j < numReceived; j++)
+				memcpy(destination + target[j] * elementSize, &receiveBuffer[j * elementSize], elementSize);
+			screening.update(field.type);
+		}
+		return SUCCESS;
+	}
+
+	Population& DistributedPopulation::getScreeningPopulation()
+	{
+		return impl->screening;
+	}
+
+	int DistributedPopulation::getOwnedCount() const
+	{
+		return impl->ownedCount;
+	}
+
+	long long DistributedPopulation::getGlobalIndex(int screeningIndex) const
+	{
+		if (screeningIndex < 0 || screeningIndex >= (int)impl->screeningIndex.size())
+		{
+			impl->host.sendError(INDEX_RANGE);
+			return -1;
+		}
+		return impl->screeningIndex[screeningIndex];
+	}
+
+	int DistributedPopulation::getOwner(int screeningIndex) const
+	{
+		if (screeningIndex < 0 || screeningIndex >= (int)impl->screeningOwner.size())
+		{
+			impl->host.sendError(INDEX_RANGE);
+			return -1;
+		}
+		return impl->screeningOwner[screeningIndex];
+	}
+
+	void DistributedPopulation::filterPairs(IndexPairList& pairs) const
+	{
+		const std::vector<int>& owner = impl->screeningOwner;
+		const int numPairs = pairs.getPairsUsed();
+		IndexPair* pair = pairs.getData(DEVICE_HOST);
+		int kept = 0;
+		for (int i = 0; i < numPairs; i++)
+		{
+			if (std::min(owner[pair[i].object1], owner[pair[i].object2]) == impl->rank)
+				pair[kept++] = pair[i];
+		}
+		pairs.update(DEVICE_HOST, kept);
+	}
+
+	void DistributedPopulation::filterConjunctions(std::vector<Conjunction>& conjunctions) const
+	{
+		const std::vector<int>& owner = impl->screeningOwner;
+		size_t kept = 0;
+		for (size_t i = 0; i < conjunctions.size(); i++)
+		{
+			if (std::min(owner[conjunctions[i].object1], owner[conjunctions[i].object2]) == impl->rank)
+				conjunctions[kept++] = conjunctions[i];
+		}
+		conjunctions.resize(kept);
+	}
+
+	ErrorCode DistributedPopulation::queryCubicPairs(DistanceQuery& query, IndexPairList& pairs, float cube_size)
+	{
+		ErrorCode status = exchangeHalo(cube_size, 0);
+		if (status != SUCCESS) return status;
+		status = query.rebuild(impl->screening);
+		if (status == SUCCESS) status = query.queryCubicPairs(impl->screening, pairs, cube_size);
+		if (status == SUCCESS) filterPairs(pairs);
+		return status;
+	}
+
+	ErrorCode DistributedPopulation::detectConjunctions(CollisionDetection& detection, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window)
+	{
+		// the halo has to contain every object that can come closer than threshold
+		Population& local = impl->local;
+		const Vector3* velocity = local.hasData(DATA_VELOCITY) ? local.getVelocity() : 0;
+		const Vector3* acceleration = local.hasData(DATA_ACCELERATION) ? local.getAcceleration() : 0;
+		double displacement = 0.0;
+		for (int i = 0; i < local.getSize(); i++)
+		{
+			double d = 0.0;
+			if (velocity) d += sqrt(velocity[i].x * velocity[i].x + velocity[i].y * velocity[i].y + velocity[i].z * velocity[i].z) * time_window;
+			if (acceleration) d += 0.5 * sqrt(acceleration[i].x * acceleration[i].x + acceleration[i].y * acceleration[i].y + acceleration[i].z * acceleration[i].z) * time_window * time_window;
+			displacement = std::max(displacement, d);
+		}
+		double maxDisplacement = 0.0;
+		MPI_Allreduce(&displacement, &maxDisplacement, 1, MPI_DOUBLE, MPI_MAX, impl->communicator);
+		ErrorCode status = exchangeHalo(threshold + 2.0 * maxDisplacement, FIELD_PROPERTIES | FIELD_VELOCITY | FIELD_ACCELERATION);
+		if (status != SUCCESS) return status;
+		status = detection.detectConjunctions(impl->screening, query, conjunctions_out, threshold, time_window);
+		if (status == SUCCESS) filterConjunctions(conjunctions_out);
+		return status;
+	}
+}
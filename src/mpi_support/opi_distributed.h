@@ -0,0 +1,151 @@
+/* OPI: Orbital Propagation Interface
+ * Copyright (C) 2014 Institute of Aerospace Systems, TU Braunschweig, All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3.0 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.
+ */
+#ifndef OPI_DISTRIBUTED_H
+#define OPI_DISTRIBUTED_H
+
+#include "../OPI/opi_cpp.h"
+#include <mpi.h>
+#include <vector>
+
+#if WIN32
+#ifdef OPI_COMPILING_MPI_LIBRARY
+#define OPI_MPI_EXPORT __declspec( dllexport )
+#else
+#define OPI_MPI_EXPORT __declspec( dllimport )
+#endif
+#else
+#define OPI_MPI_EXPORT
+#endif
+
+namespace OPI
+{
+	class DistributedPopulationImpl;
+
+	//! \brief A Population partitioned across the ranks of an MPI communicator
+	/** Every rank holds a contiguous range of objects, its shard, as a local Population that
+	 * is propagated independently by each rank. The global index of an object is its index
+	 * within the shard plus the global offset of the shard, the shards follow each other in
+	 * the order of the ranks.
+	 *
+	 * Since the shards are index ranges, neighbouring objects are usually held by different
+	 * ranks. For pair queries, exchangeHalo() therefore assigns every object to the owner of
+	 * a slab of space along one axis, with slabs of roughly equal population. Every rank
+	 * receives the objects of its slab and copies of the objects that are within a halo
+	 * width of its slab, and builds a screening Population from them. Pairs found in the
+	 * screening Populations are kept by a single rank only, see filterPairs().
+	 *
+	 * All functions except the accessors are collective and have to be called by all ranks
+	 * of the communicator in the same order.
+	 * \ingroup CPP_API_GROUP
+	 */
+	class DistributedPopulation
+	{
+		public:
+			//! Creates an empty shard on every rank of the communicator, MPI has to be initialized
+			OPI_MPI_EXPORT DistributedPopulation(Host& host, MPI_Comm communicator = MPI_COMM_WORLD);
+			OPI_MPI_EXPORT ~DistributedPopulation();
+
+			//! Returns the shard of this rank
+			/** Call updateLayout() after resizing it. */
+			OPI_MPI_EXPORT Population& getLocal();
+			//! Returns the rank of this process in the communicator
+			OPI_MPI_EXPORT int getRank() const;
+			//! Returns the number of ranks in the communicator
+			OPI_MPI_EXPORT int getRankCount() const;
+			//! Returns the total number of objects of all shards
+			OPI_MPI_EXPORT long long getGlobalSize() const;
+			//! Returns the global index of the first object of this rank's shard
+			OPI_MPI_EXPORT long long getGlobalOffset() const;
+
+			//! Recomputes the global size and offsets after the size of shards has changed
+			OPI_MPI_EXPORT void updateLayout();
+
+			/**
+			 * @brief read Loads a population file or a set of shard files written by write().
+			 *
+			 * A single population file is split into equal ranges that every rank reads for
+			 * itself with Population::read(), so the file is never loaded by one process. If
+			 * the file does not exist, the shards of filename written by the same number of ranks
+			 * are read instead.
+			 * @param filename The name of the population file, or the name passed to write().
+			 * @param fields A combination of FieldMask values selecting the fields to load.
+			 * @return DIRECTORY_NOT_FOUND if neither the file nor matching shards exist, the
+			 * error of Population::read() on any rank, SUCCESS otherwise.
+			 */
+			OPI_MPI_EXPORT ErrorCode read(const char* filename, FieldMask fields = FIELD_ALL);
+
+			//! Stores every shard as a population file, see getShardFileName()
+			OPI_MPI_EXPORT ErrorCode write(const char* filename);
+
+			//! Returns the name of the file write() stores the given shard in
+			/** It is filename followed by the rank and number of ranks, e.g. catalog.opi.3-16. */
+			OPI_MPI_EXPORT static std::string getShardFileName(const char* filename, int rank, int rankCount);
+
+			//! Propagates the shard of every rank, see Propagator::propagate()
+			/** @return The error of a rank that failed, SUCCESS if all ranks succeeded. */
+			OPI_MPI_EXPORT ErrorCode propagate(Propagator& propagator, double julian_day, double dt, PropagationMode mode = MODE_SINGLE_EPOCH);
+
+			/**
+			 * @brief exchangeHalo Builds the screening Population of this rank.
+			 *
+			 * The slab boundaries are placed along the axis of the largest extent of all positions,
+			 * at quantiles of a sample of the positions. Every object is sent to the owner of its
+			 * slab and, as a halo copy, to all ranks whose slab is closer than haloWidth along that
+			 * axis. The screening Population holds the owned objects first, followed by the halo.
+			 * @param haloWidth The width of the halo, e.g. the cube size of a pair query.
+			 * @param fields The fields copied to the screening Population in addition to the
+			 * positions. Fields that no shard holds are skipped.
+			 * @return INVALID_ARGUMENT if the shards have no positions, SUCCESS otherwise.
+			 */
+			OPI_MPI_EXPORT ErrorCode exchangeHalo(double haloWidth, int fields = FIELD_PROPERTIES | FIELD_VELOCITY | FIELD_ACCELERATION);
+
+			//! Returns the screening Population of the last exchangeHalo() call
+			OPI_MPI_EXPORT Population& getScreeningPopulation();
+			//! Returns the number of objects of the screening Population that this rank owns
+			OPI_MPI_EXPORT int getOwnedCount() const;
+			//! Returns the global index of an object of the screening Population
+			OPI_MPI_EXPORT long long getGlobalIndex(int screeningIndex) const;
+			//! Returns the rank owning the slab of an object of the screening Population
+			OPI_MPI_EXPORT int getOwner(int screeningIndex) const;
+
+			//! Removes pairs of the screening Population that are kept by a different rank
+			/** A pair is kept by the lowest owner of its two objects, so a pair is reported once
+			 * by all ranks together if it is found by its owners, which is the case for pairs
+			 * closer than the halo width along the slab axis.
+			 */
+			OPI_MPI_EXPORT void filterPairs(IndexPairList& pairs) const;
+			//! Removes conjunctions that are kept by a different rank, see filterPairs()
+			OPI_MPI_EXPORT void filterConjunctions(std::vector<Conjunction>& conjunctions) const;
+
+			//! Finds the pairs of all shards within cube_size
+			/** Exchanges a halo of cube_size, rebuilds the query on the screening Population and
+			 * filters the result. The pairs refer to the screening Population.
+			 */
+			OPI_MPI_EXPORT ErrorCode queryCubicPairs(DistanceQuery& query, IndexPairList& pairs, float cube_size);
+
+			//! Finds the conjunctions of all shards, see CollisionDetection::detectConjunctions()
+			/** The halo covers the largest displacement of any object within the time window. The
+			 * conjunctions refer to the screening Population.
+			 */
+			OPI_MPI_EXPORT ErrorCode detectConjunctions(CollisionDetection& detection, DistanceQuery* query, std::vector<Conjunction>& conjunctions_out, float threshold, float time_window);
+
+		private:
+			Pimpl<DistributedPopulationImpl> impl;
+	};
+}
+
+#endif